@@ -25,7 +25,7 @@
 
 #include "autotype/AutoTypePlatformPlugin.h"
 #include "autotype/AutoTypeSelectDialog.h"
-#include "autotype/WildcardMatcher.h"
+#include "core/AutoTypeIndex.h"
 #include "core/Config.h"
 #include "core/Database.h"
 #include "core/Entry.h"
@@ -40,7 +40,6 @@ AutoType* AutoType::m_instance = nullptr;
 AutoType::AutoType(QObject* parent, bool test)
     : QObject(parent)
     , m_inAutoType(false)
-    , m_autoTypeDelay(0)
     , m_currentGlobalKey(static_cast<Qt::Key>(0))
     , m_currentGlobalModifiers(0)
     , m_pluginLoader(new QPluginLoader(this))
@@ -143,17 +142,16 @@ void AutoType::performAutoType(const Entry* entry, QWidget* hideWindow, const QS
         sequence = customSequence;
     }
 
-    sequence.replace("{{}", "{LEFTBRACE}");
-    sequence.replace("{}}", "{RIGHTBRACE}");
-
-    QList<AutoTypeAction*> actions;
-    ListDeleter<AutoTypeAction*> actionsDeleter(&actions);
-
-    if (!parseActions(sequence, entry, actions)) {
+    QSharedPointer<const CompiledSequence> compiled = compiledSequence(entry, sequence);
+    if (!compiled) {
         m_inAutoType = false; // TODO: make this automatic
         return;
     }
 
+    QList<AutoTypeAction*> createdActions;
+    ListDeleter<AutoTypeAction*> actionsDeleter(&createdActions);
+    const QList<AutoTypeAction*> actions = expandSequence(*compiled, entry, createdActions);
+
     if (hideWindow) {
 #if defined(Q_OS_MAC)
         m_plugin->raiseLastActiveWindow();
@@ -170,6 +168,8 @@ void AutoType::performAutoType(const Entry* entry, QWidget* hideWindow, const QS
 
     QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
 
+    m_executor->prepare(actions);
+
     for (AutoTypeAction* action : asConst(actions)) {
         if (m_plugin->activeWindow() != window) {
             qWarning("Active window changed, interrupting auto-type.");
@@ -180,6 +180,8 @@ void AutoType::performAutoType(const Entry* entry, QWidget* hideWindow, const QS
         QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
     }
 
+    m_executor->finish();
+
     m_inAutoType = false;
 }
 
@@ -200,13 +202,16 @@ void AutoType::performGlobalAutoType(const QList<Database*>& dbList)
     QList<Entry*> entryList;
     QHash<Entry*, QString> sequenceHash;
 
+    const bool matchTitle = config()->get("AutoTypeEntryTitleMatch").toBool();
+    const bool matchUrl = config()->get("AutoTypeEntryURLMatch").toBool();
+
     for (Database* db : dbList) {
-        const QList<Entry*> dbEntries = db->rootGroup()->entriesRecursive();
-        for (Entry* entry : dbEntries) {
-            QString sequence = autoTypeSequence(entry, windowTitle);
+        const QList<AutoTypeIndex::Match> matches = db->autoTypeIndex()->findEntries(windowTitle, matchTitle, matchUrl);
+        for (const AutoTypeIndex::Match& match : matches) {
+            QString sequence = autoTypeSequence(match.entry, match.sequence);
             if (!sequence.isEmpty()) {
-                entryList << entry;
-                sequenceHash.insert(entry, sequence);
+                entryList << match.entry;
+                sequenceHash.insert(match.entry, sequence);
             }
         }
     }
@@ -320,21 +325,46 @@ int AutoType::callEventFilter(void* event)
     return m_plugin->platformEventFilter(event);
 }
 
-bool AutoType::parseActions(const QString& sequence, const Entry* entry, QList<AutoTypeAction*>& actions)
+/**
+ * Returns the compiled sequence, compiling it if it is not cached for the
+ * database of entry yet. Returns a null pointer if the sequence is invalid.
+ */
+QSharedPointer<const AutoType::CompiledSequence> AutoType::compiledSequence(const Entry* entry,
+                                                                             const QString& sequence)
 {
+    SequenceCache* cache = sequenceCache(entry);
+    if (cache && cache->compiledSequences.contains(sequence)) {
+        return cache->compiledSequences.value(sequence);
+    }
+
+    QSharedPointer<CompiledSequence> compiled(new CompiledSequence());
+    if (!compileSequence(sequence, *compiled)) {
+        return QSharedPointer<const CompiledSequence>();
+    }
+
+    if (cache) {
+        cache->compiledSequences.insert(sequence, compiled);
+    }
+    return compiled;
+}
+
+bool AutoType::compileSequence(const QString& sequence, CompiledSequence& compiled)
+{
+    QString preparedSequence = sequence;
+    preparedSequence.replace("{{}", "{LEFTBRACE}");
+    preparedSequence.replace("{}}", "{RIGHTBRACE}");
+
     QString tmpl;
     bool inTmpl = false;
-    m_autoTypeDelay = config()->get("AutoTypeDelay").toInt();
-
 
-    for (const QChar& ch : sequence) {
+    for (const QChar& ch : asConst(preparedSequence)) {
         if (inTmpl) {
             if (ch == '{') {
                 qWarning("Syntax error in auto-type sequence.");
                 return false;
             }
             else if (ch == '}') {
-                actions.append(createActionFromTemplate(tmpl, entry));
+                compileTemplate(tmpl, compiled);
                 inTmpl = false;
                 tmpl.clear();
             }
@@ -350,24 +380,77 @@ bool AutoType::parseActions(const QString& sequence, const Entry* entry, QList<A
             return false;
         }
         else {
-            actions.append(new AutoTypeChar(ch));
+            SequenceStep step;
+            step.action.reset(new AutoTypeChar(ch));
+            compiled.steps.append(step);
         }
     }
-    if (m_autoTypeDelay > 0) {
-        QList<AutoTypeAction*>::iterator i;
-        i = actions.begin();
-        while (i != actions.end()) {
-            ++i;
-            if (i != actions.end()) {
-                i = actions.insert(i, new AutoTypeDelay(m_autoTypeDelay));
-                ++i;
+
+    return true;
+}
+
+/**
+ * Turns a compiled sequence into the actions to perform, resolving the
+ * placeholders and the TOTP of entry. Actions that are created here are
+ * added to createdActions, the caller has to delete them.
+ */
+QList<AutoTypeAction*> AutoType::expandSequence(const CompiledSequence& compiled, const Entry* entry,
+                                                QList<AutoTypeAction*>& createdActions)
+{
+    QList<AutoTypeAction*> actions;
+
+    const int delay = compiled.delay >= 0 ? compiled.delay : config()->get("AutoTypeDelay").toInt();
+    AutoTypeAction* delayAction = nullptr;
+    if (delay > 0) {
+        delayAction = new AutoTypeDelay(delay);
+        createdActions.append(delayAction);
+    }
+
+    auto appendAction = [&](AutoTypeAction* action) {
+        if (delayAction && !actions.isEmpty()) {
+            actions.append(delayAction);
+        }
+        actions.append(action);
+    };
+    auto appendCreatedAction = [&](AutoTypeAction* action) {
+        createdActions.append(action);
+        appendAction(action);
+    };
+
+    for (const SequenceStep& step : compiled.steps) {
+        if (step.action) {
+            appendAction(step.action.data());
+        }
+        else if (step.totp) {
+            const QString totp = entry->totp();
+            for (const QChar& ch : totp) {
+                appendCreatedAction(new AutoTypeChar(ch));
+            }
+        }
+        else {
+            const QString resolved = entry->resolvePlaceholder(step.placeholder);
+            if (step.placeholder == resolved) {
+                continue;
+            }
+
+            for (const QChar& ch : resolved) {
+                if (ch == '\n') {
+                    appendCreatedAction(new AutoTypeKey(Qt::Key_Enter));
+                }
+                else if (ch == '\t') {
+                    appendCreatedAction(new AutoTypeKey(Qt::Key_Tab));
+                }
+                else {
+                    appendCreatedAction(new AutoTypeChar(ch));
+                }
             }
         }
     }
-    return true;
+
+    return actions;
 }
 
-QList<AutoTypeAction*> AutoType::createActionFromTemplate(const QString& tmpl, const Entry* entry)
+void AutoType::compileTemplate(const QString& tmpl, CompiledSequence& compiled)
 {
     QString tmplName = tmpl;
     int num = -1;
@@ -376,8 +459,8 @@ QList<AutoTypeAction*> AutoType::createActionFromTemplate(const QString& tmpl, c
     QRegExp delayRegEx("delay=(\\d+)", Qt::CaseInsensitive, QRegExp::RegExp2);
     if (delayRegEx.exactMatch(tmplName)) {
         num = delayRegEx.cap(1).toInt();
-        m_autoTypeDelay = std::max(0, std::min(num, 10000));
-        return list;
+        compiled.delay = std::max(0, std::min(num, 10000));
+        return;
     }
 
     QRegExp repeatRegEx("(.+) (\\d+)", Qt::CaseInsensitive, QRegExp::RegExp2);
@@ -386,16 +469,16 @@ QList<AutoTypeAction*> AutoType::createActionFromTemplate(const QString& tmpl, c
         num = repeatRegEx.cap(2).toInt();
 
         if (num == 0) {
-            return list;
+            return;
         }
         // some safety checks
         else if (tmplName.compare("delay",Qt::CaseInsensitive)==0) {
             if (num > 10000) {
-                return list;
+                return;
             }
         }
         else if (num > 100) {
-            return list;
+            return;
         }
     }
 
@@ -515,93 +598,63 @@ QList<AutoTypeAction*> AutoType::createActionFromTemplate(const QString& tmpl, c
         for (int i = 1; i < num; i++) {
             list.append(list.at(0)->clone());
         }
-
-        return list;
     }
-
-
-    if (tmplName.compare("delay",Qt::CaseInsensitive)==0 && num > 0) {
+    else if (tmplName.compare("delay",Qt::CaseInsensitive)==0 && num > 0) {
         list.append(new AutoTypeDelay(num));
     }
     else if (tmplName.compare("clearfield",Qt::CaseInsensitive)==0) {
         list.append(new AutoTypeClearField());
     }
-    else if (tmplName.compare("totp", Qt::CaseInsensitive) == 0) {
-        QString totp = entry->totp();
-        if (!totp.isEmpty()) {
-            for (const QChar& ch : totp) {
-                list.append(new AutoTypeChar(ch));
-            }
+
+    if (!list.isEmpty()) {
+        for (AutoTypeAction* action : asConst(list)) {
+            SequenceStep step;
+            step.action.reset(action);
+            compiled.steps.append(step);
         }
+        return;
     }
 
-    if (!list.isEmpty()) {
-        return list;
+    SequenceStep step;
+    if (tmplName.compare("totp", Qt::CaseInsensitive) == 0) {
+        step.totp = true;
     }
+    else {
+        step.placeholder = QString("{%1}").arg(tmplName);
+    }
+    compiled.steps.append(step);
+}
 
-    const QString placeholder = QString("{%1}").arg(tmplName);
-    const QString resolved = entry->resolvePlaceholder(placeholder);
-    if (placeholder != resolved) {
-        for (const QChar& ch : resolved) {
-            if (ch == '\n') {
-                list.append(new AutoTypeKey(Qt::Key_Enter));
-            }
-            else if (ch == '\t') {
-                list.append(new AutoTypeKey(Qt::Key_Tab));
-            }
-            else {
-                list.append(new AutoTypeChar(ch));
-            }
-        }
+/**
+ * Returns the sequence to type for entry. If customSequence is empty the default
+ * sequence of the entry or of its groups is used.
+ */
+QString AutoType::autoTypeSequence(const Entry* entry, const QString& customSequence)
+{
+    SequenceCache* cache = sequenceCache(entry);
+    if (!cache) {
+        return effectiveSequence(entry, customSequence);
+    }
+
+    const QPair<const Entry*, QString> key(entry, customSequence);
+    QHash<QPair<const Entry*, QString>, QString>::const_iterator i = cache->sequences.constFind(key);
+    if (i != cache->sequences.constEnd()) {
+        return i.value();
     }
 
-    return list;
+    const QString sequence = effectiveSequence(entry, customSequence);
+    cache->sequences.insert(key, sequence);
+    return sequence;
 }
 
-QString AutoType::autoTypeSequence(const Entry* entry, const QString& windowTitle)
+QString AutoType::effectiveSequence(const Entry* entry, const QString& customSequence)
 {
     if (!entry->autoTypeEnabled()) {
         return QString();
     }
 
     bool enableSet = false;
-    QString sequence;
-    if (!windowTitle.isEmpty()) {
-        bool match = false;
-        const QList<AutoTypeAssociations::Association> assocList = entry->autoTypeAssociations()->getAll();
-        for (const AutoTypeAssociations::Association& assoc : assocList) {
-            const QString window = entry->resolveMultiplePlaceholders(assoc.window);
-            if (windowMatches(windowTitle, window)) {
-                if (!assoc.sequence.isEmpty()) {
-                    sequence = assoc.sequence;
-                }
-                else {
-                    sequence = entry->defaultAutoTypeSequence();
-                }
-                match = true;
-                break;
-            }
-        }
-
-        if (!match && config()->get("AutoTypeEntryTitleMatch").toBool() 
-                && windowMatchesTitle(windowTitle, entry->resolvePlaceholder(entry->title()))) {
-            sequence = entry->defaultAutoTypeSequence();
-            match = true;
-        }
-
-        if (!match && config()->get("AutoTypeEntryURLMatch").toBool()
-                && windowMatchesUrl(windowTitle, entry->resolvePlaceholder(entry->url()))) {
-            sequence = entry->defaultAutoTypeSequence();
-            match = true;
-        }
-
-        if (!match) {
-            return QString();
-        }
-    }
-    else {
-        sequence = entry->defaultAutoTypeSequence();
-    }
+    QString sequence = customSequence.isEmpty() ? entry->defaultAutoTypeSequence() : customSequence;
 
     const Group* group = entry->group();
     do {
@@ -636,32 +689,35 @@ QString AutoType::autoTypeSequence(const Entry* entry, const QString& windowTitl
     return sequence;
 }
 
-bool AutoType::windowMatches(const QString& windowTitle, const QString& windowPattern)
+/**
+ * Returns the sequence cache of the database of entry, nullptr if the entry
+ * is not part of a database.
+ */
+AutoType::SequenceCache* AutoType::sequenceCache(const Entry* entry)
 {
-    if (windowPattern.startsWith("//") && windowPattern.endsWith("//") && windowPattern.size() >= 4) {
-        QRegExp regExp(windowPattern.mid(2, windowPattern.size() - 4), Qt::CaseInsensitive, QRegExp::RegExp2);
-        return (regExp.indexIn(windowTitle) != -1);
+    const Group* group = entry->group();
+    const Database* db = group ? group->database() : nullptr;
+    if (!db) {
+        return nullptr;
     }
-    else {
-        return WildcardMatcher(windowTitle).match(windowPattern);
+
+    if (!m_sequenceCaches.contains(db)) {
+        connect(db, SIGNAL(modifiedImmediate()), SLOT(invalidateSequenceCache()));
+        connect(db, SIGNAL(destroyed(QObject*)), SLOT(removeSequenceCache(QObject*)));
     }
-}
 
-bool AutoType::windowMatchesTitle(const QString& windowTitle, const QString& resolvedTitle)
-{
-    return !resolvedTitle.isEmpty() && windowTitle.contains(resolvedTitle, Qt::CaseInsensitive);
+    return &m_sequenceCaches[db];
 }
 
-bool AutoType::windowMatchesUrl(const QString& windowTitle, const QString& resolvedUrl)
+void AutoType::invalidateSequenceCache()
 {
-    if (!resolvedUrl.isEmpty() && windowTitle.contains(resolvedUrl, Qt::CaseInsensitive)) {
-        return true;
-    }
-
-    QUrl url(resolvedUrl);
-    if (url.isValid() && !url.host().isEmpty()) {
-        return windowTitle.contains(url.host(), Qt::CaseInsensitive);
+    QHash<const QObject*, SequenceCache>::iterator i = m_sequenceCaches.find(sender());
+    if (i != m_sequenceCaches.end()) {
+        i.value().sequences.clear();
     }
+}
 
-    return false;
+void AutoType::removeSequenceCache(QObject* database)
+{
+    m_sequenceCaches.remove(database);
 }
@@ -19,8 +19,12 @@
 #ifndef KEEPASSX_AUTOTYPE_H
 #define KEEPASSX_AUTOTYPE_H
 
+#include <QHash>
 #include <QObject>
+#include <QPair>
+#include <QSharedPointer>
 #include <QStringList>
+#include <QVector>
 #include <QWidget>
 
 class AutoTypeAction;
@@ -58,6 +62,8 @@ signals:
 
 private slots:
     void performAutoTypeFromGlobal(Entry* entry, const QString& sequence);
+    void invalidateSequenceCache();
+    void removeSequenceCache(QObject* database);
     void resetInAutoType();
     void unloadPlugin();
 
@@ -65,21 +71,54 @@ private:
     explicit AutoType(QObject* parent = nullptr, bool test = false);
     ~AutoType();
     void loadPlugin(const QString& pluginPath);
-    bool parseActions(const QString& sequence, const Entry* entry, QList<AutoTypeAction*>& actions);
-    QList<AutoTypeAction*> createActionFromTemplate(const QString& tmpl, const Entry* entry);
-    QString autoTypeSequence(const Entry* entry, const QString& windowTitle = QString());
-    bool windowMatchesTitle(const QString& windowTitle, const QString& resolvedTitle);
-    bool windowMatchesUrl(const QString& windowTitle, const QString& resolvedUrl);
-    bool windowMatches(const QString& windowTitle, const QString& windowPattern);
+
+    /**
+     * One step of a compiled sequence. Keys, characters, delays and clearing
+     * the field are compiled into actions; placeholders and the TOTP are
+     * resolved when the sequence is typed.
+     */
+    struct SequenceStep
+    {
+        QSharedPointer<AutoTypeAction> action;
+        QString placeholder;
+        bool totp = false;
+    };
+
+    struct CompiledSequence
+    {
+        QVector<SequenceStep> steps;
+        /** The {DELAY=X} of the sequence, -1 to use the configured delay. */
+        int delay = -1;
+    };
+
+    /**
+     * Sequences and compiled sequences of one database, dropped when the
+     * database is destroyed. The effective sequences are cleared on every
+     * change to the database.
+     */
+    struct SequenceCache
+    {
+        QHash<QPair<const Entry*, QString>, QString> sequences;
+        QHash<QString, QSharedPointer<const CompiledSequence>> compiledSequences;
+    };
+
+    QSharedPointer<const CompiledSequence> compiledSequence(const Entry* entry, const QString& sequence);
+    static bool compileSequence(const QString& sequence, CompiledSequence& compiled);
+    static void compileTemplate(const QString& tmpl, CompiledSequence& compiled);
+    QList<AutoTypeAction*> expandSequence(const CompiledSequence& compiled, const Entry* entry,
+                                          QList<AutoTypeAction*>& createdActions);
+    SequenceCache* sequenceCache(const Entry* entry);
+    QString autoTypeSequence(const Entry* entry, const QString& customSequence = QString());
+    QString effectiveSequence(const Entry* entry, const QString& customSequence);
 
     bool m_inAutoType;
-    int m_autoTypeDelay;
     Qt::Key m_currentGlobalKey;
     Qt::KeyboardModifiers m_currentGlobalModifiers;
     QPluginLoader* m_pluginLoader;
     AutoTypePlatformInterface* m_plugin;
     AutoTypeExecutor* m_executor;
     WId m_windowFromGlobal;
+    QHash<const QObject*, SequenceCache> m_sequenceCaches;
     static AutoType* m_instance;
 
     Q_DISABLE_COPY(AutoType)
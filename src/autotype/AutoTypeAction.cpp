@@ -82,6 +82,23 @@ void AutoTypeClearField::accept(AutoTypeExecutor* executor)
 }
 
 
+/**
+ * Called with all actions of a sequence before the first one is executed,
+ * so executors can prepare for the whole sequence at once.
+ */
+void AutoTypeExecutor::prepare(const QList<AutoTypeAction*>& actions)
+{
+    Q_UNUSED(actions);
+}
+
+/**
+ * Called after the last action of a sequence was executed or typing was
+ * interrupted.
+ */
+void AutoTypeExecutor::finish()
+{
+}
+
 void AutoTypeExecutor::execDelay(AutoTypeDelay* action)
 {
     Tools::wait(action->delayMs);
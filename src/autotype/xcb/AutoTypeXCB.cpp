@@ -21,9 +21,13 @@
 #include "KeySymMap.h"
 #include "core/Tools.h"
 
+#include <algorithm>
 #include <time.h>
 #include <xcb/xcb.h>
 
+/* how often a batch looks up the modifiers the user holds */
+static const qint64 BATCH_MODIFIER_REFRESH_MS = 100;
+
 bool AutoTypePlatformX11::m_catchXErrors = false;
 bool AutoTypePlatformX11::m_xErrorOccurred = false;
 int (*AutoTypePlatformX11::m_oldXErrorHandler)(Display*, XErrorEvent*) = nullptr;
@@ -57,6 +61,10 @@ AutoTypePlatformX11::AutoTypePlatformX11()
 
     m_loaded = true;
 
+    m_batch = false;
+    m_batchModifiers = 0;
+    m_batchErrorHandler = nullptr;
+
     updateKeymap();
 }
 
@@ -643,6 +651,11 @@ int AutoTypePlatformX11::AddKeysym(KeySym keysym)
  */
 void AutoTypePlatformX11::SendKeyEvent(unsigned keycode, bool press)
 {
+    if (m_batch) {
+        XTestFakeKeyEvent(m_dpy, keycode, press, 0);
+        return;
+    }
+
     XSync(m_dpy, False);
     int (*oldHandler) (Display*, XErrorEvent*) = XSetErrorHandler(MyErrorHandler);
 
@@ -672,6 +685,13 @@ void AutoTypePlatformX11::SendModifiers(unsigned int mask, bool press)
  */
 int AutoTypePlatformX11::GetKeycode(KeySym keysym, unsigned int *mask)
 {
+    if (m_batch) {
+        int keycode = m_mappedKeycodes.value(keysym, 0);
+        if (keycode && keysymModifiers(keysym, keycode, mask)) {
+            return keycode;
+        }
+    }
+
     int keycode = XKeysymToKeycode(m_dpy, keysym);
 
     if (keycode && keysymModifiers(keysym, keycode, mask)) {
@@ -738,8 +758,18 @@ void AutoTypePlatformX11::SendKey(KeySym keysym, unsigned int modifiers)
     int root_x, root_y, x, y;
     unsigned int original_mask;
 
-    XSync(m_dpy, False);
-    XQueryPointer(m_dpy, m_rootWindow, &root, &child, &root_x, &root_y, &x, &y, &original_mask);
+    if (m_batch) {
+        // the user may press or release modifiers while we type
+        if (m_batchTimer.hasExpired(BATCH_MODIFIER_REFRESH_MS)) {
+            XQueryPointer(m_dpy, m_rootWindow, &root, &child, &root_x, &root_y, &x, &y, &m_batchModifiers);
+            m_batchTimer.restart();
+        }
+        original_mask = m_batchModifiers;
+    }
+    else {
+        XSync(m_dpy, False);
+        XQueryPointer(m_dpy, m_rootWindow, &root, &child, &root_x, &root_y, &x, &y, &original_mask);
+    }
 
     // modifiers that need to be pressed but aren't
     unsigned int press_mask = wanted_mask & ~original_mask;
@@ -791,11 +821,142 @@ void AutoTypePlatformX11::SendKey(KeySym keysym, unsigned int modifiers)
 
     /* restore previous modifiers mask */
     SendModifiers(press_mask & ~LockMask, false);
-    SendModifiers(release_mask & ~LockMask, true);
+    if (m_batch) {
+        // the user may have let go of a released modifier by now, pressing it
+        // again would leave it stuck, so it stays released for the batch
+        m_batchModifiers &= ~(release_mask & ~LockMask);
+    }
+    else {
+        SendModifiers(release_mask & ~LockMask, true);
+    }
     if ((release_mask | press_mask) & LockMask) {
         SendModifiers(LockMask, true);
         SendModifiers(LockMask, false);
     }
+
+    if (m_batch) {
+        XFlush(m_dpy);
+    }
+}
+
+/*
+ * Start typing a sequence of keysyms in one batch. The keysyms that are
+ * missing in the keymap are mapped up front and the modifier state is only
+ * queried every BATCH_MODIFIER_REFRESH_MS, so most keys need no round trip
+ * to the X server. Modifiers that have to be released for a key are not
+ * pressed again until the batch ends.
+ */
+void AutoTypePlatformX11::beginBatch(const QList<KeySym>& keysyms)
+{
+    Q_ASSERT(!m_batch);
+
+    mapKeysyms(keysyms);
+
+    Window root, child;
+    int root_x, root_y, x, y;
+    XSync(m_dpy, False);
+    XQueryPointer(m_dpy, m_rootWindow, &root, &child, &root_x, &root_y, &x, &y, &m_batchModifiers);
+    m_batchTimer.start();
+
+    m_batchErrorHandler = XSetErrorHandler(MyErrorHandler);
+    m_batch = true;
+}
+
+/*
+ * The modifiers released during the batch are left to the keyboard: the
+ * ones the user still holds come back with the next key event, pressing
+ * them here could leave modifiers stuck that were let go of meanwhile.
+ */
+void AutoTypePlatformX11::endBatch()
+{
+    if (!m_batch) {
+        return;
+    }
+
+    XSync(m_dpy, False);
+    XSetErrorHandler(m_batchErrorHandler);
+    m_batch = false;
+}
+
+/*
+ * Map all keysyms that can't be typed with the current keymap to spare
+ * keycodes at once, with a single keymap update instead of one per key.
+ * The dedicated remap keycode is left alone for keysyms that don't fit.
+ */
+void AutoTypePlatformX11::mapKeysyms(const QList<KeySym>& keysyms)
+{
+    QList<KeySym> missing;
+    for (KeySym keysym : keysyms) {
+        if (keysym == NoSymbol || missing.contains(keysym)) {
+            continue;
+        }
+
+        unsigned int mask;
+        int keycode = m_mappedKeycodes.value(keysym, 0);
+        if (keycode && keysymModifiers(keysym, keycode, &mask)) {
+            continue;
+        }
+
+        keycode = XKeysymToKeycode(m_dpy, keysym);
+        if (keycode && keysymModifiers(keysym, keycode, &mask)) {
+            continue;
+        }
+
+        missing.append(keysym);
+    }
+
+    if (missing.isEmpty()) {
+        return;
+    }
+
+    /* reuse the keycodes of earlier batches before taking unused ones */
+    QList<int> spareKeycodes;
+    for (QHash<KeySym, int>::const_iterator i = m_mappedKeycodes.constBegin(); i != m_mappedKeycodes.constEnd(); ++i) {
+        if (!keysyms.contains(i.key())) {
+            spareKeycodes.append(i.value());
+        }
+    }
+    for (int keycode = m_minKeycode; keycode <= m_maxKeycode; keycode++) {
+        int inx = (keycode - m_minKeycode) * m_keysymPerKeycode;
+        if (keycode != static_cast<int>(m_remapKeycode) && m_keysymTable[inx] == NoSymbol) {
+            spareKeycodes.append(keycode);
+        }
+    }
+
+    QList<int> changedKeycodes;
+    for (KeySym keysym : asConst(missing)) {
+        if (spareKeycodes.isEmpty()) {
+            break;
+        }
+
+        int keycode = spareKeycodes.takeFirst();
+        int inx = (keycode - m_minKeycode) * m_keysymPerKeycode;
+        m_mappedKeycodes.remove(m_keysymTable[inx]);
+        m_mappedKeycodes.insert(keysym, keycode);
+        m_keysymTable[inx] = keysym;
+        changedKeycodes.append(keycode);
+    }
+
+    if (changedKeycodes.isEmpty()) {
+        return;
+    }
+
+    /* one request per run of contiguous keycodes, the table has them next to each other */
+    std::sort(changedKeycodes.begin(), changedKeycodes.end());
+    int first = 0;
+    for (int i = 1; i <= changedKeycodes.size(); i++) {
+        if (i < changedKeycodes.size() && changedKeycodes.at(i) == changedKeycodes.at(i - 1) + 1) {
+            continue;
+        }
+
+        int keycode = changedKeycodes.at(first);
+        int inx = (keycode - m_minKeycode) * m_keysymPerKeycode;
+        XChangeKeyboardMapping(m_dpy, keycode, m_keysymPerKeycode, &m_keysymTable[inx], i - first);
+        first = i;
+    }
+
+    XFlush(m_dpy);
+    updateKeymap();
 }
 
 int AutoTypePlatformX11::MyErrorHandler(Display* my_dpy, XErrorEvent* event)
@@ -811,11 +972,68 @@ int AutoTypePlatformX11::MyErrorHandler(Display* my_dpy, XErrorEvent* event)
 }
 
 
+namespace {
+    /**
+     * Collects the keysyms of the actions of a sequence.
+     */
+    class KeySymCollector : public AutoTypeExecutor
+    {
+    public:
+        explicit KeySymCollector(AutoTypePlatformX11* platform)
+            : m_platform(platform)
+        {
+        }
+
+        void execChar(AutoTypeChar* action) override
+        {
+            keysyms.append(m_platform->charToKeySym(action->character));
+        }
+
+        void execKey(AutoTypeKey* action) override
+        {
+            keysyms.append(m_platform->keyToKeySym(action->key));
+        }
+
+        void execDelay(AutoTypeDelay* action) override
+        {
+            Q_UNUSED(action);
+        }
+
+        void execClearField(AutoTypeClearField* action) override
+        {
+            Q_UNUSED(action);
+            keysyms.append(m_platform->keyToKeySym(Qt::Key_Home));
+            keysyms.append(m_platform->keyToKeySym(Qt::Key_End));
+            keysyms.append(m_platform->keyToKeySym(Qt::Key_Backspace));
+        }
+
+        QList<KeySym> keysyms;
+
+    private:
+        AutoTypePlatformX11* const m_platform;
+    };
+}
+
 AutoTypeExecutorX11::AutoTypeExecutorX11(AutoTypePlatformX11* platform)
     : m_platform(platform)
 {
 }
 
+void AutoTypeExecutorX11::prepare(const QList<AutoTypeAction*>& actions)
+{
+    KeySymCollector collector(m_platform);
+    for (AutoTypeAction* action : actions) {
+        action->accept(&collector);
+    }
+
+    m_platform->beginBatch(collector.keysyms);
+}
+
+void AutoTypeExecutorX11::finish()
+{
+    m_platform->endBatch();
+}
+
 void AutoTypeExecutorX11::execChar(AutoTypeChar* action)
 {
     m_platform->SendKey(m_platform->charToKeySym(action->character));
@@ -21,6 +21,8 @@
 #define KEEPASSX_AUTOTYPEXCB_H
 
 #include <QApplication>
+#include <QElapsedTimer>
+#include <QHash>
 #include <QSet>
 #include <QtPlugin>
 #include <QWidget>
@@ -59,6 +61,8 @@ public:
     KeySym keyToKeySym(Qt::Key key);
 
     void SendKey(KeySym keysym, unsigned int modifiers = 0);
+    void beginBatch(const QList<KeySym>& keysyms);
+    void endBatch();
 
 signals:
     void globalShortcutTriggered();
@@ -83,6 +87,7 @@ private:
     void SendModifiers(unsigned int mask, bool press);
     int GetKeycode(KeySym keysym, unsigned int *mask);
     bool keysymModifiers(KeySym keysym, int keycode, unsigned int *mask);
+    void mapKeysyms(const QList<KeySym>& keysyms);
 
     static int MyErrorHandler(Display* my_dpy, XErrorEvent* event);
 
@@ -118,6 +123,14 @@ private:
     KeySym m_currentRemapKeysym;
     KeyCode m_modifier_keycode[N_MOD_INDICES];
     bool m_loaded;
+
+    /* batched typing: no round trip to the X server per key */
+    bool m_batch;
+    unsigned int m_batchModifiers;
+    QElapsedTimer m_batchTimer;
+    int (*m_batchErrorHandler)(Display*, XErrorEvent*);
+    /* spare keycodes remapped to keysyms that are missing in the keymap */
+    QHash<KeySym, int> m_mappedKeycodes;
 };
 
 class AutoTypeExecutorX11 : public AutoTypeExecutor
@@ -125,6 +138,8 @@ class AutoTypeExecutorX11 : public AutoTypeExecutor
 public:
     explicit AutoTypeExecutorX11(AutoTypePlatformX11* platform);
 
+    void prepare(const QList<AutoTypeAction*>& actions) override;
+    void finish() override;
     void execChar(AutoTypeChar* action) override;
     void execKey(AutoTypeKey* action) override;
     void execClearField(AutoTypeClearField* action) override;
@@ -0,0 +1,130 @@
+/*
+ *  Copyright (C) 2017 KeePassXC Team <team@keepassxc.org>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 or (at your option)
+ *  version 3 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdlib>
+#include <stdio.h>
+
+#include "Analyze.h"
+
+#include <QCommandLineParser>
+#include <QStringList>
+#include <QTextStream>
+
+#include "core/Database.h"
+#include "core/Entry.h"
+#include "core/Group.h"
+#include "core/PasswordHealth.h"
+
+Analyze::Analyze()
+{
+    this->name = QString("analyze");
+    this->description = QObject::tr("Analyze the passwords of a database.");
+}
+
+Analyze::~Analyze()
+{
+}
+
+int Analyze::execute(QStringList arguments)
+{
+    QTextStream out(stdout);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(this->description);
+    parser.addPositionalArgument("database", QObject::tr("Path of the database."));
+    QCommandLineOption keyFile(QStringList() << "k"
+                                             << "key-file",
+                               QObject::tr("Key file of the database."),
+                               QObject::tr("path"));
+    parser.addOption(keyFile);
+    QCommandLineOption weakEntropy(QStringList() << "w"
+                                                 << "weak-entropy",
+                                   QObject::tr("Passwords with less entropy are weak. Default is 40."),
+                                   QObject::tr("bits"));
+    parser.addOption(weakEntropy);
+    QCommandLineOption staleDays(QStringList() << "d"
+                                               << "stale-days",
+                                 QObject::tr("Passwords that weren't changed for longer are old. Default is 365."),
+                                 QObject::tr("days"));
+    parser.addOption(staleDays);
+    parser.process(arguments);
+
+    const QStringList args = parser.positionalArguments();
+    if (args.size() != 1) {
+        out << parser.helpText().replace("keepassxc-cli", "keepassxc-cli analyze");
+        return EXIT_FAILURE;
+    }
+
+    double weakBits = 40.0;
+    if (parser.isSet(weakEntropy)) {
+        bool ok;
+        weakBits = parser.value(weakEntropy).toDouble(&ok);
+        if (!ok || weakBits < 0) {
+            qCritical("Invalid entropy %s.", qPrintable(parser.value(weakEntropy)));
+            return EXIT_FAILURE;
+        }
+    }
+
+    int days = 365;
+    if (parser.isSet(staleDays)) {
+        bool ok;
+        days = parser.value(staleDays).toInt(&ok);
+        if (!ok || days < 0) {
+            qCritical("Invalid number of days %s.", qPrintable(parser.value(staleDays)));
+            return EXIT_FAILURE;
+        }
+    }
+
+    Database* db = Database::unlockFromStdin(args.at(0), parser.value(keyFile));
+    if (!db) {
+        return EXIT_FAILURE;
+    }
+
+    return this->analyzeDatabase(db, weakBits, days);
+}
+
+int Analyze::analyzeDatabase(Database* database, double weakEntropy, int staleDays)
+{
+    QTextStream outputTextStream(stdout, QIODevice::WriteOnly);
+
+    PasswordHealth* health = database->passwordHealth();
+    health->setWeakEntropy(weakEntropy);
+    health->setStaleDays(staleDays);
+    const QList<PasswordHealth::Report> reports = health->analyze(database->rootGroup());
+
+    int problemCount = 0;
+    for (const PasswordHealth::Report& report : reports) {
+        if (!report.problems) {
+            continue;
+        }
+        problemCount++;
+
+        QString path = report.entry->title();
+        for (const Group* group = report.entry->group(); group && group->parentGroup(); group = group->parentGroup()) {
+            path.prepend(group->name() + "/");
+        }
+
+        outputTextStream << path << ": " << PasswordHealth::problemsToString(report.problems);
+        if (report.entropy >= 0) {
+            outputTextStream << QObject::tr(" (entropy %1 bit)").arg(QString::number(report.entropy, 'f', 2));
+        }
+        outputTextStream << endl;
+    }
+
+    outputTextStream << QObject::tr("%1 of %2 entries have problems.").arg(problemCount).arg(reports.size()) << endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,243 @@
+/*
+ *  Copyright (C) 2017 KeePassXC Team <team@keepassxc.org>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 or (at your option)
+ *  version 3 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "AsyncEntrySearcher.h"
+
+#include <QThread>
+#include <QtConcurrent>
+
+#include "core/EntrySearcher.h"
+#include "core/Global.h"
+#include "core/Group.h"
+
+const int AsyncEntrySearcher::MinPartitionSize = 256;
+
+AsyncEntrySearcher::AsyncEntrySearcher(QObject* parent)
+    : QObject(parent)
+    , m_nextPartition(0)
+    , m_caseSensitivity(Qt::CaseInsensitive)
+    , m_resultsComplete(false)
+    , m_resultsStale(false)
+{
+}
+
+AsyncEntrySearcher::~AsyncEntrySearcher()
+{
+    cancel();
+}
+
+void AsyncEntrySearcher::search(const QString& searchTerm, Group* group, Qt::CaseSensitivity caseSensitivity)
+{
+    Q_ASSERT(group);
+
+    cancel();
+
+    EntrySearcher searcher;
+    const QStringList words = EntrySearcher::searchWords(searchTerm);
+
+    QList<Entry*> candidates;
+    if (!group->resolveSearchingEnabled()) {
+        // nothing to search
+    }
+    else if (narrowsResults(words, group, caseSensitivity)) {
+        for (const QPointer<Entry>& entry : asConst(m_results)) {
+            if (entry) {
+                candidates.append(entry);
+            }
+        }
+    }
+    else {
+        candidates = searcher.candidateEntries(words, group, caseSensitivity);
+    }
+
+    if (m_database != group->database()) {
+        if (m_database) {
+            disconnect(m_database, nullptr, this, nullptr);
+        }
+        m_database = group->database();
+        if (m_database) {
+            connect(m_database, SIGNAL(modifiedImmediate()), SLOT(invalidateResults()));
+        }
+    }
+
+    m_group = group;
+    m_words = words;
+    m_caseSensitivity = caseSensitivity;
+    m_results.clear();
+    m_resultsComplete = false;
+    m_resultsStale = false;
+
+    // the worker threads only get copies of the field values, never the entries
+    QSharedPointer<SearchJob> job(new SearchJob());
+    job->words = words;
+    job->caseSensitivity = caseSensitivity;
+    job->items.reserve(candidates.size());
+    for (Entry* entry : asConst(candidates)) {
+        const EntrySearcher::GroupScope scope = searcher.groupScope(entry->group(), group, words, caseSensitivity);
+        if (scope == EntrySearcher::GroupScope::Excluded) {
+            continue;
+        }
+
+        SearchItem item;
+        item.entry = entry;
+        item.included = (scope == EntrySearcher::GroupScope::Included);
+        if (!item.included) {
+            item.fields = EntrySearcher::searchableFields(entry);
+        }
+        job->items.append(item);
+    }
+    m_job = job;
+
+    const int itemCount = job->items.size();
+    const int partitionCount = qBound(1, itemCount / MinPartitionSize, QThread::idealThreadCount() * 4);
+    for (int i = 0; i < partitionCount; ++i) {
+        const int begin = itemCount * i / partitionCount;
+        const int end = itemCount * (i + 1) / partitionCount;
+
+        QFutureWatcher<QVector<int>>* watcher = new QFutureWatcher<QVector<int>>(this);
+        connect(watcher, SIGNAL(finished()), SLOT(partitionFinished()));
+        watcher->setFuture(QtConcurrent::run(&AsyncEntrySearcher::matchPartition, job, begin, end));
+        m_partitions.append(watcher);
+    }
+}
+
+void AsyncEntrySearcher::cancel()
+{
+    if (m_job) {
+        m_job->cancelled.store(1);
+        m_job.reset();
+    }
+
+    clearPartitions();
+
+    if (!m_resultsComplete) {
+        m_results.clear();
+    }
+}
+
+bool AsyncEntrySearcher::isSearching() const
+{
+    return !m_job.isNull();
+}
+
+void AsyncEntrySearcher::partitionFinished()
+{
+    if (!m_job) {
+        return;
+    }
+
+    // results are only reported in tree order
+    QList<Entry*> entries;
+    while (m_nextPartition < m_partitions.size() && m_partitions[m_nextPartition]->isFinished()) {
+        const QVector<int> matches = m_partitions[m_nextPartition]->result();
+        for (int index : matches) {
+            Entry* entry = m_job->items.at(index).entry;
+            if (entry) {
+                entries.append(entry);
+                m_results.append(entry);
+            }
+        }
+        m_nextPartition++;
+    }
+
+    const bool done = (m_nextPartition == m_partitions.size());
+    if (done) {
+        m_job.reset();
+        clearPartitions();
+        m_resultsComplete = !m_resultsStale;
+    }
+
+    if (!entries.isEmpty()) {
+        QSharedPointer<SearchJob> job = m_job;
+        emit entriesFound(entries);
+        if (job != m_job) {
+            // a new search was started in the meantime
+            return;
+        }
+    }
+
+    if (done) {
+        emit finished();
+    }
+}
+
+/**
+ * The database changed, so the current results can't be used to narrow
+ * down the next search.
+ */
+void AsyncEntrySearcher::invalidateResults()
+{
+    m_resultsStale = true;
+    m_resultsComplete = false;
+}
+
+QVector<int> AsyncEntrySearcher::matchPartition(QSharedPointer<SearchJob> job, int begin, int end)
+{
+    QVector<int> matches;
+    for (int i = begin; i < end; ++i) {
+        if (job->cancelled.load()) {
+            return QVector<int>();
+        }
+
+        const SearchItem& item = job->items.at(i);
+        if (item.included || EntrySearcher::matchWords(job->words, item.fields, job->caseSensitivity)) {
+            matches.append(i);
+        }
+    }
+
+    return matches;
+}
+
+/**
+ * Returns true if all results of the new search are part of the previous results.
+ * This is the case if every previous search word is contained in one of the new words.
+ */
+bool AsyncEntrySearcher::narrowsResults(const QStringList& words, const Group* group,
+                                        Qt::CaseSensitivity caseSensitivity) const
+{
+    if (!m_resultsComplete || m_group != group || m_caseSensitivity != caseSensitivity) {
+        return false;
+    }
+
+    for (const QString& previousWord : m_words) {
+        bool found = false;
+        for (const QString& word : words) {
+            if (word.contains(previousWord, caseSensitivity)) {
+                found = true;
+                break;
+            }
+        }
+
+        if (!found) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void AsyncEntrySearcher::clearPartitions()
+{
+    for (QFutureWatcher<QVector<int>>* watcher : asConst(m_partitions)) {
+        disconnect(watcher, nullptr, this, nullptr);
+        watcher->deleteLater();
+    }
+
+    m_partitions.clear();
+    m_nextPartition = 0;
+}
@@ -0,0 +1,100 @@
+/*
+ *  Copyright (C) 2017 KeePassXC Team <team@keepassxc.org>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 or (at your option)
+ *  version 3 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef KEEPASSX_ASYNCENTRYSEARCHER_H
+#define KEEPASSX_ASYNCENTRYSEARCHER_H
+
+#include <QAtomicInt>
+#include <QFutureWatcher>
+#include <QObject>
+#include <QPointer>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QVector>
+
+class Database;
+class Entry;
+class Group;
+
+/**
+ * Runs searches on the global thread pool. The candidate entries are split
+ * into partitions that are matched in parallel, results are reported in tree
+ * order as soon as all partitions before them are done.
+ *
+ * Starting a new search cancels the running one. If the new search term only
+ * narrows down the previous one, just the previous results are searched again.
+ */
+class AsyncEntrySearcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit AsyncEntrySearcher(QObject* parent = nullptr);
+    ~AsyncEntrySearcher();
+
+    void search(const QString& searchTerm, Group* group, Qt::CaseSensitivity caseSensitivity);
+    void cancel();
+    bool isSearching() const;
+
+signals:
+    /**
+     * Emitted with the next part of the results of the current search.
+     */
+    void entriesFound(const QList<Entry*>& entries);
+    void finished();
+
+private slots:
+    void partitionFinished();
+    void invalidateResults();
+
+private:
+    struct SearchItem
+    {
+        QPointer<Entry> entry;
+        QStringList fields;
+        bool included;
+    };
+
+    struct SearchJob
+    {
+        QStringList words;
+        Qt::CaseSensitivity caseSensitivity;
+        QVector<SearchItem> items;
+        QAtomicInt cancelled;
+    };
+
+    static QVector<int> matchPartition(QSharedPointer<SearchJob> job, int begin, int end);
+    bool narrowsResults(const QStringList& words, const Group* group, Qt::CaseSensitivity caseSensitivity) const;
+    void clearPartitions();
+
+    QSharedPointer<SearchJob> m_job;
+    QList<QFutureWatcher<QVector<int>>*> m_partitions;
+    int m_nextPartition;
+
+    QPointer<Database> m_database;
+    QPointer<Group> m_group;
+    QStringList m_words;
+    Qt::CaseSensitivity m_caseSensitivity;
+    QList<QPointer<Entry>> m_results;
+    bool m_resultsComplete;
+    bool m_resultsStale;
+
+    static const int MinPartitionSize;
+};
+
+#endif // KEEPASSX_ASYNCENTRYSEARCHER_H
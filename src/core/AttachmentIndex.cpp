@@ -0,0 +1,86 @@
+/*
+ *  Copyright (C) 2017 KeePassXC Team <team@keepassxc.org>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 or (at your option)
+ *  version 3 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "AttachmentIndex.h"
+
+#include <algorithm>
+
+#include "core/Database.h"
+#include "core/Entry.h"
+#include "core/EntryAttachments.h"
+#include "core/Group.h"
+
+AttachmentIndex::AttachmentIndex(Group* rootGroup)
+{
+    const QList<Entry*> entries = rootGroup->entriesRecursive();
+    for (Entry* entry : entries) {
+        m_dirty.insert(entry);
+    }
+}
+
+AttachmentIndex::~AttachmentIndex()
+{
+}
+
+void AttachmentIndex::invalidateEntry(Entry* entry)
+{
+    m_dirty.insert(entry);
+}
+
+void AttachmentIndex::removeEntry(Entry* entry)
+{
+    m_dirty.remove(entry);
+
+    const QStringList keys = m_keys.take(entry);
+    for (const QString& key : keys) {
+        QHash<QString, QSet<Entry*>>::iterator i = m_entries.find(key);
+        if (i == m_entries.end()) {
+            continue;
+        }
+
+        i.value().remove(entry);
+        if (i.value().isEmpty()) {
+            m_entries.erase(i);
+        }
+    }
+}
+
+QList<Entry*> AttachmentIndex::findEntries(const QString& key)
+{
+    update();
+
+    QList<Entry*> result = m_entries.value(key).toList();
+    std::sort(result.begin(), result.end(), Database::isBeforeInTree);
+    return result;
+}
+
+void AttachmentIndex::update()
+{
+    const QSet<Entry*> dirtyEntries = m_dirty;
+    m_dirty.clear();
+    for (Entry* entry : dirtyEntries) {
+        removeEntry(entry);
+
+        const QStringList keys = entry->attachments()->keys();
+        for (const QString& key : keys) {
+            m_entries[key].insert(entry);
+        }
+        if (!keys.isEmpty()) {
+            m_keys.insert(entry, keys);
+        }
+    }
+}
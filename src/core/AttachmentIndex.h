@@ -0,0 +1,57 @@
+/*
+ *  Copyright (C) 2017 KeePassXC Team <team@keepassxc.org>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 or (at your option)
+ *  version 3 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef KEEPASSX_ATTACHMENTINDEX_H
+#define KEEPASSX_ATTACHMENTINDEX_H
+
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+
+class Entry;
+class Group;
+
+/**
+ * Index of the entries by the names of their attachments, so that features
+ * that store their settings in a well-known attachment (like KeeAgent) do not
+ * have to look at every entry of the database.
+ *
+ * Changed entries are reindexed when the index is queried the next time.
+ */
+class AttachmentIndex
+{
+public:
+    explicit AttachmentIndex(Group* rootGroup);
+    ~AttachmentIndex();
+
+    void invalidateEntry(Entry* entry);
+    void removeEntry(Entry* entry);
+
+    /**
+     * Returns the entries that have an attachment named key, in tree order.
+     */
+    QList<Entry*> findEntries(const QString& key);
+
+private:
+    void update();
+
+    QHash<QString, QSet<Entry*>> m_entries;
+    QHash<Entry*, QStringList> m_keys;
+    QSet<Entry*> m_dirty;
+};
+
+#endif // KEEPASSX_ATTACHMENTINDEX_H
@@ -0,0 +1,342 @@
+/*
+ *  Copyright (C) 2017 KeePassXC Team <team@keepassxc.org>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 or (at your option)
+ *  version 3 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "AutoTypeIndex.h"
+
+#include <QUrl>
+#include <algorithm>
+
+#include "core/Database.h"
+#include "core/Entry.h"
+#include "core/Global.h"
+#include "core/Group.h"
+
+AutoTypeIndex::AutoTypeIndex(Group* rootGroup)
+    : m_automatonDirty(true)
+{
+    const QList<Entry*> entries = rootGroup->entriesRecursive();
+    for (Entry* entry : entries) {
+        m_dirty.insert(entry);
+    }
+}
+
+AutoTypeIndex::~AutoTypeIndex()
+{
+}
+
+void AutoTypeIndex::invalidateEntry(Entry* entry)
+{
+    m_dirty.insert(entry);
+}
+
+void AutoTypeIndex::removeEntry(Entry* entry)
+{
+    m_dirty.remove(entry);
+    m_unindexedEntries.remove(entry);
+
+    if (m_rules.remove(entry) > 0) {
+        m_automatonDirty = true;
+    }
+}
+
+QList<AutoTypeIndex::Match> AutoTypeIndex::findEntries(const QString& windowTitle, bool matchTitle, bool matchUrl)
+{
+    if (windowTitle.isEmpty()) {
+        return QList<Match>();
+    }
+
+    update();
+
+    const QString foldedTitle = windowTitle.toCaseFolded();
+    QHash<Entry*, const Rule*> bestRules;
+
+    auto checkRule = [&](Entry* entry, const Rule& rule) {
+        if ((rule.type == TitleRule && !matchTitle) || (rule.type == UrlRule && !matchUrl)) {
+            return;
+        }
+
+        const Rule* bestRule = bestRules.value(entry, nullptr);
+        if (bestRule && bestRule->order <= rule.order) {
+            return;
+        }
+
+        if (rule.matches(windowTitle, foldedTitle)) {
+            bestRules.insert(entry, &rule);
+        }
+    };
+
+    // a fragment can occur several times in the window title
+    QVector<bool> checked(m_ruleRefs.size(), false);
+    auto checkRuleRef = [&](int id) {
+        if (checked.at(id)) {
+            return;
+        }
+        checked[id] = true;
+
+        const QPair<Entry*, int>& ref = m_ruleRefs.at(id);
+        const QList<Rule>& rules = *m_rules.constFind(ref.first);
+        checkRule(ref.first, rules.at(ref.second));
+    };
+
+    int state = 0;
+    for (const QChar c : foldedTitle) {
+        while (state != 0 && !m_nodes.at(state).next.contains(c)) {
+            state = m_nodes.at(state).fail;
+        }
+        state = m_nodes.at(state).next.value(c, 0);
+
+        int node = m_nodes.at(state).rules.isEmpty() ? m_nodes.at(state).dictionary : state;
+        while (node != 0) {
+            for (int id : m_nodes.at(node).rules) {
+                checkRuleRef(id);
+            }
+            node = m_nodes.at(node).dictionary;
+        }
+    }
+
+    for (int id : asConst(m_alwaysCheckedRules)) {
+        checkRuleRef(id);
+    }
+
+    // the patterns of these entries depend on other entries
+    QHash<Entry*, QList<Rule>> unindexedRules;
+    for (Entry* entry : asConst(m_unindexedEntries)) {
+        const QList<Rule>& rules = *unindexedRules.insert(entry, compileRules(entry));
+        for (const Rule& rule : rules) {
+            checkRule(entry, rule);
+        }
+    }
+
+    QList<Entry*> entries = bestRules.keys();
+    std::sort(entries.begin(), entries.end(), Database::isBeforeInTree);
+
+    QList<Match> result;
+    for (Entry* entry : asConst(entries)) {
+        Match match;
+        match.entry = entry;
+        match.sequence = bestRules.value(entry)->sequence;
+        result.append(match);
+    }
+
+    return result;
+}
+
+/**
+ * Returns the literal text that a matching window title has to contain,
+ * the longest part between the wildcards.
+ */
+QString AutoTypeIndex::Rule::fragment() const
+{
+    if (isRegExp) {
+        return QString();
+    }
+
+    QString result;
+    for (const QString& part : parts) {
+        if (part.size() > result.size()) {
+            result = part;
+        }
+    }
+    return result;
+}
+
+bool AutoTypeIndex::Rule::matches(const QString& windowTitle, const QString& foldedTitle) const
+{
+    if (isRegExp) {
+        QRegExp titleRegExp(regExp);
+        return titleRegExp.indexIn(windowTitle) != -1;
+    }
+
+    if (contains) {
+        return foldedTitle.contains(parts.first());
+    }
+
+    if (parts.size() == 1) {
+        return foldedTitle == parts.first();
+    }
+
+    // same as WildcardMatcher
+    if (!foldedTitle.startsWith(parts.first()) || !foldedTitle.endsWith(parts.last())) {
+        return false;
+    }
+
+    int index = 0;
+    for (const QString& part : parts) {
+        const int matchIndex = foldedTitle.indexOf(part, index);
+        if (matchIndex == -1) {
+            return false;
+        }
+        index = matchIndex + part.length();
+    }
+
+    return true;
+}
+
+QList<AutoTypeIndex::Rule> AutoTypeIndex::compileRules(const Entry* entry)
+{
+    QList<Rule> rules;
+
+    const QList<AutoTypeAssociations::Association> assocList = entry->autoTypeAssociations()->getAll();
+    for (int i = 0; i < assocList.size(); ++i) {
+        const AutoTypeAssociations::Association& assoc = assocList.at(i);
+        const QString window = entry->resolveMultiplePlaceholders(assoc.window);
+
+        Rule rule;
+        rule.type = WindowRule;
+        rule.order = i;
+        rule.sequence = assoc.sequence;
+        rule.contains = false;
+        rule.isRegExp = window.startsWith("//") && window.endsWith("//") && window.size() >= 4;
+        if (rule.isRegExp) {
+            rule.regExp = QRegExp(window.mid(2, window.size() - 4), Qt::CaseInsensitive, QRegExp::RegExp2);
+        }
+        else {
+            rule.parts = window.toCaseFolded().split('*', QString::KeepEmptyParts);
+        }
+        rules.append(rule);
+    }
+
+    Rule rule;
+    rule.isRegExp = false;
+    rule.contains = true;
+
+    const QString title = entry->resolvePlaceholder(entry->title());
+    if (!title.isEmpty()) {
+        rule.type = TitleRule;
+        rule.order = assocList.size();
+        rule.parts = QStringList() << title.toCaseFolded();
+        rules.append(rule);
+    }
+
+    const QString url = entry->resolvePlaceholder(entry->url());
+    if (!url.isEmpty()) {
+        rule.type = UrlRule;
+        rule.order = assocList.size() + 1;
+        rule.parts = QStringList() << url.toCaseFolded();
+        rules.append(rule);
+
+        const QString host = QUrl(url).host();
+        if (!host.isEmpty()) {
+            rule.parts = QStringList() << host.toCaseFolded();
+            rules.append(rule);
+        }
+    }
+
+    return rules;
+}
+
+bool AutoTypeIndex::hasPlaceholders(const Entry* entry)
+{
+    if (entry->title().contains('{') || entry->url().contains('{')) {
+        return true;
+    }
+
+    const QList<AutoTypeAssociations::Association> assocList = entry->autoTypeAssociations()->getAll();
+    for (const AutoTypeAssociations::Association& assoc : assocList) {
+        if (assoc.window.contains('{')) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void AutoTypeIndex::update()
+{
+    const QSet<Entry*> dirtyEntries = m_dirty;
+    m_dirty.clear();
+    for (Entry* entry : dirtyEntries) {
+        removeEntry(entry);
+
+        if (hasPlaceholders(entry)) {
+            m_unindexedEntries.insert(entry);
+        }
+        else {
+            const QList<Rule> rules = compileRules(entry);
+            if (!rules.isEmpty()) {
+                m_rules.insert(entry, rules);
+                m_automatonDirty = true;
+            }
+        }
+    }
+
+    if (m_automatonDirty) {
+        buildAutomaton();
+        m_automatonDirty = false;
+    }
+}
+
+/**
+ * Builds the trie of the rule fragments and links every node to the longest
+ * proper suffix in the trie (fail) and to the longest suffix that ends a
+ * fragment (dictionary).
+ */
+void AutoTypeIndex::buildAutomaton()
+{
+    m_nodes.clear();
+    m_ruleRefs.clear();
+    m_alwaysCheckedRules.clear();
+    m_nodes.append(Node());
+
+    for (QHash<Entry*, QList<Rule>>::const_iterator i = m_rules.constBegin(); i != m_rules.constEnd(); ++i) {
+        const QList<Rule>& rules = i.value();
+        for (int r = 0; r < rules.size(); ++r) {
+            const int id = m_ruleRefs.size();
+            m_ruleRefs.append(qMakePair(i.key(), r));
+
+            const QString fragment = rules.at(r).fragment();
+            if (fragment.isEmpty()) {
+                m_alwaysCheckedRules.append(id);
+                continue;
+            }
+
+            int node = 0;
+            for (const QChar c : fragment) {
+                int child = m_nodes.at(node).next.value(c, -1);
+                if (child == -1) {
+                    child = m_nodes.size();
+                    m_nodes[node].next.insert(c, child);
+                    m_nodes.append(Node());
+                }
+                node = child;
+            }
+            m_nodes[node].rules.append(id);
+        }
+    }
+
+    QVector<int> queue;
+    queue.reserve(m_nodes.size());
+    for (int child : asConst(m_nodes.first().next)) {
+        queue.append(child);
+    }
+
+    for (int i = 0; i < queue.size(); ++i) {
+        const int node = queue.at(i);
+        const QHash<QChar, int> next = m_nodes.at(node).next;
+        for (QHash<QChar, int>::const_iterator j = next.constBegin(); j != next.constEnd(); ++j) {
+            int fail = m_nodes.at(node).fail;
+            while (fail != 0 && !m_nodes.at(fail).next.contains(j.key())) {
+                fail = m_nodes.at(fail).fail;
+            }
+            fail = m_nodes.at(fail).next.value(j.key(), 0);
+
+            m_nodes[j.value()].fail = fail;
+            m_nodes[j.value()].dictionary = m_nodes.at(fail).rules.isEmpty() ? m_nodes.at(fail).dictionary : fail;
+            queue.append(j.value());
+        }
+    }
+}
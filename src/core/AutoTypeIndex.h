@@ -0,0 +1,114 @@
+/*
+ *  Copyright (C) 2017 KeePassXC Team <team@keepassxc.org>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 or (at your option)
+ *  version 3 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef KEEPASSX_AUTOTYPEINDEX_H
+#define KEEPASSX_AUTOTYPEINDEX_H
+
+#include <QHash>
+#include <QRegExp>
+#include <QSet>
+#include <QStringList>
+#include <QVector>
+
+class Entry;
+class Group;
+
+/**
+ * Matches window titles against the Auto-Type window associations, titles
+ * and urls of all entries at once.
+ *
+ * Every window pattern is compiled into a rule with a literal fragment that a
+ * matching window title must contain. The fragments of all rules form an
+ * Aho-Corasick automaton, so a lookup scans the window title once and only
+ * verifies the rules whose fragment was found. Regular expressions and
+ * patterns without literal text are verified on every lookup.
+ *
+ * Changed entries are recompiled when the index is queried the next time.
+ * Entries whose patterns contain placeholders are compiled on every lookup.
+ */
+class AutoTypeIndex
+{
+public:
+    struct Match
+    {
+        Entry* entry;
+        /** The sequence of the matching association, empty for the default sequence. */
+        QString sequence;
+    };
+
+    explicit AutoTypeIndex(Group* rootGroup);
+    ~AutoTypeIndex();
+
+    void invalidateEntry(Entry* entry);
+    void removeEntry(Entry* entry);
+
+    /**
+     * Returns the entries that match windowTitle in tree order. For each entry
+     * the first matching association is used, then the title and the url if
+     * matchTitle and matchUrl are set.
+     */
+    QList<Match> findEntries(const QString& windowTitle, bool matchTitle, bool matchUrl);
+
+private:
+    enum RuleType
+    {
+        WindowRule,
+        TitleRule,
+        UrlRule
+    };
+
+    struct Rule
+    {
+        RuleType type;
+        /** Association index for window rules, rules with lower values win. */
+        int order;
+        QString sequence;
+        /** Case folded pattern split at the wildcards. */
+        QStringList parts;
+        QRegExp regExp;
+        bool isRegExp;
+        /** The pattern only has to occur anywhere in the window title. */
+        bool contains;
+
+        QString fragment() const;
+        bool matches(const QString& windowTitle, const QString& foldedTitle) const;
+    };
+
+    struct Node
+    {
+        QHash<QChar, int> next;
+        int fail = 0;
+        int dictionary = 0;
+        QVector<int> rules;
+    };
+
+    static QList<Rule> compileRules(const Entry* entry);
+    static bool hasPlaceholders(const Entry* entry);
+    void update();
+    void buildAutomaton();
+
+    QHash<Entry*, QList<Rule>> m_rules;
+    QSet<Entry*> m_dirty;
+    QSet<Entry*> m_unindexedEntries;
+
+    bool m_automatonDirty;
+    QVector<Node> m_nodes;
+    QVector<QPair<Entry*, int>> m_ruleRefs;
+    QVector<int> m_alwaysCheckedRules;
+};
+
+#endif // KEEPASSX_AUTOTYPEINDEX_H
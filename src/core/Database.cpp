@@ -23,11 +23,19 @@
 #include <QTextStream>
 #include <QTimer>
 #include <QXmlStreamReader>
+#include <QtConcurrent>
 
 #include "cli/Utils.h"
+#include "core/Global.h"
 #include "core/Group.h"
 #include "core/Metadata.h"
+#include "core/AttachmentIndex.h"
+#include "core/AutoTypeIndex.h"
+#include "core/HostIndex.h"
+#include "core/PasswordHealth.h"
+#include "core/SearchIndex.h"
 #include "crypto/Random.h"
+#include "crypto/kdf/AesKdf.h"
 #include "format/KeePass2.h"
 #include "format/KeePass2Reader.h"
 #include "format/KeePass2Writer.h"
@@ -39,13 +47,15 @@ QHash<Uuid, Database*> Database::m_uuidMap;
 
 Database::Database()
     : m_metadata(new Metadata(this))
+    , m_rootGroup(nullptr)
     , m_timer(new QTimer(this))
     , m_emitModified(false)
+    , m_referenceRevision(0)
     , m_uuid(Uuid::random())
 {
     m_data.cipher = KeePass2::CIPHER_AES;
     m_data.compressionAlgo = CompressionGZip;
-    m_data.transformRounds = 100000;
+    m_data.kdf = QSharedPointer<Kdf>(new AesKdf());
     m_data.hasKey = false;
 
     setRootGroup(new Group());
@@ -62,6 +72,9 @@ Database::Database()
 
 Database::~Database()
 {
+    // the tree has to be gone before the indexes are destroyed
+    delete m_rootGroup;
+
     m_uuidMap.remove(m_uuid);
 }
 
@@ -79,6 +92,11 @@ void Database::setRootGroup(Group* group)
 {
     Q_ASSERT(group);
 
+    if (m_rootGroup && m_rootGroup != group) {
+        // the previous tree is no longer reachable through the database
+        m_rootGroup->recSetDatabase(nullptr);
+    }
+
     m_rootGroup = group;
     m_rootGroup->setParent(this);
 }
@@ -93,106 +111,402 @@ const Metadata* Database::metadata() const
     return m_metadata;
 }
 
+/**
+ * Uuids aren't unique after some merges and imports, the first entry in tree
+ * order is returned like the tree walk did before the index.
+ */
 Entry* Database::resolveEntry(const Uuid& uuid)
 {
-    return findEntryRecursive(uuid, m_rootGroup);
+    Entry* result = nullptr;
+    const QList<Entry*> entries = m_entryIndex.values(uuid);
+    for (Entry* entry : entries) {
+        if (!result || isBeforeInTree(entry, result)) {
+            result = entry;
+        }
+    }
+
+    return result;
 }
 
 Entry* Database::resolveEntry(const QString& text, EntryReferenceType referenceType)
 {
-    return findEntryRecursive(text, referenceType, m_rootGroup);
+    if (referenceType == EntryReferenceType::Uuid) {
+        return resolveEntry(Uuid::fromHex(text));
+    }
+
+    Q_ASSERT_X(referenceType != EntryReferenceType::Unknown, "Database::resolveEntry",
+               "Can't search entry with \"referenceType\" parameter equal to \"Unknown\"");
+    if (referenceType == EntryReferenceType::Unknown) {
+        return nullptr;
+    }
+
+    updateReferenceIndexes();
+
+    if (!m_referenceIndexes.contains(referenceType)) {
+        ReferenceIndex& index = m_referenceIndexes[referenceType];
+        const QList<Entry*> entries = m_rootGroup->entriesRecursive();
+        for (Entry* entry : entries) {
+            addEntryReferences(index, referenceType, entry);
+        }
+    }
+
+    // hash collisions are possible, so the value has to be compared as well
+    Entry* result = nullptr;
+    const QList<Entry*> candidates = m_referenceIndexes[referenceType].entries.values(qHash(text));
+    for (Entry* entry : candidates) {
+        if ((!result || isBeforeInTree(entry, result)) && entryMatchesReference(entry, text, referenceType)) {
+            result = entry;
+        }
+    }
+
+    return result;
 }
 
-Entry* Database::findEntryRecursive(const Uuid& uuid, Group* group)
+void Database::invalidateEntryReferences(Entry* entry)
 {
-    const QList<Entry*> entryList = group->entries();
-    for (Entry* entry : entryList) {
-        if (entry->uuid() == uuid) {
-            return entry;
+    if (!m_referenceIndexes.isEmpty()) {
+        m_dirtyReferenceEntries.insert(entry);
+    }
+}
+
+void Database::removeEntryReferences(Entry* entry)
+{
+    m_dirtyReferenceEntries.remove(entry);
+
+    for (ReferenceIndex& index : m_referenceIndexes) {
+        const QList<uint> valueHashes = index.valueHashes.take(entry);
+        for (uint valueHash : valueHashes) {
+            index.entries.remove(valueHash, entry);
         }
     }
+}
+
+void Database::updateReferenceIndexes()
+{
+    const QSet<Entry*> dirtyEntries = m_dirtyReferenceEntries;
+    m_dirtyReferenceEntries.clear();
 
-    const QList<Group*> children = group->children();
-    for (Group* child : children) {
-        Entry* result = findEntryRecursive(uuid, child);
-        if (result) {
-            return result;
+    for (Entry* entry : dirtyEntries) {
+        for (QMap<EntryReferenceType, ReferenceIndex>::iterator i = m_referenceIndexes.begin();
+             i != m_referenceIndexes.end(); ++i) {
+            ReferenceIndex& index = i.value();
+            const QList<uint> oldValueHashes = index.valueHashes.take(entry);
+            for (uint valueHash : oldValueHashes) {
+                index.entries.remove(valueHash, entry);
+            }
+
+            addEntryReferences(index, i.key(), entry);
+
+            // only changes of searchable values can change the result of a lookup
+            if (index.valueHashes.value(entry) != oldValueHashes) {
+                m_referenceRevision++;
+            }
         }
     }
+}
 
-    return nullptr;
+/**
+ * Returns a number that changes whenever a reference placeholder could resolve
+ * to a different entry than before, e.g. because entries were added, removed,
+ * moved or a searchable value changed. Placeholder caches use it to find out
+ * if a resolved value that contains a reference is still valid.
+ */
+quint64 Database::referenceRevision()
+{
+    updateReferenceIndexes();
+    return m_referenceRevision;
 }
 
-Entry* Database::findEntryRecursive(const QString& text, EntryReferenceType referenceType, Group* group)
+void Database::invalidateReferenceOrder()
 {
-    Q_ASSERT_X(referenceType != EntryReferenceType::Unknown, "Database::findEntryRecursive",
-               "Can't search entry with \"referenceType\" parameter equal to \"Unknown\"");
+    m_referenceRevision++;
+}
 
-    bool found = false;
-    const QList<Entry*> entryList = group->entries();
-    for (Entry* entry : entryList) {
-        switch (referenceType) {
-        case EntryReferenceType::Unknown:
-            return nullptr;
-        case EntryReferenceType::Title:
-            found = entry->title() == text;
-            break;
-        case EntryReferenceType::UserName:
-            found = entry->username() == text;
-            break;
-        case EntryReferenceType::Password:
-            found = entry->password() == text;
-            break;
-        case EntryReferenceType::Url:
-            found = entry->url() == text;
-            break;
-        case EntryReferenceType::Notes:
-            found = entry->notes() == text;
-            break;
-        case EntryReferenceType::Uuid:
-            found = entry->uuid() == Uuid::fromHex(text);
-            break;
-        case EntryReferenceType::CustomAttributes:
-            found = entry->attributes()->containsValue(text);
-            break;
-        }
+void Database::addEntryReferences(ReferenceIndex& index, EntryReferenceType referenceType, Entry* entry)
+{
+    QStringList values;
 
-        if (found) {
-            return entry;
+    switch (referenceType) {
+    case EntryReferenceType::Title:
+        values.append(entry->title());
+        break;
+    case EntryReferenceType::UserName:
+        values.append(entry->username());
+        break;
+    case EntryReferenceType::Password:
+        values.append(entry->password());
+        break;
+    case EntryReferenceType::Url:
+        values.append(entry->url());
+        break;
+    case EntryReferenceType::Notes:
+        values.append(entry->notes());
+        break;
+    case EntryReferenceType::CustomAttributes: {
+        const QList<QString> keys = entry->attributes()->keys();
+        for (const QString& key : keys) {
+            values.append(entry->attributes()->value(key));
         }
+        break;
+    }
+    case EntryReferenceType::Uuid:
+    case EntryReferenceType::Unknown:
+        Q_ASSERT(false);
+        return;
     }
 
-    const QList<Group*> children = group->children();
-    for (Group* child : children) {
-        Entry* result = findEntryRecursive(text, referenceType, child);
-        if (result) {
-            return result;
+    QList<uint> valueHashes;
+    for (const QString& value : asConst(values)) {
+        uint valueHash = qHash(value);
+        if (!valueHashes.contains(valueHash)) {
+            valueHashes.append(valueHash);
+            index.entries.insert(valueHash, entry);
         }
     }
+    index.valueHashes.insert(entry, valueHashes);
+}
+
+bool Database::entryMatchesReference(Entry* entry, const QString& text, EntryReferenceType referenceType)
+{
+    switch (referenceType) {
+    case EntryReferenceType::Title:
+        return entry->title() == text;
+    case EntryReferenceType::UserName:
+        return entry->username() == text;
+    case EntryReferenceType::Password:
+        return entry->password() == text;
+    case EntryReferenceType::Url:
+        return entry->url() == text;
+    case EntryReferenceType::Notes:
+        return entry->notes() == text;
+    case EntryReferenceType::CustomAttributes:
+        return entry->attributes()->containsValue(text);
+    case EntryReferenceType::Uuid:
+        return entry->uuid() == Uuid::fromHex(text);
+    case EntryReferenceType::Unknown:
+        return false;
+    }
 
-    return nullptr;
+    return false;
 }
 
-Group* Database::resolveGroup(const Uuid& uuid)
+/**
+ * Returns true if entry comes first in a depth-first walk of the tree that visits the
+ * entries of a group before its children. If several entries match a reference the
+ * first one in that order is used.
+ */
+bool Database::isBeforeInTree(Entry* entry, Entry* otherEntry)
 {
-    return findGroupRecursive(uuid, m_rootGroup);
+    Group* group = entry->group();
+    Group* otherGroup = otherEntry->group();
+
+    if (group == otherGroup) {
+        return group->entries().indexOf(entry) < group->entries().indexOf(otherEntry);
+    }
+
+    return isBeforeInTree(group, otherGroup);
 }
 
-Group* Database::findGroupRecursive(const Uuid& uuid, Group* group)
+/**
+ * Returns true if group comes first in a depth-first walk of the tree that visits
+ * a group before its children.
+ */
+bool Database::isBeforeInTree(Group* group, Group* otherGroup)
 {
-    if (group->uuid() == uuid) {
-        return group;
+    QList<Group*> path;
+    for (Group* g = group; g; g = g->parentGroup()) {
+        path.prepend(g);
+    }
+    QList<Group*> otherPath;
+    for (Group* g = otherGroup; g; g = g->parentGroup()) {
+        otherPath.prepend(g);
     }
 
-    const QList<Group*> children = group->children();
-    for (Group* child : children) {
-        Group* result = findGroupRecursive(uuid, child);
-        if (result) {
-            return result;
+    int i = 0;
+    while (i < path.size() && i < otherPath.size() && path[i] == otherPath[i]) {
+        i++;
+    }
+
+    if (i == otherPath.size()) {
+        // the same group or the other group is an ancestor
+        return false;
+    }
+    else if (i == path.size()) {
+        // group is an ancestor of the other group
+        return true;
+    }
+
+    Q_ASSERT(i > 0);
+    const QList<Group*>& siblings = path[i - 1]->children();
+    return siblings.indexOf(path[i]) < siblings.indexOf(otherPath[i]);
+}
+
+Group* Database::resolveGroup(const Uuid& uuid)
+{
+    Group* result = nullptr;
+    const QList<Group*> groups = m_groupIndex.values(uuid);
+    for (Group* group : groups) {
+        if (!result || isBeforeInTree(group, result)) {
+            result = group;
         }
     }
 
-    return nullptr;
+    return result;
+}
+
+/**
+ * Returns the full text index of the entries and groups of this database.
+ * The index is built on first use and kept up to date afterwards.
+ */
+SearchIndex* Database::searchIndex() const
+{
+    if (!m_searchIndex) {
+        m_searchIndex.reset(new SearchIndex(m_rootGroup));
+    }
+
+    return m_searchIndex.data();
+}
+
+/**
+ * Returns the index of the hosts of the entry urls, see HostIndex.
+ * The index is built on first use and kept up to date afterwards.
+ */
+HostIndex* Database::hostIndex() const
+{
+    if (!m_hostIndex) {
+        m_hostIndex.reset(new HostIndex(m_rootGroup));
+    }
+
+    return m_hostIndex.data();
+}
+
+/**
+ * Returns the index of the attachment names of the entries, see AttachmentIndex.
+ * The index is built on first use and kept up to date afterwards.
+ */
+AttachmentIndex* Database::attachmentIndex() const
+{
+    if (!m_attachmentIndex) {
+        m_attachmentIndex.reset(new AttachmentIndex(m_rootGroup));
+    }
+
+    return m_attachmentIndex.data();
+}
+
+/**
+ * Returns the index of the Auto-Type window matches, see AutoTypeIndex.
+ * The index is built on first use and kept up to date afterwards.
+ */
+AutoTypeIndex* Database::autoTypeIndex() const
+{
+    if (!m_autoTypeIndex) {
+        m_autoTypeIndex.reset(new AutoTypeIndex(m_rootGroup));
+    }
+
+    return m_autoTypeIndex.data();
+}
+
+/**
+ * Returns the password health analysis of this database, see PasswordHealth.
+ * Its cache is kept as long as the database is open.
+ */
+PasswordHealth* Database::passwordHealth() const
+{
+    if (!m_passwordHealth) {
+        m_passwordHealth.reset(new PasswordHealth());
+    }
+
+    return m_passwordHealth.data();
+}
+
+void Database::invalidateEntryIndexes(Entry* entry)
+{
+    invalidateEntryReferences(entry);
+
+    if (m_searchIndex) {
+        m_searchIndex->invalidateEntry(entry);
+    }
+
+    if (m_hostIndex) {
+        m_hostIndex->invalidateEntry(entry);
+    }
+
+    if (m_attachmentIndex) {
+        m_attachmentIndex->invalidateEntry(entry);
+    }
+
+    if (m_autoTypeIndex) {
+        m_autoTypeIndex->invalidateEntry(entry);
+    }
+}
+
+void Database::invalidateGroupIndexes(Group* group)
+{
+    if (m_searchIndex) {
+        m_searchIndex->invalidateGroup(group);
+    }
+}
+
+void Database::addEntryToIndex(Entry* entry)
+{
+    if (!entry->uuid().isNull()) {
+        m_entryIndex.insert(entry->uuid(), entry);
+    }
+
+    invalidateEntryIndexes(entry);
+    m_referenceRevision++;
+}
+
+void Database::removeEntryFromIndex(Entry* entry, const Uuid& uuid)
+{
+    m_entryIndex.remove(uuid, entry);
+
+    removeEntryReferences(entry);
+    m_referenceRevision++;
+
+    if (m_searchIndex) {
+        m_searchIndex->removeEntry(entry);
+    }
+
+    if (m_hostIndex) {
+        m_hostIndex->removeEntry(entry);
+    }
+
+    if (m_attachmentIndex) {
+        m_attachmentIndex->removeEntry(entry);
+    }
+
+    if (m_autoTypeIndex) {
+        m_autoTypeIndex->removeEntry(entry);
+    }
+}
+
+void Database::addGroupToIndex(Group* group)
+{
+    if (!group->uuid().isNull()) {
+        m_groupIndex.insert(group->uuid(), group);
+    }
+
+    invalidateGroupIndexes(group);
+}
+
+void Database::removeGroupFromIndex(Group* group, const Uuid& uuid)
+{
+    m_groupIndex.remove(uuid, group);
+
+    if (m_searchIndex) {
+        m_searchIndex->removeGroup(group);
+    }
+}
+
+QList<Entry*> Database::indexedEntries(const Uuid& uuid) const
+{
+    return m_entryIndex.values(uuid);
+}
+
+QList<Group*> Database::indexedGroups(const Uuid& uuid) const
+{
+    return m_groupIndex.values(uuid);
 }
 
 QList<DeletedObject> Database::deletedObjects()
@@ -227,12 +541,17 @@ Database::CompressionAlgorithm Database::compressionAlgo() const
 
 QByteArray Database::transformSeed() const
 {
-    return m_data.transformSeed;
+    return m_data.kdf->seed();
 }
 
 quint64 Database::transformRounds() const
 {
-    return m_data.transformRounds;
+    return m_data.kdf->rounds();
+}
+
+QSharedPointer<Kdf> Database::kdf() const
+{
+    return m_data.kdf;
 }
 
 QByteArray Database::transformedMasterKey() const
@@ -267,14 +586,16 @@ void Database::setCompressionAlgo(Database::CompressionAlgorithm algo)
 
 bool Database::setTransformRounds(quint64 rounds)
 {
-    if (m_data.transformRounds != rounds) {
-        quint64 oldRounds = m_data.transformRounds;
+    if (m_data.kdf->rounds() != rounds) {
+        quint64 oldRounds = m_data.kdf->rounds();
 
-        m_data.transformRounds = rounds;
+        if (!m_data.kdf->setRounds(rounds)) {
+            return false;
+        }
 
         if (m_data.hasKey) {
             if (!setKey(m_data.key)) {
-                m_data.transformRounds = oldRounds;
+                m_data.kdf->setRounds(oldRounds);
                 return false;
             }
         }
@@ -283,20 +604,40 @@ bool Database::setTransformRounds(quint64 rounds)
     return true;
 }
 
+bool Database::setKdf(QSharedPointer<Kdf> kdf)
+{
+    Q_ASSERT(kdf);
+
+    QSharedPointer<Kdf> oldKdf = m_data.kdf;
+    m_data.kdf = kdf;
+
+    if (m_data.hasKey) {
+        if (!setKey(m_data.key)) {
+            m_data.kdf = oldKdf;
+            return false;
+        }
+    }
+
+    return true;
+}
+
 bool Database::setKey(const CompositeKey& key, const QByteArray& transformSeed, bool updateChangedTime)
 {
-    bool ok;
     QString errorString;
+    QByteArray oldTransformSeed = m_data.kdf->seed();
 
-    QByteArray transformedMasterKey = key.transform(transformSeed, transformRounds(), &ok, &errorString);
-    if (!ok) {
+    m_data.kdf->setSeed(transformSeed);
+    QByteArray transformedMasterKey;
+    if (!key.transform(*m_data.kdf, transformedMasterKey, &errorString)) {
+        m_data.kdf->setSeed(oldTransformSeed);
         return false;
     }
 
     m_data.key = key;
-    m_data.transformSeed = transformSeed;
     m_data.transformedMasterKey = transformedMasterKey;
     m_data.hasKey = true;
+    m_data.nextKdf.reset();
+    m_data.nextTransformedMasterKey = QFuture<QByteArray>();
     if (updateChangedTime) {
         m_metadata->setMasterKeyChanged(QDateTime::currentDateTimeUtc());
     }
@@ -319,21 +660,64 @@ bool Database::transformKeyWithSeed(const QByteArray& transformSeed)
 {
     Q_ASSERT(hasKey());
 
-    bool ok;
     QString errorString;
+    QByteArray oldTransformSeed = m_data.kdf->seed();
 
-    QByteArray transformedMasterKey =
-            m_data.key.transform(transformSeed, transformRounds(), &ok, &errorString);
-    if (!ok) {
+    m_data.kdf->setSeed(transformSeed);
+    QByteArray transformedMasterKey;
+    if (!m_data.key.transform(*m_data.kdf, transformedMasterKey, &errorString)) {
+        m_data.kdf->setSeed(oldTransformSeed);
         return false;
     }
 
-    m_data.transformSeed = transformSeed;
     m_data.transformedMasterKey = transformedMasterKey;
 
     return true;
 }
 
+void Database::precomputeNextKey()
+{
+    if (!m_data.hasKey || m_data.nextKdf) {
+        return;
+    }
+
+    // the task only works on copies, so it may outlive the database
+    QSharedPointer<Kdf> kdf = m_data.kdf->clone();
+    kdf->setSeed(randomGen()->randomArray(32));
+    QByteArray rawKey = m_data.key.rawKey();
+
+    m_data.nextKdf = kdf;
+    m_data.nextTransformedMasterKey = QtConcurrent::run([kdf, rawKey]() {
+        QByteArray transformedMasterKey;
+        if (!kdf->transform(rawKey, transformedMasterKey, nullptr)) {
+            return QByteArray();
+        }
+        return transformedMasterKey;
+    });
+}
+
+bool Database::transformKeyWithNewSeed()
+{
+    Q_ASSERT(hasKey());
+
+    QSharedPointer<Kdf> nextKdf = m_data.nextKdf;
+    QFuture<QByteArray> nextTransformedMasterKey = m_data.nextTransformedMasterKey;
+    m_data.nextKdf.reset();
+    m_data.nextTransformedMasterKey = QFuture<QByteArray>();
+
+    if (nextKdf && nextKdf->uuid() == m_data.kdf->uuid() && nextKdf->rounds() == m_data.kdf->rounds()) {
+        // waiting for a running precomputation is still faster than starting over
+        QByteArray transformedMasterKey = nextTransformedMasterKey.result();
+        if (!transformedMasterKey.isEmpty()) {
+            m_data.kdf = nextKdf;
+            m_data.transformedMasterKey = transformedMasterKey;
+            return true;
+        }
+    }
+
+    return transformKeyWithSeed(randomGen()->randomArray(32));
+}
+
 bool Database::verifyKey(const CompositeKey& key) const
 {
     Q_ASSERT(hasKey());
@@ -429,6 +813,9 @@ void Database::setEmitModified(bool value)
 void Database::copyAttributesFrom(const Database* other)
 {
     m_data = other->m_data;
+    m_data.kdf = other->m_data.kdf->clone();
+    m_data.nextKdf.reset();
+    m_data.nextTransformedMasterKey = QFuture<QByteArray>();
     m_metadata->copyAttributesFrom(other->m_metadata);
 }
 
@@ -20,10 +20,17 @@
 #define KEEPASSX_DATABASE_H
 
 #include <QDateTime>
+#include <QFuture>
 #include <QHash>
+#include <QMap>
+#include <QMultiHash>
 #include <QObject>
+#include <QScopedPointer>
+#include <QSet>
+#include <QSharedPointer>
 
 #include "core/Uuid.h"
+#include "crypto/kdf/Kdf.h"
 #include "keys/CompositeKey.h"
 
 class Entry;
@@ -31,6 +38,11 @@ enum class EntryReferenceType;
 class Group;
 class Metadata;
 class QTimer;
+class AttachmentIndex;
+class AutoTypeIndex;
+class HostIndex;
+class PasswordHealth;
+class SearchIndex;
 
 struct DeletedObject
 {
@@ -56,13 +68,14 @@ public:
     {
         Uuid cipher;
         CompressionAlgorithm compressionAlgo;
-        QByteArray transformSeed;
-        quint64 transformRounds;
+        QSharedPointer<Kdf> kdf;
         QByteArray transformedMasterKey;
         CompositeKey key;
         bool hasKey;
         QByteArray masterSeed;
         QByteArray challengeResponseKey;
+        QSharedPointer<Kdf> nextKdf;
+        QFuture<QByteArray> nextTransformedMasterKey;
     };
 
     Database();
@@ -84,6 +97,14 @@ public:
     Entry* resolveEntry(const Uuid& uuid);
     Entry* resolveEntry(const QString& text, EntryReferenceType referenceType);
     Group* resolveGroup(const Uuid& uuid);
+    quint64 referenceRevision();
+    SearchIndex* searchIndex() const;
+    HostIndex* hostIndex() const;
+    AttachmentIndex* attachmentIndex() const;
+    AutoTypeIndex* autoTypeIndex() const;
+    PasswordHealth* passwordHealth() const;
+    static bool isBeforeInTree(Entry* entry, Entry* otherEntry);
+    static bool isBeforeInTree(Group* group, Group* otherGroup);
     QList<DeletedObject> deletedObjects();
     void addDeletedObject(const DeletedObject& delObj);
     void addDeletedObject(const Uuid& uuid);
@@ -92,6 +113,7 @@ public:
     Database::CompressionAlgorithm compressionAlgo() const;
     QByteArray transformSeed() const;
     quint64 transformRounds() const;
+    QSharedPointer<Kdf> kdf() const;
     QByteArray transformedMasterKey() const;
     const CompositeKey& key() const;
     QByteArray challengeResponseKey() const;
@@ -100,6 +122,12 @@ public:
     void setCipher(const Uuid& cipher);
     void setCompressionAlgo(Database::CompressionAlgorithm algo);
     bool setTransformRounds(quint64 rounds);
+
+    /**
+     * Sets the key derivation function and transforms the key again
+     * with a new random seed. The previous KDF is kept on failure.
+     */
+    bool setKdf(QSharedPointer<Kdf> kdf);
     bool setKey(const CompositeKey& key, const QByteArray& transformSeed,
                 bool updateChangedTime = true);
 
@@ -109,6 +137,18 @@ public:
     bool setKey(const CompositeKey& key);
     bool hasKey() const;
     bool transformKeyWithSeed(const QByteArray& transformSeed);
+
+    /**
+     * Transforms the key with a new random seed on a background thread.
+     * The result is used by the next call to transformKeyWithNewSeed().
+     */
+    void precomputeNextKey();
+
+    /**
+     * Switches to a new random transform seed. Uses the key from
+     * precomputeNextKey() if it matches the current key and KDF.
+     */
+    bool transformKeyWithNewSeed();
     bool verifyKey(const CompositeKey& key) const;
     void recycleEntry(Entry* entry);
     void recycleGroup(Group* group);
@@ -143,9 +183,40 @@ private slots:
     void startModifiedTimer();
 
 private:
-    Entry* findEntryRecursive(const Uuid& uuid, Group* group);
-    Entry* findEntryRecursive(const QString& text, EntryReferenceType referenceType, Group* group);
-    Group* findGroupRecursive(const Uuid& uuid, Group* group);
+    /**
+     * Value lookup table for one field that reference placeholders can search in.
+     * Only hashes of the values are stored so that no plaintext is duplicated.
+     */
+    struct ReferenceIndex
+    {
+        QMultiHash<uint, Entry*> entries;
+        QHash<Entry*, QList<uint>> valueHashes;
+    };
+
+    /**
+     * Keep the reference lookup tables up to date. Changed entries are only
+     * reindexed before the next lookup and a table is only built once it is
+     * needed, so protected values are not decrypted unless necessary.
+     */
+    void invalidateEntryReferences(Entry* entry);
+    void removeEntryReferences(Entry* entry);
+    void updateReferenceIndexes();
+    void addEntryReferences(ReferenceIndex& index, EntryReferenceType referenceType, Entry* entry);
+    static bool entryMatchesReference(Entry* entry, const QString& text, EntryReferenceType referenceType);
+    void invalidateReferenceOrder();
+
+    /**
+     * Maintain the lookup tables. These are called by Group and Entry whenever
+     * an object enters or leaves the database or its uuid or data changes.
+     */
+    void invalidateEntryIndexes(Entry* entry);
+    void invalidateGroupIndexes(Group* group);
+    void addEntryToIndex(Entry* entry);
+    void removeEntryFromIndex(Entry* entry, const Uuid& uuid);
+    void addGroupToIndex(Group* group);
+    void removeGroupFromIndex(Group* group, const Uuid& uuid);
+    QList<Entry*> indexedEntries(const Uuid& uuid) const;
+    QList<Group*> indexedGroups(const Uuid& uuid) const;
 
     void createRecycleBin();
 
@@ -156,8 +227,22 @@ private:
     DatabaseData m_data;
     bool m_emitModified;
 
+    QMultiHash<Uuid, Entry*> m_entryIndex;
+    QMultiHash<Uuid, Group*> m_groupIndex;
+    QMap<EntryReferenceType, ReferenceIndex> m_referenceIndexes;
+    QSet<Entry*> m_dirtyReferenceEntries;
+    quint64 m_referenceRevision;
+    mutable QScopedPointer<SearchIndex> m_searchIndex;
+    mutable QScopedPointer<HostIndex> m_hostIndex;
+    mutable QScopedPointer<AttachmentIndex> m_attachmentIndex;
+    mutable QScopedPointer<AutoTypeIndex> m_autoTypeIndex;
+    mutable QScopedPointer<PasswordHealth> m_passwordHealth;
+
     Uuid m_uuid;
     static QHash<Uuid, Database*> m_uuidMap;
+
+    friend class Entry;
+    friend class Group;
 };
 
 #endif // KEEPASSX_DATABASE_H
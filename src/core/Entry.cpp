@@ -25,10 +25,13 @@
 #include "core/Metadata.h"
 #include "totp/totp.h"
 
+#include <QCache>
+#include <QMutexLocker>
 #include <QRegularExpression>
 
 const int Entry::DefaultIconNumber = 0;
 const int Entry::ResolveMaximumDepth = 10;
+const int Entry::MaxResolvedValues = 64;
 
 
 Entry::Entry()
@@ -38,6 +41,7 @@ Entry::Entry()
     , m_tmpHistoryItem(nullptr)
     , m_modifiedSinceBegin(false)
     , m_updateTimeinfo(true)
+    , m_revision(0)
 {
     m_data.iconNumber = DefaultIconNumber;
     m_data.autoTypeEnabled = true;
@@ -47,8 +51,12 @@ Entry::Entry()
 
     connect(m_attributes, SIGNAL(modified()), this, SIGNAL(modified()));
     connect(m_attributes, SIGNAL(defaultKeyModified()), SLOT(emitDataChanged()));
+    connect(m_attributes, SIGNAL(modified()), SLOT(invalidateDatabaseIndexes()));
+    connect(m_attributes, SIGNAL(modified()), SLOT(invalidateResolvedValues()));
     connect(m_attachments, SIGNAL(modified()), this, SIGNAL(modified()));
+    connect(m_attachments, SIGNAL(modified()), SLOT(invalidateDatabaseIndexes()));
     connect(m_autoTypeAssociations, SIGNAL(modified()), SIGNAL(modified()));
+    connect(m_autoTypeAssociations, SIGNAL(modified()), SLOT(invalidateDatabaseIndexes()));
 
     connect(this, SIGNAL(modified()), SLOT(updateTimeinfo()));
     connect(this, SIGNAL(modified()), SLOT(updateModifiedSinceBegin()));
@@ -421,7 +429,14 @@ quint8 Entry::totpDigits() const
 void Entry::setUuid(const Uuid& uuid)
 {
     Q_ASSERT(!uuid.isNull());
-    set(m_uuid, uuid);
+
+    Uuid oldUuid = m_uuid;
+    Database* db = m_group ? m_group->database() : nullptr;
+
+    if (set(m_uuid, uuid) && db) {
+        db->removeEntryFromIndex(this, oldUuid);
+        db->addEntryToIndex(this);
+    }
 }
 
 void Entry::setIcon(int iconNumber)
@@ -722,31 +737,33 @@ void Entry::updateModifiedSinceBegin()
     m_modifiedSinceBegin = true;
 }
 
-QString Entry::resolveMultiplePlaceholdersRecursive(const QString& str, int maxDepth) const
+QString Entry::resolveMultiplePlaceholdersRecursive(const QString& str, int maxDepth,
+                                                   ResolvedValue* resolved) const
 {
     if (maxDepth <= 0) {
         qWarning("Maximum depth of replacement has been reached. Entry uuid: %s", qPrintable(uuid().toHex()));
         return str;
     }
 
-    QString result = str;
-    QRegExp placeholderRegEx("(\\{[^\\}]+\\})", Qt::CaseInsensitive, QRegExp::RegExp2);
-    placeholderRegEx.setMinimal(true);
-    int pos = 0;
-    while ((pos = placeholderRegEx.indexIn(str, pos)) != -1) {
-        const QString found = placeholderRegEx.cap(1);
-        result.replace(found, resolvePlaceholderRecursive(found, maxDepth - 1));
-        pos += placeholderRegEx.matchedLength();
+    const QVector<PlaceholderToken> tokens = parsePlaceholders(str);
+    QString result;
+    for (const PlaceholderToken& token : tokens) {
+        if (token.isPlaceholder) {
+            result.append(resolvePlaceholderRecursive(token.text, maxDepth - 1, resolved));
+        }
+        else {
+            result.append(token.text);
+        }
     }
 
     if (result != str) {
-        result = resolveMultiplePlaceholdersRecursive(result, maxDepth - 1);
+        result = resolveMultiplePlaceholdersRecursive(result, maxDepth - 1, resolved);
     }
 
     return result;
 }
 
-QString Entry::resolvePlaceholderRecursive(const QString& placeholder, int maxDepth) const
+QString Entry::resolvePlaceholderRecursive(const QString& placeholder, int maxDepth, ResolvedValue* resolved) const
 {
     const PlaceholderType typeOfPlaceholder = placeholderType(placeholder);
     switch (typeOfPlaceholder) {
@@ -754,17 +771,19 @@ QString Entry::resolvePlaceholderRecursive(const QString& placeholder, int maxDe
     case PlaceholderType::Unknown:
         return placeholder;
     case PlaceholderType::Title:
-        return title();
+        return resolveField(EntryAttributes::TitleKey, resolved);
     case PlaceholderType::UserName:
-        return username();
+        return resolveField(EntryAttributes::UserNameKey, resolved);
     case PlaceholderType::Password:
-        return password();
+        return resolveField(EntryAttributes::PasswordKey, resolved);
     case PlaceholderType::Notes:
-        return notes();
+        return resolveField(EntryAttributes::NotesKey, resolved);
     case PlaceholderType::Totp:
+        // the code changes over time
+        resolved->cacheable = false;
         return totp();
     case PlaceholderType::Url:
-        return url();
+        return resolveField(EntryAttributes::URLKey, resolved);
     case PlaceholderType::UrlWithoutScheme:
     case PlaceholderType::UrlScheme:
     case PlaceholderType::UrlHost:
@@ -775,21 +794,23 @@ QString Entry::resolvePlaceholderRecursive(const QString& placeholder, int maxDe
     case PlaceholderType::UrlUserInfo:
     case PlaceholderType::UrlUserName:
     case PlaceholderType::UrlPassword: {
-        const QString strUrl = resolveMultiplePlaceholdersRecursive(url(), maxDepth - 1);
+        const QString strUrl = resolveMultiplePlaceholdersRecursive(resolveField(EntryAttributes::URLKey, resolved),
+                                                                    maxDepth - 1, resolved);
         return resolveUrlPlaceholder(strUrl, typeOfPlaceholder);
     }
     case PlaceholderType::CustomAttribute: {
         const QString key = placeholder.mid(3, placeholder.length() - 4); // {S:attr} => mid(3, len - 4)
-        return attributes()->hasKey(key) ? attributes()->value(key) : QString();
+        return attributes()->hasKey(key) ? resolveField(key, resolved) : QString();
     }
     case PlaceholderType::Reference:
-        return resolveReferencePlaceholderRecursive(placeholder, maxDepth);
+        return resolveReferencePlaceholderRecursive(placeholder, maxDepth, resolved);
     }
 
     return placeholder;
 }
 
-QString Entry::resolveReferencePlaceholderRecursive(const QString& placeholder, int maxDepth) const
+QString Entry::resolveReferencePlaceholderRecursive(const QString& placeholder, int maxDepth,
+                                                   ResolvedValue* resolved) const
 {
     // resolving references in format: {REF:<WantedField>@<SearchIn>:<SearchText>}
     // using format from http://keepass.info/help/base/fieldrefs.html at the time of writing
@@ -804,34 +825,45 @@ QString Entry::resolveReferencePlaceholderRecursive(const QString& placeholder,
     const QString searchText = match.captured(EntryAttributes::SearchTextGroupName);
 
     const EntryReferenceType searchInType = Entry::referenceType(searchIn);
-    const Entry* refEntry = m_group->database()->resolveEntry(searchText, searchInType);
+    Database* db = m_group->database();
+    const Entry* refEntry = db->resolveEntry(searchText, searchInType);
+
+    if (!resolved->usesReferences) {
+        resolved->usesReferences = true;
+        resolved->database = db;
+        resolved->referenceRevision = db->referenceRevision();
+    }
 
     if (refEntry) {
+        if (refEntry != this) {
+            resolved->dependencies.append(qMakePair(QPointer<const Entry>(refEntry), refEntry->m_revision));
+        }
+
         const QString wantedField = match.captured(EntryAttributes::WantedFieldGroupName);
-        result = refEntry->referenceFieldValue(Entry::referenceType(wantedField));
+        result = refEntry->referenceFieldValue(Entry::referenceType(wantedField), resolved);
 
         // Referencing fields of other entries only works with standard fields, not with custom user strings.
         // If you want to reference a custom user string, you need to place a redirection in a standard field
         // of the entry with the custom string, using {S:<Name>}, and reference the standard field.
-        result = refEntry->resolveMultiplePlaceholdersRecursive(result, maxDepth - 1);
+        result = refEntry->resolveMultiplePlaceholdersRecursive(result, maxDepth - 1, resolved);
     }
 
     return result;
 }
 
-QString Entry::referenceFieldValue(EntryReferenceType referenceType) const
+QString Entry::referenceFieldValue(EntryReferenceType referenceType, ResolvedValue* resolved) const
 {
     switch (referenceType) {
     case EntryReferenceType::Title:
-        return title();
+        return resolveField(EntryAttributes::TitleKey, resolved);
     case EntryReferenceType::UserName:
-        return username();
+        return resolveField(EntryAttributes::UserNameKey, resolved);
     case EntryReferenceType::Password:
-        return password();
+        return resolveField(EntryAttributes::PasswordKey, resolved);
     case EntryReferenceType::Url:
-        return url();
+        return resolveField(EntryAttributes::URLKey, resolved);
     case EntryReferenceType::Notes:
-        return notes();
+        return resolveField(EntryAttributes::NotesKey, resolved);
     case EntryReferenceType::Uuid:
         return uuid().toHex();
     default:
@@ -840,6 +872,20 @@ QString Entry::referenceFieldValue(EntryReferenceType referenceType) const
     return QString();
 }
 
+/**
+ * Returns the value of an attribute. Values that contain the password or
+ * another protected attribute aren't cached, so their plaintext isn't kept
+ * around after it has been used.
+ */
+QString Entry::resolveField(const QString& key, ResolvedValue* resolved) const
+{
+    if (key == EntryAttributes::PasswordKey || m_attributes->isProtected(key)) {
+        resolved->cacheable = false;
+    }
+
+    return m_attributes->value(key);
+}
+
 Group* Entry::group()
 {
     return m_group;
@@ -887,6 +933,20 @@ void Entry::emitDataChanged()
     emit dataChanged(this);
 }
 
+void Entry::invalidateDatabaseIndexes()
+{
+    if (m_group && m_group->database()) {
+        m_group->database()->invalidateEntryIndexes(this);
+    }
+}
+
+void Entry::invalidateResolvedValues()
+{
+    m_revision++;
+    m_resolvedStrings.clear();
+    m_resolvedPlaceholders.clear();
+}
+
 const Database* Entry::database() const
 {
     if (m_group) {
@@ -906,12 +966,112 @@ QString Entry::maskPasswordPlaceholders(const QString& str) const
 
 QString Entry::resolveMultiplePlaceholders(const QString& str) const
 {
-    return resolveMultiplePlaceholdersRecursive(str, ResolveMaximumDepth);
+    if (!str.contains(QLatin1Char('{'))) {
+        return str;
+    }
+
+    return resolveCached(m_resolvedStrings, str, false);
 }
 
 QString Entry::resolvePlaceholder(const QString& placeholder) const
 {
-    return resolvePlaceholderRecursive(placeholder, ResolveMaximumDepth);
+    if (placeholderType(placeholder) == PlaceholderType::NotPlaceholder) {
+        return placeholder;
+    }
+
+    return resolveCached(m_resolvedPlaceholders, placeholder, true);
+}
+
+QString Entry::resolveCached(QHash<QString, ResolvedValue>& cache, const QString& str, bool singlePlaceholder) const
+{
+    QHash<QString, ResolvedValue>::const_iterator i = cache.constFind(str);
+    if (i != cache.constEnd() && isResolvedValueValid(i.value())) {
+        return i.value().value;
+    }
+
+    ResolvedValue resolved;
+    if (singlePlaceholder) {
+        resolved.value = resolvePlaceholderRecursive(str, ResolveMaximumDepth, &resolved);
+    }
+    else {
+        resolved.value = resolveMultiplePlaceholdersRecursive(str, ResolveMaximumDepth, &resolved);
+    }
+
+    if (resolved.cacheable) {
+        if (cache.size() >= MaxResolvedValues) {
+            cache.clear();
+        }
+        cache.insert(str, resolved);
+    }
+    else {
+        cache.remove(str);
+    }
+
+    return resolved.value;
+}
+
+bool Entry::isResolvedValueValid(const ResolvedValue& resolved) const
+{
+    if (resolved.usesReferences) {
+        Database* db = m_group ? m_group->database() : nullptr;
+        if (!db || db != resolved.database || db->referenceRevision() != resolved.referenceRevision) {
+            return false;
+        }
+    }
+
+    for (const QPair<QPointer<const Entry>, quint64>& dependency : resolved.dependencies) {
+        if (!dependency.first || dependency.first->m_revision != dependency.second) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Split a string into literal text and placeholders. The result only depends on
+ * the string, so it is shared between all entries.
+ */
+QVector<Entry::PlaceholderToken> Entry::parsePlaceholders(const QString& str)
+{
+    static QMutex cacheMutex;
+    static QCache<QString, QVector<PlaceholderToken>> cache(1000);
+
+    QMutexLocker locker(&cacheMutex);
+    if (const QVector<PlaceholderToken>* cachedTokens = cache.object(str)) {
+        return *cachedTokens;
+    }
+    locker.unlock();
+
+    QVector<PlaceholderToken> tokens;
+    int literalStart = 0;
+    int pos = 0;
+    while ((pos = str.indexOf(QLatin1Char('{'), pos)) != -1) {
+        const int end = str.indexOf(QLatin1Char('}'), pos + 1);
+        if (end == -1) {
+            break;
+        }
+        if (end == pos + 1) {
+            // "{}" is not a placeholder
+            pos = end + 1;
+            continue;
+        }
+
+        if (pos > literalStart) {
+            tokens.append({str.mid(literalStart, pos - literalStart), false});
+        }
+        tokens.append({str.mid(pos, end - pos + 1), true});
+        pos = end + 1;
+        literalStart = pos;
+    }
+    if (literalStart < str.size()) {
+        tokens.append({str.mid(literalStart), false});
+    }
+
+    locker.relock();
+    cache.insert(str, new QVector<PlaceholderToken>(tokens));
+
+    return tokens;
 }
 
 QString Entry::resolveUrlPlaceholder(const QString& str, Entry::PlaceholderType placeholderType) const
@@ -20,12 +20,14 @@
 #define KEEPASSX_ENTRY_H
 
 #include <QColor>
+#include <QHash>
 #include <QImage>
 #include <QMap>
 #include <QPixmap>
 #include <QPointer>
 #include <QSet>
 #include <QUrl>
+#include <QVector>
 
 #include "core/AutoTypeAssociations.h"
 #include "core/EntryAttachments.h"
@@ -109,6 +111,7 @@ public:
 
     static const int DefaultIconNumber;
     static const int ResolveMaximumDepth;
+    static const int MaxResolvedValues;
 
     void setUuid(const Uuid& uuid);
     void setIcon(int iconNumber);
@@ -210,12 +213,41 @@ private slots:
     void emitDataChanged();
     void updateTimeinfo();
     void updateModifiedSinceBegin();
+    void invalidateDatabaseIndexes();
+    void invalidateResolvedValues();
 
 private:
-    QString resolveMultiplePlaceholdersRecursive(const QString& str, int maxDepth) const;
-    QString resolvePlaceholderRecursive(const QString& placeholder, int maxDepth) const;
-    QString resolveReferencePlaceholderRecursive(const QString& placeholder, int maxDepth) const;
-    QString referenceFieldValue(EntryReferenceType referenceType) const;
+    struct PlaceholderToken
+    {
+        QString text;
+        bool isPlaceholder;
+    };
+
+    /**
+     * A resolved placeholder string together with everything it was derived from.
+     * Fields of the entry itself are not recorded, the whole cache is dropped
+     * when the entry changes. Values containing protected fields aren't cached.
+     */
+    struct ResolvedValue
+    {
+        QString value;
+        bool cacheable = true;
+        bool usesReferences = false;
+        QPointer<Database> database;
+        quint64 referenceRevision = 0;
+        QList<QPair<QPointer<const Entry>, quint64>> dependencies;
+    };
+
+    QString resolveCached(QHash<QString, ResolvedValue>& cache, const QString& str, bool singlePlaceholder) const;
+    bool isResolvedValueValid(const ResolvedValue& resolved) const;
+    static QVector<PlaceholderToken> parsePlaceholders(const QString& str);
+
+    QString resolveMultiplePlaceholdersRecursive(const QString& str, int maxDepth, ResolvedValue* resolved) const;
+    QString resolvePlaceholderRecursive(const QString& placeholder, int maxDepth, ResolvedValue* resolved) const;
+    QString resolveReferencePlaceholderRecursive(const QString& placeholder, int maxDepth,
+                                                 ResolvedValue* resolved) const;
+    QString referenceFieldValue(EntryReferenceType referenceType, ResolvedValue* resolved) const;
+    QString resolveField(const QString& key, ResolvedValue* resolved) const;
 
     static EntryReferenceType referenceType(const QString& referenceStr);
 
@@ -233,6 +265,9 @@ private:
     bool m_modifiedSinceBegin;
     QPointer<Group> m_group;
     bool m_updateTimeinfo;
+    quint64 m_revision;
+    mutable QHash<QString, ResolvedValue> m_resolvedStrings;
+    mutable QHash<QString, ResolvedValue> m_resolvedPlaceholders;
 };
 
 Q_DECLARE_OPERATORS_FOR_FLAGS(Entry::CloneFlags)
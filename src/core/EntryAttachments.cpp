@@ -70,6 +70,34 @@ void EntryAttachments::set(const QString& key, const QByteArray& value)
     }
 }
 
+/**
+ * Protected attachments are flagged for in-memory protection by KeePass.
+ * KeePassXC doesn't treat them differently, the flag is only kept so that
+ * it survives saving the database.
+ */
+bool EntryAttachments::isProtected(const QString& key) const
+{
+    return m_protectedAttachments.contains(key);
+}
+
+void EntryAttachments::setProtected(const QString& key, bool protect)
+{
+    Q_ASSERT(m_attachments.contains(key));
+
+    if (protect == m_protectedAttachments.contains(key)) {
+        return;
+    }
+
+    if (protect) {
+        m_protectedAttachments.insert(key);
+    }
+    else {
+        m_protectedAttachments.remove(key);
+    }
+
+    emit modified();
+}
+
 void EntryAttachments::remove(const QString& key)
 {
     if (!m_attachments.contains(key)) {
@@ -81,6 +109,7 @@ void EntryAttachments::remove(const QString& key)
     emit aboutToBeRemoved(key);
 
     m_attachments.remove(key);
+    m_protectedAttachments.remove(key);
 
     emit removed(key);
     emit modified();
@@ -103,6 +132,7 @@ void EntryAttachments::remove(const QStringList& keys)
         isModified = true;
         emit aboutToBeRemoved(key);
         m_attachments.remove(key);
+        m_protectedAttachments.remove(key);
         emit removed(key);
     }
 
@@ -120,6 +150,7 @@ void EntryAttachments::clear()
     emit aboutToBeReset();
 
     m_attachments.clear();
+    m_protectedAttachments.clear();
 
     emit reset();
     emit modified();
@@ -131,6 +162,7 @@ void EntryAttachments::copyDataFrom(const EntryAttachments* other)
         emit aboutToBeReset();
 
         m_attachments = other->m_attachments;
+        m_protectedAttachments = other->m_protectedAttachments;
 
         emit reset();
         emit modified();
@@ -139,10 +171,11 @@ void EntryAttachments::copyDataFrom(const EntryAttachments* other)
 
 bool EntryAttachments::operator==(const EntryAttachments& other) const
 {
-    return m_attachments == other.m_attachments;
+    return m_attachments == other.m_attachments
+            && m_protectedAttachments == other.m_protectedAttachments;
 }
 
 bool EntryAttachments::operator!=(const EntryAttachments& other) const
 {
-    return m_attachments != other.m_attachments;
+    return !(*this == other);
 }
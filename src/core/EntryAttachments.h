@@ -20,6 +20,7 @@
 
 #include <QMap>
 #include <QObject>
+#include <QSet>
 
 class QStringList;
 
@@ -34,6 +35,8 @@ public:
     QList<QByteArray> values() const;
     QByteArray value(const QString& key) const;
     void set(const QString& key, const QByteArray& value);
+    bool isProtected(const QString& key) const;
+    void setProtected(const QString& key, bool protect);
     void remove(const QString& key);
     void remove(const QStringList& keys);
     void clear();
@@ -53,6 +56,7 @@ signals:
 
 private:
     QMap<QString, QByteArray> m_attachments;
+    QSet<QString> m_protectedAttachments;
 };
 
 #endif // KEEPASSX_ENTRYATTACHMENTS_H
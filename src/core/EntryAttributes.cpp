@@ -18,6 +18,8 @@
 
 #include "EntryAttributes.h"
 
+#include "format/KeePass2RandomStream.h"
+
 const QString EntryAttributes::TitleKey = "Title";
 const QString EntryAttributes::UserNameKey = "UserName";
 const QString EntryAttributes::PasswordKey = "Password";
@@ -62,6 +64,11 @@ QList<QString> EntryAttributes::customKeys()
 
 QString EntryAttributes::value(const QString& key) const
 {
+    QHash<QString, QSharedPointer<EncryptedValue> >::const_iterator i = m_encryptedAttributes.constFind(key);
+    if (i != m_encryptedAttributes.constEnd()) {
+        return decrypt(i.value());
+    }
+
     return m_attributes.value(key);
 }
 
@@ -72,7 +79,13 @@ bool EntryAttributes::contains(const QString& key) const
 
 bool EntryAttributes::containsValue(const QString& value) const
 {
-    return m_attributes.values().contains(value);
+    for (QMap<QString, QString>::const_iterator i = m_attributes.constBegin(); i != m_attributes.constEnd(); ++i) {
+        if (this->value(i.key()) == value) {
+            return true;
+        }
+    }
+
+    return false;
 }
 
 bool EntryAttributes::isProtected(const QString& key) const
@@ -96,7 +109,7 @@ void EntryAttributes::set(const QString& key, const QString& value, bool protect
     bool emitModified = false;
 
     bool addAttribute = !m_attributes.contains(key);
-    bool changeValue = !addAttribute && (m_attributes.value(key) != value);
+    bool changeValue = !addAttribute && (this->value(key) != value);
     bool defaultAttribute = isDefaultAttribute(key);
 
     if (addAttribute && !defaultAttribute) {
@@ -105,6 +118,7 @@ void EntryAttributes::set(const QString& key, const QString& value, bool protect
 
     if (addAttribute || changeValue) {
         m_attributes.insert(key, value);
+        m_encryptedAttributes.remove(key);
         emitModified = true;
     }
 
@@ -133,6 +147,41 @@ void EntryAttributes::set(const QString& key, const QString& value, bool protect
     }
 }
 
+void EntryAttributes::setEncrypted(const QString& key, const QByteArray& ciphertext,
+                                   QSharedPointer<KeePass2RandomStream> randomStream, qint64 streamPosition)
+{
+    Q_ASSERT(randomStream);
+
+    bool addAttribute = !m_attributes.contains(key);
+    bool defaultAttribute = isDefaultAttribute(key);
+
+    if (addAttribute && !defaultAttribute) {
+        emit aboutToBeAdded(key);
+    }
+
+    QSharedPointer<EncryptedValue> encryptedValue(new EncryptedValue());
+    encryptedValue->ciphertext = ciphertext;
+    encryptedValue->randomStream = randomStream;
+    encryptedValue->streamPosition = streamPosition;
+    encryptedValue->decrypted = false;
+
+    m_attributes.insert(key, QString());
+    m_encryptedAttributes.insert(key, encryptedValue);
+    m_protectedAttributes.insert(key);
+
+    emit modified();
+
+    if (defaultAttribute) {
+        emit defaultKeyModified();
+    }
+    else if (addAttribute) {
+        emit added(key);
+    }
+    else {
+        emit customKeyModified(key);
+    }
+}
+
 void EntryAttributes::remove(const QString& key)
 {
     Q_ASSERT(!isDefaultAttribute(key));
@@ -146,6 +195,7 @@ void EntryAttributes::remove(const QString& key)
 
     m_attributes.remove(key);
     m_protectedAttributes.remove(key);
+    m_encryptedAttributes.remove(key);
 
     emit removed(key);
     emit modified();
@@ -166,7 +216,7 @@ void EntryAttributes::rename(const QString& oldKey, const QString& newKey)
         return;
     }
 
-    QString data = value(oldKey);
+    QString data = m_attributes.value(oldKey);
     bool protect = isProtected(oldKey);
 
     emit aboutToRename(oldKey, newKey);
@@ -177,6 +227,9 @@ void EntryAttributes::rename(const QString& oldKey, const QString& newKey)
         m_protectedAttributes.remove(oldKey);
         m_protectedAttributes.insert(newKey);
     }
+    if (m_encryptedAttributes.contains(oldKey)) {
+        m_encryptedAttributes.insert(newKey, m_encryptedAttributes.take(oldKey));
+    }
 
     emit modified();
     emit renamed(oldKey, newKey);
@@ -196,16 +249,20 @@ void EntryAttributes::copyCustomKeysFrom(const EntryAttributes* other)
         if (!isDefaultAttribute(key)) {
             m_attributes.remove(key);
             m_protectedAttributes.remove(key);
+            m_encryptedAttributes.remove(key);
         }
     }
 
     const QList<QString> otherKeyList = other->keys();
     for (const QString& key : otherKeyList) {
         if (!isDefaultAttribute(key)) {
-            m_attributes.insert(key, other->value(key));
+            m_attributes.insert(key, other->m_attributes.value(key));
             if (other->isProtected(key)) {
                 m_protectedAttributes.insert(key);
             }
+            if (other->m_encryptedAttributes.contains(key)) {
+                m_encryptedAttributes.insert(key, other->m_encryptedAttributes.value(key));
+            }
         }
     }
 
@@ -226,7 +283,7 @@ bool EntryAttributes::areCustomKeysDifferent(const EntryAttributes* other)
             continue;
         }
 
-        if (isProtected(key) != other->isProtected(key) || value(key) != other->value(key)) {
+        if (isProtected(key) != other->isProtected(key) || !isValueEqual(key, other)) {
             return true;
         }
     }
@@ -241,6 +298,7 @@ void EntryAttributes::copyDataFrom(const EntryAttributes* other)
 
         m_attributes = other->m_attributes;
         m_protectedAttributes = other->m_protectedAttributes;
+        m_encryptedAttributes = other->m_encryptedAttributes;
 
         emit reset();
         emit modified();
@@ -249,14 +307,27 @@ void EntryAttributes::copyDataFrom(const EntryAttributes* other)
 
 bool EntryAttributes::operator==(const EntryAttributes& other) const
 {
-    return (m_attributes == other.m_attributes
-            && m_protectedAttributes == other.m_protectedAttributes);
+    if (m_encryptedAttributes.isEmpty() && other.m_encryptedAttributes.isEmpty()) {
+        return (m_attributes == other.m_attributes
+                && m_protectedAttributes == other.m_protectedAttributes);
+    }
+
+    if (m_protectedAttributes != other.m_protectedAttributes || m_attributes.keys() != other.m_attributes.keys()) {
+        return false;
+    }
+
+    for (QMap<QString, QString>::const_iterator i = m_attributes.constBegin(); i != m_attributes.constEnd(); ++i) {
+        if (!isValueEqual(i.key(), &other)) {
+            return false;
+        }
+    }
+
+    return true;
 }
 
 bool EntryAttributes::operator!=(const EntryAttributes& other) const
 {
-    return (m_attributes != other.m_attributes
-            || m_protectedAttributes != other.m_protectedAttributes);
+    return !(*this == other);
 }
 
 QRegularExpressionMatch EntryAttributes::matchReference(const QString& text)
@@ -274,6 +345,7 @@ void EntryAttributes::clear()
 
     m_attributes.clear();
     m_protectedAttributes.clear();
+    m_encryptedAttributes.clear();
 
     for (const QString& key : DefaultAttributes) {
         m_attributes.insert(key, "");
@@ -290,7 +362,13 @@ int EntryAttributes::attributesSize()
     QMapIterator<QString, QString> i(m_attributes);
     while (i.hasNext()) {
         i.next();
-        size += i.value().toUtf8().size();
+        // the ciphertext has the size of the UTF-8 encoded plaintext
+        if (m_encryptedAttributes.contains(i.key())) {
+            size += m_encryptedAttributes.value(i.key())->ciphertext.size();
+        }
+        else {
+            size += i.value().toUtf8().size();
+        }
     }
     return size;
 }
@@ -299,3 +377,37 @@ bool EntryAttributes::isDefaultAttribute(const QString& key)
 {
     return DefaultAttributes.contains(key);
 }
+
+QString EntryAttributes::decrypt(const QSharedPointer<EncryptedValue>& encryptedValue)
+{
+    QMutexLocker locker(&encryptedValue->mutex);
+
+    if (!encryptedValue->decrypted) {
+        bool ok;
+        QByteArray plaintext = encryptedValue->randomStream->processAt(encryptedValue->streamPosition,
+                                                                       encryptedValue->ciphertext, &ok);
+        if (!ok) {
+            qWarning("EntryAttributes::decrypt: %s", qPrintable(encryptedValue->randomStream->errorString()));
+            return QString();
+        }
+
+        encryptedValue->plaintext = QString::fromUtf8(plaintext);
+        encryptedValue->decrypted = true;
+    }
+
+    return encryptedValue->plaintext;
+}
+
+bool EntryAttributes::isValueEqual(const QString& key, const EntryAttributes* other) const
+{
+    // values that come from the same place in the same file don't have to be decrypted
+    QHash<QString, QSharedPointer<EncryptedValue> >::const_iterator i = m_encryptedAttributes.constFind(key);
+    QHash<QString, QSharedPointer<EncryptedValue> >::const_iterator j = other->m_encryptedAttributes.constFind(key);
+    if (i != m_encryptedAttributes.constEnd() && j != other->m_encryptedAttributes.constEnd()
+            && i.value()->randomStream == j.value()->randomStream
+            && i.value()->streamPosition == j.value()->streamPosition) {
+        return true;
+    }
+
+    return value(key) == other->value(key);
+}
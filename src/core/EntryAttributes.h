@@ -19,12 +19,17 @@
 #ifndef KEEPASSX_ENTRYATTRIBUTES_H
 #define KEEPASSX_ENTRYATTRIBUTES_H
 
+#include <QHash>
 #include <QMap>
+#include <QMutex>
 #include <QObject>
 #include <QRegularExpression>
 #include <QSet>
+#include <QSharedPointer>
 #include <QStringList>
 
+class KeePass2RandomStream;
+
 class EntryAttributes : public QObject
 {
     Q_OBJECT
@@ -40,6 +45,13 @@ public:
     bool isProtected(const QString& key) const;
     bool isReference(const QString& key) const;
     void set(const QString& key, const QString& value, bool protect = false);
+
+    /**
+     * Sets a protected value that is still encrypted with the inner random stream
+     * of a database file. It is decrypted the first time it is read.
+     */
+    void setEncrypted(const QString& key, const QByteArray& ciphertext,
+                      QSharedPointer<KeePass2RandomStream> randomStream, qint64 streamPosition);
     void remove(const QString& key);
     void rename(const QString& oldKey, const QString& newKey);
     void copyCustomKeysFrom(const EntryAttributes* other);
@@ -79,8 +91,24 @@ signals:
     void reset();
 
 private:
+    struct EncryptedValue
+    {
+        QByteArray ciphertext;
+        QSharedPointer<KeePass2RandomStream> randomStream;
+        qint64 streamPosition;
+
+        // guards the cached plaintext, values are shared between copies
+        QMutex mutex;
+        bool decrypted;
+        QString plaintext;
+    };
+
+    static QString decrypt(const QSharedPointer<EncryptedValue>& encryptedValue);
+    bool isValueEqual(const QString& key, const EntryAttributes* other) const;
+
     QMap<QString, QString> m_attributes;
     QSet<QString> m_protectedAttributes;
+    QHash<QString, QSharedPointer<EncryptedValue> > m_encryptedAttributes;
 };
 
 #endif // KEEPASSX_ENTRYATTRIBUTES_H
@@ -18,7 +18,12 @@
 
 #include "EntrySearcher.h"
 
+#include <algorithm>
+
+#include "core/Database.h"
+#include "core/Global.h"
 #include "core/Group.h"
+#include "core/SearchIndex.h"
 
 QList<Entry*> EntrySearcher::search(const QString& searchTerm, const Group* group,
                                     Qt::CaseSensitivity caseSensitivity)
@@ -27,59 +32,139 @@ QList<Entry*> EntrySearcher::search(const QString& searchTerm, const Group* grou
         return QList<Entry*>();
     }
 
-    return searchEntries(searchTerm, group, caseSensitivity);
+    m_groupScopes.clear();
+
+    const QStringList words = searchWords(searchTerm);
+    QList<Entry*> searchResult;
+
+    const QList<Entry*> candidates = candidateEntries(words, group, caseSensitivity);
+    for (Entry* entry : candidates) {
+        const GroupScope scope = groupScope(entry->group(), group, words, caseSensitivity);
+        if (scope == GroupScope::Included
+                || (scope == GroupScope::Searched && matchWords(words, searchableFields(entry), caseSensitivity))) {
+            searchResult.append(entry);
+        }
+    }
+
+    return searchResult;
 }
 
-QList<Entry*> EntrySearcher::searchEntries(const QString& searchTerm, const Group* group,
-                                           Qt::CaseSensitivity caseSensitivity)
+QStringList EntrySearcher::searchWords(const QString& searchTerm)
 {
-    QList<Entry*> searchResult;
+    return searchTerm.split(QRegExp("\\s"), QString::SkipEmptyParts);
+}
 
-    const QList<Entry*> entryList = group->entries();
-    for (Entry* entry : entryList) {
-       searchResult.append(matchEntry(searchTerm, entry, caseSensitivity));
+/**
+ * Returns all entries below group that can be part of the result in tree order.
+ * If the group belongs to a database its search index is used to narrow them
+ * down, otherwise every entry is a candidate.
+ */
+QList<Entry*> EntrySearcher::candidateEntries(const QStringList& words, const Group* group,
+                                              Qt::CaseSensitivity caseSensitivity)
+{
+    if (!group->database()) {
+        return group->entriesRecursive();
     }
 
-    const QList<Group*> children = group->children();
-    for (Group* childGroup : children) {
-        if (childGroup->searchingEnabled() != Group::Disable) {
-            if (matchGroup(searchTerm, childGroup, caseSensitivity)) {
-                searchResult.append(childGroup->entriesRecursive());
-            } else {
-                searchResult.append(searchEntries(searchTerm, childGroup, caseSensitivity));
+    SearchIndex* index = group->database()->searchIndex();
+    QSet<Entry*> entryCandidates;
+    QSet<Group*> groupCandidates;
+    if (!index->entryCandidates(words, entryCandidates) || !index->groupCandidates(words, groupCandidates)) {
+        return group->entriesRecursive();
+    }
+
+    // all entries of a matching group can be part of the result
+    for (Group* candidate : asConst(groupCandidates)) {
+        if (matchGroup(words, candidate, caseSensitivity)) {
+            const QList<Entry*> groupEntries = candidate->entriesRecursive();
+            for (Entry* entry : groupEntries) {
+                entryCandidates.insert(entry);
             }
         }
     }
 
-    return searchResult;
+    // sorting a few entries is cheaper than walking the whole tree
+    if (entryCandidates.size() * 64 < index->entryCount()) {
+        QList<Entry*> candidates;
+        for (Entry* entry : asConst(entryCandidates)) {
+            if (groupScope(entry->group(), group, words, caseSensitivity) != GroupScope::Excluded) {
+                candidates.append(entry);
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(), Database::isBeforeInTree);
+        return candidates;
+    }
+
+    QList<Entry*> candidates;
+    const QList<Entry*> entryList = group->entriesRecursive();
+    for (Entry* entry : entryList) {
+        if (entryCandidates.contains(entry)) {
+            candidates.append(entry);
+        }
+    }
+
+    return candidates;
 }
 
-QList<Entry*> EntrySearcher::matchEntry(const QString& searchTerm, Entry* entry,
-                                        Qt::CaseSensitivity caseSensitivity)
+/**
+ * Searching descends from searchGroup into all child groups that don't have
+ * searching disabled. Once a group matches the search words all entries below
+ * it are part of the result. The scopes are cached, so the same searcher must
+ * not be used with different words or search groups without calling search().
+ */
+EntrySearcher::GroupScope EntrySearcher::groupScope(const Group* group, const Group* searchGroup,
+                                                    const QStringList& words, Qt::CaseSensitivity caseSensitivity)
 {
-    const QStringList wordList = searchTerm.split(QRegExp("\\s"), QString::SkipEmptyParts);
-    for (const QString& word : wordList) {
-        if (!wordMatch(word, entry, caseSensitivity)) {
-            return QList<Entry*>();
+    if (!group) {
+        return GroupScope::Excluded;
+    }
+    else if (group == searchGroup) {
+        return GroupScope::Searched;
+    }
+
+    QHash<const Group*, GroupScope>::const_iterator i = m_groupScopes.constFind(group);
+    if (i != m_groupScopes.constEnd()) {
+        return i.value();
+    }
+
+    GroupScope scope = groupScope(group->parentGroup(), searchGroup, words, caseSensitivity);
+    if (scope == GroupScope::Searched) {
+        if (group->searchingEnabled() == Group::Disable) {
+            scope = GroupScope::Excluded;
+        }
+        else if (matchGroup(words, group, caseSensitivity)) {
+            scope = GroupScope::Included;
         }
     }
 
-    return QList<Entry*>() << entry;
+    m_groupScopes.insert(group, scope);
+    return scope;
 }
 
-bool EntrySearcher::wordMatch(const QString& word, Entry* entry, Qt::CaseSensitivity caseSensitivity)
+QStringList EntrySearcher::searchableFields(Entry* entry)
 {
-    return entry->resolvePlaceholder(entry->title()).contains(word, caseSensitivity) ||
-            entry->resolvePlaceholder(entry->username()).contains(word, caseSensitivity) ||
-            entry->resolvePlaceholder(entry->url()).contains(word, caseSensitivity) ||
-            entry->resolvePlaceholder(entry->notes()).contains(word, caseSensitivity);
+    return QStringList() << entry->resolvePlaceholder(entry->title())
+                         << entry->resolvePlaceholder(entry->username())
+                         << entry->resolvePlaceholder(entry->url())
+                         << entry->resolvePlaceholder(entry->notes());
 }
 
-bool EntrySearcher::matchGroup(const QString& searchTerm, const Group* group, Qt::CaseSensitivity caseSensitivity)
+/**
+ * Returns true if every word is contained in one of the fields.
+ */
+bool EntrySearcher::matchWords(const QStringList& words, const QStringList& fields,
+                               Qt::CaseSensitivity caseSensitivity)
 {
-    const QStringList wordList = searchTerm.split(QRegExp("\\s"), QString::SkipEmptyParts);
-    for (const QString& word : wordList) {
-        if (!wordMatch(word, group, caseSensitivity)) {
+    for (const QString& word : words) {
+        bool found = false;
+        for (const QString& field : fields) {
+            if (field.contains(word, caseSensitivity)) {
+                found = true;
+                break;
+            }
+        }
+
+        if (!found) {
             return false;
         }
     }
@@ -87,8 +172,7 @@ bool EntrySearcher::matchGroup(const QString& searchTerm, const Group* group, Qt
     return true;
 }
 
-bool EntrySearcher::wordMatch(const QString& word, const Group* group, Qt::CaseSensitivity caseSensitivity)
+bool EntrySearcher::matchGroup(const QStringList& words, const Group* group, Qt::CaseSensitivity caseSensitivity)
 {
-    return group->name().contains(word, caseSensitivity) ||
-            group->notes().contains(word, caseSensitivity);
+    return matchWords(words, QStringList() << group->name() << group->notes(), caseSensitivity);
 }
@@ -19,7 +19,9 @@
 #ifndef KEEPASSX_ENTRYSEARCHER_H
 #define KEEPASSX_ENTRYSEARCHER_H
 
+#include <QHash>
 #include <QString>
+#include <QStringList>
 
 
 class Group;
@@ -28,14 +30,34 @@ class Entry;
 class EntrySearcher
 {
 public:
+    /**
+     * How the entries of a group take part in a search.
+     */
+    enum class GroupScope
+    {
+        Excluded,
+        Searched,
+        Included
+    };
+
     QList<Entry*> search(const QString& searchTerm, const Group* group, Qt::CaseSensitivity caseSensitivity);
 
+    /**
+     * The building blocks of search(). A search looks at the candidate entries
+     * in tree order and keeps those whose group is included or whose fields
+     * contain all words.
+     */
+    static QStringList searchWords(const QString& searchTerm);
+    QList<Entry*> candidateEntries(const QStringList& words, const Group* group, Qt::CaseSensitivity caseSensitivity);
+    GroupScope groupScope(const Group* group, const Group* searchGroup, const QStringList& words,
+                          Qt::CaseSensitivity caseSensitivity);
+    static QStringList searchableFields(Entry* entry);
+    static bool matchWords(const QStringList& words, const QStringList& fields, Qt::CaseSensitivity caseSensitivity);
+
 private:
-    QList<Entry*> searchEntries(const QString& searchTerm, const Group* group, Qt::CaseSensitivity caseSensitivity);
-    QList<Entry*> matchEntry(const QString& searchTerm, Entry* entry, Qt::CaseSensitivity caseSensitivity);
-    bool wordMatch(const QString& word, Entry* entry, Qt::CaseSensitivity caseSensitivity);
-    bool matchGroup(const QString& searchTerm, const Group* group, Qt::CaseSensitivity caseSensitivity);
-    bool wordMatch(const QString& word, const Group* group, Qt::CaseSensitivity caseSensitivity);
+    bool matchGroup(const QStringList& words, const Group* group, Qt::CaseSensitivity caseSensitivity);
+
+    QHash<const Group*, GroupScope> m_groupScopes;
 };
 
 #endif // KEEPASSX_ENTRYSEARCHER_H
@@ -62,6 +62,10 @@ Group::~Group()
         m_db->addDeletedObject(delGroup);
     }
 
+    if (m_db) {
+        m_db->removeGroupFromIndex(this, m_uuid);
+    }
+
     cleanupParent();
 }
 
@@ -248,19 +252,29 @@ bool Group::isExpired() const
 
 void Group::setUuid(const Uuid& uuid)
 {
-    set(m_uuid, uuid);
+    Uuid oldUuid = m_uuid;
+
+    if (set(m_uuid, uuid) && m_db) {
+        m_db->removeGroupFromIndex(this, oldUuid);
+        m_db->addGroupToIndex(this);
+    }
 }
 
 void Group::setName(const QString& name)
 {
     if (set(m_data.name, name)) {
+        if (m_db) {
+            m_db->invalidateGroupIndexes(this);
+        }
         emit dataChanged(this);
     }
 }
 
 void Group::setNotes(const QString& notes)
 {
-    set(m_data.notes, notes);
+    if (set(m_data.notes, notes) && m_db) {
+        m_db->invalidateGroupIndexes(this);
+    }
 }
 
 void Group::setIcon(int iconNumber)
@@ -405,6 +419,7 @@ void Group::setParent(Group* parent, int index)
     }
     else {
         emit aboutToMove(this, parent, index);
+        m_db->invalidateReferenceOrder();
         m_parent->m_children.removeAll(this);
         m_parent = parent;
         QObject::setParent(parent);
@@ -534,6 +549,19 @@ Entry* Group::findEntry(QString entryId)
 Entry* Group::findEntryByUuid(const Uuid& uuid)
 {
     Q_ASSERT(!uuid.isNull());
+
+    if (m_db) {
+        // with duplicate uuids the first entry in tree order is returned
+        Entry* result = nullptr;
+        const QList<Entry*> candidates = m_db->indexedEntries(uuid);
+        for (Entry* entry : candidates) {
+            if (isAncestorOf(entry->group()) && (!result || Database::isBeforeInTree(entry, result))) {
+                result = entry;
+            }
+        }
+        return result;
+    }
+
     for (Entry* entry : entriesRecursive(false)) {
         if (entry->uuid() == uuid) {
             return entry;
@@ -730,6 +758,18 @@ void Group::merge(const Group* other)
 Group* Group::findChildByUuid(const Uuid& uuid)
 {
     Q_ASSERT(!uuid.isNull());
+
+    if (m_db) {
+        Group* result = nullptr;
+        const QList<Group*> candidates = m_db->indexedGroups(uuid);
+        for (Group* group : candidates) {
+            if (isAncestorOf(group) && (!result || Database::isBeforeInTree(group, result))) {
+                result = group;
+            }
+        }
+        return result;
+    }
+
     for (Group* group : groupsRecursive(true)) {
         if (group->uuid() == uuid) {
             return group;
@@ -739,6 +779,18 @@ Group* Group::findChildByUuid(const Uuid& uuid)
     return nullptr;
 }
 
+bool Group::isAncestorOf(const Group* group) const
+{
+    while (group) {
+        if (group == this) {
+            return true;
+        }
+        group = group->parentGroup();
+    }
+
+    return false;
+}
+
 Group* Group::findChildByName(const QString& name)
 {
     for (Group* group : asConst(m_children)) {
@@ -795,6 +847,10 @@ void Group::copyDataFrom(const Group* other)
 {
     m_data = other->m_data;
     m_lastTopVisibleEntry = other->m_lastTopVisibleEntry;
+
+    if (m_db) {
+        m_db->invalidateGroupIndexes(this);
+    }
 }
 
 void Group::addEntry(Entry* entry)
@@ -808,6 +864,7 @@ void Group::addEntry(Entry* entry)
     connect(entry, SIGNAL(dataChanged(Entry*)), SIGNAL(entryDataChanged(Entry*)));
     if (m_db) {
         connect(entry, SIGNAL(modified()), m_db, SIGNAL(modifiedImmediate()));
+        m_db->addEntryToIndex(entry);
     }
 
     emit modified();
@@ -823,6 +880,7 @@ void Group::removeEntry(Entry* entry)
     entry->disconnect(this);
     if (m_db) {
         entry->disconnect(m_db);
+        m_db->removeEntryFromIndex(entry, entry->uuid());
     }
     m_entries.removeAll(entry);
     emit modified();
@@ -840,14 +898,17 @@ void Group::recSetDatabase(Database* db)
         disconnect(SIGNAL(aboutToMove(Group*,Group*,int)), m_db);
         disconnect(SIGNAL(moved()), m_db);
         disconnect(SIGNAL(modified()), m_db);
+        m_db->removeGroupFromIndex(this, m_uuid);
     }
 
     for (Entry* entry : asConst(m_entries)) {
         if (m_db) {
             entry->disconnect(m_db);
+            m_db->removeEntryFromIndex(entry, entry->uuid());
         }
         if (db) {
             connect(entry, SIGNAL(modified()), db, SIGNAL(modifiedImmediate()));
+            db->addEntryToIndex(entry);
         }
     }
 
@@ -860,6 +921,7 @@ void Group::recSetDatabase(Database* db)
         connect(this, SIGNAL(aboutToMove(Group*,Group*,int)), db, SIGNAL(groupAboutToMove(Group*,Group*,int)));
         connect(this, SIGNAL(moved()), db, SIGNAL(groupMoved()));
         connect(this, SIGNAL(modified()), db, SIGNAL(modifiedImmediate()));
+        db->addGroupToIndex(this);
     }
 
     m_db = db;
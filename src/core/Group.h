@@ -91,6 +91,7 @@ public:
 
     Group* findChildByName(const QString& name);
     Group* findChildByUuid(const Uuid& uuid);
+    bool isAncestorOf(const Group* group) const;
     Entry* findEntry(QString entryId);
     Entry* findEntryByUuid(const Uuid& uuid);
     Entry* findEntryByPath(QString entryPath, QString basePath = QString(""));
@@ -0,0 +1,215 @@
+/*
+ *  Copyright (C) 2017 KeePassXC Team <team@keepassxc.org>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 or (at your option)
+ *  version 3 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "HostIndex.h"
+
+#include <QUrl>
+#include <algorithm>
+
+#include "core/Database.h"
+#include "core/Entry.h"
+#include "core/Global.h"
+#include "core/Group.h"
+
+namespace {
+    bool hasUrlScheme(const QString& str)
+    {
+        const QString scheme = str.left(8).toLower();
+        return scheme.startsWith("http://")
+            || scheme.startsWith("https://")
+            || scheme.startsWith("ftp://")
+            || scheme.startsWith("ftps://");
+    }
+}
+
+HostIndex::Node::~Node()
+{
+    qDeleteAll(children);
+}
+
+HostIndex::HostIndex(Group* rootGroup)
+{
+    const QList<Entry*> entries = rootGroup->entriesRecursive();
+    for (Entry* entry : entries) {
+        m_dirty.insert(entry);
+    }
+}
+
+HostIndex::~HostIndex()
+{
+}
+
+void HostIndex::invalidateEntry(Entry* entry)
+{
+    m_dirty.insert(entry);
+}
+
+void HostIndex::removeEntry(Entry* entry)
+{
+    m_dirty.remove(entry);
+    m_unindexedEntries.remove(entry);
+
+    const QStringList hosts = m_hosts.take(entry);
+    for (const QString& host : hosts) {
+        removeHost(entry, host);
+    }
+}
+
+QVector<QList<Entry*>> HostIndex::findEntries(const QString& hostname)
+{
+    if (hostname.isEmpty()) {
+        return QVector<QList<Entry*>>();
+    }
+
+    update();
+
+    const QStringList hostLabels = labels(hostname);
+    QVector<QList<Entry*>> result(hostLabels.size());
+
+    const Node* node = &m_root;
+    for (int i = 0; i < hostLabels.size(); ++i) {
+        node = node->children.value(hostLabels.at(i));
+        if (!node) {
+            break;
+        }
+        result[hostLabels.size() - 1 - i] = node->entries.toList();
+    }
+
+    // the urls of these entries depend on other entries
+    for (Entry* entry : asConst(m_unindexedEntries)) {
+        const QStringList hosts = entryHosts(entry);
+        for (const QString& host : hosts) {
+            const QStringList entryLabels = labels(host);
+            if (entryLabels.size() <= hostLabels.size() && hostLabels.mid(0, entryLabels.size()) == entryLabels) {
+                QList<Entry*>& entries = result[hostLabels.size() - entryLabels.size()];
+                if (!entries.contains(entry)) {
+                    entries.append(entry);
+                }
+            }
+        }
+    }
+
+    for (QList<Entry*>& entries : result) {
+        std::sort(entries.begin(), entries.end(), Database::isBeforeInTree);
+    }
+
+    return result;
+}
+
+/**
+ * Returns the hosts an entry is found for: the host of its url and the host
+ * of its title if the title is a url or a plain host name.
+ */
+QStringList HostIndex::entryHosts(const Entry* entry)
+{
+    QStringList hosts;
+
+    const QString url = entry->webUrl();
+    if (!url.isEmpty()) {
+        const QString host = QUrl(url).host();
+        if (!host.isEmpty()) {
+            hosts.append(host);
+        }
+    }
+
+    const QString title = entry->title();
+    QString titleHost;
+    if (hasUrlScheme(title)) {
+        titleHost = QUrl(title).host();
+    }
+    else if (!title.isEmpty() && !title.contains("://")) {
+        const QString host = QUrl(QString("https://").append(title)).host();
+        if (host == title.toLower()) {
+            titleHost = host;
+        }
+    }
+    if (!titleHost.isEmpty() && !hosts.contains(titleHost)) {
+        hosts.append(titleHost);
+    }
+
+    return hosts;
+}
+
+/**
+ * Splits a host name into its labels, starting with the top level domain.
+ */
+QStringList HostIndex::labels(const QString& host)
+{
+    QStringList result = host.toLower().split('.');
+    std::reverse(result.begin(), result.end());
+    return result;
+}
+
+void HostIndex::addHost(Entry* entry, const QString& host)
+{
+    Node* node = &m_root;
+    const QStringList hostLabels = labels(host);
+    for (const QString& label : hostLabels) {
+        Node*& child = node->children[label];
+        if (!child) {
+            child = new Node();
+        }
+        node = child;
+    }
+    node->entries.insert(entry);
+}
+
+void HostIndex::removeHost(Entry* entry, const QString& host)
+{
+    const QStringList hostLabels = labels(host);
+    QVector<Node*> path;
+    path.reserve(hostLabels.size() + 1);
+    path.append(&m_root);
+    for (const QString& label : hostLabels) {
+        Node* child = path.last()->children.value(label);
+        if (!child) {
+            return;
+        }
+        path.append(child);
+    }
+    path.last()->entries.remove(entry);
+
+    // drop the nodes that no longer lead to any entry
+    for (int i = path.size() - 1; i > 0; --i) {
+        Node* node = path.at(i);
+        if (!node->entries.isEmpty() || !node->children.isEmpty()) {
+            break;
+        }
+        path.at(i - 1)->children.remove(hostLabels.at(i - 1));
+        delete node;
+    }
+}
+
+void HostIndex::update()
+{
+    const QSet<Entry*> dirtyEntries = m_dirty;
+    m_dirty.clear();
+    for (Entry* entry : dirtyEntries) {
+        removeEntry(entry);
+
+        if (entry->url().contains('{')) {
+            m_unindexedEntries.insert(entry);
+        }
+        else {
+            const QStringList hosts = entryHosts(entry);
+            for (const QString& host : hosts) {
+                addHost(entry, host);
+            }
+            m_hosts.insert(entry, hosts);
+        }
+    }
+}
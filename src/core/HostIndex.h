@@ -0,0 +1,76 @@
+/*
+ *  Copyright (C) 2017 KeePassXC Team <team@keepassxc.org>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 or (at your option)
+ *  version 3 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef KEEPASSX_HOSTINDEX_H
+#define KEEPASSX_HOSTINDEX_H
+
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+#include <QVector>
+
+class Entry;
+class Group;
+
+/**
+ * Index of the host names of the entry urls and of the titles that are urls
+ * or host names. The hosts are stored in a trie of their labels in reverse
+ * order, so a lookup only walks the labels of the requested host name.
+ * A title that is a single label like "GitHub" matches nothing, it would
+ * match any host containing that label, e.g. "github.attacker.com".
+ *
+ * Changed entries are reindexed when the index is queried the next time.
+ */
+class HostIndex
+{
+public:
+    explicit HostIndex(Group* rootGroup);
+    ~HostIndex();
+
+    void invalidateEntry(Entry* entry);
+    void removeEntry(Entry* entry);
+
+    /**
+     * Returns the entries whose host is hostname or one of its parent domains.
+     * Element 0 holds the entries for hostname itself, element 1 those for
+     * hostname without its first label and so on. Each list is in tree order.
+     */
+    QVector<QList<Entry*>> findEntries(const QString& hostname);
+
+    static QStringList entryHosts(const Entry* entry);
+
+private:
+    struct Node
+    {
+        ~Node();
+
+        QHash<QString, Node*> children;
+        QSet<Entry*> entries;
+    };
+
+    static QStringList labels(const QString& host);
+    void addHost(Entry* entry, const QString& host);
+    void removeHost(Entry* entry, const QString& host);
+    void update();
+
+    Node m_root;
+    QHash<Entry*, QStringList> m_hosts;
+    QSet<Entry*> m_dirty;
+    QSet<Entry*> m_unindexedEntries;
+};
+
+#endif // KEEPASSX_HOSTINDEX_H
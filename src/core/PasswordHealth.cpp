@@ -0,0 +1,216 @@
+/*
+ *  Copyright (C) 2017 KeePassXC Team <team@keepassxc.org>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 or (at your option)
+ *  version 3 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PasswordHealth.h"
+
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+#include <QtConcurrent>
+
+#include <zxcvbn.h>
+
+#include "core/Database.h"
+#include "core/Entry.h"
+#include "core/Group.h"
+#include "core/Metadata.h"
+#include "crypto/CryptoHash.h"
+#include "crypto/Random.h"
+
+namespace {
+    double estimateEntropy(const QByteArray& password)
+    {
+        return ZxcvbnMatch(password.constData(), 0, 0);
+    }
+}
+
+PasswordHealth::PasswordHealth()
+    : m_hashKey(randomGen()->randomArray(32))
+    , m_weakEntropy(40.0)
+    , m_staleDays(365)
+    , m_estimatedCount(0)
+{
+}
+
+PasswordHealth::~PasswordHealth()
+{
+}
+
+QList<PasswordHealth::Report> PasswordHealth::analyze(const Group* group)
+{
+    const Group* recycleBin = nullptr;
+    if (group->database()) {
+        recycleBin = group->database()->metadata()->recycleBin();
+    }
+
+    QList<Report> reports;
+    QList<QByteArray> hashes;
+    QHash<QByteArray, int> reuseCounts;
+    QList<QByteArray> newPasswords;
+    QList<QByteArray> newHashes;
+    QSet<QByteArray> pendingHashes;
+
+    const QList<Entry*> entries = group->entriesRecursive();
+    for (Entry* entry : entries) {
+        bool inRecycleBin = false;
+        for (const Group* g = entry->group(); g; g = g->parentGroup()) {
+            if (g == recycleBin) {
+                inRecycleBin = true;
+                break;
+            }
+        }
+        if (inRecycleBin) {
+            continue;
+        }
+
+        Report report;
+        report.entry = entry;
+        report.problems = NoProblem;
+        report.entropy = -1;
+        report.reuseCount = 0;
+        report.passwordChanged = passwordChanged(entry);
+        reports.append(report);
+
+        /* passwords referencing another entry are checked with that entry */
+        const QString password = entry->password();
+        if (password.isEmpty()
+            || entry->placeholderType(password) == Entry::PlaceholderType::Reference) {
+            hashes.append(QByteArray());
+            continue;
+        }
+
+        const QByteArray hash = passwordHash(password);
+        hashes.append(hash);
+        reuseCounts[hash]++;
+
+        if (!m_entropies.contains(hash) && !pendingHashes.contains(hash)) {
+            pendingHashes.insert(hash);
+            newPasswords.append(password.toLatin1());
+            newHashes.append(hash);
+        }
+    }
+
+    /* zxcvbn is the expensive part, run it on all cores */
+    const QList<double> newEntropies = QtConcurrent::blockingMapped(newPasswords, estimateEntropy);
+    for (int i = 0; i < newHashes.size(); ++i) {
+        m_entropies.insert(newHashes[i], newEntropies[i]);
+    }
+    m_estimatedCount = newHashes.size();
+
+    const QDateTime now = QDateTime::currentDateTimeUtc();
+    for (int i = 0; i < reports.size(); ++i) {
+        Report& report = reports[i];
+        const QByteArray& hash = hashes[i];
+
+        if (!hash.isEmpty()) {
+            report.entropy = m_entropies.value(hash);
+            report.reuseCount = reuseCounts.value(hash);
+            if (report.entropy < m_weakEntropy) {
+                report.problems |= WeakPassword;
+            }
+            if (report.reuseCount > 1) {
+                report.problems |= ReusedPassword;
+            }
+            if (report.passwordChanged.isValid() && report.passwordChanged.daysTo(now) > m_staleDays) {
+                report.problems |= StalePassword;
+            }
+        }
+
+        if (report.entry->isExpired()) {
+            report.problems |= Expired;
+        }
+    }
+
+    return reports;
+}
+
+double PasswordHealth::weakEntropy() const
+{
+    return m_weakEntropy;
+}
+
+void PasswordHealth::setWeakEntropy(double bits)
+{
+    m_weakEntropy = bits;
+}
+
+int PasswordHealth::staleDays() const
+{
+    return m_staleDays;
+}
+
+void PasswordHealth::setStaleDays(int days)
+{
+    m_staleDays = days;
+}
+
+int PasswordHealth::estimatedCount() const
+{
+    return m_estimatedCount;
+}
+
+void PasswordHealth::clearCache()
+{
+    m_entropies.clear();
+}
+
+QString PasswordHealth::problemsToString(Problems problems)
+{
+    QStringList list;
+    if (problems & WeakPassword) {
+        list << QObject::tr("Weak password");
+    }
+    if (problems & ReusedPassword) {
+        list << QObject::tr("Reused password");
+    }
+    if (problems & Expired) {
+        list << QObject::tr("Expired");
+    }
+    if (problems & StalePassword) {
+        list << QObject::tr("Old password");
+    }
+
+    return list.join(", ");
+}
+
+/**
+ * The hash is keyed with a random key that only lives in memory, so the
+ * cache can't be used to test guesses of the passwords.
+ */
+QByteArray PasswordHealth::passwordHash(const QString& password) const
+{
+    return CryptoHash::hmac(password.toUtf8(), m_hashKey, CryptoHash::Sha256);
+}
+
+/**
+ * Returns when the password of entry was last changed, according to the
+ * history of the entry.
+ */
+QDateTime PasswordHealth::passwordChanged(const Entry* entry)
+{
+    QDateTime changed = entry->timeInfo().lastModificationTime();
+
+    const QList<Entry*>& history = entry->historyItems();
+    for (int i = history.size() - 1; i >= 0; --i) {
+        if (history[i]->password() != entry->password()) {
+            break;
+        }
+        changed = history[i]->timeInfo().lastModificationTime();
+    }
+
+    return changed;
+}
@@ -0,0 +1,100 @@
+/*
+ *  Copyright (C) 2017 KeePassXC Team <team@keepassxc.org>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 or (at your option)
+ *  version 3 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef KEEPASSX_PASSWORDHEALTH_H
+#define KEEPASSX_PASSWORDHEALTH_H
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QFlags>
+#include <QHash>
+#include <QList>
+#include <QString>
+
+class Entry;
+class Group;
+
+/**
+ * Audits the passwords of all entries of a group: weak passwords (estimated
+ * with zxcvbn on all cores), passwords used by more than one entry, expired
+ * entries and passwords that haven't been changed for a long time.
+ *
+ * Passwords are only compared by a keyed hash, no plaintext copies are kept.
+ * The entropy estimates are cached by that hash, so analyzing the database
+ * again after some edits only estimates the new passwords.
+ */
+class PasswordHealth
+{
+public:
+    enum Problem
+    {
+        NoProblem = 0,
+        WeakPassword = 1 << 0,
+        ReusedPassword = 1 << 1,
+        Expired = 1 << 2,
+        StalePassword = 1 << 3
+    };
+    Q_DECLARE_FLAGS(Problems, Problem)
+
+    struct Report
+    {
+        Entry* entry;
+        Problems problems;
+        /* -1 if the entry has no password to estimate */
+        double entropy;
+        /* number of entries that use the same password, including this one */
+        int reuseCount;
+        QDateTime passwordChanged;
+    };
+
+    PasswordHealth();
+    ~PasswordHealth();
+
+    /**
+     * Analyzes all entries of group and its subgroups except the ones in
+     * the recycle bin. Returns one report per entry, in tree order.
+     */
+    QList<Report> analyze(const Group* group);
+
+    double weakEntropy() const;
+    void setWeakEntropy(double bits);
+    int staleDays() const;
+    void setStaleDays(int days);
+
+    /**
+     * Returns how many passwords had to be estimated by the last analysis,
+     * the others were found in the cache.
+     */
+    int estimatedCount() const;
+    void clearCache();
+
+    static QString problemsToString(Problems problems);
+
+private:
+    QByteArray passwordHash(const QString& password) const;
+    static QDateTime passwordChanged(const Entry* entry);
+
+    const QByteArray m_hashKey;
+    QHash<QByteArray, double> m_entropies;
+    double m_weakEntropy;
+    int m_staleDays;
+    int m_estimatedCount;
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(PasswordHealth::Problems)
+
+#endif // KEEPASSX_PASSWORDHEALTH_H
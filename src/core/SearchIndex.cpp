@@ -0,0 +1,200 @@
+/*
+ *  Copyright (C) 2017 KeePassXC Team <team@keepassxc.org>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 or (at your option)
+ *  version 3 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "SearchIndex.h"
+
+#include <algorithm>
+
+#include "core/Entry.h"
+#include "core/Global.h"
+#include "core/Group.h"
+
+SearchIndex::SearchIndex(Group* rootGroup)
+{
+    const QList<Group*> groups = rootGroup->groupsRecursive(true);
+    for (Group* group : groups) {
+        m_groups.dirty.insert(group);
+
+        const QList<Entry*> entries = group->entries();
+        for (Entry* entry : entries) {
+            m_entries.dirty.insert(entry);
+        }
+    }
+}
+
+void SearchIndex::invalidateEntry(Entry* entry)
+{
+    m_entries.dirty.insert(entry);
+}
+
+void SearchIndex::removeEntry(Entry* entry)
+{
+    m_entries.dirty.remove(entry);
+    m_unindexedEntries.remove(entry);
+    removeObject(m_entries, entry);
+}
+
+void SearchIndex::invalidateGroup(Group* group)
+{
+    m_groups.dirty.insert(group);
+}
+
+void SearchIndex::removeGroup(Group* group)
+{
+    m_groups.dirty.remove(group);
+    removeObject(m_groups, group);
+}
+
+bool SearchIndex::entryCandidates(const QStringList& words, QSet<Entry*>& candidates)
+{
+    update();
+
+    if (!SearchIndex::candidates(m_entries, words, candidates)) {
+        return false;
+    }
+
+    // the values of these entries depend on other entries
+    candidates.unite(m_unindexedEntries);
+    return true;
+}
+
+bool SearchIndex::groupCandidates(const QStringList& words, QSet<Group*>& candidates)
+{
+    update();
+
+    return SearchIndex::candidates(m_groups, words, candidates);
+}
+
+int SearchIndex::entryCount()
+{
+    update();
+
+    return m_entries.trigrams.size() + m_unindexedEntries.size();
+}
+
+void SearchIndex::update()
+{
+    const QSet<Entry*> dirtyEntries = m_entries.dirty;
+    m_entries.dirty.clear();
+    for (Entry* entry : dirtyEntries) {
+        removeObject(m_entries, entry);
+        m_unindexedEntries.remove(entry);
+
+        const QStringList fields = QStringList() << entry->title() << entry->username()
+                                                 << entry->url() << entry->notes();
+        bool hasPlaceholder = false;
+        for (const QString& field : fields) {
+            if (entry->placeholderType(field) != Entry::PlaceholderType::NotPlaceholder) {
+                hasPlaceholder = true;
+                break;
+            }
+        }
+
+        if (hasPlaceholder) {
+            m_unindexedEntries.insert(entry);
+        }
+        else {
+            addObject(m_entries, entry, fields);
+        }
+    }
+
+    const QSet<Group*> dirtyGroups = m_groups.dirty;
+    m_groups.dirty.clear();
+    for (Group* group : dirtyGroups) {
+        removeObject(m_groups, group);
+        addObject(m_groups, group, QStringList() << group->name() << group->notes());
+    }
+}
+
+template <class T> void SearchIndex::addObject(TrigramTable<T>& table, T* object, const QStringList& texts)
+{
+    const QVector<quint64> objectTrigrams = trigrams(texts);
+    for (quint64 trigram : objectTrigrams) {
+        table.objects[trigram].insert(object);
+    }
+    table.trigrams.insert(object, objectTrigrams);
+}
+
+template <class T> void SearchIndex::removeObject(TrigramTable<T>& table, T* object)
+{
+    const QVector<quint64> objectTrigrams = table.trigrams.take(object);
+    for (quint64 trigram : objectTrigrams) {
+        typename QHash<quint64, QSet<T*>>::iterator i = table.objects.find(trigram);
+        if (i != table.objects.end()) {
+            i.value().remove(object);
+            if (i.value().isEmpty()) {
+                table.objects.erase(i);
+            }
+        }
+    }
+}
+
+template <class T> bool SearchIndex::candidates(const TrigramTable<T>& table, const QStringList& words,
+                                                QSet<T*>& result)
+{
+    QVector<quint64> wordTrigrams;
+    for (const QString& word : words) {
+        wordTrigrams += trigrams(QStringList() << word);
+    }
+    if (wordTrigrams.isEmpty()) {
+        return false;
+    }
+
+    // start with the rarest trigram to keep the intersections small
+    QVector<const QSet<T*>*> objectSets;
+    for (quint64 trigram : asConst(wordTrigrams)) {
+        typename QHash<quint64, QSet<T*>>::const_iterator i = table.objects.constFind(trigram);
+        if (i == table.objects.constEnd()) {
+            result.clear();
+            return true;
+        }
+        objectSets.append(&i.value());
+    }
+    std::sort(objectSets.begin(), objectSets.end(), [](const QSet<T*>* a, const QSet<T*>* b) {
+        return a->size() < b->size();
+    });
+
+    result = *objectSets.first();
+    for (int i = 1; i < objectSets.size() && !result.isEmpty(); ++i) {
+        result.intersect(*objectSets[i]);
+    }
+
+    return true;
+}
+
+/**
+ * Returns the sorted and deduplicated trigrams of the case folded texts.
+ * Trigrams never span two texts.
+ */
+QVector<quint64> SearchIndex::trigrams(const QStringList& texts)
+{
+    QVector<quint64> result;
+    for (const QString& text : texts) {
+        const QString folded = text.toCaseFolded();
+        const QChar* data = folded.constData();
+        for (int i = 0; i + 3 <= folded.size(); ++i) {
+            result.append((static_cast<quint64>(data[i].unicode()) << 32)
+                          | (static_cast<quint64>(data[i + 1].unicode()) << 16)
+                          | static_cast<quint64>(data[i + 2].unicode()));
+        }
+    }
+
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+    return result;
+}
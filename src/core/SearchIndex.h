@@ -0,0 +1,80 @@
+/*
+ *  Copyright (C) 2017 KeePassXC Team <team@keepassxc.org>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 or (at your option)
+ *  version 3 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef KEEPASSX_SEARCHINDEX_H
+#define KEEPASSX_SEARCHINDEX_H
+
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+#include <QVector>
+
+class Entry;
+class Group;
+
+/**
+ * Trigram index over the searchable fields of all entries and groups of a
+ * database. It only narrows down the objects that can possibly contain a word
+ * (case-insensitively), the caller still has to check the candidates.
+ *
+ * Changed objects are reindexed when the index is queried the next time.
+ */
+class SearchIndex
+{
+public:
+    explicit SearchIndex(Group* rootGroup);
+
+    void invalidateEntry(Entry* entry);
+    void removeEntry(Entry* entry);
+    void invalidateGroup(Group* group);
+    void removeGroup(Group* group);
+
+    /**
+     * Collect the entries whose title, username, url or notes may contain all
+     * words. Returns false if none of the words is long enough to use the index,
+     * in that case every entry is a candidate.
+     */
+    bool entryCandidates(const QStringList& words, QSet<Entry*>& candidates);
+    /**
+     * Same as entryCandidates() for the name and notes of groups.
+     */
+    bool groupCandidates(const QStringList& words, QSet<Group*>& candidates);
+    int entryCount();
+
+private:
+    template <class T> struct TrigramTable
+    {
+        QHash<quint64, QSet<T*>> objects;
+        QHash<T*, QVector<quint64>> trigrams;
+        QSet<T*> dirty;
+    };
+
+    template <class T> static void addObject(TrigramTable<T>& table, T* object, const QStringList& texts);
+    template <class T> static void removeObject(TrigramTable<T>& table, T* object);
+    template <class T> static bool candidates(const TrigramTable<T>& table, const QStringList& words,
+                                              QSet<T*>& result);
+    static QVector<quint64> trigrams(const QStringList& texts);
+
+    void update();
+
+    TrigramTable<Entry> m_entries;
+    TrigramTable<Group> m_groups;
+    QSet<Entry*> m_unindexedEntries;
+};
+
+#endif // KEEPASSX_SEARCHINDEX_H
@@ -28,7 +28,7 @@ public:
     int hashLen;
 };
 
-CryptoHash::CryptoHash(CryptoHash::Algorithm algo)
+CryptoHash::CryptoHash(CryptoHash::Algorithm algo, bool hmac)
     : d_ptr(new CryptoHashPrivate())
 {
     Q_D(CryptoHash);
@@ -42,12 +42,16 @@ CryptoHash::CryptoHash(CryptoHash::Algorithm algo)
         algoGcrypt = GCRY_MD_SHA256;
         break;
 
+    case CryptoHash::Sha512:
+        algoGcrypt = GCRY_MD_SHA512;
+        break;
+
     default:
         Q_ASSERT(false);
         break;
     }
 
-    gcry_error_t error = gcry_md_open(&d->ctx, algoGcrypt, 0);
+    gcry_error_t error = gcry_md_open(&d->ctx, algoGcrypt, hmac ? GCRY_MD_FLAG_HMAC : 0);
     Q_ASSERT(error == 0); // TODO: error handling
     Q_UNUSED(error);
 
@@ -74,6 +78,15 @@ void CryptoHash::addData(const QByteArray& data)
     gcry_md_write(d->ctx, data.constData(), data.size());
 }
 
+void CryptoHash::setKey(const QByteArray& data)
+{
+    Q_D(CryptoHash);
+
+    gcry_error_t error = gcry_md_setkey(d->ctx, data.constData(), data.size());
+    Q_ASSERT(error == 0);
+    Q_UNUSED(error);
+}
+
 void CryptoHash::reset()
 {
     Q_D(CryptoHash);
@@ -96,3 +109,11 @@ QByteArray CryptoHash::hash(const QByteArray& data, CryptoHash::Algorithm algo)
     cryptoHash.addData(data);
     return cryptoHash.result();
 }
+
+QByteArray CryptoHash::hmac(const QByteArray& data, const QByteArray& key, CryptoHash::Algorithm algo)
+{
+    CryptoHash cryptoHash(algo, true);
+    cryptoHash.setKey(key);
+    cryptoHash.addData(data);
+    return cryptoHash.result();
+}
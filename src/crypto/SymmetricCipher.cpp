@@ -61,6 +61,7 @@ SymmetricCipherBackend* SymmetricCipher::createBackend(SymmetricCipher::Algorith
     case SymmetricCipher::Aes256:
     case SymmetricCipher::Twofish:
     case SymmetricCipher::Salsa20:
+    case SymmetricCipher::ChaCha20:
         return new SymmetricCipherGcrypt(algo, mode, direction);
 
     default:
@@ -94,6 +95,9 @@ SymmetricCipher::Algorithm SymmetricCipher::cipherToAlgorithm(Uuid cipher)
     if (cipher == KeePass2::CIPHER_AES) {
         return SymmetricCipher::Aes256;
     }
+    else if (cipher == KeePass2::CIPHER_CHACHA20) {
+        return SymmetricCipher::ChaCha20;
+    }
     else {
         return SymmetricCipher::Twofish;
     }
@@ -104,7 +108,36 @@ Uuid SymmetricCipher::algorithmToCipher(SymmetricCipher::Algorithm algo)
     switch (algo) {
     case SymmetricCipher::Aes256:
         return KeePass2::CIPHER_AES;
+    case SymmetricCipher::ChaCha20:
+        return KeePass2::CIPHER_CHACHA20;
     default:
         return KeePass2::CIPHER_TWOFISH;
     }
 }
+
+/**
+ * Block ciphers are used in CBC mode by the KeePass formats, stream
+ * ciphers encrypt the data as is.
+ */
+SymmetricCipher::Mode SymmetricCipher::algorithmMode(SymmetricCipher::Algorithm algo)
+{
+    switch (algo) {
+    case SymmetricCipher::Salsa20:
+    case SymmetricCipher::ChaCha20:
+        return SymmetricCipher::Stream;
+    default:
+        return SymmetricCipher::Cbc;
+    }
+}
+
+int SymmetricCipher::algorithmIvSize(SymmetricCipher::Algorithm algo)
+{
+    switch (algo) {
+    case SymmetricCipher::Salsa20:
+        return 8;
+    case SymmetricCipher::ChaCha20:
+        return 12;
+    default:
+        return 16;
+    }
+}
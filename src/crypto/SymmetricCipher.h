@@ -32,7 +32,8 @@ public:
     {
         Aes256,
         Twofish,
-        Salsa20
+        Salsa20,
+        ChaCha20
     };
 
     enum Mode
@@ -76,6 +77,8 @@ public:
 
     static SymmetricCipher::Algorithm cipherToAlgorithm(Uuid cipher);
     static Uuid algorithmToCipher(SymmetricCipher::Algorithm algo);
+    static SymmetricCipher::Mode algorithmMode(SymmetricCipher::Algorithm algo);
+    static int algorithmIvSize(SymmetricCipher::Algorithm algo);
 
 private:
     static SymmetricCipherBackend* createBackend(SymmetricCipher::Algorithm algo, SymmetricCipher::Mode mode,
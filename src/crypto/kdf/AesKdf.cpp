@@ -0,0 +1,133 @@
+/*
+ *  Copyright (C) 2017 KeePassXC Team <team@keepassxc.org>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 or (at your option)
+ *  version 3 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "AesKdf.h"
+
+#include <QElapsedTimer>
+#include <QtConcurrent>
+
+#include "crypto/CryptoHash.h"
+#include "crypto/SymmetricCipher.h"
+#include "format/KeePass2.h"
+
+const quint64 AesKdf::DefaultRounds = 100000;
+
+AesKdf::AesKdf()
+    : Kdf(KeePass2::KDF_AES)
+{
+    m_rounds = DefaultRounds;
+}
+
+bool AesKdf::transform(const QByteArray& raw, QByteArray& result, QString* errorString) const
+{
+    Q_ASSERT(raw.size() == 32);
+
+    if (m_seed.size() != 32) {
+        if (errorString) {
+            *errorString = "Invalid transform seed size";
+        }
+        return false;
+    }
+
+    bool okLeft;
+    QString errorStringLeft;
+    bool okRight;
+    QString errorStringRight;
+
+    // both halves are independent, so transform them in parallel
+    QFuture<QByteArray> future = QtConcurrent::run(transformKeyRaw, raw.left(16), m_seed, m_rounds,
+                                                   &okLeft, &errorStringLeft);
+    QByteArray result2 = transformKeyRaw(raw.right(16), m_seed, m_rounds, &okRight, &errorStringRight);
+
+    QByteArray transformed;
+    transformed.append(future.result());
+    transformed.append(result2);
+
+    if (!okLeft || !okRight) {
+        if (errorString) {
+            *errorString = okLeft ? errorStringRight : errorStringLeft;
+        }
+        return false;
+    }
+
+    result = CryptoHash::hash(transformed, CryptoHash::Sha256);
+    return true;
+}
+
+QByteArray AesKdf::transformKeyRaw(const QByteArray& key, const QByteArray& seed,
+                                   quint64 rounds, bool* ok, QString* errorString)
+{
+    QByteArray iv(16, 0);
+    SymmetricCipher cipher(SymmetricCipher::Aes256, SymmetricCipher::Ecb,
+                           SymmetricCipher::Encrypt);
+    if (!cipher.init(seed, iv)) {
+        *ok = false;
+        *errorString = cipher.errorString();
+        return QByteArray();
+    }
+
+    QByteArray result = key;
+
+    if (!cipher.processInPlace(result, rounds)) {
+        *ok = false;
+        *errorString = cipher.errorString();
+        return QByteArray();
+    }
+
+    *ok = true;
+    return result;
+}
+
+QSharedPointer<Kdf> AesKdf::clone() const
+{
+    return QSharedPointer<Kdf>(new AesKdf(*this));
+}
+
+quint64 AesKdf::benchmarkImpl(int msec) const
+{
+    // the transformation runs on two threads, so benchmark both at the same time
+    QFuture<quint64> future = QtConcurrent::run(benchmarkRounds, msec);
+    quint64 rounds = benchmarkRounds(msec);
+
+    return qMin(rounds, future.result());
+}
+
+quint64 AesKdf::benchmarkRounds(int msec)
+{
+    QByteArray key = QByteArray(16, '\x7E');
+    QByteArray seed = QByteArray(32, '\x4B');
+    QByteArray iv(16, 0);
+    quint64 rounds = 0;
+
+    SymmetricCipher cipher(SymmetricCipher::Aes256, SymmetricCipher::Ecb,
+                           SymmetricCipher::Encrypt);
+    if (!cipher.init(seed, iv)) {
+        return 0;
+    }
+
+    QElapsedTimer t;
+    t.start();
+
+    do {
+        if (!cipher.processInPlace(key, 10000)) {
+            return 0;
+        }
+        rounds += 10000;
+    } while (!t.hasExpired(msec));
+
+    return rounds;
+}
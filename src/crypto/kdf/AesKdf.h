@@ -0,0 +1,42 @@
+/*
+ *  Copyright (C) 2017 KeePassXC Team <team@keepassxc.org>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 or (at your option)
+ *  version 3 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef KEEPASSX_AESKDF_H
+#define KEEPASSX_AESKDF_H
+
+#include "crypto/kdf/Kdf.h"
+
+class AesKdf : public Kdf
+{
+public:
+    AesKdf();
+
+    bool transform(const QByteArray& raw, QByteArray& result, QString* errorString) const override;
+    QSharedPointer<Kdf> clone() const override;
+
+    static const quint64 DefaultRounds;
+
+protected:
+    quint64 benchmarkImpl(int msec) const override;
+
+private:
+    static QByteArray transformKeyRaw(const QByteArray& key, const QByteArray& seed,
+                                      quint64 rounds, bool* ok, QString* errorString);
+    static quint64 benchmarkRounds(int msec);
+};
+
+#endif // KEEPASSX_AESKDF_H
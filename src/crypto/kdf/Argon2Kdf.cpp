@@ -0,0 +1,148 @@
+/*
+ *  Copyright (C) 2017 KeePassXC Team <team@keepassxc.org>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 or (at your option)
+ *  version 3 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Argon2Kdf.h"
+
+#include <QElapsedTimer>
+#include <QThread>
+
+#include <argon2.h>
+
+#include "format/KeePass2.h"
+
+const quint32 Argon2Kdf::DefaultIterations = 2;
+// memory in KiB
+const quint64 Argon2Kdf::DefaultMemory = 64 * 1024;
+const quint32 Argon2Kdf::MinParallelism = 1;
+const quint32 Argon2Kdf::MaxParallelism = 64;
+
+Argon2Kdf::Argon2Kdf(Type type)
+    : Kdf(type == Type::Argon2id ? KeePass2::KDF_ARGON2ID : KeePass2::KDF_ARGON2D)
+    , m_type(type)
+    , m_version(ARGON2_VERSION_13)
+    , m_memory(DefaultMemory)
+    , m_parallelism(qBound(MinParallelism, static_cast<quint32>(QThread::idealThreadCount()), MaxParallelism))
+{
+    m_rounds = DefaultIterations;
+}
+
+Argon2Kdf::Type Argon2Kdf::type() const
+{
+    return m_type;
+}
+
+quint32 Argon2Kdf::version() const
+{
+    return m_version;
+}
+
+bool Argon2Kdf::setVersion(quint32 version)
+{
+    if (version != ARGON2_VERSION_10 && version != ARGON2_VERSION_13) {
+        return false;
+    }
+
+    m_version = version;
+    return true;
+}
+
+quint64 Argon2Kdf::memory() const
+{
+    return m_memory;
+}
+
+bool Argon2Kdf::setMemory(quint64 kibibytes)
+{
+    // libargon2 needs at least 8 KiB per lane
+    if (kibibytes < 8 * static_cast<quint64>(m_parallelism) || kibibytes > ARGON2_MAX_MEMORY) {
+        return false;
+    }
+
+    m_memory = kibibytes;
+    return true;
+}
+
+quint32 Argon2Kdf::parallelism() const
+{
+    return m_parallelism;
+}
+
+bool Argon2Kdf::setParallelism(quint32 parallelism)
+{
+    if (parallelism < MinParallelism || parallelism > MaxParallelism) {
+        return false;
+    }
+
+    m_parallelism = parallelism;
+    m_memory = qMax(m_memory, 8 * static_cast<quint64>(parallelism));
+    return true;
+}
+
+bool Argon2Kdf::transform(const QByteArray& raw, QByteArray& result, QString* errorString) const
+{
+    if (m_rounds > ARGON2_MAX_TIME) {
+        if (errorString) {
+            *errorString = "Too many Argon2 iterations";
+        }
+        return false;
+    }
+
+    return transformRaw(raw, static_cast<quint32>(m_rounds), result, errorString);
+}
+
+bool Argon2Kdf::transformRaw(const QByteArray& raw, quint32 iterations, QByteArray& result,
+                             QString* errorString) const
+{
+    QByteArray hash(32, '\0');
+
+    // argon2_hash() starts one thread per lane
+    int rc = argon2_hash(iterations, static_cast<quint32>(m_memory), m_parallelism,
+                         raw.constData(), raw.size(), m_seed.constData(), m_seed.size(),
+                         hash.data(), hash.size(), nullptr, 0,
+                         m_type == Type::Argon2id ? Argon2_id : Argon2_d, m_version);
+    if (rc != ARGON2_OK) {
+        if (errorString) {
+            *errorString = QString::fromLatin1(argon2_error_message(rc));
+        }
+        return false;
+    }
+
+    result = hash;
+    return true;
+}
+
+QSharedPointer<Kdf> Argon2Kdf::clone() const
+{
+    return QSharedPointer<Kdf>(new Argon2Kdf(*this));
+}
+
+quint64 Argon2Kdf::benchmarkImpl(int msec) const
+{
+    QByteArray key(32, '\x7E');
+    QByteArray result;
+
+    // Every iteration passes over the whole memory once, so the time of
+    // a single iteration scales linearly to the target time.
+    QElapsedTimer t;
+    t.start();
+    if (!transformRaw(key, 1, result, nullptr)) {
+        return 1;
+    }
+    qint64 elapsed = qMax(Q_INT64_C(1), t.elapsed());
+
+    return qMax(Q_UINT64_C(1), static_cast<quint64>(msec / elapsed));
+}
@@ -0,0 +1,68 @@
+/*
+ *  Copyright (C) 2017 KeePassXC Team <team@keepassxc.org>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 or (at your option)
+ *  version 3 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef KEEPASSX_ARGON2KDF_H
+#define KEEPASSX_ARGON2KDF_H
+
+#include "crypto/kdf/Kdf.h"
+
+/**
+ * Argon2 key derivation. The rounds of the base class are the Argon2
+ * iterations, the seed is used as salt. The lanes are computed in
+ * parallel on worker threads by libargon2.
+ */
+class Argon2Kdf : public Kdf
+{
+public:
+    enum class Type
+    {
+        Argon2d,
+        Argon2id
+    };
+
+    explicit Argon2Kdf(Type type = Type::Argon2d);
+
+    Type type() const;
+    quint32 version() const;
+    bool setVersion(quint32 version);
+    quint64 memory() const;
+    bool setMemory(quint64 kibibytes);
+    quint32 parallelism() const;
+    bool setParallelism(quint32 parallelism);
+
+    bool transform(const QByteArray& raw, QByteArray& result, QString* errorString) const override;
+    QSharedPointer<Kdf> clone() const override;
+
+    static const quint32 DefaultIterations;
+    static const quint64 DefaultMemory;
+    static const quint32 MinParallelism;
+    static const quint32 MaxParallelism;
+
+protected:
+    quint64 benchmarkImpl(int msec) const override;
+
+private:
+    bool transformRaw(const QByteArray& raw, quint32 iterations, QByteArray& result,
+                      QString* errorString) const;
+
+    Type m_type;
+    quint32 m_version;
+    quint64 m_memory;
+    quint32 m_parallelism;
+};
+
+#endif // KEEPASSX_ARGON2KDF_H
@@ -0,0 +1,91 @@
+/*
+ *  Copyright (C) 2017 KeePassXC Team <team@keepassxc.org>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 or (at your option)
+ *  version 3 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Kdf.h"
+
+#include "crypto/Random.h"
+#include "crypto/kdf/AesKdf.h"
+#include "crypto/kdf/Argon2Kdf.h"
+#include "format/KeePass2.h"
+
+Kdf::Kdf(const Uuid& uuid)
+    : m_rounds(1)
+    , m_seed(32, '\0')
+    , m_uuid(uuid)
+{
+}
+
+Kdf::~Kdf()
+{
+}
+
+Uuid Kdf::uuid() const
+{
+    return m_uuid;
+}
+
+quint64 Kdf::rounds() const
+{
+    return m_rounds;
+}
+
+bool Kdf::setRounds(quint64 rounds)
+{
+    if (rounds == 0) {
+        return false;
+    }
+
+    m_rounds = rounds;
+    return true;
+}
+
+QByteArray Kdf::seed() const
+{
+    return m_seed;
+}
+
+void Kdf::setSeed(const QByteArray& seed)
+{
+    m_seed = seed;
+}
+
+void Kdf::randomizeSeed()
+{
+    m_seed = randomGen()->randomArray(32);
+}
+
+quint64 Kdf::benchmark(int msec) const
+{
+    Q_ASSERT(msec > 0);
+
+    return qMax(Q_UINT64_C(1), benchmarkImpl(msec));
+}
+
+QSharedPointer<Kdf> Kdf::create(const Uuid& uuid)
+{
+    if (uuid == KeePass2::KDF_AES) {
+        return QSharedPointer<Kdf>(new AesKdf());
+    }
+    else if (uuid == KeePass2::KDF_ARGON2D) {
+        return QSharedPointer<Kdf>(new Argon2Kdf(Argon2Kdf::Type::Argon2d));
+    }
+    else if (uuid == KeePass2::KDF_ARGON2ID) {
+        return QSharedPointer<Kdf>(new Argon2Kdf(Argon2Kdf::Type::Argon2id));
+    }
+
+    return QSharedPointer<Kdf>();
+}
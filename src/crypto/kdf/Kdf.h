@@ -0,0 +1,70 @@
+/*
+ *  Copyright (C) 2017 KeePassXC Team <team@keepassxc.org>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 or (at your option)
+ *  version 3 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef KEEPASSX_KDF_H
+#define KEEPASSX_KDF_H
+
+#include <QByteArray>
+#include <QSharedPointer>
+#include <QString>
+
+#include "core/Uuid.h"
+
+/**
+ * Key derivation function used to transform the composite key
+ * into the transformed master key.
+ */
+class Kdf
+{
+public:
+    explicit Kdf(const Uuid& uuid);
+    virtual ~Kdf();
+
+    Uuid uuid() const;
+
+    quint64 rounds() const;
+    virtual bool setRounds(quint64 rounds);
+    QByteArray seed() const;
+    void setSeed(const QByteArray& seed);
+    void randomizeSeed();
+
+    virtual bool transform(const QByteArray& raw, QByteArray& result, QString* errorString) const = 0;
+    virtual QSharedPointer<Kdf> clone() const = 0;
+
+    /**
+     * Returns the number of rounds that can be computed in about msec
+     * milliseconds with the remaining parameters of this instance.
+     */
+    quint64 benchmark(int msec) const;
+
+    /**
+     * Creates a KDF with default parameters from its uuid or
+     * returns a null pointer if the uuid is unknown.
+     */
+    static QSharedPointer<Kdf> create(const Uuid& uuid);
+
+protected:
+    virtual quint64 benchmarkImpl(int msec) const = 0;
+
+    quint64 m_rounds;
+    QByteArray m_seed;
+
+private:
+    Uuid m_uuid;
+};
+
+#endif // KEEPASSX_KDF_H
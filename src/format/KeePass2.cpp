@@ -0,0 +1,136 @@
+/*
+ *  Copyright (C) 2017 KeePassXC Team <team@keepassxc.org>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 or (at your option)
+ *  version 3 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "KeePass2.h"
+
+#include "crypto/CryptoHash.h"
+#include "crypto/kdf/AesKdf.h"
+#include "crypto/kdf/Argon2Kdf.h"
+
+namespace {
+    QSharedPointer<Kdf> aesKdfFromParameters(const QVariantMap& parameters)
+    {
+        bool ok;
+        quint64 rounds = parameters.value(KeePass2::KDFPARAM_AES_ROUNDS).toULongLong(&ok);
+        QByteArray seed = parameters.value(KeePass2::KDFPARAM_AES_SEED).toByteArray();
+        if (!ok || seed.size() != 32) {
+            return QSharedPointer<Kdf>();
+        }
+
+        QSharedPointer<Kdf> kdf(new AesKdf());
+        if (!kdf->setRounds(rounds)) {
+            return QSharedPointer<Kdf>();
+        }
+        kdf->setSeed(seed);
+
+        return kdf;
+    }
+
+    QSharedPointer<Kdf> argon2KdfFromParameters(Argon2Kdf::Type type, const QVariantMap& parameters)
+    {
+        // secret keys and associated data are not supported
+        if (!parameters.value(KeePass2::KDFPARAM_ARGON2_SECRET).toByteArray().isEmpty()
+                || !parameters.value(KeePass2::KDFPARAM_ARGON2_ASSOCDATA).toByteArray().isEmpty()) {
+            return QSharedPointer<Kdf>();
+        }
+
+        bool ok;
+        QByteArray salt = parameters.value(KeePass2::KDFPARAM_ARGON2_SALT).toByteArray();
+        quint32 version = parameters.value(KeePass2::KDFPARAM_ARGON2_VERSION).toUInt(&ok);
+        if (!ok || salt.isEmpty()) {
+            return QSharedPointer<Kdf>();
+        }
+        quint32 parallelism = parameters.value(KeePass2::KDFPARAM_ARGON2_PARALLELISM).toUInt(&ok);
+        if (!ok) {
+            return QSharedPointer<Kdf>();
+        }
+        quint64 memory = parameters.value(KeePass2::KDFPARAM_ARGON2_MEMORY).toULongLong(&ok);
+        if (!ok) {
+            return QSharedPointer<Kdf>();
+        }
+        quint64 iterations = parameters.value(KeePass2::KDFPARAM_ARGON2_ITERATIONS).toULongLong(&ok);
+        if (!ok) {
+            return QSharedPointer<Kdf>();
+        }
+
+        Argon2Kdf* argon2 = new Argon2Kdf(type);
+        QSharedPointer<Kdf> kdf(argon2);
+
+        // the memory is stored in bytes, Argon2Kdf uses KiB
+        if (!argon2->setVersion(version) || !argon2->setParallelism(parallelism)
+                || !argon2->setMemory(memory / 1024) || !argon2->setRounds(iterations)) {
+            return QSharedPointer<Kdf>();
+        }
+        argon2->setSeed(salt);
+
+        return kdf;
+    }
+}
+
+QSharedPointer<Kdf> KeePass2::kdfFromParameters(const QVariantMap& parameters)
+{
+    QByteArray uuidBytes = parameters.value(KDFPARAM_UUID).toByteArray();
+    if (uuidBytes.size() != Uuid::Length) {
+        return QSharedPointer<Kdf>();
+    }
+
+    Uuid uuid(uuidBytes);
+    if (uuid == KDF_AES) {
+        return aesKdfFromParameters(parameters);
+    }
+    else if (uuid == KDF_ARGON2D) {
+        return argon2KdfFromParameters(Argon2Kdf::Type::Argon2d, parameters);
+    }
+    else if (uuid == KDF_ARGON2ID) {
+        return argon2KdfFromParameters(Argon2Kdf::Type::Argon2id, parameters);
+    }
+
+    return QSharedPointer<Kdf>();
+}
+
+QVariantMap KeePass2::kdfToParameters(const Kdf& kdf)
+{
+    QVariantMap parameters;
+    parameters.insert(KDFPARAM_UUID, kdf.uuid().toByteArray());
+
+    if (kdf.uuid() == KDF_AES) {
+        parameters.insert(KDFPARAM_AES_ROUNDS, static_cast<quint64>(kdf.rounds()));
+        parameters.insert(KDFPARAM_AES_SEED, kdf.seed());
+    }
+    else {
+        const Argon2Kdf& argon2 = static_cast<const Argon2Kdf&>(kdf);
+        parameters.insert(KDFPARAM_ARGON2_SALT, argon2.seed());
+        parameters.insert(KDFPARAM_ARGON2_PARALLELISM, static_cast<quint32>(argon2.parallelism()));
+        parameters.insert(KDFPARAM_ARGON2_MEMORY, static_cast<quint64>(argon2.memory() * 1024));
+        parameters.insert(KDFPARAM_ARGON2_ITERATIONS, static_cast<quint64>(argon2.rounds()));
+        parameters.insert(KDFPARAM_ARGON2_VERSION, static_cast<quint32>(argon2.version()));
+    }
+
+    return parameters;
+}
+
+QByteArray KeePass2::hmacKey(const QByteArray& masterSeed, const QByteArray& challengeResponseKey,
+                             const QByteArray& transformedMasterKey)
+{
+    CryptoHash hash(CryptoHash::Sha512);
+    hash.addData(masterSeed);
+    hash.addData(challengeResponseKey);
+    hash.addData(transformedMasterKey);
+    hash.addData(QByteArray(1, '\x01'));
+    return hash.result();
+}
@@ -18,15 +18,22 @@
 #ifndef KEEPASSX_KEEPASS2_H
 #define KEEPASSX_KEEPASS2_H
 
+#include <QSharedPointer>
+#include <QString>
+#include <QVariantMap>
 #include <QtGlobal>
 
 #include "core/Uuid.h"
 
+class Kdf;
+
 namespace KeePass2
 {
     const quint32 SIGNATURE_1 = 0x9AA2D903;
     const quint32 SIGNATURE_2 = 0xB54BFB67;
-    const quint32 FILE_VERSION = 0x00030001;
+    const quint32 FILE_VERSION_3 = 0x00030001;
+    const quint32 FILE_VERSION_4 = 0x00040000;
+    const quint32 FILE_VERSION = FILE_VERSION_4;
     const quint32 FILE_VERSION_MIN = 0x00020000;
     const quint32 FILE_VERSION_CRITICAL_MASK = 0xFFFF0000;
 
@@ -34,6 +41,14 @@ namespace KeePass2
 
     const Uuid CIPHER_AES = Uuid(QByteArray::fromHex("31c1f2e6bf714350be5805216afc5aff"));
     const Uuid CIPHER_TWOFISH = Uuid(QByteArray::fromHex("ad68f29f576f4bb9a36ad47af965346c"));
+    const Uuid CIPHER_CHACHA20 = Uuid(QByteArray::fromHex("d6038a2b8b6f4cb5a524339a31dbb59a"));
+
+    const Uuid KDF_AES = Uuid(QByteArray::fromHex("c9d9f39a628a4460bf740d08c18a4fea"));
+    const Uuid KDF_ARGON2D = Uuid(QByteArray::fromHex("ef636ddf8c29444b91f7a9a403e30a0c"));
+    const Uuid KDF_ARGON2ID = Uuid(QByteArray::fromHex("9e298b1956db4773b23dfc3ec6f0a1e6"));
+
+    // seconds between 0001-01-01 (KDBX 4 timestamps) and the Unix epoch
+    const qint64 EPOCH_OFFSET_SECS = Q_INT64_C(62135596800);
 
     const QByteArray INNER_STREAM_SALSA20_IV("\xE8\x30\x09\x4B\x97\x20\x5D\x2A");
 
@@ -49,14 +64,69 @@ namespace KeePass2
         EncryptionIV = 7,
         ProtectedStreamKey = 8,
         StreamStartBytes = 9,
-        InnerRandomStreamID = 10
+        InnerRandomStreamID = 10,
+        KdfParameters = 11,
+        PublicCustomData = 12
     };
 
+    enum InnerHeaderFieldID
+    {
+        InnerHeaderEnd = 0,
+        InnerHeaderRandomStreamID = 1,
+        InnerHeaderRandomStreamKey = 2,
+        InnerHeaderBinary = 3
+    };
+
+    // flags of an InnerHeaderBinary field
+    const quint8 InnerBinaryProtected = 0x01;
+
     enum ProtectedStreamAlgo
     {
         ArcFourVariant = 1,
-        Salsa20 = 2
+        Salsa20 = 2,
+        ChaCha20 = 3
     };
+
+    enum VariantMapFieldType
+    {
+        VariantMapEnd = 0,
+        VariantMapUInt32 = 0x04,
+        VariantMapUInt64 = 0x05,
+        VariantMapBool = 0x08,
+        VariantMapInt32 = 0x0C,
+        VariantMapInt64 = 0x0D,
+        VariantMapString = 0x18,
+        VariantMapByteArray = 0x42
+    };
+
+    const quint16 VARIANTMAP_VERSION = 0x0100;
+    const quint16 VARIANTMAP_CRITICAL_MASK = 0xFF00;
+
+    // KDBX 4 stores the KDF parameters in a variant map with these keys
+    const QString KDFPARAM_UUID("$UUID");
+    const QString KDFPARAM_AES_ROUNDS("R");
+    const QString KDFPARAM_AES_SEED("S");
+    const QString KDFPARAM_ARGON2_SALT("S");
+    const QString KDFPARAM_ARGON2_PARALLELISM("P");
+    const QString KDFPARAM_ARGON2_MEMORY("M");
+    const QString KDFPARAM_ARGON2_ITERATIONS("I");
+    const QString KDFPARAM_ARGON2_VERSION("V");
+    const QString KDFPARAM_ARGON2_SECRET("K");
+    const QString KDFPARAM_ARGON2_ASSOCDATA("A");
+
+    /**
+     * Converts between a KDF and the KDBX 4 variant map representation
+     * of its parameters. kdfFromParameters() returns a null pointer for
+     * unknown or invalid parameters.
+     */
+    QSharedPointer<Kdf> kdfFromParameters(const QVariantMap& parameters);
+    QVariantMap kdfToParameters(const Kdf& kdf);
+
+    /**
+     * Derives the key of the KDBX 4 HMAC block stream.
+     */
+    QByteArray hmacKey(const QByteArray& masterSeed, const QByteArray& challengeResponseKey,
+                       const QByteArray& transformedMasterKey);
 }
 
 #endif // KEEPASSX_KEEPASS2_H
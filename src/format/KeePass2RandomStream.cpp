@@ -17,38 +17,92 @@
 
 #include "KeePass2RandomStream.h"
 
+#include <cstring>
+
+#include "core/Endian.h"
 #include "crypto/CryptoHash.h"
 #include "format/KeePass2.h"
 
-KeePass2RandomStream::KeePass2RandomStream()
-    : m_cipher(SymmetricCipher::Salsa20, SymmetricCipher::Stream, SymmetricCipher::Encrypt)
-    , m_offset(0)
+namespace {
+    inline quint32 rotateLeft(quint32 value, int bits)
+    {
+        return (value << bits) | (value >> (32 - bits));
+    }
+
+    inline void salsa20QuarterRound(quint32& a, quint32& b, quint32& c, quint32& d)
+    {
+        b ^= rotateLeft(a + d, 7);
+        c ^= rotateLeft(b + a, 9);
+        d ^= rotateLeft(c + b, 13);
+        a ^= rotateLeft(d + c, 18);
+    }
+}
+
+KeePass2RandomStream::KeePass2RandomStream(KeePass2::ProtectedStreamAlgo algo)
+    : m_algo(algo)
+    , m_cipher(cipherAlgo(algo), SymmetricCipher::Stream, SymmetricCipher::Encrypt)
+    , m_cipherBlockIndex(-1)
+    , m_bufferBlockIndex(-1)
+    , m_position(0)
 {
 }
 
 bool KeePass2RandomStream::init(const QByteArray& key)
 {
-    return m_cipher.init(CryptoHash::hash(key, CryptoHash::Sha256),
-                         KeePass2::INNER_STREAM_SALSA20_IV);
+    m_key = key;
+    m_bufferBlockIndex = -1;
+    m_position = 0;
+
+    if (m_algo == KeePass2::ChaCha20) {
+        QByteArray keyIv = CryptoHash::hash(key, CryptoHash::Sha512);
+        m_cipherKey = keyIv.left(32);
+        m_cipherNonce = keyIv.mid(32, 12);
+    }
+    else {
+        m_cipherKey = CryptoHash::hash(key, CryptoHash::Sha256);
+        m_cipherNonce = KeePass2::INNER_STREAM_SALSA20_IV;
+
+        // the key stream blocks are computed directly, the block counter
+        // in words 8 and 9 is set for each block
+        const char* sigma = "expand 32-byte k";
+        for (int i = 0; i < 4; ++i) {
+            m_salsa20State[i * 5] = Endian::bytesToUInt32(QByteArray(sigma + i * 4, 4), QSysInfo::LittleEndian);
+            m_salsa20State[1 + i] = Endian::bytesToUInt32(m_cipherKey.mid(i * 4, 4), QSysInfo::LittleEndian);
+            m_salsa20State[11 + i] = Endian::bytesToUInt32(m_cipherKey.mid(16 + i * 4, 4), QSysInfo::LittleEndian);
+        }
+        m_salsa20State[6] = Endian::bytesToUInt32(m_cipherNonce.left(4), QSysInfo::LittleEndian);
+        m_salsa20State[7] = Endian::bytesToUInt32(m_cipherNonce.mid(4, 4), QSysInfo::LittleEndian);
+        m_salsa20State[8] = 0;
+        m_salsa20State[9] = 0;
+
+        m_cipherBlockIndex = -1;
+        return true;
+    }
+
+    m_cipherBlockIndex = 0;
+    return m_cipher.init(m_cipherKey, m_cipherNonce);
 }
 
 QByteArray KeePass2RandomStream::randomBytes(int size, bool* ok)
 {
     QByteArray result;
+    result.reserve(size);
 
     int bytesRemaining = size;
 
     while (bytesRemaining > 0) {
-        if (m_buffer.size() == m_offset) {
-            if (!loadBlock()) {
+        qint64 blockIndex = m_position / BlockSize;
+        if (blockIndex != m_bufferBlockIndex) {
+            if (!loadBlock(blockIndex)) {
                 *ok = false;
                 return QByteArray();
             }
         }
 
-        int bytesToCopy = qMin(bytesRemaining, m_buffer.size() - m_offset);
-        result.append(m_buffer.mid(m_offset, bytesToCopy));
-        m_offset += bytesToCopy;
+        int offset = static_cast<int>(m_position % BlockSize);
+        int bytesToCopy = qMin(bytesRemaining, BlockSize - offset);
+        result.append(m_buffer.constData() + offset, bytesToCopy);
+        m_position += bytesToCopy;
         bytesRemaining -= bytesToCopy;
     }
 
@@ -97,15 +151,107 @@ QString KeePass2RandomStream::errorString() const
     return m_cipher.errorString();
 }
 
-bool KeePass2RandomStream::loadBlock()
+qint64 KeePass2RandomStream::position() const
+{
+    return m_position;
+}
+
+void KeePass2RandomStream::seek(qint64 position)
+{
+    Q_ASSERT(position >= 0);
+
+    m_position = position;
+}
+
+QByteArray KeePass2RandomStream::processAt(qint64 position, const QByteArray& data, bool* ok)
+{
+    QMutexLocker locker(&m_mutex);
+
+    seek(position);
+    return process(data, ok);
+}
+
+QSharedPointer<KeePass2RandomStream> KeePass2RandomStream::clone() const
 {
-    Q_ASSERT(m_offset == m_buffer.size());
+    QSharedPointer<KeePass2RandomStream> stream(new KeePass2RandomStream(m_algo));
+    if (!stream->init(m_key)) {
+        return QSharedPointer<KeePass2RandomStream>();
+    }
+
+    return stream;
+}
+
+SymmetricCipher::Algorithm KeePass2RandomStream::cipherAlgo(KeePass2::ProtectedStreamAlgo algo)
+{
+    switch (algo) {
+    case KeePass2::ChaCha20:
+        return SymmetricCipher::ChaCha20;
+
+    case KeePass2::Salsa20:
+        return SymmetricCipher::Salsa20;
+
+    default:
+        Q_ASSERT(false);
+        return SymmetricCipher::Salsa20;
+    }
+}
+
+bool KeePass2RandomStream::loadBlock(qint64 blockIndex)
+{
+    if (m_algo == KeePass2::Salsa20) {
+        // libgcrypt can't set the Salsa20 block counter
+        salsa20Block(static_cast<quint64>(blockIndex));
+        m_bufferBlockIndex = blockIndex;
+        return true;
+    }
 
-    m_buffer.fill('\0', m_cipher.blockSize());
+    if (blockIndex != m_cipherBlockIndex) {
+        // a 16 byte IV sets the 32 bit block counter in front of the nonce
+        QByteArray iv = Endian::int32ToBytes(static_cast<qint32>(blockIndex), QSysInfo::LittleEndian);
+        iv.append(m_cipherNonce);
+        if (!m_cipher.init(m_cipherKey, iv)) {
+            return false;
+        }
+    }
+
+    m_buffer.fill('\0', BlockSize);
     if (!m_cipher.processInPlace(m_buffer)) {
         return false;
     }
-    m_offset = 0;
+    m_cipherBlockIndex = blockIndex + 1;
+    m_bufferBlockIndex = blockIndex;
 
     return true;
 }
+
+/**
+ * Computes the Salsa20/20 key stream block with the given block counter into m_buffer.
+ */
+void KeePass2RandomStream::salsa20Block(quint64 blockIndex)
+{
+    quint32 input[16];
+    memcpy(input, m_salsa20State, sizeof(input));
+    input[8] = static_cast<quint32>(blockIndex);
+    input[9] = static_cast<quint32>(blockIndex >> 32);
+
+    quint32 x[16];
+    memcpy(x, input, sizeof(x));
+
+    for (int i = 0; i < 10; ++i) {
+        // column round
+        salsa20QuarterRound(x[0], x[4], x[8], x[12]);
+        salsa20QuarterRound(x[5], x[9], x[13], x[1]);
+        salsa20QuarterRound(x[10], x[14], x[2], x[6]);
+        salsa20QuarterRound(x[15], x[3], x[7], x[11]);
+        // row round
+        salsa20QuarterRound(x[0], x[1], x[2], x[3]);
+        salsa20QuarterRound(x[5], x[6], x[7], x[4]);
+        salsa20QuarterRound(x[10], x[11], x[8], x[9]);
+        salsa20QuarterRound(x[15], x[12], x[13], x[14]);
+    }
+
+    m_buffer.clear();
+    for (int i = 0; i < 16; ++i) {
+        m_buffer.append(Endian::int32ToBytes(static_cast<qint32>(x[i] + input[i]), QSysInfo::LittleEndian));
+    }
+}
@@ -19,25 +19,59 @@
 #define KEEPASSX_KEEPASS2RANDOMSTREAM_H
 
 #include <QByteArray>
+#include <QMutex>
+#include <QSharedPointer>
 
 #include "crypto/SymmetricCipher.h"
+#include "format/KeePass2.h"
 
 class KeePass2RandomStream
 {
 public:
-    KeePass2RandomStream();
+    explicit KeePass2RandomStream(KeePass2::ProtectedStreamAlgo algo = KeePass2::Salsa20);
     bool init(const QByteArray& key);
     QByteArray randomBytes(int size, bool* ok);
     QByteArray process(const QByteArray& data, bool* ok);
     Q_REQUIRED_RESULT bool processInPlace(QByteArray& data);
     QString errorString() const;
 
+    /**
+     * Offset of the next key stream byte. Protected values can be decrypted
+     * out of order, both ciphers compute a key stream block from its index.
+     */
+    qint64 position() const;
+    void seek(qint64 position);
+
+    /**
+     * Seeks to position and processes data in one step. Unlike the other
+     * functions it is thread-safe, for streams shared by lazily decrypted values.
+     */
+    QByteArray processAt(qint64 position, const QByteArray& data, bool* ok);
+
+    /**
+     * Returns an independent stream with the same key or a null pointer
+     * if it can't be initialized.
+     */
+    QSharedPointer<KeePass2RandomStream> clone() const;
+
 private:
-    bool loadBlock();
+    static SymmetricCipher::Algorithm cipherAlgo(KeePass2::ProtectedStreamAlgo algo);
+    bool loadBlock(qint64 blockIndex);
+    void salsa20Block(quint64 blockIndex);
+
+    static const int BlockSize = 64;
 
+    const KeePass2::ProtectedStreamAlgo m_algo;
+    QByteArray m_key;
     SymmetricCipher m_cipher;
+    QByteArray m_cipherKey;
+    QByteArray m_cipherNonce;
+    quint32 m_salsa20State[16];
+    qint64 m_cipherBlockIndex;
     QByteArray m_buffer;
-    int m_offset;
+    qint64 m_bufferBlockIndex;
+    qint64 m_position;
+    QMutex m_mutex;
 };
 
 #endif // KEEPASSX_KEEPASS2RANDOMSTREAM_H
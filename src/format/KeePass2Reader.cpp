@@ -24,11 +24,14 @@
 #include "core/Database.h"
 #include "core/Endian.h"
 #include "crypto/CryptoHash.h"
+#include "crypto/kdf/Kdf.h"
 #include "format/KeePass1.h"
 #include "format/KeePass2.h"
 #include "format/KeePass2RandomStream.h"
 #include "format/KeePass2XmlReader.h"
 #include "streams/HashedBlockStream.h"
+#include "streams/HmacBlockStream.h"
+#include "streams/PipelineStream.h"
 #include "streams/QtIOCompressor"
 #include "streams/StoreDataStream.h"
 #include "streams/SymmetricCipherStream.h"
@@ -39,7 +42,10 @@ KeePass2Reader::KeePass2Reader()
     , m_error(false)
     , m_headerEnd(false)
     , m_saveXml(false)
+    , m_pipelined(true)
+    , m_version(0)
     , m_db(nullptr)
+    , m_irsAlgo(KeePass2::Salsa20)
 {
 }
 
@@ -52,11 +58,17 @@ Database* KeePass2Reader::readDatabase(QIODevice* device, const CompositeKey& ke
     m_errorStr.clear();
     m_headerEnd = false;
     m_xmlData.clear();
+    m_version = 0;
     m_masterSeed.clear();
     m_transformSeed.clear();
     m_encryptionIV.clear();
     m_streamStartBytes.clear();
     m_protectedStreamKey.clear();
+    m_irsAlgo = KeePass2::Salsa20;
+    m_headerHash.clear();
+    m_headerHmac.clear();
+    m_binaries.clear();
+    m_protectedBinaries.clear();
 
     StoreDataStream headerStream(m_device);
     headerStream.open(QIODevice::ReadOnly);
@@ -90,6 +102,8 @@ Database* KeePass2Reader::readDatabase(QIODevice* device, const CompositeKey& ke
         raiseError(tr("Unsupported KeePass database version."));
         return nullptr;
     }
+    m_version = version;
+    bool kdbx4 = m_version >= KeePass2::FILE_VERSION_4;
 
     while (readHeaderField() && !hasError()) {
     }
@@ -101,13 +115,31 @@ Database* KeePass2Reader::readDatabase(QIODevice* device, const CompositeKey& ke
     }
 
     // check if all required headers were present
-    if (m_masterSeed.isEmpty() || m_transformSeed.isEmpty() || m_encryptionIV.isEmpty()
+    if (kdbx4) {
+        // the inner random stream is set up by the inner header
+        if (m_masterSeed.isEmpty() || m_transformSeed.isEmpty() || m_encryptionIV.isEmpty()
+                || m_db->cipher().isNull()) {
+            raiseError("missing database headers");
+            return nullptr;
+        }
+
+        if (!readKdbx4Hashes(headerStream.storedData())) {
+            return nullptr;
+        }
+    }
+    else if (m_masterSeed.isEmpty() || m_transformSeed.isEmpty() || m_encryptionIV.isEmpty()
             || m_streamStartBytes.isEmpty() || m_protectedStreamKey.isEmpty()
             || m_db->cipher().isNull()) {
         raiseError("missing database headers");
         return nullptr;
     }
 
+    const SymmetricCipher::Algorithm cipherAlgo = SymmetricCipher::cipherToAlgorithm(m_db->cipher());
+    if (m_encryptionIV.size() != SymmetricCipher::algorithmIvSize(cipherAlgo)) {
+        raiseError("Invalid encryption iv size");
+        return nullptr;
+    }
+
     if (!m_db->setKey(key, m_transformSeed, false)) {
         raiseError(tr("Unable to calculate master key"));
         return nullptr;
@@ -124,8 +156,38 @@ Database* KeePass2Reader::readDatabase(QIODevice* device, const CompositeKey& ke
     hash.addData(m_db->transformedMasterKey());
     QByteArray finalKey = hash.result();
 
-    SymmetricCipherStream cipherStream(m_device, SymmetricCipher::cipherToAlgorithm(m_db->cipher()),
-                                       SymmetricCipher::Cbc, SymmetricCipher::Decrypt);
+    // Every layer of the stream stack below the XML parser gets a thread of its own when
+    // pipelining is enabled. The stages have to be destroyed before the device they wrap.
+    QScopedPointer<HmacBlockStream> hmacStream;
+    QScopedPointer<PipelineStream> hmacStage;
+    QIODevice* cipherBaseDevice = m_device;
+
+    if (kdbx4) {
+        QByteArray hmacKey = KeePass2::hmacKey(m_masterSeed, m_db->challengeResponseKey(),
+                                               m_db->transformedMasterKey());
+        QByteArray headerHmac = CryptoHash::hmac(headerStream.storedData(),
+                                                 HmacBlockStream::getHmacKey(Q_UINT64_C(0xFFFFFFFFFFFFFFFF),
+                                                                             hmacKey),
+                                                 CryptoHash::Sha256);
+        if (headerHmac != m_headerHmac) {
+            raiseError(tr("Wrong key or database file is corrupt."));
+            return nullptr;
+        }
+
+        hmacStream.reset(new HmacBlockStream(m_device, hmacKey));
+        if (!hmacStream->open(QIODevice::ReadOnly)) {
+            raiseError(hmacStream->errorString());
+            return nullptr;
+        }
+        cipherBaseDevice = hmacStream.data();
+
+        if (!openPipelineStage(hmacStage, cipherBaseDevice)) {
+            return nullptr;
+        }
+    }
+
+    SymmetricCipherStream cipherStream(cipherBaseDevice, cipherAlgo, SymmetricCipher::algorithmMode(cipherAlgo),
+                                       SymmetricCipher::Decrypt);
     if (!cipherStream.init(finalKey, m_encryptionIV)) {
         raiseError(cipherStream.errorString());
         return nullptr;
@@ -135,36 +197,75 @@ Database* KeePass2Reader::readDatabase(QIODevice* device, const CompositeKey& ke
         return nullptr;
     }
 
-    QByteArray realStart = cipherStream.read(32);
+    if (!kdbx4) {
+        QByteArray realStart = cipherStream.read(32);
 
-    if (realStart != m_streamStartBytes) {
-        raiseError(tr("Wrong key or database file is corrupt."));
-        return nullptr;
+        if (realStart != m_streamStartBytes) {
+            raiseError(tr("Wrong key or database file is corrupt."));
+            return nullptr;
+        }
     }
 
-    HashedBlockStream hashedStream(&cipherStream);
-    if (!hashedStream.open(QIODevice::ReadOnly)) {
-        raiseError(hashedStream.errorString());
+    QIODevice* payloadDevice = &cipherStream;
+    QScopedPointer<PipelineStream> cipherStage;
+    if (!openPipelineStage(cipherStage, payloadDevice)) {
         return nullptr;
     }
 
+    QScopedPointer<HashedBlockStream> hashedStream;
+    QScopedPointer<PipelineStream> hashedStage;
+
+    // the HMAC block stream of KDBX 4 already authenticates the data
+    if (!kdbx4) {
+        hashedStream.reset(new HashedBlockStream(payloadDevice));
+        if (!hashedStream->open(QIODevice::ReadOnly)) {
+            raiseError(hashedStream->errorString());
+            return nullptr;
+        }
+        payloadDevice = hashedStream.data();
+
+        if (!openPipelineStage(hashedStage, payloadDevice)) {
+            return nullptr;
+        }
+    }
+
     QIODevice* xmlDevice;
     QScopedPointer<QtIOCompressor> ioCompressor;
+    QScopedPointer<PipelineStream> compressorStage;
 
     if (m_db->compressionAlgo() == Database::CompressionNone) {
-        xmlDevice = &hashedStream;
+        xmlDevice = payloadDevice;
     }
     else {
-        ioCompressor.reset(new QtIOCompressor(&hashedStream));
+        ioCompressor.reset(new QtIOCompressor(payloadDevice));
         ioCompressor->setStreamFormat(QtIOCompressor::GzipFormat);
         if (!ioCompressor->open(QIODevice::ReadOnly)) {
             raiseError(ioCompressor->errorString());
             return nullptr;
         }
         xmlDevice = ioCompressor.data();
+
+        if (!openPipelineStage(compressorStage, xmlDevice)) {
+            return nullptr;
+        }
+    }
+
+    if (kdbx4) {
+        m_headerEnd = false;
+        while (readInnerHeaderField(xmlDevice) && !hasError()) {
+        }
+
+        if (hasError()) {
+            return nullptr;
+        }
+
+        if (m_protectedStreamKey.isEmpty()) {
+            raiseError("missing database headers");
+            return nullptr;
+        }
     }
 
-    KeePass2RandomStream randomStream;
+    KeePass2RandomStream randomStream(m_irsAlgo);
     if (!randomStream.init(m_protectedStreamKey)) {
         raiseError(randomStream.errorString());
         return nullptr;
@@ -179,7 +280,9 @@ Database* KeePass2Reader::readDatabase(QIODevice* device, const CompositeKey& ke
         xmlDevice = buffer.data();
     }
 
-    KeePass2XmlReader xmlReader;
+    KeePass2XmlReader xmlReader(m_version);
+    xmlReader.setBinaryPool(binaryPool());
+    xmlReader.setProtectedBinaries(m_protectedBinaries);
     xmlReader.readDatabase(xmlDevice, m_db, &randomStream);
 
     if (xmlReader.hasError()) {
@@ -192,9 +295,9 @@ Database* KeePass2Reader::readDatabase(QIODevice* device, const CompositeKey& ke
         }
     }
 
-    Q_ASSERT(version < 0x00030001 || !xmlReader.headerHash().isEmpty());
+    Q_ASSERT(version < 0x00030001 || kdbx4 || !xmlReader.headerHash().isEmpty());
 
-    if (!xmlReader.headerHash().isEmpty()) {
+    if (!kdbx4 && !xmlReader.headerHash().isEmpty()) {
         QByteArray headerHash = CryptoHash::hash(headerStream.storedData(), CryptoHash::Sha256);
         if (headerHash != xmlReader.headerHash()) {
             raiseError("Header doesn't match hash");
@@ -238,6 +341,11 @@ void KeePass2Reader::setSaveXml(bool save)
     m_saveXml = save;
 }
 
+void KeePass2Reader::setPipelined(bool pipelined)
+{
+    m_pipelined = pipelined;
+}
+
 QByteArray KeePass2Reader::xmlData()
 {
     return m_xmlData;
@@ -248,6 +356,30 @@ QByteArray KeePass2Reader::streamKey()
     return m_protectedStreamKey;
 }
 
+KeePass2::ProtectedStreamAlgo KeePass2Reader::protectedStreamAlgo()
+{
+    return m_irsAlgo;
+}
+
+quint32 KeePass2Reader::version()
+{
+    return m_version;
+}
+
+QHash<QString, QByteArray> KeePass2Reader::binaryPool()
+{
+    QHash<QString, QByteArray> pool;
+    for (int i = 0; i < m_binaries.size(); i++) {
+        pool.insert(QString::number(i), m_binaries.at(i));
+    }
+    return pool;
+}
+
+QSet<QString> KeePass2Reader::protectedBinaries()
+{
+    return m_protectedBinaries;
+}
+
 void KeePass2Reader::raiseError(const QString& errorMessage)
 {
     m_error = true;
@@ -264,8 +396,14 @@ bool KeePass2Reader::readHeaderField()
     quint8 fieldID = fieldIDArray.at(0);
 
     bool ok;
-    quint16 fieldLen = Endian::readUInt16(m_headerStream, KeePass2::BYTEORDER, &ok);
-    if (!ok) {
+    qint64 fieldLen;
+    if (m_version >= KeePass2::FILE_VERSION_4) {
+        fieldLen = Endian::readInt32(m_headerStream, KeePass2::BYTEORDER, &ok);
+    }
+    else {
+        fieldLen = Endian::readUInt16(m_headerStream, KeePass2::BYTEORDER, &ok);
+    }
+    if (!ok || fieldLen < 0) {
         raiseError("Invalid header field length");
         return false;
     }
@@ -320,6 +458,14 @@ bool KeePass2Reader::readHeaderField()
         setInnerRandomStreamID(fieldData);
         break;
 
+    case KeePass2::KdfParameters:
+        setKdfParameters(fieldData);
+        break;
+
+    case KeePass2::PublicCustomData:
+        // not used by KeePassXC, but covered by the header hash and HMAC
+        break;
+
     default:
         qWarning("Unknown header field read: id=%d", fieldID);
         break;
@@ -328,6 +474,197 @@ bool KeePass2Reader::readHeaderField()
     return !m_headerEnd;
 }
 
+bool KeePass2Reader::readInnerHeaderField(QIODevice* device)
+{
+    QByteArray fieldIDArray = device->read(1);
+    if (fieldIDArray.size() != 1) {
+        raiseError("Invalid inner header id size");
+        return false;
+    }
+    quint8 fieldID = fieldIDArray.at(0);
+
+    bool ok;
+    qint32 fieldLen = Endian::readInt32(device, KeePass2::BYTEORDER, &ok);
+    if (!ok || fieldLen < 0) {
+        raiseError("Invalid inner header field length");
+        return false;
+    }
+
+    QByteArray fieldData;
+    if (fieldLen != 0) {
+        fieldData = device->read(fieldLen);
+        if (fieldData.size() != fieldLen) {
+            raiseError("Invalid inner header data length");
+            return false;
+        }
+    }
+
+    switch (fieldID) {
+    case KeePass2::InnerHeaderEnd:
+        m_headerEnd = true;
+        break;
+
+    case KeePass2::InnerHeaderRandomStreamID:
+        setInnerRandomStreamID(fieldData);
+        break;
+
+    case KeePass2::InnerHeaderRandomStreamKey:
+        if (fieldData.isEmpty()) {
+            raiseError("Invalid stream key size");
+        }
+        else {
+            m_protectedStreamKey = fieldData;
+        }
+        break;
+
+    case KeePass2::InnerHeaderBinary:
+        // the first byte holds the flags, the attachment follows unencoded
+        if (fieldData.isEmpty()) {
+            raiseError("Invalid inner header binary size");
+        }
+        else {
+            if (static_cast<quint8>(fieldData.at(0)) & KeePass2::InnerBinaryProtected) {
+                m_protectedBinaries.insert(QString::number(m_binaries.size()));
+            }
+            m_binaries.append(fieldData.mid(1));
+        }
+        break;
+
+    default:
+        qWarning("Unknown inner header field read: id=%d", fieldID);
+        break;
+    }
+
+    return !m_headerEnd;
+}
+
+bool KeePass2Reader::readKdbx4Hashes(const QByteArray& headerData)
+{
+    m_headerHash = m_device->read(32);
+    m_headerHmac = m_device->read(32);
+    if (m_headerHash.size() != 32 || m_headerHmac.size() != 32) {
+        raiseError("Invalid header checksum size");
+        return false;
+    }
+
+    if (m_headerHash != CryptoHash::hash(headerData, CryptoHash::Sha256)) {
+        raiseError("Header doesn't match hash");
+        return false;
+    }
+
+    return true;
+}
+
+bool KeePass2Reader::parseVariantMap(const QByteArray& data, QVariantMap& map)
+{
+    QBuffer buffer;
+    buffer.setData(data);
+    buffer.open(QIODevice::ReadOnly);
+
+    bool ok;
+    quint16 version = Endian::readUInt16(&buffer, KeePass2::BYTEORDER, &ok);
+    if (!ok || (version & KeePass2::VARIANTMAP_CRITICAL_MASK)
+            > (KeePass2::VARIANTMAP_VERSION & KeePass2::VARIANTMAP_CRITICAL_MASK)) {
+        return false;
+    }
+
+    while (true) {
+        QByteArray typeArray = buffer.read(1);
+        if (typeArray.size() != 1) {
+            return false;
+        }
+        quint8 type = typeArray.at(0);
+        if (type == KeePass2::VariantMapEnd) {
+            return true;
+        }
+
+        qint32 nameLen = Endian::readInt32(&buffer, KeePass2::BYTEORDER, &ok);
+        if (!ok || nameLen < 0) {
+            return false;
+        }
+        QByteArray name = buffer.read(nameLen);
+        if (name.size() != nameLen) {
+            return false;
+        }
+
+        qint32 valueLen = Endian::readInt32(&buffer, KeePass2::BYTEORDER, &ok);
+        if (!ok || valueLen < 0) {
+            return false;
+        }
+        QByteArray value = buffer.read(valueLen);
+        if (value.size() != valueLen) {
+            return false;
+        }
+
+        QVariant variant;
+        switch (type) {
+        case KeePass2::VariantMapUInt32:
+            if (value.size() != 4) {
+                return false;
+            }
+            variant = QVariant(Endian::bytesToUInt32(value, KeePass2::BYTEORDER));
+            break;
+
+        case KeePass2::VariantMapUInt64:
+            if (value.size() != 8) {
+                return false;
+            }
+            variant = QVariant(Endian::bytesToUInt64(value, KeePass2::BYTEORDER));
+            break;
+
+        case KeePass2::VariantMapBool:
+            if (value.size() != 1) {
+                return false;
+            }
+            variant = QVariant(value.at(0) != 0);
+            break;
+
+        case KeePass2::VariantMapInt32:
+            if (value.size() != 4) {
+                return false;
+            }
+            variant = QVariant(Endian::bytesToInt32(value, KeePass2::BYTEORDER));
+            break;
+
+        case KeePass2::VariantMapInt64:
+            if (value.size() != 8) {
+                return false;
+            }
+            variant = QVariant(Endian::bytesToInt64(value, KeePass2::BYTEORDER));
+            break;
+
+        case KeePass2::VariantMapString:
+            variant = QVariant(QString::fromUtf8(value));
+            break;
+
+        case KeePass2::VariantMapByteArray:
+            variant = QVariant(value);
+            break;
+
+        default:
+            return false;
+        }
+
+        map.insert(QString::fromUtf8(name), variant);
+    }
+}
+
+bool KeePass2Reader::openPipelineStage(QScopedPointer<PipelineStream>& stage, QIODevice*& device)
+{
+    if (!m_pipelined) {
+        return true;
+    }
+
+    stage.reset(new PipelineStream(device));
+    if (!stage->open(QIODevice::ReadOnly)) {
+        raiseError(stage->errorString());
+        return false;
+    }
+
+    device = stage.data();
+    return true;
+}
+
 void KeePass2Reader::setCipher(const QByteArray& data)
 {
     if (data.size() != Uuid::Length) {
@@ -336,7 +673,8 @@ void KeePass2Reader::setCipher(const QByteArray& data)
     else {
         Uuid uuid(data);
 
-        if (uuid != KeePass2::CIPHER_AES && uuid != KeePass2::CIPHER_TWOFISH) {
+        if (uuid != KeePass2::CIPHER_AES && uuid != KeePass2::CIPHER_TWOFISH
+                && uuid != KeePass2::CIPHER_CHACHA20) {
             raiseError("Unsupported cipher");
         }
         else {
@@ -396,7 +734,8 @@ void KeePass2Reader::setTransformRounds(const QByteArray& data)
 
 void KeePass2Reader::setEncryptionIV(const QByteArray& data)
 {
-    if (data.size() != 16) {
+    // the size depends on the cipher and is checked once all headers are read
+    if (data.isEmpty() || data.size() > 16) {
         raiseError("Invalid encryption iv size");
     }
     else {
@@ -432,8 +771,30 @@ void KeePass2Reader::setInnerRandomStreamID(const QByteArray& data)
     else {
         quint32 id = Endian::bytesToUInt32(data, KeePass2::BYTEORDER);
 
-        if (id != KeePass2::Salsa20) {
+        if (id != KeePass2::Salsa20 && id != KeePass2::ChaCha20) {
             raiseError("Unsupported random stream algorithm");
         }
+        else {
+            m_irsAlgo = static_cast<KeePass2::ProtectedStreamAlgo>(id);
+        }
     }
 }
+
+void KeePass2Reader::setKdfParameters(const QByteArray& data)
+{
+    QVariantMap parameters;
+    if (!parseVariantMap(data, parameters)) {
+        raiseError("Invalid KDF parameters");
+        return;
+    }
+
+    QSharedPointer<Kdf> kdf = KeePass2::kdfFromParameters(parameters);
+    if (!kdf) {
+        raiseError(tr("Unsupported key derivation function or invalid parameters."));
+        return;
+    }
+
+    // the database has no key yet, so this does not transform anything
+    m_db->setKdf(kdf);
+    m_transformSeed = kdf->seed();
+}
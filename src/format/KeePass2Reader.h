@@ -19,10 +19,17 @@
 #define KEEPASSX_KEEPASS2READER_H
 
 #include <QCoreApplication>
+#include <QHash>
+#include <QList>
+#include <QScopedPointer>
+#include <QSet>
+#include <QVariantMap>
 
+#include "format/KeePass2.h"
 #include "keys/CompositeKey.h"
 
 class Database;
+class PipelineStream;
 class QIODevice;
 
 class KeePass2Reader
@@ -36,13 +43,22 @@ public:
     bool hasError();
     QString errorString();
     void setSaveXml(bool save);
+    void setPipelined(bool pipelined);
     QByteArray xmlData();
     QByteArray streamKey();
+    KeePass2::ProtectedStreamAlgo protectedStreamAlgo();
+    quint32 version();
+    QHash<QString, QByteArray> binaryPool();
+    QSet<QString> protectedBinaries();
 
 private:
     void raiseError(const QString& errorMessage);
 
     bool readHeaderField();
+    bool readInnerHeaderField(QIODevice* device);
+    bool readKdbx4Hashes(const QByteArray& headerData);
+    bool parseVariantMap(const QByteArray& data, QVariantMap& map);
+    bool openPipelineStage(QScopedPointer<PipelineStream>& stage, QIODevice*& device);
 
     void setCipher(const QByteArray& data);
     void setCompressionFlags(const QByteArray& data);
@@ -53,6 +69,7 @@ private:
     void setProtectedStreamKey(const QByteArray& data);
     void setStreamStartBytes(const QByteArray& data);
     void setInnerRandomStreamID(const QByteArray& data);
+    void setKdfParameters(const QByteArray& data);
 
     QIODevice* m_device;
     QIODevice* m_headerStream;
@@ -60,7 +77,9 @@ private:
     QString m_errorStr;
     bool m_headerEnd;
     bool m_saveXml;
+    bool m_pipelined;
     QByteArray m_xmlData;
+    quint32 m_version;
 
     Database* m_db;
     QByteArray m_masterSeed;
@@ -68,6 +87,11 @@ private:
     QByteArray m_encryptionIV;
     QByteArray m_streamStartBytes;
     QByteArray m_protectedStreamKey;
+    KeePass2::ProtectedStreamAlgo m_irsAlgo;
+    QByteArray m_headerHash;
+    QByteArray m_headerHmac;
+    QList<QByteArray> m_binaries;
+    QSet<QString> m_protectedBinaries;
 };
 
 #endif // KEEPASSX_KEEPASS2READER_H
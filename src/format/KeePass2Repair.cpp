@@ -71,9 +71,10 @@ KeePass2Repair::RepairOutcome KeePass2Repair::repairDatabase(QIODevice* device,
         return qMakePair(RepairFailed, nullptr);
     }
 
-    KeePass2RandomStream randomStream;
+    KeePass2RandomStream randomStream(reader.protectedStreamAlgo());
     randomStream.init(reader.streamKey());
-    KeePass2XmlReader xmlReader;
+    KeePass2XmlReader xmlReader(reader.version());
+    xmlReader.setBinaryPool(reader.binaryPool());
     QBuffer buffer(&xmlData);
     buffer.open(QIODevice::ReadOnly);
     xmlReader.readDatabase(&buffer, db.data(), &randomStream);
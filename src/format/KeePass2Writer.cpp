@@ -28,6 +28,8 @@
 #include "format/KeePass2RandomStream.h"
 #include "format/KeePass2XmlWriter.h"
 #include "streams/HashedBlockStream.h"
+#include "streams/HmacBlockStream.h"
+#include "streams/PipelineStream.h"
 #include "streams/QtIOCompressor"
 #include "streams/SymmetricCipherStream.h"
 
@@ -36,7 +38,9 @@
 
 KeePass2Writer::KeePass2Writer()
     : m_device(0)
+    , m_version(KeePass2::FILE_VERSION_3)
     , m_error(false)
+    , m_pipelined(true)
 {
 }
 
@@ -45,9 +49,24 @@ void KeePass2Writer::writeDatabase(QIODevice* device, Database* db)
     m_error = false;
     m_errorStr.clear();
 
-    QByteArray transformSeed = randomGen()->randomArray(32);
+    // Only KDBX 4 can store the parameters of other KDFs and KeePass only reads
+    // ChaCha20 from KDBX 4. Other databases stay KDBX 3.1 so that older clients
+    // can still open them.
+    if (db->kdf()->uuid() == KeePass2::KDF_AES && db->cipher() != KeePass2::CIPHER_CHACHA20) {
+        m_version = KeePass2::FILE_VERSION_3;
+        writeKdbx3Database(device, db);
+    }
+    else {
+        m_version = KeePass2::FILE_VERSION_4;
+        writeKdbx4Database(device, db);
+    }
+}
+
+void KeePass2Writer::writeKdbx3Database(QIODevice* device, Database* db)
+{
     QByteArray masterSeed = randomGen()->randomArray(32);
-    QByteArray encryptionIV = randomGen()->randomArray(16);
+    const SymmetricCipher::Algorithm cipherAlgo = SymmetricCipher::cipherToAlgorithm(db->cipher());
+    QByteArray encryptionIV = randomGen()->randomArray(SymmetricCipher::algorithmIvSize(cipherAlgo));
     QByteArray protectedStreamKey = randomGen()->randomArray(32);
     QByteArray startBytes = randomGen()->randomArray(32);
     QByteArray endOfHeader = "\r\n\r\n";
@@ -57,7 +76,7 @@ void KeePass2Writer::writeDatabase(QIODevice* device, Database* db)
         return;
     }
 
-    if (!db->transformKeyWithSeed(transformSeed)) {
+    if (!db->transformKeyWithNewSeed()) {
         raiseError(tr("Unable to calculate master key"));
         return;
     }
@@ -75,7 +94,7 @@ void KeePass2Writer::writeDatabase(QIODevice* device, Database* db)
 
     CHECK_RETURN(writeData(Endian::int32ToBytes(KeePass2::SIGNATURE_1, KeePass2::BYTEORDER)));
     CHECK_RETURN(writeData(Endian::int32ToBytes(KeePass2::SIGNATURE_2, KeePass2::BYTEORDER)));
-    CHECK_RETURN(writeData(Endian::int32ToBytes(KeePass2::FILE_VERSION, KeePass2::BYTEORDER)));
+    CHECK_RETURN(writeData(Endian::int32ToBytes(KeePass2::FILE_VERSION_3, KeePass2::BYTEORDER)));
 
     CHECK_RETURN(writeHeaderField(KeePass2::CipherID, db->cipher().toByteArray()));
     CHECK_RETURN(writeHeaderField(KeePass2::CompressionFlags,
@@ -99,8 +118,8 @@ void KeePass2Writer::writeDatabase(QIODevice* device, Database* db)
     QByteArray headerHash = CryptoHash::hash(header.data(), CryptoHash::Sha256);
     CHECK_RETURN(writeData(header.data()));
 
-    SymmetricCipherStream cipherStream(device, SymmetricCipher::cipherToAlgorithm(db->cipher()),
-                                       SymmetricCipher::Cbc, SymmetricCipher::Encrypt);
+    SymmetricCipherStream cipherStream(device, cipherAlgo, SymmetricCipher::algorithmMode(cipherAlgo),
+                                       SymmetricCipher::Encrypt);
     cipherStream.init(finalKey, encryptionIV);
     if (!cipherStream.open(QIODevice::WriteOnly)) {
         raiseError(cipherStream.errorString());
@@ -109,25 +128,37 @@ void KeePass2Writer::writeDatabase(QIODevice* device, Database* db)
     m_device = &cipherStream;
     CHECK_RETURN(writeData(startBytes));
 
-    HashedBlockStream hashedStream(&cipherStream);
+    // Every layer of the stream stack below the XML writer gets a thread of its own when
+    // pipelining is enabled. The stages have to be destroyed before the device they wrap.
+    QIODevice* hashedBaseDevice = &cipherStream;
+    QScopedPointer<PipelineStream> cipherStage;
+    CHECK_RETURN(openPipelineStage(cipherStage, hashedBaseDevice));
+
+    HashedBlockStream hashedStream(hashedBaseDevice);
     if (!hashedStream.open(QIODevice::WriteOnly)) {
         raiseError(hashedStream.errorString());
         return;
     }
 
+    QIODevice* compressorBaseDevice = &hashedStream;
+    QScopedPointer<PipelineStream> hashedStage;
+    CHECK_RETURN(openPipelineStage(hashedStage, compressorBaseDevice));
+
     QScopedPointer<QtIOCompressor> ioCompressor;
+    QScopedPointer<PipelineStream> compressorStage;
 
     if (db->compressionAlgo() == Database::CompressionNone) {
-        m_device = &hashedStream;
+        m_device = compressorBaseDevice;
     }
     else {
-        ioCompressor.reset(new QtIOCompressor(&hashedStream));
+        ioCompressor.reset(new QtIOCompressor(compressorBaseDevice));
         ioCompressor->setStreamFormat(QtIOCompressor::GzipFormat);
         if (!ioCompressor->open(QIODevice::WriteOnly)) {
             raiseError(ioCompressor->errorString());
             return;
         }
         m_device = ioCompressor.data();
+        CHECK_RETURN(openPipelineStage(compressorStage, m_device));
     }
 
     KeePass2RandomStream randomStream;
@@ -136,18 +167,21 @@ void KeePass2Writer::writeDatabase(QIODevice* device, Database* db)
         return;
     }
 
-    KeePass2XmlWriter xmlWriter;
+    KeePass2XmlWriter xmlWriter(KeePass2::FILE_VERSION_3);
     xmlWriter.writeDatabase(m_device, db, &randomStream, headerHash);
 
     // Explicitly close/reset streams so they are flushed and we can detect
     // errors. QIODevice::close() resets errorString() etc.
+    CHECK_RETURN(flushPipelineStage(compressorStage.data()));
     if (ioCompressor) {
         ioCompressor->close();
     }
+    CHECK_RETURN(flushPipelineStage(hashedStage.data()));
     if (!hashedStream.reset()) {
         raiseError(hashedStream.errorString());
         return;
     }
+    CHECK_RETURN(flushPipelineStage(cipherStage.data()));
     if (!cipherStream.reset()) {
         raiseError(cipherStream.errorString());
         return;
@@ -158,6 +192,149 @@ void KeePass2Writer::writeDatabase(QIODevice* device, Database* db)
     }
 }
 
+void KeePass2Writer::writeKdbx4Database(QIODevice* device, Database* db)
+{
+    QByteArray masterSeed = randomGen()->randomArray(32);
+    const SymmetricCipher::Algorithm cipherAlgo = SymmetricCipher::cipherToAlgorithm(db->cipher());
+    QByteArray encryptionIV = randomGen()->randomArray(SymmetricCipher::algorithmIvSize(cipherAlgo));
+    QByteArray protectedStreamKey = randomGen()->randomArray(64);
+    QByteArray endOfHeader = "\r\n\r\n";
+
+    if (db->challengeMasterSeed(masterSeed) == false) {
+        raiseError(tr("Unable to issue challenge-response."));
+        return;
+    }
+
+    if (!db->transformKeyWithNewSeed()) {
+        raiseError(tr("Unable to calculate master key"));
+        return;
+    }
+
+    CryptoHash hash(CryptoHash::Sha256);
+    hash.addData(masterSeed);
+    hash.addData(db->challengeResponseKey());
+    Q_ASSERT(!db->transformedMasterKey().isEmpty());
+    hash.addData(db->transformedMasterKey());
+    QByteArray finalKey = hash.result();
+
+    QByteArray hmacKey = KeePass2::hmacKey(masterSeed, db->challengeResponseKey(),
+                                           db->transformedMasterKey());
+
+    QBuffer header;
+    header.open(QIODevice::WriteOnly);
+    m_device = &header;
+
+    CHECK_RETURN(writeData(Endian::int32ToBytes(KeePass2::SIGNATURE_1, KeePass2::BYTEORDER)));
+    CHECK_RETURN(writeData(Endian::int32ToBytes(KeePass2::SIGNATURE_2, KeePass2::BYTEORDER)));
+    CHECK_RETURN(writeData(Endian::int32ToBytes(KeePass2::FILE_VERSION_4, KeePass2::BYTEORDER)));
+
+    CHECK_RETURN(writeHeaderField(KeePass2::CipherID, db->cipher().toByteArray()));
+    CHECK_RETURN(writeHeaderField(KeePass2::CompressionFlags,
+                                  Endian::int32ToBytes(db->compressionAlgo(),
+                                                       KeePass2::BYTEORDER)));
+    CHECK_RETURN(writeHeaderField(KeePass2::MasterSeed, masterSeed));
+    CHECK_RETURN(writeHeaderField(KeePass2::EncryptionIV, encryptionIV));
+    CHECK_RETURN(writeHeaderField(KeePass2::KdfParameters,
+                                  serializeVariantMap(KeePass2::kdfToParameters(*db->kdf()))));
+    CHECK_RETURN(writeHeaderField(KeePass2::EndOfHeader, endOfHeader));
+
+    header.close();
+    m_device = device;
+    CHECK_RETURN(writeData(header.data()));
+
+    // the header is followed by its hash and its HMAC
+    CHECK_RETURN(writeData(CryptoHash::hash(header.data(), CryptoHash::Sha256)));
+    CHECK_RETURN(writeData(CryptoHash::hmac(header.data(),
+                                            HmacBlockStream::getHmacKey(Q_UINT64_C(0xFFFFFFFFFFFFFFFF), hmacKey),
+                                            CryptoHash::Sha256)));
+
+    HmacBlockStream hmacStream(device, hmacKey);
+    if (!hmacStream.open(QIODevice::WriteOnly)) {
+        raiseError(hmacStream.errorString());
+        return;
+    }
+
+    // Every layer of the stream stack below the XML writer gets a thread of its own when
+    // pipelining is enabled. The stages have to be destroyed before the device they wrap.
+    QIODevice* cipherBaseDevice = &hmacStream;
+    QScopedPointer<PipelineStream> hmacStage;
+    CHECK_RETURN(openPipelineStage(hmacStage, cipherBaseDevice));
+
+    SymmetricCipherStream cipherStream(cipherBaseDevice, cipherAlgo, SymmetricCipher::algorithmMode(cipherAlgo),
+                                       SymmetricCipher::Encrypt);
+    cipherStream.init(finalKey, encryptionIV);
+    if (!cipherStream.open(QIODevice::WriteOnly)) {
+        raiseError(cipherStream.errorString());
+        return;
+    }
+
+    QIODevice* compressorBaseDevice = &cipherStream;
+    QScopedPointer<PipelineStream> cipherStage;
+    CHECK_RETURN(openPipelineStage(cipherStage, compressorBaseDevice));
+
+    QScopedPointer<QtIOCompressor> ioCompressor;
+    QScopedPointer<PipelineStream> compressorStage;
+
+    if (db->compressionAlgo() == Database::CompressionNone) {
+        m_device = compressorBaseDevice;
+    }
+    else {
+        ioCompressor.reset(new QtIOCompressor(compressorBaseDevice));
+        ioCompressor->setStreamFormat(QtIOCompressor::GzipFormat);
+        if (!ioCompressor->open(QIODevice::WriteOnly)) {
+            raiseError(ioCompressor->errorString());
+            return;
+        }
+        m_device = ioCompressor.data();
+        CHECK_RETURN(openPipelineStage(compressorStage, m_device));
+    }
+
+    // attachments are stored raw in the inner header instead of base64 in the XML
+    CHECK_RETURN(writeInnerHeaderField(KeePass2::InnerHeaderRandomStreamID,
+                                       Endian::int32ToBytes(KeePass2::ChaCha20, KeePass2::BYTEORDER)));
+    CHECK_RETURN(writeInnerHeaderField(KeePass2::InnerHeaderRandomStreamKey, protectedStreamKey));
+    const QList<QByteArray> binaries = KeePass2XmlWriter::binaries(db);
+    const QSet<QByteArray> protectedBinaries = KeePass2XmlWriter::protectedBinaries(db);
+    for (const QByteArray& binary : binaries) {
+        QByteArray data;
+        data.reserve(binary.size() + 1);
+        data.append(static_cast<char>(protectedBinaries.contains(binary) ? KeePass2::InnerBinaryProtected : 0));
+        data.append(binary);
+        CHECK_RETURN(writeInnerHeaderField(KeePass2::InnerHeaderBinary, data));
+    }
+    CHECK_RETURN(writeInnerHeaderField(KeePass2::InnerHeaderEnd, QByteArray()));
+
+    KeePass2RandomStream randomStream(KeePass2::ChaCha20);
+    if (!randomStream.init(protectedStreamKey)) {
+        raiseError(randomStream.errorString());
+        return;
+    }
+
+    KeePass2XmlWriter xmlWriter(KeePass2::FILE_VERSION_4);
+    xmlWriter.writeDatabase(m_device, db, &randomStream);
+
+    // Explicitly close/reset streams so they are flushed and we can detect
+    // errors. QIODevice::close() resets errorString() etc.
+    CHECK_RETURN(flushPipelineStage(compressorStage.data()));
+    if (ioCompressor) {
+        ioCompressor->close();
+    }
+    CHECK_RETURN(flushPipelineStage(cipherStage.data()));
+    if (!cipherStream.reset()) {
+        raiseError(cipherStream.errorString());
+        return;
+    }
+    CHECK_RETURN(flushPipelineStage(hmacStage.data()));
+    if (!hmacStream.reset()) {
+        raiseError(hmacStream.errorString());
+        return;
+    }
+
+    if (xmlWriter.hasError()) {
+        raiseError(xmlWriter.errorString());
+    }
+}
+
 bool KeePass2Writer::writeData(const QByteArray& data)
 {
     if (m_device->write(data) != data.size()) {
@@ -171,18 +348,120 @@ bool KeePass2Writer::writeData(const QByteArray& data)
 
 bool KeePass2Writer::writeHeaderField(KeePass2::HeaderFieldID fieldId, const QByteArray& data)
 {
-    Q_ASSERT(data.size() <= 65535);
+    QByteArray fieldIdArr;
+    fieldIdArr[0] = fieldId;
+    CHECK_RETURN_FALSE(writeData(fieldIdArr));
+    if (m_version >= KeePass2::FILE_VERSION_4) {
+        CHECK_RETURN_FALSE(writeData(Endian::int32ToBytes(data.size(), KeePass2::BYTEORDER)));
+    }
+    else {
+        Q_ASSERT(data.size() <= 65535);
+        CHECK_RETURN_FALSE(writeData(Endian::int16ToBytes(static_cast<quint16>(data.size()),
+                                                          KeePass2::BYTEORDER)));
+    }
+    CHECK_RETURN_FALSE(writeData(data));
 
+    return true;
+}
+
+bool KeePass2Writer::writeInnerHeaderField(KeePass2::InnerHeaderFieldID fieldId, const QByteArray& data)
+{
     QByteArray fieldIdArr;
     fieldIdArr[0] = fieldId;
     CHECK_RETURN_FALSE(writeData(fieldIdArr));
-    CHECK_RETURN_FALSE(writeData(Endian::int16ToBytes(static_cast<quint16>(data.size()),
-                                                      KeePass2::BYTEORDER)));
+    CHECK_RETURN_FALSE(writeData(Endian::int32ToBytes(data.size(), KeePass2::BYTEORDER)));
     CHECK_RETURN_FALSE(writeData(data));
 
     return true;
 }
 
+QByteArray KeePass2Writer::serializeVariantMap(const QVariantMap& map)
+{
+    QByteArray data = Endian::int16ToBytes(KeePass2::VARIANTMAP_VERSION, KeePass2::BYTEORDER);
+
+    for (QVariantMap::const_iterator i = map.constBegin(); i != map.constEnd(); ++i) {
+        KeePass2::VariantMapFieldType type;
+        QByteArray value;
+
+        switch (i.value().type()) {
+        case QVariant::UInt:
+            type = KeePass2::VariantMapUInt32;
+            value = Endian::int32ToBytes(static_cast<qint32>(i.value().toUInt()), KeePass2::BYTEORDER);
+            break;
+
+        case QVariant::ULongLong:
+            type = KeePass2::VariantMapUInt64;
+            value = Endian::int64ToBytes(static_cast<qint64>(i.value().toULongLong()), KeePass2::BYTEORDER);
+            break;
+
+        case QVariant::Bool:
+            type = KeePass2::VariantMapBool;
+            value = QByteArray(1, i.value().toBool() ? '\x01' : '\0');
+            break;
+
+        case QVariant::Int:
+            type = KeePass2::VariantMapInt32;
+            value = Endian::int32ToBytes(i.value().toInt(), KeePass2::BYTEORDER);
+            break;
+
+        case QVariant::LongLong:
+            type = KeePass2::VariantMapInt64;
+            value = Endian::int64ToBytes(i.value().toLongLong(), KeePass2::BYTEORDER);
+            break;
+
+        case QVariant::String:
+            type = KeePass2::VariantMapString;
+            value = i.value().toString().toUtf8();
+            break;
+
+        case QVariant::ByteArray:
+            type = KeePass2::VariantMapByteArray;
+            value = i.value().toByteArray();
+            break;
+
+        default:
+            Q_ASSERT(false);
+            continue;
+        }
+
+        QByteArray name = i.key().toUtf8();
+        data.append(static_cast<char>(type));
+        data.append(Endian::int32ToBytes(name.size(), KeePass2::BYTEORDER));
+        data.append(name);
+        data.append(Endian::int32ToBytes(value.size(), KeePass2::BYTEORDER));
+        data.append(value);
+    }
+
+    data.append(static_cast<char>(KeePass2::VariantMapEnd));
+    return data;
+}
+
+bool KeePass2Writer::openPipelineStage(QScopedPointer<PipelineStream>& stage, QIODevice*& device)
+{
+    if (!m_pipelined) {
+        return true;
+    }
+
+    stage.reset(new PipelineStream(device));
+    if (!stage->open(QIODevice::WriteOnly)) {
+        raiseError(stage->errorString());
+        return false;
+    }
+
+    device = stage.data();
+    return true;
+}
+
+bool KeePass2Writer::flushPipelineStage(PipelineStream* stage)
+{
+    if (stage && !stage->reset()) {
+        raiseError(stage->errorString());
+        return false;
+    }
+
+    return true;
+}
+
 void KeePass2Writer::writeDatabase(const QString& filename, Database* db)
 {
     QFile file(filename);
@@ -203,6 +482,11 @@ QString KeePass2Writer::errorString()
     return m_errorStr;
 }
 
+void KeePass2Writer::setPipelined(bool pipelined)
+{
+    m_pipelined = pipelined;
+}
+
 void KeePass2Writer::raiseError(const QString& errorMessage)
 {
     m_error = true;
@@ -19,11 +19,14 @@
 #define KEEPASSX_KEEPASS2WRITER_H
 
 #include <QCoreApplication>
+#include <QScopedPointer>
+#include <QVariantMap>
 
 #include "format/KeePass2.h"
 #include "keys/CompositeKey.h"
 
 class Database;
+class PipelineStream;
 class QIODevice;
 
 class KeePass2Writer
@@ -36,15 +39,24 @@ public:
     void writeDatabase(const QString& filename, Database* db);
     bool hasError();
     QString errorString();
+    void setPipelined(bool pipelined);
 
 private:
+    void writeKdbx3Database(QIODevice* device, Database* db);
+    void writeKdbx4Database(QIODevice* device, Database* db);
     bool writeData(const QByteArray& data);
     bool writeHeaderField(KeePass2::HeaderFieldID fieldId, const QByteArray& data);
+    bool writeInnerHeaderField(KeePass2::InnerHeaderFieldID fieldId, const QByteArray& data);
+    static QByteArray serializeVariantMap(const QVariantMap& map);
+    bool openPipelineStage(QScopedPointer<PipelineStream>& stage, QIODevice*& device);
+    bool flushPipelineStage(PipelineStream* stage);
     void raiseError(const QString& errorMessage);
 
     QIODevice* m_device;
+    quint32 m_version;
     bool m_error;
     QString m_errorStr;
+    bool m_pipelined;
 };
 
 #endif // KEEPASSX_KEEPASS2WRITER_H
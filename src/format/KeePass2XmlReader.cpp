@@ -22,6 +22,7 @@
 
 #include "core/Database.h"
 #include "core/DatabaseIcons.h"
+#include "core/Endian.h"
 #include "core/Group.h"
 #include "core/Metadata.h"
 #include "core/Tools.h"
@@ -30,8 +31,9 @@
 
 typedef QPair<QString, QString> StringPair;
 
-KeePass2XmlReader::KeePass2XmlReader()
-    : m_randomStream(nullptr)
+KeePass2XmlReader::KeePass2XmlReader(quint32 version)
+    : m_version(version)
+    , m_randomStream(nullptr)
     , m_db(nullptr)
     , m_meta(nullptr)
     , m_tmpParent(nullptr)
@@ -45,6 +47,16 @@ void KeePass2XmlReader::setStrictMode(bool strictMode)
     m_strictMode = strictMode;
 }
 
+void KeePass2XmlReader::setBinaryPool(const QHash<QString, QByteArray>& binaryPool)
+{
+    m_binaryPool = binaryPool;
+}
+
+void KeePass2XmlReader::setProtectedBinaries(const QSet<QString>& protectedBinaries)
+{
+    m_protectedBinaries = protectedBinaries;
+}
+
 void KeePass2XmlReader::readDatabase(QIODevice* device, Database* db, KeePass2RandomStream* randomStream)
 {
     m_error = false;
@@ -58,6 +70,7 @@ void KeePass2XmlReader::readDatabase(QIODevice* device, Database* db, KeePass2Ra
     m_meta->setUpdateDatetime(false);
 
     m_randomStream = randomStream;
+    m_lazyRandomStream.reset();
     m_headerHash.clear();
 
     m_tmpParent = new Group();
@@ -105,6 +118,9 @@ void KeePass2XmlReader::readDatabase(QIODevice* device, Database* db, KeePass2Ra
     for (i = m_binaryMap.constBegin(); i != m_binaryMap.constEnd(); ++i) {
         const QPair<Entry*, QString>& target = i.value();
         target.first->attachments()->set(target.second, m_binaryPool[i.key()]);
+        if (m_protectedBinaries.contains(i.key())) {
+            target.first->attachments()->setProtected(target.second, true);
+        }
     }
 
     m_meta->setUpdateDatetime(true);
@@ -799,6 +815,8 @@ void KeePass2XmlReader::parseEntryString(Entry* entry)
 
     QString key;
     QString value;
+    QByteArray ciphertext;
+    qint64 streamPosition = 0;
     bool protect = false;
     bool keySet = false;
     bool valueSet = false;
@@ -811,21 +829,24 @@ void KeePass2XmlReader::parseEntryString(Entry* entry)
         else if (m_xml.name() == "Value") {
             QXmlStreamAttributes attr = m_xml.attributes();
             value = readString();
+            ciphertext.clear();
 
             bool isProtected = attr.value("Protected") == "True";
             bool protectInMemory = attr.value("ProtectInMemory") == "True";
 
             if (isProtected && !value.isEmpty()) {
                 if (m_randomStream) {
-                    QByteArray ciphertext = QByteArray::fromBase64(value.toLatin1());
-                    bool ok;
-                    QByteArray plaintext = m_randomStream->process(ciphertext, &ok);
-                    if (!ok) {
-                        value.clear();
-                        raiseError(m_randomStream->errorString());
-                    }
-                    else {
-                        value = QString::fromUtf8(plaintext);
+                    // only remember where the value is in the key stream, it's decrypted when it's used
+                    ciphertext = QByteArray::fromBase64(value.toLatin1());
+                    streamPosition = m_randomStream->position();
+                    m_randomStream->seek(streamPosition + ciphertext.size());
+                    value.clear();
+
+                    if (!m_lazyRandomStream) {
+                        m_lazyRandomStream = m_randomStream->clone();
+                        if (!m_lazyRandomStream) {
+                            raiseError(m_randomStream->errorString());
+                        }
                     }
                 }
                 else {
@@ -846,6 +867,9 @@ void KeePass2XmlReader::parseEntryString(Entry* entry)
         if (entry->attributes()->hasKey(key) && !entry->attributes()->value(key).isEmpty()) {
             raiseError("Duplicate custom attribute found");
         }
+        else if (!ciphertext.isEmpty() && m_lazyRandomStream) {
+            entry->attributes()->setEncrypted(key, ciphertext, m_lazyRandomStream, streamPosition);
+        }
         else {
             entry->attributes()->set(key, value, protect);
         }
@@ -1046,7 +1070,20 @@ bool KeePass2XmlReader::readBool()
 QDateTime KeePass2XmlReader::readDateTime()
 {
     QString str = readString();
-    QDateTime dt = QDateTime::fromString(str, Qt::ISODate);
+    QDateTime dt;
+
+    if (m_version >= KeePass2::FILE_VERSION_4) {
+        // KDBX 4 stores the seconds since 0001-01-01 00:00 UTC
+        QByteArray secsBytes = QByteArray::fromBase64(str.toLatin1());
+        if (secsBytes.size() == 8) {
+            qint64 secs = Endian::bytesToInt64(secsBytes, KeePass2::BYTEORDER);
+            dt = QDateTime::fromMSecsSinceEpoch((secs - KeePass2::EPOCH_OFFSET_SECS) * 1000, Qt::UTC);
+        }
+    }
+
+    if (!dt.isValid()) {
+        dt = QDateTime::fromString(str, Qt::ISODate);
+    }
 
     if (!dt.isValid()) {
         if (m_strictMode) {
@@ -23,10 +23,13 @@
 #include <QDateTime>
 #include <QHash>
 #include <QPair>
+#include <QSet>
+#include <QSharedPointer>
 #include <QXmlStreamReader>
 
 #include "core/TimeInfo.h"
 #include "core/Uuid.h"
+#include "format/KeePass2.h"
 
 class Database;
 class Entry;
@@ -39,7 +42,7 @@ class KeePass2XmlReader
     Q_DECLARE_TR_FUNCTIONS(KeePass2XmlReader)
 
 public:
-    KeePass2XmlReader();
+    explicit KeePass2XmlReader(quint32 version = KeePass2::FILE_VERSION_3);
     Database* readDatabase(QIODevice* device);
     void readDatabase(QIODevice* device, Database* db, KeePass2RandomStream* randomStream = nullptr);
     Database* readDatabase(const QString& filename);
@@ -47,6 +50,8 @@ public:
     QString errorString();
     QByteArray headerHash();
     void setStrictMode(bool strictMode);
+    void setBinaryPool(const QHash<QString, QByteArray>& binaryPool);
+    void setProtectedBinaries(const QSet<QString>& protectedBinaries);
 
 private:
     bool parseKeePassFile();
@@ -83,8 +88,10 @@ private:
     void raiseError(const QString& errorMessage);
     void skipCurrentElement();
 
+    const quint32 m_version;
     QXmlStreamReader m_xml;
     KeePass2RandomStream* m_randomStream;
+    QSharedPointer<KeePass2RandomStream> m_lazyRandomStream;
     Database* m_db;
     Metadata* m_meta;
     Group* m_tmpParent;
@@ -92,6 +99,7 @@ private:
     QHash<Uuid, Entry*> m_entries;
     QHash<QString, QByteArray> m_binaryPool;
     QHash<QString, QPair<Entry*, QString> > m_binaryMap;
+    QSet<QString> m_protectedBinaries;
     QByteArray m_headerHash;
     bool m_error;
     QString m_errorStr;
@@ -19,13 +19,16 @@
 
 #include <QBuffer>
 #include <QFile>
+#include <QSet>
 
+#include "core/Endian.h"
 #include "core/Metadata.h"
 #include "format/KeePass2RandomStream.h"
 #include "streams/QtIOCompressor"
 
-KeePass2XmlWriter::KeePass2XmlWriter()
-    : m_db(nullptr)
+KeePass2XmlWriter::KeePass2XmlWriter(quint32 version)
+    : m_version(version)
+    , m_db(nullptr)
     , m_meta(nullptr)
     , m_randomStream(nullptr)
     , m_error(false)
@@ -80,20 +83,51 @@ QString KeePass2XmlWriter::errorString()
     return m_errorStr;
 }
 
-void KeePass2XmlWriter::generateIdMap()
+QList<QByteArray> KeePass2XmlWriter::binaries(const Database* db)
 {
-    const QList<Entry*> allEntries = m_db->rootGroup()->entriesRecursive(true);
-    int nextId = 0;
+    const QList<Entry*> allEntries = db->rootGroup()->entriesRecursive(true);
+    QList<QByteArray> result;
+    QSet<QByteArray> seen;
 
     for (Entry* entry : allEntries) {
         const QList<QString> attachmentKeys = entry->attachments()->keys();
         for (const QString& key : attachmentKeys) {
             QByteArray data = entry->attachments()->value(key);
-            if (!m_idMap.contains(data)) {
-                m_idMap.insert(data, nextId++);
+            if (!seen.contains(data)) {
+                seen.insert(data);
+                result.append(data);
+            }
+        }
+    }
+
+    return result;
+}
+
+QSet<QByteArray> KeePass2XmlWriter::protectedBinaries(const Database* db)
+{
+    const QList<Entry*> allEntries = db->rootGroup()->entriesRecursive(true);
+    QSet<QByteArray> result;
+
+    for (Entry* entry : allEntries) {
+        const QList<QString> attachmentKeys = entry->attachments()->keys();
+        for (const QString& key : attachmentKeys) {
+            if (entry->attachments()->isProtected(key)) {
+                result.insert(entry->attachments()->value(key));
             }
         }
     }
+
+    return result;
+}
+
+void KeePass2XmlWriter::generateIdMap()
+{
+    const QList<QByteArray> allBinaries = binaries(m_db);
+
+    m_idMap.clear();
+    for (int i = 0; i < allBinaries.size(); i++) {
+        m_idMap.insert(allBinaries.at(i), i);
+    }
 }
 
 void KeePass2XmlWriter::writeMetadata()
@@ -126,7 +160,10 @@ void KeePass2XmlWriter::writeMetadata()
     writeUuid("LastTopVisibleGroup", m_meta->lastTopVisibleGroup());
     writeNumber("HistoryMaxItems", m_meta->historyMaxItems());
     writeNumber("HistoryMaxSize", m_meta->historyMaxSize());
-    writeBinaries();
+    if (m_version < KeePass2::FILE_VERSION_4) {
+        // KDBX 4 stores the attachments in the inner header
+        writeBinaries();
+    }
     writeCustomData();
 
     m_xml.writeEndElement();
@@ -475,6 +512,12 @@ void KeePass2XmlWriter::writeDateTime(const QString& qualifiedName, const QDateT
     Q_ASSERT(dateTime.isValid());
     Q_ASSERT(dateTime.timeSpec() == Qt::UTC);
 
+    if (m_version >= KeePass2::FILE_VERSION_4) {
+        qint64 secs = dateTime.toMSecsSinceEpoch() / 1000 + KeePass2::EPOCH_OFFSET_SECS;
+        writeBinary(qualifiedName, Endian::int64ToBytes(secs, KeePass2::BYTEORDER));
+        return;
+    }
+
     QString dateTimeStr = dateTime.toString(Qt::ISODate);
 
     // Qt < 4.8 doesn't append a 'Z' at the end
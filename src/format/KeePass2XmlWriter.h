@@ -21,6 +21,7 @@
 #include <QColor>
 #include <QDateTime>
 #include <QImage>
+#include <QSet>
 #include <QXmlStreamWriter>
 
 #include "core/Database.h"
@@ -28,6 +29,7 @@
 #include "core/Group.h"
 #include "core/TimeInfo.h"
 #include "core/Uuid.h"
+#include "format/KeePass2.h"
 
 class KeePass2RandomStream;
 class Metadata;
@@ -35,13 +37,25 @@ class Metadata;
 class KeePass2XmlWriter
 {
 public:
-    KeePass2XmlWriter();
+    explicit KeePass2XmlWriter(quint32 version = KeePass2::FILE_VERSION_3);
     void writeDatabase(QIODevice* device, Database* db, KeePass2RandomStream* randomStream = nullptr,
                        const QByteArray& headerHash = QByteArray());
     void writeDatabase(const QString& filename, Database* db);
     bool hasError();
     QString errorString();
 
+    /**
+     * Returns the deduplicated attachment data of db in the order of
+     * the ids that the Binary elements of entries refer to.
+     */
+    static QList<QByteArray> binaries(const Database* db);
+
+    /**
+     * Returns the attachment data of db that is stored in at least one
+     * attachment flagged as protected.
+     */
+    static QSet<QByteArray> protectedBinaries(const Database* db);
+
 private:
     void generateIdMap();
 
@@ -77,6 +91,7 @@ private:
 
     void raiseError(const QString& errorMessage);
 
+    const quint32 m_version;
     QXmlStreamWriter m_xml;
     Database* m_db;
     Metadata* m_meta;
@@ -187,6 +187,8 @@ void DatabaseOpenWidget::openDatabase()
     QApplication::restoreOverrideCursor();
 
     if (m_db) {
+        // have the key for the first save ready in the background
+        m_db->precomputeNextKey();
         if (m_ui->messageWidget->isVisible()) {
             m_ui->messageWidget->animatedHide();
         }
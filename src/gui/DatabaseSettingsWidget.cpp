@@ -21,7 +21,8 @@
 #include "core/Database.h"
 #include "core/Group.h"
 #include "core/Metadata.h"
-#include "crypto/SymmetricCipher.h"
+#include "crypto/kdf/AesKdf.h"
+#include "crypto/kdf/Argon2Kdf.h"
 #include "format/KeePass2.h"
 #include "keys/CompositeKey.h"
 
@@ -39,6 +40,8 @@ DatabaseSettingsWidget::DatabaseSettingsWidget(QWidget* parent)
     connect(m_ui->historyMaxSizeCheckBox, SIGNAL(toggled(bool)),
             m_ui->historyMaxSizeSpinBox, SLOT(setEnabled(bool)));
     connect(m_ui->transformBenchmarkButton, SIGNAL(clicked()), SLOT(transformRoundsBenchmark()));
+    connect(m_ui->kdfComboBox, SIGNAL(currentIndexChanged(int)), SLOT(kdfChanged(int)));
+    connect(m_ui->kdfComboBox, SIGNAL(activated(int)), SLOT(kdfActivated(int)));
 }
 
 DatabaseSettingsWidget::~DatabaseSettingsWidget()
@@ -55,8 +58,32 @@ void DatabaseSettingsWidget::load(Database* db)
     m_ui->dbDescriptionEdit->setText(meta->description());
     m_ui->recycleBinEnabledCheckBox->setChecked(meta->recycleBinEnabled());
     m_ui->defaultUsernameEdit->setText(meta->defaultUserName());
-    m_ui->AlgorithmComboBox->setCurrentIndex(SymmetricCipher::cipherToAlgorithm(m_db->cipher()));
-    m_ui->transformRoundsSpinBox->setValue(m_db->transformRounds());
+    if (m_db->cipher() == KeePass2::CIPHER_CHACHA20) {
+        m_ui->AlgorithmComboBox->setCurrentIndex(CipherChaCha20);
+    }
+    else if (m_db->cipher() == KeePass2::CIPHER_TWOFISH) {
+        m_ui->AlgorithmComboBox->setCurrentIndex(CipherTwofish);
+    }
+    else {
+        m_ui->AlgorithmComboBox->setCurrentIndex(CipherAes);
+    }
+
+    QSharedPointer<Kdf> kdf = m_db->kdf();
+    m_ui->memorySpinBox->setValue(static_cast<int>(Argon2Kdf::DefaultMemory / 1024));
+    m_ui->parallelismSpinBox->setValue(static_cast<int>(Argon2Kdf().parallelism()));
+    if (kdf->uuid() == KeePass2::KDF_AES) {
+        m_ui->kdfComboBox->setCurrentIndex(KdfAes);
+    }
+    else {
+        const Argon2Kdf* argon2 = static_cast<const Argon2Kdf*>(kdf.data());
+        m_ui->kdfComboBox->setCurrentIndex(argon2->type() == Argon2Kdf::Type::Argon2id ? KdfArgon2id
+                                                                                       : KdfArgon2d);
+        m_ui->memorySpinBox->setValue(static_cast<int>(argon2->memory() / 1024));
+        m_ui->parallelismSpinBox->setValue(static_cast<int>(argon2->parallelism()));
+    }
+    m_ui->transformRoundsSpinBox->setValue(static_cast<int>(kdf->rounds()));
+    kdfChanged(m_ui->kdfComboBox->currentIndex());
+
     if (meta->historyMaxItems() > -1) {
         m_ui->historyMaxItemsSpinBox->setValue(meta->historyMaxItems());
         m_ui->historyMaxItemsCheckBox->setChecked(true);
@@ -85,12 +112,37 @@ void DatabaseSettingsWidget::save()
     meta->setName(m_ui->dbNameEdit->text());
     meta->setDescription(m_ui->dbDescriptionEdit->text());
     meta->setDefaultUserName(m_ui->defaultUsernameEdit->text());
-    m_db->setCipher(SymmetricCipher::algorithmToCipher(static_cast<SymmetricCipher::Algorithm>
-                                                       (m_ui->AlgorithmComboBox->currentIndex())));
+    switch (m_ui->AlgorithmComboBox->currentIndex()) {
+    case CipherTwofish:
+        m_db->setCipher(KeePass2::CIPHER_TWOFISH);
+        break;
+    case CipherChaCha20:
+        m_db->setCipher(KeePass2::CIPHER_CHACHA20);
+        break;
+    default:
+        m_db->setCipher(KeePass2::CIPHER_AES);
+        break;
+    }
     meta->setRecycleBinEnabled(m_ui->recycleBinEnabledCheckBox->isChecked());
-    if (static_cast<quint64>(m_ui->transformRoundsSpinBox->value()) != m_db->transformRounds()) {
+
+    QSharedPointer<Kdf> kdf = kdfFromUi();
+    QSharedPointer<Kdf> oldKdf = m_db->kdf();
+    bool kdfModified = kdf->uuid() != oldKdf->uuid();
+    if (!kdfModified && kdf->uuid() != KeePass2::KDF_AES) {
+        const Argon2Kdf* argon2 = static_cast<const Argon2Kdf*>(kdf.data());
+        const Argon2Kdf* oldArgon2 = static_cast<const Argon2Kdf*>(oldKdf.data());
+        kdfModified = argon2->memory() != oldArgon2->memory()
+                || argon2->parallelism() != oldArgon2->parallelism();
+    }
+
+    if (kdfModified) {
         QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
-        m_db->setTransformRounds(m_ui->transformRoundsSpinBox->value());
+        m_db->setKdf(kdf);
+        QApplication::restoreOverrideCursor();
+    }
+    else if (kdf->rounds() != m_db->transformRounds()) {
+        QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
+        m_db->setTransformRounds(kdf->rounds());
         QApplication::restoreOverrideCursor();
     }
 
@@ -135,13 +187,59 @@ void DatabaseSettingsWidget::reject()
 void DatabaseSettingsWidget::transformRoundsBenchmark()
 {
     QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
-    int rounds = CompositeKey::transformKeyBenchmark(1000);
-    if (rounds != -1) {
-        m_ui->transformRoundsSpinBox->setValue(rounds);
-    }
+    quint64 rounds = kdfFromUi()->benchmark(1000);
+    m_ui->transformRoundsSpinBox->setValue(static_cast<int>(qMin<quint64>(
+            rounds, static_cast<quint64>(m_ui->transformRoundsSpinBox->maximum()))));
     QApplication::restoreOverrideCursor();
 }
 
+void DatabaseSettingsWidget::kdfChanged(int index)
+{
+    bool argon2 = index != KdfAes;
+
+    m_ui->memoryUsageLabel->setEnabled(argon2);
+    m_ui->memorySpinBox->setEnabled(argon2);
+    m_ui->parallelismLabel->setEnabled(argon2);
+    m_ui->parallelismSpinBox->setEnabled(argon2);
+}
+
+/**
+ * The rounds of AES-KDF and Argon2 have very different costs, so a KDF chosen
+ * by the user starts with its default rounds instead of the previous value.
+ */
+void DatabaseSettingsWidget::kdfActivated(int index)
+{
+    if (index == KdfAes) {
+        m_ui->transformRoundsSpinBox->setValue(static_cast<int>(AesKdf::DefaultRounds));
+    }
+    else {
+        m_ui->transformRoundsSpinBox->setValue(static_cast<int>(Argon2Kdf::DefaultIterations));
+    }
+}
+
+QSharedPointer<Kdf> DatabaseSettingsWidget::kdfFromUi() const
+{
+    QSharedPointer<Kdf> kdf;
+
+    switch (m_ui->kdfComboBox->currentIndex()) {
+    case KdfArgon2d:
+    case KdfArgon2id: {
+        Argon2Kdf* argon2 = new Argon2Kdf(m_ui->kdfComboBox->currentIndex() == KdfArgon2id
+                                          ? Argon2Kdf::Type::Argon2id : Argon2Kdf::Type::Argon2d);
+        argon2->setMemory(static_cast<quint64>(m_ui->memorySpinBox->value()) * 1024);
+        argon2->setParallelism(static_cast<quint32>(m_ui->parallelismSpinBox->value()));
+        kdf = QSharedPointer<Kdf>(argon2);
+        break;
+    }
+    default:
+        kdf = QSharedPointer<Kdf>(new AesKdf());
+        break;
+    }
+
+    kdf->setRounds(static_cast<quint64>(m_ui->transformRoundsSpinBox->value()));
+    return kdf;
+}
+
 void DatabaseSettingsWidget::truncateHistories()
 {
     const QList<Entry*> allEntries = m_db->rootGroup()->entriesRecursive(false);
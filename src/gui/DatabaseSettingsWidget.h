@@ -19,10 +19,12 @@
 #define KEEPASSX_DATABASESETTINGSWIDGET_H
 
 #include <QScopedPointer>
+#include <QSharedPointer>
 
 #include "gui/DialogyWidget.h"
 
 class Database;
+class Kdf;
 
 namespace Ui {
     class DatabaseSettingsWidget;
@@ -45,8 +47,25 @@ private slots:
     void save();
     void reject();
     void transformRoundsBenchmark();
+    void kdfChanged(int index);
+    void kdfActivated(int index);
 
 private:
+    enum CipherIndex
+    {
+        CipherAes = 0,
+        CipherTwofish = 1,
+        CipherChaCha20 = 2
+    };
+
+    enum KdfIndex
+    {
+        KdfAes = 0,
+        KdfArgon2d = 1,
+        KdfArgon2id = 2
+    };
+
+    QSharedPointer<Kdf> kdfFromUi() const;
     void truncateHistories();
 
     const QScopedPointer<Ui::DatabaseSettingsWidget> m_ui;
@@ -366,6 +366,7 @@ bool DatabaseTabWidget::saveDatabase(Database* db)
 
         if (errorMessage.isEmpty()) {
             // successfully saved database file
+            db->precomputeNextKey();
             dbStruct.modified = false;
             dbStruct.dbWidget->databaseSaved();
             updateTabName(db);
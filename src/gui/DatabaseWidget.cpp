@@ -33,8 +33,8 @@
 #include <QApplication>
 
 #include "autotype/AutoType.h"
+#include "core/AsyncEntrySearcher.h"
 #include "core/Config.h"
-#include "core/EntrySearcher.h"
 #include "core/FilePath.h"
 #include "core/Group.h"
 #include "core/Metadata.h"
@@ -50,6 +50,7 @@
 #include "gui/DetailsWidget.h"
 #include "gui/KeePass1OpenWidget.h"
 #include "gui/MessageBox.h"
+#include "gui/PasswordHealthDialog.h"
 #include "gui/UnlockDatabaseWidget.h"
 #include "gui/UnlockDatabaseDialog.h"
 #include "gui/entry/EditEntryWidget.h"
@@ -101,6 +102,10 @@ DatabaseWidget::DatabaseWidget(Database* db, QWidget* parent)
     connect(m_entryView, SIGNAL(customContextMenuRequested(QPoint)),
             SLOT(emitEntryContextMenuRequested(QPoint)));
 
+    m_searcher = new AsyncEntrySearcher(this);
+    connect(m_searcher, SIGNAL(entriesFound(QList<Entry*>)), SLOT(addSearchResults(QList<Entry*>)));
+    connect(m_searcher, SIGNAL(finished()), SLOT(finishSearch()));
+
     // Add a notification for when we are searching
     m_searchingLabel = new QLabel();
     m_searchingLabel->setText(tr("Searching..."));
@@ -213,6 +218,7 @@ DatabaseWidget::DatabaseWidget(Database* db, QWidget* parent)
     m_fileWatchUnblockTimer.setSingleShot(true);
     m_ignoreAutoReload = false;
 
+    m_searchResultCount = 0;
     m_searchCaseSensitive = false;
     m_searchLimitGroup = config()->get("SearchLimitGroup", false).toBool();
 
@@ -394,6 +400,13 @@ void DatabaseWidget::showTotp()
     totpDialog->open();
 }
 
+void DatabaseWidget::showPasswordHealth()
+{
+    PasswordHealthDialog* healthDialog = new PasswordHealthDialog(this, m_db);
+    connect(healthDialog, SIGNAL(entryActivated(Entry*)), SLOT(switchToEntryEdit(Entry*)));
+    healthDialog->open();
+}
+
 void DatabaseWidget::copyTotp()
 {
     Entry* currentEntry = m_entryView->currentEntry();
@@ -1033,14 +1046,34 @@ void DatabaseWidget::search(const QString& searchtext)
 
     Group* searchGroup = m_searchLimitGroup ? currentGroup() : m_db->rootGroup();
 
-    QList<Entry*> searchResult = EntrySearcher().search(searchtext, searchGroup, caseSensitive);
-
-    m_entryView->setEntryList(searchResult);
+    // the previous results stay visible until the first new ones arrive
+    m_searchResultCount = -1;
     m_lastSearchText = searchtext;
+    m_searcher->search(searchtext, searchGroup, caseSensitive);
+}
+
+void DatabaseWidget::addSearchResults(const QList<Entry*>& entries)
+{
+    if (m_searchResultCount < 0) {
+        m_entryView->setEntryList(entries);
+        m_searchResultCount = entries.size();
+    }
+    else {
+        m_entryView->addEntryList(entries);
+        m_searchResultCount += entries.size();
+    }
+}
+
+void DatabaseWidget::finishSearch()
+{
+    if (m_searchResultCount < 0) {
+        m_entryView->setEntryList(QList<Entry*>());
+        m_searchResultCount = 0;
+    }
 
     // Display a label detailing our search results
-    if (searchResult.size() > 0) {
-        m_searchingLabel->setText(tr("Search Results (%1)").arg(searchResult.size()));
+    if (m_searchResultCount > 0) {
+        m_searchingLabel->setText(tr("Search Results (%1)").arg(m_searchResultCount));
     }
     else {
         m_searchingLabel->setText(tr("No Results"));
@@ -1079,6 +1112,8 @@ QString DatabaseWidget::getCurrentSearch()
 
 void DatabaseWidget::endSearch()
 {
+    m_searcher->cancel();
+
     if (isInSearchMode())
     {
         emit listModeAboutToActivate();
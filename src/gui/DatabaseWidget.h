@@ -30,6 +30,7 @@
 #include "gui/MessageWidget.h"
 #include "gui/csvImport/CsvImportWizard.h"
 
+class AsyncEntrySearcher;
 class ChangeMasterKeyWidget;
 class DatabaseOpenWidget;
 class DatabaseSettingsWidget;
@@ -155,6 +156,7 @@ public slots:
     void switchToGroupEdit();
     void switchToMasterKeyChange(bool disableCancel = false);
     void switchToDatabaseSettings();
+    void showPasswordHealth();
     void switchToOpenDatabase(const QString& fileName);
     void switchToOpenDatabase(const QString& fileName, const QString& password, const QString& keyFile);
     void switchToImportCsv(const QString& fileName);
@@ -198,6 +200,9 @@ private slots:
     void reloadDatabaseFile();
     void restoreGroupEntryFocus(Uuid groupUuid, Uuid EntryUuid);
     void unblockAutoReload();
+    // Search result slots
+    void addSearchResults(const QList<Entry*>& entries);
+    void finishSearch();
 
 private:
     void setClipboardTextAndMinimize(const QString& text);
@@ -232,7 +237,9 @@ private:
     DetailsWidget* m_detailsView;
 
     // Search state
+    AsyncEntrySearcher* m_searcher;
     QString m_lastSearchText;
+    int m_searchResultCount;
     bool m_searchCaseSensitive;
     bool m_searchLimitGroup;
 
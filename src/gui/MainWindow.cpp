@@ -289,6 +289,9 @@ MainWindow::MainWindow()
     m_actionMultiplexer.connect(m_ui->actionEntryDelete, SIGNAL(triggered()),
             SLOT(deleteEntries()));
 
+    m_actionMultiplexer.connect(m_ui->actionPasswordHealth, SIGNAL(triggered()),
+            SLOT(showPasswordHealth()));
+
     m_actionMultiplexer.connect(m_ui->actionEntryTotp, SIGNAL(triggered()),
             SLOT(showTotp()));
     m_actionMultiplexer.connect(m_ui->actionEntrySetupTotp, SIGNAL(triggered()),
@@ -465,6 +468,7 @@ void MainWindow::setMenuActionState(DatabaseWidget::Mode mode)
             m_ui->actionGroupEmptyRecycleBin->setEnabled(recycleBinSelected);
             m_ui->actionChangeMasterKey->setEnabled(true);
             m_ui->actionChangeDatabaseSettings->setEnabled(true);
+            m_ui->actionPasswordHealth->setEnabled(true);
             m_ui->actionDatabaseSave->setEnabled(m_ui->tabWidget->canSave());
             m_ui->actionDatabaseSaveAs->setEnabled(true);
             m_ui->actionExportCsv->setEnabled(true);
@@ -496,6 +500,7 @@ void MainWindow::setMenuActionState(DatabaseWidget::Mode mode)
 
             m_ui->actionChangeMasterKey->setEnabled(false);
             m_ui->actionChangeDatabaseSettings->setEnabled(false);
+            m_ui->actionPasswordHealth->setEnabled(false);
             m_ui->actionDatabaseSave->setEnabled(false);
             m_ui->actionDatabaseSaveAs->setEnabled(false);
             m_ui->actionExportCsv->setEnabled(false);
@@ -529,6 +534,7 @@ void MainWindow::setMenuActionState(DatabaseWidget::Mode mode)
 
         m_ui->actionChangeMasterKey->setEnabled(false);
         m_ui->actionChangeDatabaseSettings->setEnabled(false);
+        m_ui->actionPasswordHealth->setEnabled(false);
         m_ui->actionDatabaseSave->setEnabled(false);
         m_ui->actionDatabaseSaveAs->setEnabled(false);
         m_ui->actionDatabaseClose->setEnabled(false);
@@ -0,0 +1,106 @@
+/*
+ *  Copyright (C) 2017 KeePassXC Team <team@keepassxc.org>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 or (at your option)
+ *  version 3 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PasswordHealthDialog.h"
+#include "ui_PasswordHealthDialog.h"
+
+#include <QApplication>
+#include <QHeaderView>
+
+#include "core/Database.h"
+#include "core/Entry.h"
+#include "core/Group.h"
+#include "core/PasswordHealth.h"
+#include "gui/DatabaseWidget.h"
+
+namespace {
+    enum Column
+    {
+        TitleColumn,
+        UsernameColumn,
+        GroupColumn,
+        ProblemsColumn,
+        EntropyColumn
+    };
+}
+
+PasswordHealthDialog::PasswordHealthDialog(DatabaseWidget* parent, Database* db)
+    : QDialog(parent)
+    , m_ui(new Ui::PasswordHealthDialog())
+    , m_db(db)
+{
+    m_ui->setupUi(this);
+
+    setAttribute(Qt::WA_DeleteOnClose);
+
+    m_ui->reportTree->header()->setSectionResizeMode(QHeaderView::ResizeToContents);
+    connect(m_ui->reportTree, SIGNAL(itemActivated(QTreeWidgetItem*, int)), SLOT(activateItem(QTreeWidgetItem*)));
+    connect(m_ui->buttonBox, SIGNAL(rejected()), SLOT(close()));
+
+    analyze();
+}
+
+PasswordHealthDialog::~PasswordHealthDialog()
+{
+}
+
+void PasswordHealthDialog::analyze()
+{
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    const QList<PasswordHealth::Report> reports = m_db->passwordHealth()->analyze(m_db->rootGroup());
+    QApplication::restoreOverrideCursor();
+
+    m_ui->reportTree->clear();
+    m_entries.clear();
+
+    for (const PasswordHealth::Report& report : reports) {
+        if (!report.problems) {
+            continue;
+        }
+
+        QTreeWidgetItem* item = new QTreeWidgetItem(m_ui->reportTree);
+        item->setText(TitleColumn, report.entry->title());
+        item->setIcon(TitleColumn, report.entry->iconScaledPixmap());
+        item->setText(UsernameColumn, report.entry->username());
+        item->setText(GroupColumn, report.entry->group()->name());
+        item->setText(ProblemsColumn, PasswordHealth::problemsToString(report.problems));
+        if (report.entropy >= 0) {
+            item->setData(EntropyColumn, Qt::DisplayRole, qRound(report.entropy));
+        }
+        item->setData(TitleColumn, Qt::UserRole, m_entries.size());
+        m_entries.append(report.entry);
+    }
+
+    m_ui->reportTree->sortByColumn(EntropyColumn, Qt::AscendingOrder);
+
+    if (m_entries.isEmpty()) {
+        m_ui->summaryLabel->setText(tr("No problems found in %n entries.", "", reports.size()));
+    }
+    else {
+        m_ui->summaryLabel->setText(tr("%1 of %n entries have problems.", "", reports.size())
+                                    .arg(m_entries.size()));
+    }
+}
+
+void PasswordHealthDialog::activateItem(QTreeWidgetItem* item)
+{
+    Entry* entry = m_entries.value(item->data(TitleColumn, Qt::UserRole).toInt());
+    if (entry) {
+        emit entryActivated(entry);
+        close();
+    }
+}
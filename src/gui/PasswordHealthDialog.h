@@ -0,0 +1,60 @@
+/*
+ *  Copyright (C) 2017 KeePassXC Team <team@keepassxc.org>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 or (at your option)
+ *  version 3 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef KEEPASSX_PASSWORDHEALTHDIALOG_H
+#define KEEPASSX_PASSWORDHEALTHDIALOG_H
+
+#include <QDialog>
+#include <QList>
+#include <QScopedPointer>
+
+class Database;
+class DatabaseWidget;
+class Entry;
+class QTreeWidgetItem;
+
+namespace Ui {
+    class PasswordHealthDialog;
+}
+
+/**
+ * Shows the entries of a database that have password problems, see
+ * PasswordHealth.
+ */
+class PasswordHealthDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit PasswordHealthDialog(DatabaseWidget* parent, Database* db);
+    ~PasswordHealthDialog();
+
+signals:
+    void entryActivated(Entry* entry);
+
+private slots:
+    void activateItem(QTreeWidgetItem* item);
+
+private:
+    void analyze();
+
+    const QScopedPointer<Ui::PasswordHealthDialog> m_ui;
+    Database* const m_db;
+    QList<Entry*> m_entries;
+};
+
+#endif // KEEPASSX_PASSWORDHEALTHDIALOG_H
@@ -104,6 +104,26 @@ void EntryModel::setEntryList(const QList<Entry*>& entries)
     emit switchedToEntryListMode();
 }
 
+/**
+ * Appends entries in entry list mode. The entries have to belong to the
+ * databases of the current list.
+ */
+void EntryModel::addEntryList(const QList<Entry*>& entries)
+{
+    if (m_group || m_entries.isEmpty()) {
+        setEntryList(entries);
+        return;
+    }
+    if (entries.isEmpty()) {
+        return;
+    }
+
+    beginInsertRows(QModelIndex(), m_entries.size(), m_entries.size() + entries.size() - 1);
+    m_entries.append(entries);
+    m_orgEntries.append(entries);
+    endInsertRows();
+}
+
 int EntryModel::rowCount(const QModelIndex& parent) const
 {
     if (parent.isValid()) {
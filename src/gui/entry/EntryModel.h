@@ -51,6 +51,7 @@ public:
     QMimeData* mimeData(const QModelIndexList& indexes) const override;
 
     void setEntryList(const QList<Entry*>& entries);
+    void addEntryList(const QList<Entry*>& entries);
 
 signals:
     void switchedToEntryListMode();
@@ -78,6 +78,14 @@ void EntryView::setEntryList(const QList<Entry*>& entries)
     setFirstEntryActive();
 }
 
+void EntryView::addEntryList(const QList<Entry*>& entries)
+{
+    m_model->addEntryList(entries);
+    if (!currentIndex().isValid()) {
+        setFirstEntryActive();
+    }
+}
+
 void EntryView::setFirstEntryActive()
 {
     if (m_model->rowCount() > 0) {
@@ -37,8 +37,19 @@ AccessControlDialog::~AccessControlDialog()
 
 void AccessControlDialog::setUrl(const QString &url)
 {
+    setUrls(QStringList() << url);
+}
+
+void AccessControlDialog::setUrls(const QStringList &urls)
+{
+    QStringList hosts;
+    for (const QString& url: urls) {
+        const QString host = QUrl(url).host();
+        if (!hosts.contains(host))
+            hosts << host;
+    }
     ui->label->setText(QString(tr("%1 has requested access to passwords for the following item(s).\n"
-                                  "Please select whether you want to allow access.")).arg(QUrl(url).host()));
+                                  "Please select whether you want to allow access.")).arg(hosts.join(", ")));
 }
 
 void AccessControlDialog::setItems(const QList<Entry*> &items)
@@ -20,6 +20,7 @@
 #define ACCESSCONTROLDIALOG_H
 
 #include <QDialog>
+#include <QStringList>
 #include <QScopedPointer>
 
 class Entry;
@@ -37,6 +38,7 @@ public:
     ~AccessControlDialog();
 
     void setUrl(const QString & url);
+    void setUrls(const QStringList & urls);
     void setItems(const QList<Entry *> & items);
     bool remember() const;
     void setRemember(bool r);
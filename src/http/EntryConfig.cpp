@@ -23,6 +23,15 @@
 #include "http/Protocol.h"
 
 static const char KEEPASSHTTP_NAME[] = "KeePassHttp Settings";  //TODO: duplicated string (also in Service.cpp)
+static const int CACHE_SIZE = 10000;
+
+namespace {
+    struct CachedConfig
+    {
+        QString json;
+        QSharedPointer<const EntryConfig> config;
+    };
+}
 
 EntryConfig::EntryConfig(QObject *parent) :
     QObject(parent)
@@ -49,7 +58,7 @@ void EntryConfig::setDeniedHosts(const QStringList &deniedHosts)
     m_deniedHosts = deniedHosts.toSet();
 }
 
-bool EntryConfig::isAllowed(const QString &host)
+bool EntryConfig::isAllowed(const QString &host) const
 {
     return m_allowedHosts.contains(host);
 }
@@ -60,7 +69,7 @@ void EntryConfig::allow(const QString &host)
     m_deniedHosts.remove(host);
 }
 
-bool EntryConfig::isDenied(const QString &host)
+bool EntryConfig::isDenied(const QString &host) const
 {
     return m_deniedHosts.contains(host);
 }
@@ -83,7 +92,11 @@ void EntryConfig::setRealm(const QString &realm)
 
 bool EntryConfig::load(const Entry *entry)
 {
-    QString s = entry->attributes()->value(KEEPASSHTTP_NAME);
+    return parse(entry->attributes()->value(KEEPASSHTTP_NAME));
+}
+
+bool EntryConfig::parse(const QString &s)
+{
     if (s.isEmpty())
         return false;
 
@@ -105,3 +118,28 @@ void EntryConfig::save(Entry *entry)
     QByteArray json = QJsonDocument(o).toJson(QJsonDocument::Compact);
     entry->attributes()->set(KEEPASSHTTP_NAME, json);
 }
+
+QSharedPointer<const EntryConfig> EntryConfig::cached(const Entry *entry)
+{
+    const QString json = entry->attributes()->value(KEEPASSHTTP_NAME);
+    if (json.isEmpty())
+        return QSharedPointer<const EntryConfig>();
+
+    //Keyed by uuid, a new entry at the address of a deleted one can't hit its item
+    static QMutex cacheMutex;
+    static QCache<Uuid, CachedConfig> cache(CACHE_SIZE);
+    QMutexLocker locker(&cacheMutex);
+
+    //An unchanged attribute shares its data with the cached copy, so the comparison is cheap.
+    //History items and clones have the same uuid but possibly other settings.
+    const CachedConfig* item = cache.object(entry->uuid());
+    if (item && item->json == json)
+        return item->config;
+
+    QSharedPointer<EntryConfig> config(new EntryConfig());
+    if (!config->parse(json))
+        config.reset();
+
+    cache.insert(entry->uuid(), new CachedConfig{json, config});
+    return config;
+}
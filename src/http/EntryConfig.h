@@ -23,6 +23,7 @@
 #include <QtCore/QString>
 #include <QtCore/QStringList>
 #include <QtCore/QSet>
+#include <QtCore/QSharedPointer>
 
 class Entry;
 
@@ -38,14 +39,21 @@ public:
 
     bool load(const Entry * entry);
     void save(Entry * entry);
-    bool isAllowed(const QString & host);
+    bool isAllowed(const QString & host) const;
     void allow(const QString & host);
-    bool isDenied(const QString & host);
+    bool isDenied(const QString & host) const;
     void deny(const QString & host);
     QString realm() const;
     void setRealm(const QString &realm);
 
+    /**
+     * Returns the parsed settings of the entry or a null pointer if it has none.
+     * The settings are only parsed again once the settings attribute changed.
+     */
+    static QSharedPointer<const EntryConfig> cached(const Entry * entry);
+
 private:
+    bool parse(const QString & json);
     QStringList allowedHosts() const;
     void setAllowedHosts(const QStringList &allowedHosts);
     QStringList deniedHosts() const;
@@ -19,6 +19,15 @@
 #include "HttpSettings.h"
 #include "core/Config.h"
 
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QStandardPaths>
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
 PasswordGenerator HttpSettings::m_generator;
 
 bool HttpSettings::isEnabled()
@@ -143,6 +152,45 @@ void HttpSettings::setHttpPort(int port)
     config()->set("Http/Port", port);
 }
 
+bool HttpSettings::listenOnHttpPort()
+{
+    return config()->get("Http/ListenOnHttpPort", true).toBool();
+}
+
+void HttpSettings::setListenOnHttpPort(bool listen)
+{
+    config()->set("Http/ListenOnHttpPort", listen);
+}
+
+bool HttpSettings::localSocketEnabled()
+{
+    return config()->get("Http/LocalSocket", false).toBool();
+}
+
+void HttpSettings::setLocalSocketEnabled(bool enabled)
+{
+    config()->set("Http/LocalSocket", enabled);
+}
+
+QString HttpSettings::localSocketName()
+{
+#ifdef Q_OS_WIN
+    return QString("keepassxc-http-%1").arg(QString::fromLocal8Bit(qgetenv("USERNAME")));
+#else
+    // the runtime directory is only accessible by the user
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation);
+    if (dir.isEmpty()) {
+        // fall back to a private directory of the user, the temporary directory is shared
+        const uint uid = ::getuid();
+        dir = QString("%1/keepassxc-%2").arg(QDir::tempPath()).arg(uid);
+        if (!QDir().mkpath(dir) || QFileInfo(dir).ownerId() != uid
+            || !QFile::setPermissions(dir, QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner))
+            return QString();
+    }
+    return dir + "/keepassxc-http.socket";
+#endif
+}
+
 bool HttpSettings::passwordUseNumbers()
 {
     return config()->get("Http/generator/Numbers", true).toBool();
@@ -49,6 +49,15 @@ public:
     static void setSupportKphFields(bool supportKphFields);
     static int  httpPort();
     static void setHttpPort(int port);
+    static bool listenOnHttpPort();
+    static void setListenOnHttpPort(bool listen);
+    static bool localSocketEnabled();
+    static void setLocalSocketEnabled(bool enabled);
+    /**
+     * The name of the local socket, empty if there is no directory to put it
+     * in that only the user can access.
+     */
+    static QString localSocketName();
 
     static bool passwordUseNumbers();
     static void setPasswordUseNumbers(bool useNumbers);
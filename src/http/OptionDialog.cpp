@@ -59,11 +59,13 @@ void OptionDialog::loadSettings()
     else
         m_ui->sortByTitle->setChecked(true);
     m_ui->httpPort->setText(QString::number(settings.httpPort()));
+    m_ui->listenOnHttpPort->setChecked(settings.listenOnHttpPort());
 
     m_ui->alwaysAllowAccess->setChecked(settings.alwaysAllowAccess());
     m_ui->alwaysAllowUpdate->setChecked(settings.alwaysAllowUpdate());
     m_ui->searchInAllDatabases->setChecked(settings.searchInAllDatabases());
     m_ui->supportKphFields->setChecked(settings.supportKphFields());
+    m_ui->localSocket->setChecked(settings.localSocketEnabled());
 
     m_ui->passwordGenerator->loadSettings();
 }
@@ -86,10 +88,12 @@ void OptionDialog::saveSettings()
         port = 19455;
     }
     settings.setHttpPort(port);
+    settings.setListenOnHttpPort(m_ui->listenOnHttpPort->isChecked());
     settings.setAlwaysAllowAccess(m_ui->alwaysAllowAccess->isChecked());
     settings.setAlwaysAllowUpdate(m_ui->alwaysAllowUpdate->isChecked());
     settings.setSearchInAllDatabases(m_ui->searchInAllDatabases->isChecked());
     settings.setSupportKphFields(m_ui->supportKphFields->isChecked());
+    settings.setLocalSocketEnabled(m_ui->localSocket->isChecked());
 
     m_ui->passwordGenerator->saveSettings();
 }
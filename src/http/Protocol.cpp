@@ -33,6 +33,7 @@ static const char * const STR_SET_LOGIN = "set-login";
 static const char * const STR_ASSOCIATE = "associate";
 static const char * const STR_TEST_ASSOCIATE = "test-associate";
 static const char * const STR_GENERATE_PASSWORD = "generate-password";
+static const char * const STR_GET_LOGINS_BATCH = "get-logins-batch";
 static const char * const STR_VERSION = "1.8.4.2";
 
 }/*namespace KeepassHttpProtocol*/
@@ -67,6 +68,7 @@ static QHash<QString, RequestType> createStringHash()
     hash.insert(STR_ASSOCIATE,        ASSOCIATE);
     hash.insert(STR_TEST_ASSOCIATE,   TEST_ASSOCIATE);
     hash.insert(STR_GENERATE_PASSWORD,GENERATE_PASSWORD);
+    hash.insert(STR_GET_LOGINS_BATCH, GET_LOGINS_BATCH);
     return hash;
 }
 
@@ -131,10 +133,8 @@ static QString encrypt(const QString & data, SymmetricCipherGcrypt & cipher)
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 Request::Request():
-    m_requestType(INVALID),
-    m_cipher(SymmetricCipher::Aes256, SymmetricCipher::Cbc, SymmetricCipher::Decrypt)
+    m_sortSelection(false)
 {
-  m_cipher.init();
 }
 
 QString Request::nonce() const
@@ -142,105 +142,61 @@ QString Request::nonce() const
     return m_nonce;
 }
 
-void Request::setNonce(const QString &nonce)
-{
-    m_nonce = nonce;
-}
-
 QString Request::verifier() const
 {
     return m_verifier;
 }
 
-void Request::setVerifier(const QString &verifier)
-{
-    m_verifier = verifier;
-}
-
 QString Request::id() const
 {
     return m_id;
 }
 
-void Request::setId(const QString &id)
-{
-    m_id = id;
-}
-
 QString Request::key() const
 {
     return m_key;
 }
 
-void Request::setKey(const QString &key)
-{
-    m_key = key;
-}
-
 QString Request::submitUrl() const
 {
-    //Q_ASSERT(m_cipher.isValid());
-    return decrypt(m_submitUrl, m_cipher);
-}
-
-void Request::setSubmitUrl(const QString &submitUrl)
-{
-    m_submitUrl = submitUrl;
+    Q_ASSERT(isVerified());
+    return m_submitUrl;
 }
 
 QString Request::url() const
 {
-    //Q_ASSERT(m_cipher.isValid());
-    return decrypt(m_url, m_cipher);
-}
-
-void Request::setUrl(const QString &url)
-{
-    m_url = url;
+    Q_ASSERT(isVerified());
+    return m_url;
 }
 
 QString Request::realm() const
 {
-    //Q_ASSERT(m_cipher.isValid());
-    return decrypt(m_realm, m_cipher);
-}
-
-void Request::setRealm(const QString &realm)
-{
-    m_realm = realm;
+    Q_ASSERT(isVerified());
+    return m_realm;
 }
 
 QString Request::login() const
 {
-    //Q_ASSERT(m_cipher.isValid());
-    return decrypt(m_login, m_cipher);
-}
-
-void Request::setLogin(const QString &login)
-{
-    m_login = login;
+    Q_ASSERT(isVerified());
+    return m_login;
 }
 
 QString Request::uuid() const
 {
-    //Q_ASSERT(m_cipher.isValid());
-    return decrypt(m_uuid, m_cipher);
-}
-
-void Request::setUuid(const QString &uuid)
-{
-    m_uuid = uuid;
+    Q_ASSERT(isVerified());
+    return m_uuid;
 }
 
 QString Request::password() const
 {
-    //Q_ASSERT(m_cipher.isValid());
-    return decrypt(m_password, m_cipher);
+    Q_ASSERT(isVerified());
+    return m_password;
 }
 
-void Request::setPassword(const QString &password)
+QList<QPair<QString, QString>> Request::urls() const
 {
-    m_password = password;
+    Q_ASSERT(isVerified());
+    return m_urls;
 }
 
 bool Request::sortSelection() const
@@ -248,11 +204,6 @@ bool Request::sortSelection() const
     return m_sortSelection;
 }
 
-void Request::setSortSelection(bool sortSelection)
-{
-    m_sortSelection = sortSelection;
-}
-
 KeepassHttpProtocol::RequestType Request::requestType() const
 {
     return parseRequest(m_requestType);
@@ -263,19 +214,46 @@ QString Request::requestTypeStr() const
     return m_requestType;
 }
 
-void Request::setRequestType(const QString &requestType)
+bool Request::verify(const QString &key)
 {
-    m_requestType = requestType;
+    if (isVerified())
+        return true;
+    if (key.isEmpty() || m_nonce.isEmpty())
+        return false;
+
+    SymmetricCipherGcrypt cipher(SymmetricCipher::Aes256, SymmetricCipher::Cbc, SymmetricCipher::Decrypt);
+    if (!cipher.init() || !cipher.setKey(decode64(key)) || !cipher.setIv(decode64(m_nonce)))
+        return false;
+    if (decrypt(m_verifier, cipher) != m_nonce)
+        return false;
+
+    m_login = decrypt(m_login, cipher);
+    m_password = decrypt(m_password, cipher);
+    m_uuid = decrypt(m_uuid, cipher);
+    m_url = decrypt(m_url, cipher);
+    m_submitUrl = decrypt(m_submitUrl, cipher);
+    m_realm = decrypt(m_realm, cipher);
+
+    m_urls.clear();
+    m_urls.reserve(m_urlList.size());
+    for (const QVariant& item: asConst(m_urlList)) {
+        const QVariantMap map = item.toMap();
+        m_urls << qMakePair(decrypt(map.value("Url").toString(), cipher),
+                            decrypt(map.value("SubmitUrl").toString(), cipher));
+    }
+
+    m_verifiedKey = key;
+    return true;
 }
 
-bool Request::CheckVerifier(const QString &key) const
+bool Request::isVerified() const
 {
-    //Q_ASSERT(!m_cipher.isValid());
-
-    m_cipher.setKey(decode64(key));
-    m_cipher.setIv(decode64(m_nonce));
+    return !m_verifiedKey.isEmpty();
+}
 
-    return decrypt(m_verifier, m_cipher) == m_nonce;
+QString Request::verifiedKey() const
+{
+    return m_verifiedKey;
 }
 
 bool Request::fromJson(QString text)
@@ -284,11 +262,22 @@ bool Request::fromJson(QString text)
     if (doc.isNull())
         return false;
 
-    m_requestType.clear();
-    QVariantMap map = doc.object().toVariantMap();
-    for(QVariantMap::iterator iter = map.begin(); iter != map.end(); ++iter) {
-        setProperty(iter.key().toLatin1(), iter.value());
-    }
+    const QVariantMap map = doc.object().toVariantMap();
+    m_requestType = map.value("RequestType").toString();
+    m_sortSelection = map.value("SortSelection").toBool();
+    m_login = map.value("Login").toString();
+    m_password = map.value("Password").toString();
+    m_uuid = map.value("Uuid").toString();
+    m_url = map.value("Url").toString();
+    m_submitUrl = map.value("SubmitUrl").toString();
+    m_key = map.value("Key").toString();
+    m_id = map.value("Id").toString();
+    m_verifier = map.value("Verifier").toString();
+    m_nonce = map.value("Nonce").toString();
+    m_realm = map.value("Realm").toString();
+    m_urlList = map.value("Urls").toList();
+    m_urls.clear();
+    m_verifiedKey.clear();
 
     return requestType() != INVALID;
 }
@@ -304,6 +293,7 @@ Response::Response(const Request &request, QString hash):
     m_count(-1),
     m_version(STR_VERSION),
     m_hash(hash),
+    m_entriesEncrypted(true),
     m_cipher(SymmetricCipher::Aes256, SymmetricCipher::Cbc, SymmetricCipher::Encrypt)
 {
   m_cipher.init();
@@ -311,9 +301,15 @@ Response::Response(const Request &request, QString hash):
 
 void Response::setVerifier(QString key)
 {
-    //Q_ASSERT(!m_cipher.isValid());
+    m_key = key;
+}
 
-     m_cipher.setKey(decode64(key));
+void Response::encryptVerifier()
+{
+    if (m_key.isEmpty())
+        return;
+
+    m_cipher.setKey(decode64(m_key));
 
     //Generate new IV
     const QByteArray iv = randomGen()->randomArray(m_cipher.blockSize());
@@ -322,10 +318,14 @@ void Response::setVerifier(QString key)
 
     //Encrypt
     m_verifier = encrypt(m_nonce, m_cipher);
+    m_key.clear();
 }
 
 QString Response::toJson()
 {
+    encryptVerifier();
+    encryptEntries();
+
     QJsonObject json;
     
     int count = metaObject()->propertyCount();
@@ -334,6 +334,8 @@ QString Response::toJson()
         const char *name = metaproperty.name();
         json.insert(QString(name), QJsonValue::fromVariant(this->property(name)));
     }
+    if (requestType() == GET_LOGINS_BATCH)
+        json.insert("Results", QJsonValue::fromVariant(getResults()));
 
     QJsonDocument doc(json);
     return doc.toJson(QJsonDocument::Compact);
@@ -387,22 +389,76 @@ void Response::setEntries(const QList<Entry> &entries)
     //Q_ASSERT(m_cipher.isValid());
 
     m_count = entries.count();
+    m_entries = entries;
+    m_entriesEncrypted = false;
+}
+
+void Response::encryptEntries()
+{
+    if (m_entriesEncrypted)
+        return;
 
     QList<Entry> encryptedEntries;
-    encryptedEntries.reserve(m_count);
-    for (const Entry& entry: entries) {
-        Entry encryptedEntry(encrypt(entry.name(), m_cipher),
-                             encrypt(entry.login(), m_cipher),
-                             entry.password().isNull() ? QString() : encrypt(entry.password(), m_cipher),
-                             encrypt(entry.uuid(), m_cipher));
-        const auto stringFields = entry.stringFields();
-        for (const StringField& field: stringFields) {
-            encryptedEntry.addStringField(encrypt(field.key(), m_cipher),
-                                          encrypt(field.value(), m_cipher));
-        }
-        encryptedEntries << encryptedEntry;
+    encryptedEntries.reserve(m_entries.count());
+    for (const Entry& entry: asConst(m_entries)) {
+        encryptedEntries << encryptEntry(entry);
     }
     m_entries = encryptedEntries;
+
+    for (QPair<QString, QList<Entry>>& result: m_results) {
+        result.first = encrypt(result.first, m_cipher);
+        for (Entry& entry: result.second) {
+            entry = encryptEntry(entry);
+        }
+    }
+    m_entriesEncrypted = true;
+}
+
+Entry Response::encryptEntry(const Entry &entry)
+{
+    Entry encryptedEntry(encrypt(entry.name(), m_cipher),
+                         encrypt(entry.login(), m_cipher),
+                         entry.password().isNull() ? QString() : encrypt(entry.password(), m_cipher),
+                         encrypt(entry.uuid(), m_cipher));
+    const auto stringFields = entry.stringFields();
+    for (const StringField& field: stringFields) {
+        encryptedEntry.addStringField(encrypt(field.key(), m_cipher),
+                                      encrypt(field.value(), m_cipher));
+    }
+    return encryptedEntry;
+}
+
+QVariant Response::getResults() const
+{
+    QList<QVariant> res;
+    res.reserve(m_results.size());
+    for (const QPair<QString, QList<Entry>>& result: asConst(m_results)) {
+        QList<QVariant> entries;
+        entries.reserve(result.second.size());
+        for (const Entry& entry: result.second) {
+            entries.append(qobject2qvariant(&entry));
+        }
+
+        QVariantMap map;
+        map.insert("Url", result.first);
+        map.insert("Count", result.second.size());
+        map.insert("Entries", entries);
+        res.append(map);
+    }
+    return res;
+}
+
+void Response::setResults(const QStringList &urls, const QList<QList<Entry>> &results)
+{
+    Q_ASSERT(urls.size() == results.size());
+
+    m_count = 0;
+    m_results.clear();
+    for (int i = 0; i < results.size(); ++i) {
+        m_count += results.at(i).size();
+        m_results << qMakePair(urls.at(i), results.at(i));
+    }
+    m_entriesEncrypted = false;
 }
 
 QString Response::hash() const
@@ -34,27 +34,19 @@ enum RequestType {
     SET_LOGIN,
     ASSOCIATE,
     TEST_ASSOCIATE,
-    GENERATE_PASSWORD
+    GENERATE_PASSWORD,
+    GET_LOGINS_BATCH
 };
 
 //TODO: use QByteArray whenever possible?
 
-class Request : public QObject
+/**
+ * A decoded request. It is a plain value rather than a QObject, so it can be
+ * handed between the GUI thread and the thread pool. The encrypted fields can
+ * only be read after verify() succeeded.
+ */
+class Request
 {
-    Q_OBJECT
-    Q_PROPERTY(QString RequestType   READ requestTypeStr WRITE setRequestType  )
-    Q_PROPERTY(bool    SortSelection READ sortSelection  WRITE setSortSelection)
-    Q_PROPERTY(QString Login         READ login          WRITE setLogin        )
-    Q_PROPERTY(QString Password      READ password       WRITE setPassword     )
-    Q_PROPERTY(QString Uuid          READ uuid           WRITE setUuid         )
-    Q_PROPERTY(QString Url           READ url            WRITE setUrl          )
-    Q_PROPERTY(QString SubmitUrl     READ submitUrl      WRITE setSubmitUrl    )
-    Q_PROPERTY(QString Key           READ key            WRITE setKey          )
-    Q_PROPERTY(QString Id            READ id             WRITE setId           )
-    Q_PROPERTY(QString Verifier      READ verifier       WRITE setVerifier     )
-    Q_PROPERTY(QString Nonce         READ nonce          WRITE setNonce        )
-    Q_PROPERTY(QString Realm         READ realm          WRITE setRealm        )
-
 public:
     Request();
     bool fromJson(QString text);
@@ -72,22 +64,24 @@ public:
     QString verifier() const;
     QString nonce() const;
     QString realm() const;
-    bool CheckVerifier(const QString & key) const;
+    /**
+     * The url and submit url pairs of a get-logins-batch request.
+     */
+    QList<QPair<QString, QString>> urls() const;
+
+    /**
+     * Checks the verifier with the key of the client and decrypts all
+     * encrypted fields at once. Does not touch any database, so it can run on
+     * a worker thread.
+     */
+    bool verify(const QString &key);
+    bool isVerified() const;
+    /**
+     * The key the verifier was checked with, empty if the request isn't verified.
+     */
+    QString verifiedKey() const;
 
 private:
-    void setRequestType(const QString &requestType);
-    void setSortSelection(bool sortSelection);
-    void setLogin(const QString &login);
-    void setPassword(const QString &password);
-    void setUuid(const QString &uuid);
-    void setUrl(const QString &url);
-    void setSubmitUrl(const QString &submitUrl);
-    void setKey(const QString &key);
-    void setId(const QString &id);
-    void setVerifier(const QString &verifier);
-    void setNonce(const QString &nonce);
-    void setRealm(const QString &realm);
-
     QString m_requestType;
     bool m_sortSelection;
     QString m_login;
@@ -100,7 +94,9 @@ private:
     QString m_verifier;
     QString m_nonce;
     QString m_realm;
-    mutable SymmetricCipherGcrypt m_cipher;
+    QVariantList m_urlList;
+    QList<QPair<QString, QString>> m_urls;
+    QString m_verifiedKey;
 };
 
 class StringField : public QObject
@@ -185,14 +181,36 @@ public:
     void setCount(int count);
     QVariant getEntries() const;
     void setEntries(const QList<Entry> &entries);
+    /**
+     * The entries found for each url, only serialized for a
+     * get-logins-batch request.
+     */
+    QVariant getResults() const;
+    /**
+     * Sets the entries found for each url of a get-logins-batch request,
+     * in the order of the request.
+     */
+    void setResults(const QStringList &urls, const QList<QList<Entry>> &results);
     QString nonce() const;
     QString verifier() const;
+    /**
+     * Sets the key of the client. The verifier and the entries are encrypted
+     * with it in toJson().
+     */
     void setVerifier(QString key);
 
+    /**
+     * Encrypts the verifier and the entries with the key of the client and
+     * serializes the response. Does not touch any database, so it can run on
+     * a worker thread.
+     */
     QString toJson();
 
 private:
     QString requestTypeStr() const;
+    void encryptVerifier();
+    void encryptEntries();
+    Entry encryptEntry(const Entry &entry);
 
     QString m_requestType;
     QString m_error;
@@ -202,6 +220,9 @@ private:
     QString m_version;
     QString m_hash;
     QList<Entry> m_entries;
+    QList<QPair<QString, QList<Entry>>> m_results;
+    bool    m_entriesEncrypted;
+    QString m_key;
     QString m_nonce;
     QString m_verifier;
     mutable SymmetricCipherGcrypt m_cipher;
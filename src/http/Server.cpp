@@ -17,8 +17,14 @@
 */
 
 #include <QEventLoop>
+#include <QtConcurrent>
 #include <QtCore/QHash>
 #include <QtCore/QCryptographicHash>
+#include <QtCore/QFutureWatcher>
+#include <QtCore/QPointer>
+#include <QtCore/QtEndian>
+#include <QtNetwork/QLocalServer>
+#include <QtNetwork/QLocalSocket>
 #include <QtWidgets/QMessageBox>
 
 #include "qhttp/qhttpserver.hpp"
@@ -33,11 +39,16 @@
 using namespace KeepassHttpProtocol;
 using namespace qhttp::server;
 
+static const int FRAME_HEADER_SIZE = 4;
+static const quint32 MAX_REQUEST_SIZE = 1024 * 1024;
+
 Server::Server(QObject *parent) :
     QObject(parent),
     m_started(false),
-    m_server(nullptr)
+    m_server(nullptr),
+    m_localServer(nullptr)
 {
+    m_clock.start();
 
 }
 
@@ -46,18 +57,17 @@ void Server::testAssociate(const Request& r, Response * protocolResp)
     if (r.id().isEmpty())
         return;   //ping
 
-    QString key = getKey(r.id());
-    if (key.isEmpty() || !r.CheckVerifier(key))
+    if (!r.isVerified())
         return;
 
     protocolResp->setSuccess();
     protocolResp->setId(r.id());
-    protocolResp->setVerifier(key);
+    protocolResp->setVerifier(r.verifiedKey());
 }
 
 void Server::associate(const Request& r, Response * protocolResp)
 {
-    if (!r.CheckVerifier(r.key()))
+    if (!r.isVerified())
         return;
 
     QString id = storeKey(r.key());
@@ -71,13 +81,12 @@ void Server::associate(const Request& r, Response * protocolResp)
 
 void Server::getLogins(const Request &r, Response *protocolResp)
 {
-    QString key = getKey(r.id());
-    if (!r.CheckVerifier(key))
+    if (!r.isVerified())
         return;
 
     protocolResp->setSuccess();
     protocolResp->setId(r.id());
-    protocolResp->setVerifier(key);
+    protocolResp->setVerifier(r.verifiedKey());
     QList<Entry> entries = findMatchingEntries(r.id(), r.url(), r.submitUrl(), r.realm());  //TODO: filtering, request confirmation [in db adaptation layer?]
     if (r.sortSelection()) {
         //TODO: sorting (in db adaptation layer? here?)
@@ -85,34 +94,57 @@ void Server::getLogins(const Request &r, Response *protocolResp)
     protocolResp->setEntries(entries);
 }
 
+void Server::getLoginsBatch(const Request &r, Response *protocolResp)
+{
+    if (!r.isVerified())
+        return;
+
+    protocolResp->setSuccess();
+    protocolResp->setId(r.id());
+    protocolResp->setVerifier(r.verifiedKey());
+
+    const QList<QPair<QString, QString>> urls = r.urls();
+    QStringList requestedUrls;
+    requestedUrls.reserve(urls.size());
+    for (const auto& url: urls)
+        requestedUrls << url.first;
+    protocolResp->setResults(requestedUrls, findMatchingEntriesBatch(r.id(), urls, r.realm()));
+}
+
+QList<QList<Entry>> Server::findMatchingEntriesBatch(const QString &id, const QList<QPair<QString, QString>> &urls, const QString &realm)
+{
+    QList<QList<Entry>> results;
+    results.reserve(urls.size());
+    for (const auto& url: urls)
+        results << findMatchingEntries(id, url.first, url.second, realm);
+    return results;
+}
+
 void Server::getLoginsCount(const Request &r, Response *protocolResp)
 {
-    QString key = getKey(r.id());
-    if (!r.CheckVerifier(key))
+    if (!r.isVerified())
         return;
 
     protocolResp->setSuccess();
     protocolResp->setId(r.id());
-    protocolResp->setVerifier(key);
+    protocolResp->setVerifier(r.verifiedKey());
     protocolResp->setCount(countMatchingEntries(r.id(), r.url(), r.submitUrl(), r.realm()));
 }
 
 void Server::getAllLogins(const Request &r, Response *protocolResp)
 {
-    QString key = getKey(r.id());
-    if (!r.CheckVerifier(key))
+    if (!r.isVerified())
         return;
 
     protocolResp->setSuccess();
     protocolResp->setId(r.id());
-    protocolResp->setVerifier(key);
+    protocolResp->setVerifier(r.verifiedKey());
     protocolResp->setEntries(searchAllEntries(r.id()));   //TODO: ensure there is no password --> change API?
 }
 
 void Server::setLogin(const Request &r, Response *protocolResp)
 {
-    QString key = getKey(r.id());
-    if (!r.CheckVerifier(key))
+    if (!r.isVerified())
         return;
 
     QString uuid = r.uuid();
@@ -123,13 +155,12 @@ void Server::setLogin(const Request &r, Response *protocolResp)
 
     protocolResp->setSuccess();
     protocolResp->setId(r.id());
-    protocolResp->setVerifier(key);
+    protocolResp->setVerifier(r.verifiedKey());
 }
 
 void Server::generatePassword(const Request &r, Response *protocolResp)
 {
-    QString key = getKey(r.id());
-    if (!r.CheckVerifier(key))
+    if (!r.isVerified())
         return;
 
     QString password = generatePassword();
@@ -137,35 +168,101 @@ void Server::generatePassword(const Request &r, Response *protocolResp)
 
     protocolResp->setSuccess();
     protocolResp->setId(r.id());
-    protocolResp->setVerifier(key);
+    protocolResp->setVerifier(r.verifiedKey());
     protocolResp->setEntries(QList<Entry>() << Entry("generate-password", bits, password, "generate-password"));
 
     memset(password.data(), 0, password.length());
 }
 
-void Server::handleRequest(const QByteArray& data, QHttpResponse* response)
+void Server::handleRequest(const QByteArray& data, QObject* connection)
 {
-    Request r;
-    if (!r.fromJson(data))
+    const qint64 started = m_clock.nsecsElapsed();
+    QPointer<QObject> connectionPtr(connection);
+    auto watcher = new QFutureWatcher<QSharedPointer<Request>>(this);
+    connect(watcher, &QFutureWatcherBase::finished, this, [=]() {
+        watcher->deleteLater();
+        if (connectionPtr)
+            verifyRequest(watcher->result(), connectionPtr, started);
+    });
+    watcher->setFuture(QtConcurrent::run(&Server::decodeRequest, data));
+}
+
+QSharedPointer<Request> Server::decodeRequest(const QByteArray& data)
+{
+    QSharedPointer<Request> r(new Request());
+    if (!r->fromJson(data))
+        return QSharedPointer<Request>();
+    return r;
+}
+
+void Server::verifyRequest(QSharedPointer<Request> r, QObject* connection, qint64 started)
+{
+    if (!r) {
+        sendResponse(connection, QByteArray());
         return;
+    }
+
+    //The keys of the clients are stored in the database, so only the lookup runs here
+    QString key;
+    if (r->requestType() == ASSOCIATE)
+        key = r->key();
+    else if (!r->id().isEmpty())
+        key = getKey(r->id());
+
+    QPointer<QObject> connectionPtr(connection);
+    auto watcher = new QFutureWatcher<void>(this);
+    connect(watcher, &QFutureWatcherBase::finished, this, [=]() {
+        watcher->deleteLater();
+        if (connectionPtr)
+            processRequest(r, connectionPtr, started);
+    });
+    watcher->setFuture(QtConcurrent::run(&Server::decryptRequest, r, key));
+}
+
+void Server::decryptRequest(QSharedPointer<Request> r, const QString& key)
+{
+    r->verify(key);
+}
+
+void Server::processRequest(QSharedPointer<Request> r, QObject* connection, qint64 started)
+{
+    //The access control dialog runs a nested event loop, the connection might be gone afterwards
+    QPointer<QObject> connectionPtr(connection);
 
     QByteArray hash = QCryptographicHash::hash(
         (getDatabaseRootUuid() + getDatabaseRecycleBinUuid()).toUtf8(),
          QCryptographicHash::Sha1).toHex();
 
-    Response protocolResp(r, QString::fromLatin1(hash));
-    switch(r.requestType()) {
+    QSharedPointer<Response> protocolResp(new Response(*r, QString::fromLatin1(hash)));
+    switch(r->requestType()) {
     case INVALID: break;
-    case GET_LOGINS:        getLogins(r, &protocolResp); break;
-    case GET_LOGINS_COUNT:  getLoginsCount(r, &protocolResp); break;
-    case GET_ALL_LOGINS:    getAllLogins(r, &protocolResp); break;
-    case SET_LOGIN:         setLogin(r, &protocolResp); break;
-    case ASSOCIATE:         associate(r, &protocolResp); break;
-    case TEST_ASSOCIATE:    testAssociate(r, &protocolResp); break;
-    case GENERATE_PASSWORD: generatePassword(r, &protocolResp); break;
+    case GET_LOGINS:        getLogins(*r, protocolResp.data()); break;
+    case GET_LOGINS_COUNT:  getLoginsCount(*r, protocolResp.data()); break;
+    case GET_ALL_LOGINS:    getAllLogins(*r, protocolResp.data()); break;
+    case SET_LOGIN:         setLogin(*r, protocolResp.data()); break;
+    case ASSOCIATE:         associate(*r, protocolResp.data()); break;
+    case TEST_ASSOCIATE:    testAssociate(*r, protocolResp.data()); break;
+    case GENERATE_PASSWORD: generatePassword(*r, protocolResp.data()); break;
+    case GET_LOGINS_BATCH:  getLoginsBatch(*r, protocolResp.data()); break;
     }
 
-    QString out = protocolResp.toJson().toUtf8();
+    //The response is only borrowed by the pool, it is destroyed with the watcher on the GUI thread
+    const QString requestType = r->requestTypeStr();
+    auto watcher = new QFutureWatcher<QByteArray>(this);
+    connect(watcher, &QFutureWatcherBase::finished, this, [=]() {
+        Q_UNUSED(protocolResp);
+        watcher->deleteLater();
+        if (!connectionPtr)
+            return;
+        sendResponse(connectionPtr, watcher->result());
+        recordLatency(requestType, m_clock.nsecsElapsed() - started);
+    });
+    watcher->setFuture(QtConcurrent::run(&Server::encodeResponse, protocolResp.data()));
+}
+
+QByteArray Server::encodeResponse(Response* protocolResp)
+{
+    QString out = protocolResp->toJson().toUtf8();
 
     // THIS IS A FAKE HACK!!!
     // the real "error" is a misbehavior in the QJSON qobject2qvariant method
@@ -182,9 +279,90 @@ void Server::handleRequest(const QByteArray& data, QHttpResponse* response)
         out.replace(pos2, 15, "\"Entries\":[],");
     }
 
-    response->setStatusCode(qhttp::ESTATUS_OK);
-    response->addHeader("Content-Type", "application/json");
-    response->end(out.toUtf8());
+    return out.toUtf8();
+}
+
+void Server::recordLatency(const QString& requestType, qint64 nsecs)
+{
+    LatencyCounter& counter = m_latencies[requestType];
+    if (counter.histogram.isEmpty())
+        counter.histogram.fill(0, LatencyCounter::BucketCount);
+
+    counter.count++;
+    counter.totalNsecs += nsecs;
+    counter.maxNsecs = qMax(counter.maxNsecs, nsecs);
+
+    //Bucket i holds the latencies below 2^(i+1) microseconds
+    int bucket = 0;
+    for (qint64 usecs = nsecs / 1000; usecs > 1 && bucket < LatencyCounter::BucketCount - 1; usecs >>= 1)
+        bucket++;
+    counter.histogram[bucket]++;
+}
+
+static qint64 latencyPercentile(const QVector<quint64>& histogram, quint64 count, int percent)
+{
+    const quint64 rank = (count * percent + 99) / 100;
+    quint64 seen = 0;
+    for (int i = 0; i < histogram.size(); i++) {
+        seen += histogram.at(i);
+        if (seen >= rank)
+            return Q_INT64_C(1) << (i + 1);
+    }
+    return Q_INT64_C(1) << histogram.size();
+}
+
+QString Server::latencyReport() const
+{
+    QString report;
+    for (auto i = m_latencies.constBegin(); i != m_latencies.constEnd(); ++i) {
+        const LatencyCounter& counter = i.value();
+        report += QString("%1: %2 requests, mean %3 us, p50 < %4 us, p95 < %5 us, p99 < %6 us, max %7 us\n")
+                  .arg(i.key())
+                  .arg(counter.count)
+                  .arg(counter.totalNsecs / 1000 / static_cast<qint64>(counter.count))
+                  .arg(latencyPercentile(counter.histogram, counter.count, 50))
+                  .arg(latencyPercentile(counter.histogram, counter.count, 95))
+                  .arg(latencyPercentile(counter.histogram, counter.count, 99))
+                  .arg(counter.maxNsecs / 1000);
+    }
+    return report;
+}
+
+void Server::resetLatencies()
+{
+    m_latencies.clear();
+}
+
+/**
+ * An empty response means the request was invalid or no database could be
+ * opened. Local clients get an empty message in that case, HTTP clients
+ * keep getting no answer to invalid requests.
+ */
+void Server::sendResponse(QObject* connection, const QByteArray& data)
+{
+    if (QHttpResponse* response = qobject_cast<QHttpResponse*>(connection)) {
+        if (data.isEmpty())
+            return;
+        response->setStatusCode(qhttp::ESTATUS_OK);
+        response->addHeader("Content-Type", "application/json");
+        response->end(data);
+    } else if (QLocalSocket* socket = qobject_cast<QLocalSocket*>(connection)) {
+        writeFrame(socket, data);
+
+        auto localConnection = m_localConnections.find(socket);
+        if (localConnection != m_localConnections.end()) {
+            localConnection->busy = false;
+            processLocalRequest(socket);
+        }
+    }
+}
+
+void Server::writeFrame(QLocalSocket* socket, const QByteArray& data)
+{
+    char header[FRAME_HEADER_SIZE];
+    qToBigEndian<quint32>(static_cast<quint32>(data.size()), reinterpret_cast<uchar*>(header));
+    socket->write(header, FRAME_HEADER_SIZE);
+    socket->write(data);
 }
 
 void Server::start(void)
@@ -192,25 +370,80 @@ void Server::start(void)
     if (m_started)
         return;
 
-    // local loopback hardcoded, since KeePassHTTP handshake
-    // is not safe against interception
-    QHostAddress address("127.0.0.1");
-    int port = HttpSettings::httpPort();
+    if (HttpSettings::listenOnHttpPort()) {
+        // local loopback hardcoded, since KeePassHTTP handshake
+        // is not safe against interception
+        QHostAddress address("127.0.0.1");
+        int port = HttpSettings::httpPort();
+
+        m_server = new QHttpServer(this);
+        m_server->listen(address, port);
+        connect(m_server, SIGNAL(newRequest(QHttpRequest*, QHttpResponse*)), this, SLOT(onNewRequest(QHttpRequest*, QHttpResponse*)));
+    }
 
-    m_server = new QHttpServer(this);
-    m_server->listen(address, port);
-    connect(m_server, SIGNAL(newRequest(QHttpRequest*, QHttpResponse*)), this, SLOT(onNewRequest(QHttpRequest*, QHttpResponse*)));
+    if (HttpSettings::localSocketEnabled())
+        listenOnLocalSocket();
 
     m_started = true;
 }
 
+void Server::listenOnLocalSocket()
+{
+    const QString name = HttpSettings::localSocketName();
+    if (name.isEmpty()) {
+        qWarning("Cannot listen on local socket: no private directory for it");
+        return;
+    }
+
+    m_localServer = new QLocalServer(this);
+    m_localServer->setSocketOptions(QLocalServer::UserAccessOption);
+    bool listening = m_localServer->listen(name);
+    if (!listening && m_localServer->serverError() == QAbstractSocket::AddressInUseError) {
+        // only remove the socket left behind by a crashed instance, not the one of a running instance
+        QLocalSocket probe;
+        probe.connectToServer(name);
+        if (!probe.waitForConnected(1000)) {
+            QLocalServer::removeServer(name);
+            listening = m_localServer->listen(name);
+        }
+    }
+
+    if (listening) {
+        connect(m_localServer, SIGNAL(newConnection()), this, SLOT(onNewLocalConnection()));
+    } else {
+        qWarning("Cannot listen on local socket %s: %s", qPrintable(name),
+                 qPrintable(m_localServer->errorString()));
+        delete m_localServer;
+        m_localServer = nullptr;
+    }
+}
+
 void Server::stop(void)
 {
     if (!m_started)
         return;
 
-    m_server->stopListening();
-    m_server->deleteLater();
+    //Set KEEPASSXC_HTTP_LATENCY to get the latencies of a session in the log
+    if (!m_latencies.isEmpty() && qEnvironmentVariableIsSet("KEEPASSXC_HTTP_LATENCY"))
+        qDebug("KeePassHTTP request latencies:\n%s", qPrintable(latencyReport()));
+    resetLatencies();
+
+    if (m_server) {
+        m_server->stopListening();
+        m_server->deleteLater();
+        m_server = nullptr;
+    }
+
+    if (m_localServer) {
+        const auto sockets = m_localConnections.keys();
+        for (QLocalSocket* socket: sockets)
+            socket->disconnect(this);
+        m_localConnections.clear();
+        m_localServer->close();
+        m_localServer->deleteLater();
+        m_localServer = nullptr;
+    }
+
     m_started = false;
 }
 
@@ -224,9 +457,74 @@ void Server::onNewRequest(QHttpRequest* request, QHttpResponse* response)
         }
     }
 
-    request->collectData(1024);
+    request->collectData(static_cast<int>(MAX_REQUEST_SIZE));
 
     request->onEnd([=]() {
         this->handleRequest(request->collectedData(), response);
     });
 }
+
+void Server::onNewLocalConnection()
+{
+    while (QLocalSocket* socket = m_localServer->nextPendingConnection()) {
+        m_localConnections.insert(socket, LocalConnection());
+        connect(socket, SIGNAL(readyRead()), this, SLOT(onLocalReadyRead()));
+        connect(socket, SIGNAL(disconnected()), this, SLOT(onLocalDisconnected()));
+    }
+}
+
+void Server::onLocalReadyRead()
+{
+    QLocalSocket* socket = qobject_cast<QLocalSocket*>(sender());
+    auto connection = m_localConnections.find(socket);
+    if (connection == m_localConnections.end())
+        return;
+
+    QByteArray& buffer = connection->buffer;
+    buffer.append(socket->readAll());
+    while (buffer.size() >= FRAME_HEADER_SIZE) {
+        const quint32 size = qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(buffer.constData()));
+        if (size > MAX_REQUEST_SIZE) {
+            m_localConnections.erase(connection);
+            socket->abort();
+            return;
+        }
+        if (static_cast<quint32>(buffer.size()) < FRAME_HEADER_SIZE + size)
+            break;
+
+        connection->requests.append(buffer.mid(FRAME_HEADER_SIZE, static_cast<int>(size)));
+        buffer.remove(0, FRAME_HEADER_SIZE + static_cast<int>(size));
+    }
+
+    processLocalRequest(socket);
+}
+
+void Server::onLocalDisconnected()
+{
+    QLocalSocket* socket = qobject_cast<QLocalSocket*>(sender());
+    if (!socket)
+        return;
+
+    m_localConnections.remove(socket);
+    socket->deleteLater();
+}
+
+void Server::processLocalRequest(QLocalSocket* socket)
+{
+    //One request per connection at a time, so the responses keep the order of the requests
+    auto connection = m_localConnections.find(socket);
+    if (connection == m_localConnections.end() || connection->busy || connection->requests.isEmpty())
+        return;
+
+    const QByteArray data = connection->requests.takeFirst();
+    connection->busy = true;
+
+    QPointer<QLocalSocket> socketPtr(socket);
+    if (!isDatabaseOpened() && !openDatabase()) {
+        if (socketPtr)
+            sendResponse(socket, QByteArray());
+        return;
+    }
+
+    handleRequest(data, socket);
+}
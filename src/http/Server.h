@@ -21,6 +21,14 @@
 
 #include <QtCore/QObject>
 #include <QtCore/QList>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QHash>
+#include <QtCore/QMap>
+#include <QtCore/QVector>
+#include <QtCore/QSharedPointer>
+
+class QLocalServer;
+class QLocalSocket;
 
 namespace qhttp {
     namespace server {
@@ -51,25 +59,75 @@ public:
     virtual QString getKey(const QString &id) = 0;
     virtual QString storeKey(const QString &key) = 0;
     virtual QList<Entry> findMatchingEntries(const QString &id, const QString &url, const QString & submitUrl, const QString & realm) = 0;
+    /**
+     * Finds the entries for several url and submit url pairs at once. The
+     * default implementation looks up each pair separately.
+     */
+    virtual QList<QList<Entry>> findMatchingEntriesBatch(const QString &id, const QList<QPair<QString, QString>> &urls, const QString & realm);
     virtual int countMatchingEntries(const QString &id, const QString &url, const QString & submitUrl, const QString & realm) = 0;
     virtual QList<Entry> searchAllEntries(const QString &id) = 0;
     virtual void addEntry(const QString &id, const QString &login, const QString &password, const QString &url, const QString &submitUrl, const QString &realm) = 0;
     virtual void updateEntry(const QString &id, const QString &uuid, const QString &login, const QString &password, const QString &url) = 0;
     virtual QString generatePassword() = 0;
 
+    /**
+     * Returns the number of handled requests and their latency from receiving
+     * the request to sending the response, per request type. Percentiles are
+     * upper bounds with a power of two resolution. The latencies are reset
+     * when the server stops, and logged before if the KEEPASSXC_HTTP_LATENCY
+     * environment variable is set.
+     */
+    QString latencyReport() const;
+    void resetLatencies();
+
 public slots:
     void start();
     void stop();
 
 private slots:
     void onNewRequest(QHttpRequest* request, QHttpResponse* response);
-    void handleRequest(const QByteArray& data, QHttpResponse* response);
+    void onNewLocalConnection();
+    void onLocalReadyRead();
+    void onLocalDisconnected();
 
 private:
+    /**
+     * Requests are handled in steps that alternate between the global thread
+     * pool and the GUI thread: the request is decoded on the pool, the key of
+     * the client is looked up in the database, the request is verified and
+     * decrypted on the pool, the entries are looked up in the database and
+     * the encrypted response is encoded on the pool. The connection is either
+     * a QHttpResponse or a QLocalSocket, see sendResponse().
+     */
+    void handleRequest(const QByteArray& data, QObject* connection);
+    static QSharedPointer<KeepassHttpProtocol::Request> decodeRequest(const QByteArray& data);
+    void verifyRequest(QSharedPointer<KeepassHttpProtocol::Request> r, QObject* connection, qint64 started);
+    static void decryptRequest(QSharedPointer<KeepassHttpProtocol::Request> r, const QString& key);
+    void processRequest(QSharedPointer<KeepassHttpProtocol::Request> r, QObject* connection, qint64 started);
+    static QByteArray encodeResponse(KeepassHttpProtocol::Response* protocolResp);
+    void sendResponse(QObject* connection, const QByteArray& data);
+    void recordLatency(const QString& requestType, qint64 nsecs);
+    void listenOnLocalSocket();
+    void processLocalRequest(QLocalSocket* socket);
+    static void writeFrame(QLocalSocket* socket, const QByteArray& data);
+
+    /**
+     * Local clients send the same JSON messages as HTTP clients, each one
+     * prefixed with its size as a big endian quint32. Responses are framed
+     * the same way and sent in the order of the requests.
+     */
+    struct LocalConnection
+    {
+        QByteArray buffer;
+        QList<QByteArray> requests;
+        bool busy = false;
+    };
+
     void testAssociate(const KeepassHttpProtocol::Request &r, KeepassHttpProtocol::Response *protocolResp);
     void associate(const KeepassHttpProtocol::Request &r, KeepassHttpProtocol::Response *protocolResp);
     void getLogins(const KeepassHttpProtocol::Request &r, KeepassHttpProtocol::Response *protocolResp);
     void getLoginsCount(const KeepassHttpProtocol::Request &r, KeepassHttpProtocol::Response *protocolResp);
+    void getLoginsBatch(const KeepassHttpProtocol::Request &r, KeepassHttpProtocol::Response *protocolResp);
     void getAllLogins(const KeepassHttpProtocol::Request &r, KeepassHttpProtocol::Response *protocolResp);
     void setLogin(const KeepassHttpProtocol::Request &r, KeepassHttpProtocol::Response *protocolResp);
     void generatePassword(const KeepassHttpProtocol::Request &r, KeepassHttpProtocol::Response *protocolResp);
@@ -77,6 +135,21 @@ private:
     bool m_started;
 
     QHttpServer* m_server;
+    QLocalServer* m_localServer;
+    QHash<QLocalSocket*, LocalConnection> m_localConnections;
+
+    struct LatencyCounter
+    {
+        static const int BucketCount = 32;
+
+        quint64 count = 0;
+        qint64 totalNsecs = 0;
+        qint64 maxNsecs = 0;
+        QVector<quint64> histogram;
+    };
+
+    QElapsedTimer m_clock;
+    QMap<QString, LatencyCounter> m_latencies;
 };
 
 }   /*namespace KeepassHttpProtocol*/
@@ -30,7 +30,7 @@
 #include "core/Entry.h"
 #include "core/Global.h"
 #include "core/Group.h"
-#include "core/EntrySearcher.h"
+#include "core/HostIndex.h"
 #include "core/Metadata.h"
 #include "core/Uuid.h"
 #include "core/PasswordGenerator.h"
@@ -178,39 +178,16 @@ QString Service::storeKey(const QString &key)
     return id;
 }
 
-bool Service::matchUrlScheme(const QString & url)
+QVector<QList<Entry*>> Service::searchEntries(Database* db, const QString& hostname)
 {
-    QString str = url.left(8).toLower();
-    return str.startsWith("http://") ||
-           str.startsWith("https://") ||
-           str.startsWith("ftp://") ||
-           str.startsWith("ftps://");
-}
-
-bool Service::removeFirstDomain(QString & hostname)
-{
-    int pos = hostname.indexOf(".");
-    if (pos < 0)
-        return false;
-    hostname = hostname.mid(pos + 1);
-    return !hostname.isEmpty();
-}
-
-QList<Entry*> Service::searchEntries(Database* db, const QString& hostname)
-{
-    QList<Entry*> entries;
-    if (Group* rootGroup = db->rootGroup()) {
-        const auto results = EntrySearcher().search(hostname, rootGroup, Qt::CaseInsensitive);
-        for (Entry* entry: results) {
-            QString title = entry->title();
-            QString url = entry->webUrl();
-
-            //Filter to match hostname in Title and Url fields
-            if (   (!title.isEmpty() && hostname.contains(title))
-                || (!url.isEmpty() && hostname.contains(url))
-                || (matchUrlScheme(title) && hostname.endsWith(QUrl(title).host()))
-                || (matchUrlScheme(url) && hostname.endsWith(QUrl(url).host())) )
-                entries.append(entry);
+    QVector<QList<Entry*>> entries = db->hostIndex()->findEntries(hostname);
+    for (QList<Entry*>& domainEntries : entries) {
+        auto i = domainEntries.begin();
+        while (i != domainEntries.end()) {
+            if ((*i)->group()->resolveSearchingEnabled())
+                ++i;
+            else
+                i = domainEntries.erase(i);
         }
     }
     return entries;
@@ -231,28 +208,33 @@ QList<Entry*> Service::searchEntries(const QString& text)
             databases << db;
     }
 
-    //Search entries matching the hostname
-    QString hostname = QUrl(text).host();
-    QList<Entry*> entries;
-    do {
-        for (Database* db: asConst(databases)) {
-            entries << searchEntries(db, hostname);
-        }
-    } while(entries.isEmpty() && removeFirstDomain(hostname));
+    //Search entries matching the hostname, or else its closest parent domain
+    const QString hostname = QUrl(text).host();
+    QVector<QList<Entry*>> entries;
+    for (Database* db: asConst(databases)) {
+        const QVector<QList<Entry*>> dbEntries = searchEntries(db, hostname);
+        entries.resize(qMax(entries.size(), dbEntries.size()));
+        for (int i = 0; i < dbEntries.size(); i++)
+            entries[i] << dbEntries.at(i);
+    }
 
-    return entries;
+    for (const QList<Entry*>& domainEntries: asConst(entries)) {
+        if (!domainEntries.isEmpty())
+            return domainEntries;
+    }
+    return QList<Entry*>();
 }
 
 Service::Access Service::checkAccess(const Entry *entry, const QString & host, const QString & submitHost, const QString & realm)
 {
-    EntryConfig config;
-    if (!config.load(entry))
+    const QSharedPointer<const EntryConfig> config = EntryConfig::cached(entry);
+    if (!config)
         return Unknown;  //not configured
-    if ((config.isAllowed(host)) && (submitHost.isEmpty() || config.isAllowed(submitHost)))
+    if ((config->isAllowed(host)) && (submitHost.isEmpty() || config->isAllowed(submitHost)))
         return Allowed;  //allowed
-    if ((config.isDenied(host)) || (!submitHost.isEmpty() && config.isDenied(submitHost)))
+    if ((config->isDenied(host)) || (!submitHost.isEmpty() && config->isDenied(submitHost)))
         return Denied;   //denied
-    if (!realm.isEmpty() && config.realm() != realm)
+    if (!realm.isEmpty() && config->realm() != realm)
         return Denied;
     return Unknown;      //not configured for this host
 }
@@ -328,31 +310,50 @@ private:
     const QString m_field;
 };
 
-QList<KeepassHttpProtocol::Entry> Service::findMatchingEntries(const QString& /*id*/, const QString& url, const QString& submitUrl, const QString& realm)
+QList<KeepassHttpProtocol::Entry> Service::findMatchingEntries(const QString& id, const QString& url, const QString& submitUrl, const QString& realm)
+{
+    return findMatchingEntriesBatch(id, QList<QPair<QString, QString>>() << qMakePair(url, submitUrl), realm).first();
+}
+
+QList<QList<KeepassHttpProtocol::Entry>> Service::findMatchingEntriesBatch(const QString& /*id*/, const QList<QPair<QString, QString>>& urls, const QString& realm)
 {
     const bool alwaysAllowAccess = HttpSettings::alwaysAllowAccess();
-    const QString host = QUrl(url).host();
-    const QString submitHost = QUrl(submitUrl).host();
 
     //Check entries for authorization
-    QList<Entry*> pwEntriesToConfirm;
-    QList<Entry*> pwEntries;
-    const auto entries = searchEntries(url);
-    for (Entry* entry: entries) {
-        switch(checkAccess(entry, host, submitHost, realm)) {
-        case Denied:
-            continue;
-
-        case Unknown:
-            if (alwaysAllowAccess)
-                pwEntries.append(entry);
-            else
-                pwEntriesToConfirm.append(entry);
-            break;
+    QVector<QList<Entry*>> pwEntriesToConfirm(urls.size());
+    QVector<QList<Entry*>> pwEntries(urls.size());
+    QStringList urlsToConfirm;
+    QList<Entry*> itemsToConfirm;
+    for (int i = 0; i < urls.size(); i++) {
+        const QString& url = urls.at(i).first;
+        const QString host = QUrl(url).host();
+        const QString submitHost = QUrl(urls.at(i).second).host();
 
-        case Allowed:
-            pwEntries.append(entry);
-            break;
+        const auto entries = searchEntries(url);
+        for (Entry* entry: entries) {
+            switch(checkAccess(entry, host, submitHost, realm)) {
+            case Denied:
+                continue;
+
+            case Unknown:
+                if (alwaysAllowAccess)
+                    pwEntries[i].append(entry);
+                else
+                    pwEntriesToConfirm[i].append(entry);
+                break;
+
+            case Allowed:
+                pwEntries[i].append(entry);
+                break;
+            }
+        }
+
+        if (!pwEntriesToConfirm.at(i).isEmpty()) {
+            urlsToConfirm << url;
+            for (Entry* entry: asConst(pwEntriesToConfirm.at(i))) {
+                if (!itemsToConfirm.contains(entry))
+                    itemsToConfirm << entry;
+            }
         }
     }
 
@@ -363,36 +364,51 @@ QList<KeepassHttpProtocol::Entry> Service::findMatchingEntries(const QString& /*
     //                                 .arg(id).arg(submitHost.isEmpty() ? host : submithost));
     //    pwEntriesToConfirm.clear(); //timeout --> do not request confirmation
 
-    if (!pwEntriesToConfirm.isEmpty()) {
+    //A single confirmation covers all urls of the request
+    if (!itemsToConfirm.isEmpty()) {
 
         AccessControlDialog dlg;
-        dlg.setUrl(url);
-        dlg.setItems(pwEntriesToConfirm);
+        dlg.setUrls(urlsToConfirm);
+        dlg.setItems(itemsToConfirm);
         //dlg.setRemember();        //TODO: setting!
 
         int res = dlg.exec();
-        if (dlg.remember()) {
-            for (Entry* entry: asConst(pwEntriesToConfirm)) {
-                EntryConfig config;
-                config.load(entry);
-                if (res == QDialog::Accepted) {
-                    config.allow(host);
-                    if (!submitHost.isEmpty() && host != submitHost)
-                        config.allow(submitHost);
-                } else if (res == QDialog::Rejected) {
-                    config.deny(host);
-                    if (!submitHost.isEmpty() && host != submitHost)
-                        config.deny(submitHost);
+        for (int i = 0; i < urls.size(); i++) {
+            if (dlg.remember()) {
+                const QString host = QUrl(urls.at(i).first).host();
+                const QString submitHost = QUrl(urls.at(i).second).host();
+                for (Entry* entry: asConst(pwEntriesToConfirm.at(i))) {
+                    EntryConfig config;
+                    config.load(entry);
+                    if (res == QDialog::Accepted) {
+                        config.allow(host);
+                        if (!submitHost.isEmpty() && host != submitHost)
+                            config.allow(submitHost);
+                    } else if (res == QDialog::Rejected) {
+                        config.deny(host);
+                        if (!submitHost.isEmpty() && host != submitHost)
+                            config.deny(submitHost);
+                    }
+                    if (!realm.isEmpty())
+                        config.setRealm(realm);
+                    config.save(entry);
                 }
-                if (!realm.isEmpty())
-                    config.setRealm(realm);
-                config.save(entry);
             }
+            if (res == QDialog::Accepted)
+                pwEntries[i].append(pwEntriesToConfirm.at(i));
         }
-        if (res == QDialog::Accepted)
-            pwEntries.append(pwEntriesToConfirm);
     }
 
+    QList<QList<KeepassHttpProtocol::Entry>> results;
+    results.reserve(urls.size());
+    for (int i = 0; i < urls.size(); i++) {
+        results << prepareEntries(pwEntries.at(i), QUrl(urls.at(i).first).host(), urls.at(i).second);
+    }
+    return results;
+}
+
+QList<KeepassHttpProtocol::Entry> Service::prepareEntries(QList<Entry*> pwEntries, const QString& host, const QString& submitUrl)
+{
     //Sort results
     const bool sortSelection = true;
     if (sortSelection) {
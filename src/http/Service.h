@@ -20,6 +20,7 @@
 #define SERVICE_H
 
 #include <QObject>
+#include <QVector>
 #include "gui/DatabaseTabWidget.h"
 #include "Server.h"
 
@@ -37,6 +38,7 @@ public:
     virtual QString getKey(const QString& id);
     virtual QString storeKey(const QString& key);
     virtual QList<KeepassHttpProtocol::Entry> findMatchingEntries(const QString& id, const QString& url, const QString&  submitUrl, const QString&  realm);
+    virtual QList<QList<KeepassHttpProtocol::Entry>> findMatchingEntriesBatch(const QString& id, const QList<QPair<QString, QString>>& urls, const QString& realm);
     virtual int countMatchingEntries(const QString& id, const QString& url, const QString&  submitUrl, const QString&  realm);
     virtual QList<KeepassHttpProtocol::Entry> searchAllEntries(const QString& id);
     virtual void addEntry(const QString& id, const QString& login, const QString& password, const QString& url, const QString& submitUrl, const QString& realm);
@@ -50,14 +52,13 @@ public slots:
 private:
     enum Access { Denied, Unknown, Allowed};
     Entry* getConfigEntry(bool create = false);
-    bool matchUrlScheme(const QString& url);
     Access checkAccess(const Entry* entry, const QString&  host, const QString&  submitHost, const QString&  realm);
-    bool removeFirstDomain(QString& hostname);
     Group *findCreateAddEntryGroup();
     class SortEntries;
     int sortPriority(const Entry *entry, const QString &host, const QString &submitUrl, const QString &baseSubmitUrl) const;
     KeepassHttpProtocol::Entry prepareEntry(const Entry* entry);
-    QList<Entry*> searchEntries(Database* db, const QString& hostname);
+    QList<KeepassHttpProtocol::Entry> prepareEntries(QList<Entry*> entries, const QString& host, const QString& submitUrl);
+    QVector<QList<Entry*>> searchEntries(Database* db, const QString& hostname);
     QList<Entry*> searchEntries(const QString& text);
 
     DatabaseTabWidget * const m_dbTabWidget;
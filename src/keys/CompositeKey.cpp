@@ -17,16 +17,13 @@
 */
 
 #include "CompositeKey.h"
-#include "CompositeKey_p.h"
 #include "ChallengeResponseKey.h"
 
-#include <QElapsedTimer>
 #include <QFile>
-#include <QtConcurrent>
 
 #include "core/Global.h"
 #include "crypto/CryptoHash.h"
-#include "crypto/SymmetricCipher.h"
+#include "crypto/kdf/AesKdf.h"
 #include "keys/FileKey.h"
 #include "keys/PasswordKey.h"
 
@@ -91,63 +88,24 @@ QByteArray CompositeKey::rawKey() const
     return cryptoHash.result();
 }
 
+bool CompositeKey::transform(const Kdf& kdf, QByteArray& result, QString* errorString) const
+{
+    return kdf.transform(rawKey(), result, errorString);
+}
+
 QByteArray CompositeKey::transform(const QByteArray& seed, quint64 rounds,
                                    bool* ok, QString* errorString) const
 {
     Q_ASSERT(seed.size() == 32);
     Q_ASSERT(rounds > 0);
 
-    bool okLeft;
-    QString errorStringLeft;
-    bool okRight;
-    QString errorStringRight;
-
-    QByteArray key = rawKey();
-
-    QFuture<QByteArray> future = QtConcurrent::run(transformKeyRaw, key.left(16), seed, rounds,
-                                                   &okLeft, &errorStringLeft);
-    QByteArray result2 = transformKeyRaw(key.right(16), seed, rounds, &okRight, &errorStringRight);
-
-    QByteArray transformed;
-    transformed.append(future.result());
-    transformed.append(result2);
-
-    *ok = (okLeft && okRight);
-
-    if (!okLeft) {
-        *errorString = errorStringLeft;
-        return QByteArray();
-    }
-
-    if (!okRight) {
-        *errorString = errorStringRight;
-        return QByteArray();
-    }
-
-    return CryptoHash::hash(transformed, CryptoHash::Sha256);
-}
-
-QByteArray CompositeKey::transformKeyRaw(const QByteArray& key, const QByteArray& seed,
-                                         quint64 rounds, bool* ok, QString* errorString)
-{
-    QByteArray iv(16, 0);
-    SymmetricCipher cipher(SymmetricCipher::Aes256, SymmetricCipher::Ecb,
-                           SymmetricCipher::Encrypt);
-    if (!cipher.init(seed, iv)) {
-        *ok = false;
-        *errorString = cipher.errorString();
-        return QByteArray();
-    }
-
-    QByteArray result = key;
+    AesKdf kdf;
+    kdf.setSeed(seed);
+    kdf.setRounds(rounds);
 
-    if (!cipher.processInPlace(result, rounds)) {
-        *ok = false;
-        *errorString = cipher.errorString();
-        return QByteArray();
-    }
+    QByteArray result;
+    *ok = transform(kdf, result, errorString);
 
-    *ok = true;
     return result;
 }
 
@@ -183,53 +141,3 @@ void CompositeKey::addChallengeResponseKey(QSharedPointer<ChallengeResponseKey>
 {
     m_challengeResponseKeys.append(key);
 }
-
-
-int CompositeKey::transformKeyBenchmark(int msec)
-{
-    TransformKeyBenchmarkThread thread1(msec);
-    TransformKeyBenchmarkThread thread2(msec);
-
-    thread1.start();
-    thread2.start();
-
-    thread1.wait();
-    thread2.wait();
-
-    return qMin(thread1.rounds(), thread2.rounds());
-}
-
-
-TransformKeyBenchmarkThread::TransformKeyBenchmarkThread(int msec)
-    : m_msec(msec)
-    , m_rounds(0)
-{
-    Q_ASSERT(msec > 0);
-}
-
-int TransformKeyBenchmarkThread::rounds()
-{
-    return m_rounds;
-}
-
-void TransformKeyBenchmarkThread::run()
-{
-    QByteArray key = QByteArray(16, '\x7E');
-    QByteArray seed = QByteArray(32, '\x4B');
-    QByteArray iv(16, 0);
-
-    SymmetricCipher cipher(SymmetricCipher::Aes256, SymmetricCipher::Ecb,
-                           SymmetricCipher::Encrypt);
-    cipher.init(seed, iv);
-
-    QElapsedTimer t;
-    t.start();
-
-    do {
-        if (!cipher.processInPlace(key, 10000)) {
-            m_rounds = -1;
-            return;
-        }
-        m_rounds += 10000;
-    } while (!t.hasExpired(m_msec));
-}
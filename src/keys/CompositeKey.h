@@ -26,6 +26,8 @@
 #include "keys/Key.h"
 #include "keys/ChallengeResponseKey.h"
 
+class Kdf;
+
 class CompositeKey : public Key
 {
 public:
@@ -38,6 +40,7 @@ public:
     CompositeKey& operator=(const CompositeKey& key);
 
     QByteArray rawKey() const;
+    bool transform(const Kdf& kdf, QByteArray& result, QString* errorString) const;
     QByteArray transform(const QByteArray& seed, quint64 rounds,
                          bool* ok, QString* errorString) const;
     bool challenge(const QByteArray& seed, QByteArray &result) const;
@@ -45,12 +48,7 @@ public:
     void addKey(const Key& key);
     void addChallengeResponseKey(QSharedPointer<ChallengeResponseKey> key);
 
-    static int transformKeyBenchmark(int msec);
-
 private:
-    static QByteArray transformKeyRaw(const QByteArray& key, const QByteArray& seed,
-                                      quint64 rounds, bool* ok, QString* errorString);
-
     QList<Key*> m_keys;
     QList<QSharedPointer<ChallengeResponseKey>> m_challengeResponseKeys;
 };
@@ -24,6 +24,7 @@
 
 // bcrypt_pbkdf.cpp
 int bcrypt_pbkdf(const QByteArray& pass, const QByteArray& salt, QByteArray& key, quint32 rounds);
+int bcrypt_pbkdf_parallel(const QByteArray& pass, const QByteArray& salt, QByteArray& key, quint32 rounds);
 
 OpenSSHKey::OpenSSHKey(QObject *parent)
     : QObject(parent)
@@ -310,7 +311,7 @@ bool OpenSSHKey::openPrivateKey(const QString& passphrase)
         decryptKey.fill(0, cipher->keySize() + cipher->blockSize());
 
         QByteArray phraseData = passphrase.toLatin1();
-        if (bcrypt_pbkdf(phraseData, salt, decryptKey, rounds) < 0) {
+        if (bcrypt_pbkdf_parallel(phraseData, salt, decryptKey, rounds) < 0) {
             m_error = tr("Key derivation failed, key file corrupted?");
             return false;
         }
@@ -20,6 +20,11 @@
 #include "BinaryStream.h"
 #include "KeeAgentSettings.h"
 
+#include <QtConcurrent>
+
+#include "core/AttachmentIndex.h"
+#include "core/Global.h"
+
 #ifndef Q_OS_WIN
 #include <QtNetwork>
 #else
@@ -37,11 +42,20 @@ SSHAgent::SSHAgent(QObject* parent) : QObject(parent)
 
 SSHAgent::~SSHAgent()
 {
-    for (QSet<OpenSSHKey> keys : m_keys.values()) {
-        for (OpenSSHKey key : keys) {
-            removeIdentity(key);
+    for (QFutureWatcher<LoadedKey>* watcher : asConst(m_pendingLoads)) {
+        watcher->disconnect(this);
+        watcher->cancel();
+    }
+
+    QList<QByteArray> requests;
+    for (const QSet<QByteArray>& keys : asConst(m_keys)) {
+        for (const QByteArray& publicKey : keys) {
+            requests << removeIdentityRequest(publicKey);
         }
     }
+
+    QList<QByteArray> responses;
+    sendMessages(requests, responses);
 }
 
 SSHAgent* SSHAgent::instance()
@@ -67,28 +81,93 @@ bool SSHAgent::isAgentRunning() const
 #endif
 }
 
-bool SSHAgent::sendMessage(const QByteArray& in, QByteArray& out) const
+/**
+ * Sends all messages and collects their responses in the same order. On Unix
+ * the messages are pipelined over one connection that is kept open, so only
+ * the first call has to connect to the agent.
+ */
+bool SSHAgent::sendMessages(const QList<QByteArray>& in, QList<QByteArray>& out) const
 {
+    out.clear();
+    if (in.isEmpty()) {
+        return true;
+    }
+
 #ifndef Q_OS_WIN
-    QLocalSocket socket;
-    BinaryStream stream(&socket);
+    bool reused = false;
+    if (sendMessagesOnce(in, out, reused)) {
+        return true;
+    }
+
+    // the agent may have closed the connection since the last call
+    if (reused) {
+        return sendMessagesOnce(in, out, reused);
+    }
+
+    return false;
+#else
+    for (const QByteArray& message : in) {
+        QByteArray response;
+        if (!sendMessage(message, response)) {
+            return false;
+        }
+        out << response;
+    }
 
-    socket.connectToServer(m_socketPath);
-    if (!socket.waitForConnected(500)) {
+    return true;
+#endif
+}
+
+#ifndef Q_OS_WIN
+bool SSHAgent::sendMessage(const QByteArray& in, QByteArray& out) const
+{
+    QList<QByteArray> responses;
+    if (!sendMessages(QList<QByteArray>() << in, responses)) {
         return false;
     }
 
-    stream.writeString(in);
-    stream.flush();
+    out = responses.first();
+    return true;
+}
+
+bool SSHAgent::sendMessagesOnce(const QList<QByteArray>& in, QList<QByteArray>& out, bool& reused) const
+{
+    out.clear();
+
+    reused = m_socket && m_socket->state() == QLocalSocket::ConnectedState;
+    if (!reused) {
+        m_socket.reset(new QLocalSocket());
+        m_socket->connectToServer(m_socketPath);
+        if (!m_socket->waitForConnected(500)) {
+            m_socket.reset();
+            return false;
+        }
+    }
+
+    BinaryStream stream(m_socket.data());
+    for (const QByteArray& message : in) {
+        stream.writeString(message);
+    }
 
-    if (!stream.readString(out)) {
+    if (!stream.flush()) {
+        m_socket.reset();
         return false;
     }
 
-    socket.close();
+    for (int i = 0; i < in.size(); ++i) {
+        QByteArray response;
+        if (!stream.readString(response)) {
+            m_socket.reset();
+            return false;
+        }
+        out << response;
+    }
 
     return true;
+}
 #else
+bool SSHAgent::sendMessage(const QByteArray& in, QByteArray& out) const
+{
     HWND hWnd = FindWindowA("Pageant", "Pageant");
 
     if (!hWnd) {
@@ -143,7 +222,7 @@ bool SSHAgent::sendMessage(const QByteArray& in, QByteArray& out) const
 }
 
 
-bool SSHAgent::addIdentity(OpenSSHKey& key, quint32 lifetime, bool confirm) const
+QByteArray SSHAgent::addIdentityRequest(OpenSSHKey& key, quint32 lifetime, bool confirm) const
 {
     QByteArray requestData;
     BinaryStream request(&requestData);
@@ -160,113 +239,231 @@ bool SSHAgent::addIdentity(OpenSSHKey& key, quint32 lifetime, bool confirm) cons
         request.write(SSH_AGENT_CONSTRAIN_CONFIRM);
     }
 
-    QByteArray responseData;
-    sendMessage(requestData, responseData);
-
-    if (responseData.length() < 1 || static_cast<quint8>(responseData[0]) != SSH_AGENT_SUCCESS) {
-        return false;
-    }
-
-    return true;
+    return requestData;
 }
 
-bool SSHAgent::removeIdentity(OpenSSHKey& key) const
+QByteArray SSHAgent::removeIdentityRequest(const QByteArray& publicKey) const
 {
     QByteArray requestData;
     BinaryStream request(&requestData);
 
+    request.write(SSH_AGENTC_REMOVE_IDENTITY);
+    request.writeString(publicKey);
+
+    return requestData;
+}
+
+QByteArray SSHAgent::publicKeyBlob(const OpenSSHKey& key)
+{
+    OpenSSHKey copy = key;
     QByteArray keyData;
     BinaryStream keyStream(&keyData);
-    key.writePublic(keyStream);
+    copy.writePublic(keyStream);
 
-    request.write(SSH_AGENTC_REMOVE_IDENTITY);
-    request.writeString(keyData);
+    return keyData;
+}
 
+bool SSHAgent::isSuccess(const QByteArray& response) const
+{
+    return response.length() >= 1 && static_cast<quint8>(response[0]) == SSH_AGENT_SUCCESS;
+}
+
+bool SSHAgent::addIdentity(OpenSSHKey& key, quint32 lifetime, bool confirm) const
+{
     QByteArray responseData;
-    sendMessage(requestData, responseData);
+    sendMessage(addIdentityRequest(key, lifetime, confirm), responseData);
 
-    if (responseData.length() < 1 || static_cast<quint8>(responseData[0]) != SSH_AGENT_SUCCESS) {
-        return false;
-    }
+    return isSuccess(responseData);
+}
 
-    return true;
+bool SSHAgent::removeIdentity(OpenSSHKey& key) const
+{
+    QByteArray responseData;
+    sendMessage(removeIdentityRequest(publicKeyBlob(key)), responseData);
+
+    return isSuccess(responseData);
 }
 
 void SSHAgent::removeIdentityAtLock(const OpenSSHKey& key, const Uuid& uuid)
 {
-    OpenSSHKey copy = key;
-    copy.clearPrivate();
-    m_keys[uuid.toHex()].insert(copy);
+    m_keys[uuid.toHex()].insert(publicKeyBlob(key));
 }
 
-void SSHAgent::databaseModeChanged(DatabaseWidget::Mode mode)
+/**
+ * Parses the key of an entry and decrypts it if it is added when the database
+ * is opened. The parsed key of the previous unlock is reused if neither the
+ * settings nor the key data have changed since.
+ */
+SSHAgent::LoadedKey SSHAgent::loadKey(const KeyJob& job)
 {
-    DatabaseWidget* widget = qobject_cast<DatabaseWidget*>(sender());
+    LoadedKey result;
 
-    if (widget == nullptr) {
-        return;
+    QSharedPointer<ParsedKey> parsed(new ParsedKey());
+    parsed->settingsData = job.settingsData;
+    parsed->settings = job.settings;
+    result.parsed = parsed;
+
+    const KeeAgentSettings& settings = job.settings;
+    if (!settings.allowUseOfSshKey()) {
+        return result;
     }
 
-    Uuid uuid = widget->database()->uuid();
+    QByteArray keyData = job.keyData;
+    if (settings.selectedType() != "attachment" && !settings.fileName().isEmpty()) {
+        QFile file(settings.fileName());
 
-    if (mode == DatabaseWidget::LockedMode && m_keys.contains(uuid.toHex())) {
-        QSet<OpenSSHKey> keys = m_keys.take(uuid.toHex());
-        for (OpenSSHKey key : keys) {
-            removeIdentity(key);
+        if (file.size() > 1024 * 1024) {
+            return result;
+        }
+
+        if (!file.open(QIODevice::ReadOnly)) {
+            return result;
         }
-    } else if (mode == DatabaseWidget::ViewMode && !m_keys.contains(uuid.toHex())) {
-        for (Entry* e : widget->database()->rootGroup()->entriesRecursive()) {
 
-            if (!e->attachments()->hasKey("KeeAgent.settings"))
-                continue;
+        keyData = file.readAll();
+    }
 
-            KeeAgentSettings settings;
-            settings.fromXml(e->attachments()->value("KeeAgent.settings"));
+    if (keyData.isEmpty()) {
+        return result;
+    }
 
-            if (!settings.allowUseOfSshKey()) {
-                continue;
-            }
+    if (job.cached && job.cached->settingsData == job.settingsData && job.cached->key
+        && job.cached->keyData == keyData) {
+        result.parsed = job.cached;
+    }
+    else {
+        QSharedPointer<OpenSSHKey> key(new OpenSSHKey());
 
-            QByteArray keyData;
-            if (settings.selectedType() == "attachment") {
-                keyData = e->attachments()->value(settings.attachmentName());
-            } else if (!settings.fileName().isEmpty()) {
-                QFile file(settings.fileName());
+        if (!key->parse(keyData)) {
+            return result;
+        }
 
-                if (file.size() > 1024 * 1024) {
-                    continue;
-                }
+        parsed->keyData = keyData;
+        parsed->key = key;
+        parsed->publicKey = publicKeyBlob(*key);
+    }
 
-                if (!file.open(QIODevice::ReadOnly)) {
-                    continue;
-                }
+    if (settings.addAtDatabaseOpen()) {
+        QSharedPointer<OpenSSHKey> key(new OpenSSHKey(*result.parsed->key));
+        if (key->openPrivateKey(job.password)) {
+            result.openedKey = key;
+        }
+    }
 
-                keyData = file.readAll();
-            }
+    return result;
+}
 
-            if (keyData.isEmpty()) {
-                continue;
-            }
+void SSHAgent::keysLoaded(const Uuid& uuid, const QList<KeyJob>& jobs, const QList<LoadedKey>& keys)
+{
+    QHash<Uuid, QSharedPointer<const ParsedKey>> newCache;
+    QList<QByteArray> requests;
+    for (int i = 0; i < keys.size(); ++i) {
+        const LoadedKey& loaded = keys.at(i);
+        newCache.insert(jobs.at(i).uuid, loaded.parsed);
+
+        if (!loaded.parsed->key) {
+            continue;
+        }
 
-            OpenSSHKey key;
+        const KeeAgentSettings& settings = loaded.parsed->settings;
+        if (settings.removeAtDatabaseClose()) {
+            m_keys[uuid.toHex()].insert(loaded.parsed->publicKey);
+        }
+
+        if (loaded.openedKey) {
+            int lifetime = 0;
 
-            if (!key.parse(keyData)) {
-                continue;
+            if (settings.useLifetimeConstraintWhenAdding()) {
+                lifetime = settings.lifetimeConstraintDuration();
             }
 
-            if (settings.removeAtDatabaseClose()) {
-                removeIdentityAtLock(key, uuid);
+            requests << addIdentityRequest(*loaded.openedKey, lifetime, settings.useConfirmConstraintWhenAdding());
+        }
+    }
+    m_keyCache.insert(uuid.toHex(), newCache);
+
+    QList<QByteArray> responses;
+    sendMessages(requests, responses);
+}
+
+void SSHAgent::databaseModeChanged(DatabaseWidget::Mode mode)
+{
+    DatabaseWidget* widget = qobject_cast<DatabaseWidget*>(sender());
+
+    if (widget == nullptr) {
+        return;
+    }
+
+    Uuid uuid = widget->database()->uuid();
+
+    if (mode == DatabaseWidget::LockedMode && m_pendingLoads.contains(uuid.toHex())) {
+        // the keys of an unlock that is still loading must not be added after the lock
+        QFutureWatcher<LoadedKey>* watcher = m_pendingLoads.take(uuid.toHex());
+        watcher->disconnect(this);
+        watcher->cancel();
+        watcher->deleteLater();
+    }
+
+    if (mode == DatabaseWidget::LockedMode && m_keyCache.contains(uuid.toHex())) {
+        // keys that are not encrypted must not outlive the unlocked database
+        QHash<Uuid, QSharedPointer<const ParsedKey>>& cache = m_keyCache[uuid.toHex()];
+        QHash<Uuid, QSharedPointer<const ParsedKey>>::iterator i = cache.begin();
+        while (i != cache.end()) {
+            if (i.value()->key && !i.value()->key->encrypted()) {
+                i = cache.erase(i);
             }
+            else {
+                ++i;
+            }
+        }
+    }
 
-            if (settings.addAtDatabaseOpen() && key.openPrivateKey(e->password())) {
-                int lifetime = 0;
+    if (mode == DatabaseWidget::LockedMode && m_keys.contains(uuid.toHex())) {
+        const QSet<QByteArray> keys = m_keys.take(uuid.toHex());
+        QList<QByteArray> requests;
+        for (const QByteArray& publicKey : keys) {
+            requests << removeIdentityRequest(publicKey);
+        }
 
-                if (settings.useLifetimeConstraintWhenAdding()) {
-                    lifetime = settings.lifetimeConstraintDuration();
-                }
+        QList<QByteArray> responses;
+        sendMessages(requests, responses);
+    } else if (mode == DatabaseWidget::ViewMode && !m_keys.contains(uuid.toHex())
+               && !m_pendingLoads.contains(uuid.toHex())) {
+        const QHash<Uuid, QSharedPointer<const ParsedKey>> cache = m_keyCache.value(uuid.toHex());
+        const QList<Entry*> entries = widget->database()->attachmentIndex()->findEntries("KeeAgent.settings");
+
+        QList<KeyJob> jobs;
+        for (Entry* e : entries) {
+            KeyJob job;
+            job.uuid = e->uuid();
+            job.settingsData = e->attachments()->value("KeeAgent.settings");
+            job.cached = cache.value(job.uuid);
+            if (job.cached && job.cached->settingsData == job.settingsData) {
+                job.settings = job.cached->settings;
+            }
+            else {
+                job.settings.fromXml(job.settingsData);
+            }
 
-                addIdentity(key, lifetime, settings.useConfirmConstraintWhenAdding());
+            if (job.settings.allowUseOfSshKey()) {
+                if (job.settings.selectedType() == "attachment") {
+                    job.keyData = e->attachments()->value(job.settings.attachmentName());
+                }
+                if (job.settings.addAtDatabaseOpen()) {
+                    job.password = e->password();
+                }
             }
+            jobs << job;
         }
+
+        // decrypting keys is expensive (bcrypt_pbkdf), do it for all keys in parallel off the GUI thread
+        QFutureWatcher<LoadedKey>* watcher = new QFutureWatcher<LoadedKey>(this);
+        m_pendingLoads.insert(uuid.toHex(), watcher);
+        connect(watcher, &QFutureWatcherBase::finished, this, [=]() {
+            m_pendingLoads.remove(uuid.toHex());
+            watcher->deleteLater();
+            keysLoaded(uuid, jobs, watcher->future().results());
+        });
+        watcher->setFuture(QtConcurrent::mapped(jobs, &SSHAgent::loadKey));
     }
 }
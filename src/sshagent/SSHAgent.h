@@ -21,10 +21,15 @@
 
 #include <QtCore>
 #include <QList>
+#include <QSharedPointer>
 #include "OpenSSHKey.h"
+#include "KeeAgentSettings.h"
+#include "core/Uuid.h"
 
 #include "gui/DatabaseWidget.h"
 
+class QLocalSocket;
+
 class SSHAgent : public QObject
 {
     Q_OBJECT
@@ -37,6 +42,7 @@ public:
     bool addIdentity(OpenSSHKey& key, quint32 lifetime = 0, bool confirm = false) const;
     bool removeIdentity(OpenSSHKey& key) const;
     void removeIdentityAtLock(const OpenSSHKey& key, const Uuid& uuid);
+    bool sendMessages(const QList<QByteArray>& in, QList<QByteArray>& out) const;
 
 public slots:
     void databaseModeChanged(DatabaseWidget::Mode mode = DatabaseWidget::LockedMode);
@@ -56,18 +62,66 @@ private:
     explicit SSHAgent(QObject* parent = nullptr);
     ~SSHAgent();
 
+    /**
+     * A key parsed from the KeeAgent settings of an entry. The private part is
+     * still encrypted, so it can be kept around while the database is locked.
+     */
+    struct ParsedKey
+    {
+        QByteArray settingsData;
+        KeeAgentSettings settings;
+        QByteArray keyData;
+        QSharedPointer<const OpenSSHKey> key;
+        QByteArray publicKey;
+    };
+
+    /**
+     * Everything needed to load the key of an entry, copied on the GUI thread
+     * so that the key can be parsed and decrypted on a worker thread. Only the
+     * attachment that holds the key is copied, and the password only if the
+     * key is added when the database is opened.
+     */
+    struct KeyJob
+    {
+        Uuid uuid;
+        QByteArray settingsData;
+        KeeAgentSettings settings;
+        QByteArray keyData;
+        QString password;
+        QSharedPointer<const ParsedKey> cached;
+    };
+
+    struct LoadedKey
+    {
+        QSharedPointer<const ParsedKey> parsed;
+        QSharedPointer<OpenSSHKey> openedKey;
+    };
+
+    static LoadedKey loadKey(const KeyJob& job);
+    void keysLoaded(const Uuid& uuid, const QList<KeyJob>& jobs, const QList<LoadedKey>& keys);
+    static QByteArray publicKeyBlob(const OpenSSHKey& key);
+
+    QByteArray addIdentityRequest(OpenSSHKey& key, quint32 lifetime, bool confirm) const;
+    QByteArray removeIdentityRequest(const QByteArray& publicKey) const;
+    bool isSuccess(const QByteArray& response) const;
+
     bool sendMessage(const QByteArray& in, QByteArray& out) const;
 
     static SSHAgent* m_instance;
 
 #ifndef Q_OS_WIN
+    bool sendMessagesOnce(const QList<QByteArray>& in, QList<QByteArray>& out, bool& reused) const;
+
     QString m_socketPath;
+    mutable QScopedPointer<QLocalSocket> m_socket;
 #else
     const quint32 AGENT_MAX_MSGLEN = 8192;
     const quint32 AGENT_COPYDATA_ID = 0x804e50ba;
 #endif
 
-    QMap<QString, QSet<OpenSSHKey>> m_keys;
+    QMap<QString, QSet<QByteArray>> m_keys;
+    QHash<QString, QHash<Uuid, QSharedPointer<const ParsedKey>>> m_keyCache;
+    QHash<QString, QFutureWatcher<LoadedKey>*> m_pendingLoads;
 };
 
 #endif // AGENTCLIENT_H
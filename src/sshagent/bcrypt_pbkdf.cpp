@@ -16,6 +16,7 @@
  */
 
 #include <QtCore>
+#include <QtConcurrent>
 
 extern "C" {
 #include "blf.h"
@@ -98,71 +99,100 @@ bcrypt_hash(const quint8* sha2pass, const quint8* sha2salt, quint8* out)
     explicit_bzero(&state, sizeof(state));
 }
 
-int bcrypt_pbkdf(const QByteArray& pass, const QByteArray& salt, QByteArray& key, quint32 rounds)
+/*
+ * Computes the output block number count, each block depends only on the
+ * password, the salt and its own number.
+ */
+static void
+bcrypt_pbkdf_block(const QByteArray& sha2pass, const QByteArray& salt, quint32 count, quint32 rounds,
+                   quint8* out)
 {
     QCryptographicHash ctx(QCryptographicHash::Sha512);
-    QByteArray sha2pass;
     QByteArray sha2salt;
-    quint8 out[BCRYPT_HASHSIZE];
     quint8 tmpout[BCRYPT_HASHSIZE];
     quint8 countsalt[4];
 
+    countsalt[0] = (count >> 24) & 0xff;
+    countsalt[1] = (count >> 16) & 0xff;
+    countsalt[2] = (count >> 8) & 0xff;
+    countsalt[3] = count & 0xff;
+
+    /* first round, salt is salt */
+    ctx.reset();
+    ctx.addData(salt);
+    ctx.addData(reinterpret_cast<char *>(countsalt), sizeof(countsalt));
+    sha2salt = ctx.result();
+
+    bcrypt_hash(reinterpret_cast<const quint8 *>(sha2pass.constData()), reinterpret_cast<quint8 *>(sha2salt.data()), tmpout);
+    memcpy(out, tmpout, BCRYPT_HASHSIZE);
+
+    for (quint32 i = 1; i < rounds; i++) {
+        /* subsequent rounds, salt is previous output */
+        ctx.reset();
+        ctx.addData(reinterpret_cast<char *>(tmpout), sizeof(tmpout));
+        sha2salt = ctx.result();
+        bcrypt_hash(reinterpret_cast<const quint8 *>(sha2pass.constData()), reinterpret_cast<quint8 *>(sha2salt.data()), tmpout);
+        for (quint32 j = 0; j < BCRYPT_HASHSIZE; j++)
+            out[j] ^= tmpout[j];
+    }
+
+    /* zap */
+    explicit_bzero(tmpout, sizeof(tmpout));
+}
+
+/*
+ * pbkdf2 deviation: output the key material non-linearly, block number
+ * count provides every stride-th byte of the key.
+ */
+static void
+bcrypt_pbkdf_output(QByteArray& key, const quint8* out, quint32 count, quint32 stride, quint32 amt)
+{
+    for (quint32 i = 0; i < amt; i++) {
+        int dest = i * stride + (count - 1);
+        if (dest >= key.length())
+            break;
+        key.data()[dest] = out[i];
+    }
+}
+
+static bool
+bcrypt_pbkdf_prepare(const QByteArray& pass, const QByteArray& salt, const QByteArray& key, quint32 rounds,
+                     QByteArray& sha2pass, quint32& stride, quint32& amt)
+{
     /* nothing crazy */
     if (rounds < 1) {
-        return -1;
+        return false;
     }
 
     if (pass.isEmpty() || salt.isEmpty() || key.isEmpty() ||
-        static_cast<quint32>(key.length()) > sizeof(out) * sizeof(out)) {
-        return -1;
+        static_cast<quint32>(key.length()) > BCRYPT_HASHSIZE * BCRYPT_HASHSIZE) {
+        return false;
     }
 
-    quint32 stride = (key.length() + sizeof(out) - 1) / sizeof(out);
-    quint32 amt = (key.length() + stride - 1) / stride;
+    stride = (key.length() + BCRYPT_HASHSIZE - 1) / BCRYPT_HASHSIZE;
+    amt = (key.length() + stride - 1) / stride;
 
     /* collapse password */
-    ctx.reset();
-    ctx.addData(pass);
-    sha2pass = ctx.result();
+    sha2pass = QCryptographicHash::hash(pass, QCryptographicHash::Sha512);
 
-    /* generate key, sizeof(out) at a time */
-    for (quint32 count = 1, keylen = key.length(); keylen > 0; count++) {
-        countsalt[0] = (count >> 24) & 0xff;
-        countsalt[1] = (count >> 16) & 0xff;
-        countsalt[2] = (count >> 8) & 0xff;
-        countsalt[3] = count & 0xff;
+    return true;
+}
 
-        /* first round, salt is salt */
-        ctx.reset();
-        ctx.addData(salt);
-        ctx.addData(reinterpret_cast<char *>(countsalt), sizeof(countsalt));
-        sha2salt = ctx.result();
+int bcrypt_pbkdf(const QByteArray& pass, const QByteArray& salt, QByteArray& key, quint32 rounds)
+{
+    QByteArray sha2pass;
+    quint32 stride;
+    quint32 amt;
+    quint8 out[BCRYPT_HASHSIZE];
 
-        bcrypt_hash(reinterpret_cast<quint8 *>(sha2pass.data()), reinterpret_cast<quint8 *>(sha2salt.data()), tmpout);
-        memcpy(out, tmpout, sizeof(out));
-
-        for (quint32 i = 1; i < rounds; i++) {
-            /* subsequent rounds, salt is previous output */
-            ctx.reset();
-            ctx.addData(reinterpret_cast<char *>(tmpout), sizeof(tmpout));
-            sha2salt = ctx.result();
-            bcrypt_hash(reinterpret_cast<quint8 *>(sha2pass.data()), reinterpret_cast<quint8 *>(sha2salt.data()), tmpout);
-            for (quint32 j = 0; j < sizeof(out); j++)
-                out[j] ^= tmpout[j];
-        }
-
-        /*
-         * pbkdf2 deviation: output the key material non-linearly.
-         */
-        amt = MINIMUM(amt, keylen);
-        quint32 i;
-        for (i = 0; i < amt; i++) {
-            int dest = i * stride + (count - 1);
-            if (dest >= key.length())
-                break;
-            key.data()[dest] = out[i];
-        }
-        keylen -= i;
+    if (!bcrypt_pbkdf_prepare(pass, salt, key, rounds, sha2pass, stride, amt)) {
+        return -1;
+    }
+
+    /* generate key, sizeof(out) at a time */
+    for (quint32 count = 1; count <= stride; count++) {
+        bcrypt_pbkdf_block(sha2pass, salt, count, rounds, out);
+        bcrypt_pbkdf_output(key, out, count, stride, amt);
     }
 
     /* zap */
@@ -170,3 +200,44 @@ int bcrypt_pbkdf(const QByteArray& pass, const QByteArray& salt, QByteArray& key
 
     return 0;
 }
+
+/*
+ * Same as bcrypt_pbkdf, but the output blocks are computed in parallel on the
+ * global thread pool. A key of n bytes has ceil(n / 32) independent blocks.
+ */
+int bcrypt_pbkdf_parallel(const QByteArray& pass, const QByteArray& salt, QByteArray& key, quint32 rounds)
+{
+    QByteArray sha2pass;
+    quint32 stride;
+    quint32 amt;
+
+    if (!bcrypt_pbkdf_prepare(pass, salt, key, rounds, sha2pass, stride, amt)) {
+        return -1;
+    }
+
+    if (stride == 1) {
+        return bcrypt_pbkdf(pass, salt, key, rounds);
+    }
+
+    struct Block
+    {
+        quint32 count;
+        quint8 out[BCRYPT_HASHSIZE];
+    };
+
+    QVector<Block> blocks(stride);
+    for (quint32 count = 1; count <= stride; count++) {
+        blocks[count - 1].count = count;
+    }
+
+    QtConcurrent::blockingMap(blocks, [&sha2pass, &salt, rounds](Block& block) {
+        bcrypt_pbkdf_block(sha2pass, salt, block.count, rounds, block.out);
+    });
+
+    for (Block& block : blocks) {
+        bcrypt_pbkdf_output(key, block.out, block.count, stride, amt);
+        explicit_bzero(block.out, sizeof(block.out));
+    }
+
+    return 0;
+}
@@ -0,0 +1,275 @@
+/*
+ *  Copyright (C) 2017 KeePassXC Team <team@keepassxc.org>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 or (at your option)
+ *  version 3 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "HmacBlockStream.h"
+
+#include <cstring>
+
+#include "core/Endian.h"
+#include "crypto/CryptoHash.h"
+
+const QSysInfo::Endian HmacBlockStream::ByteOrder = QSysInfo::LittleEndian;
+
+HmacBlockStream::HmacBlockStream(QIODevice* baseDevice, const QByteArray& key)
+    : LayeredStream(baseDevice)
+    , m_blockSize(1024*1024)
+    , m_key(key)
+{
+    init();
+}
+
+HmacBlockStream::HmacBlockStream(QIODevice* baseDevice, const QByteArray& key, qint32 blockSize)
+    : LayeredStream(baseDevice)
+    , m_blockSize(blockSize)
+    , m_key(key)
+{
+    Q_ASSERT(blockSize > 0 && blockSize <= MaxBlockSize);
+    init();
+}
+
+HmacBlockStream::~HmacBlockStream()
+{
+    close();
+}
+
+void HmacBlockStream::init()
+{
+    m_buffer.clear();
+    m_bufferPos = 0;
+    m_blockIndex = 0;
+    m_eof = false;
+    m_error = false;
+}
+
+bool HmacBlockStream::reset()
+{
+    // Write final block(s) only if device is writable and we haven't
+    // already written a final block.
+    if (isWritable() && (!m_buffer.isEmpty() || m_blockIndex != 0)) {
+        if (!m_buffer.isEmpty()) {
+            if (!writeHashedBlock()) {
+                return false;
+            }
+        }
+
+        // write empty final block
+        if (!writeHashedBlock()) {
+            return false;
+        }
+    }
+
+    init();
+
+    return true;
+}
+
+void HmacBlockStream::close()
+{
+    // Write final block(s) only if device is writable and we haven't
+    // already written a final block.
+    if (isWritable() && (!m_buffer.isEmpty() || m_blockIndex != 0)) {
+        if (!m_buffer.isEmpty()) {
+            writeHashedBlock();
+        }
+
+        // write empty final block
+        writeHashedBlock();
+    }
+
+    LayeredStream::close();
+}
+
+/**
+ * The stream is sequential, so the end is only known once the empty
+ * final block has been read.
+ */
+bool HmacBlockStream::atEnd() const
+{
+    if (!isReadable()) {
+        return LayeredStream::atEnd();
+    }
+
+    return m_eof || m_error;
+}
+
+QByteArray HmacBlockStream::getHmacKey(quint64 blockIndex, const QByteArray& key)
+{
+    CryptoHash hash(CryptoHash::Sha512);
+    hash.addData(Endian::int64ToBytes(static_cast<qint64>(blockIndex), ByteOrder));
+    hash.addData(key);
+    return hash.result();
+}
+
+QByteArray HmacBlockStream::blockHmac(const QByteArray& sizeBytes) const
+{
+    CryptoHash hmac(CryptoHash::Sha256, true);
+    hmac.setKey(getHmacKey(m_blockIndex, m_key));
+    hmac.addData(Endian::int64ToBytes(static_cast<qint64>(m_blockIndex), ByteOrder));
+    hmac.addData(sizeBytes);
+    hmac.addData(m_buffer);
+    return hmac.result();
+}
+
+qint64 HmacBlockStream::readData(char* data, qint64 maxSize)
+{
+    if (m_error) {
+        return -1;
+    }
+    else if (m_eof) {
+        return 0;
+    }
+
+    qint64 bytesRemaining = maxSize;
+    qint64 offset = 0;
+
+    while (bytesRemaining > 0) {
+        if (m_bufferPos == m_buffer.size()) {
+            if (!readHashedBlock()) {
+                if (m_error) {
+                    return -1;
+                }
+                else {
+                    return maxSize - bytesRemaining;
+                }
+            }
+        }
+
+        int bytesToCopy = qMin(bytesRemaining, static_cast<qint64>(m_buffer.size() - m_bufferPos));
+
+        memcpy(data + offset, m_buffer.constData() + m_bufferPos, bytesToCopy);
+
+        offset += bytesToCopy;
+        m_bufferPos += bytesToCopy;
+        bytesRemaining -= bytesToCopy;
+    }
+
+    return maxSize;
+}
+
+bool HmacBlockStream::readHashedBlock()
+{
+    QByteArray hmac = m_baseDevice->read(32);
+    if (hmac.size() != 32) {
+        m_error = true;
+        setErrorString("Invalid block HMAC size.");
+        return false;
+    }
+
+    QByteArray sizeBytes = m_baseDevice->read(4);
+    if (sizeBytes.size() != 4) {
+        m_error = true;
+        setErrorString("Invalid block size.");
+        return false;
+    }
+    m_blockSize = Endian::bytesToInt32(sizeBytes, ByteOrder);
+    if (m_blockSize < 0 || m_blockSize > MaxBlockSize) {
+        m_error = true;
+        setErrorString("Invalid block size.");
+        return false;
+    }
+
+    m_buffer = m_baseDevice->read(m_blockSize);
+    if (m_buffer.size() != m_blockSize) {
+        m_error = true;
+        setErrorString("Block too short.");
+        return false;
+    }
+
+    // the final empty block is authenticated as well
+    if (hmac != blockHmac(sizeBytes)) {
+        m_error = true;
+        setErrorString("Mismatch between HMAC and data.");
+        return false;
+    }
+
+    m_bufferPos = 0;
+    m_blockIndex++;
+
+    if (m_blockSize == 0) {
+        m_eof = true;
+        return false;
+    }
+
+    return true;
+}
+
+qint64 HmacBlockStream::writeData(const char* data, qint64 maxSize)
+{
+    Q_ASSERT(maxSize >= 0);
+
+    if (m_error) {
+        return 0;
+    }
+
+    qint64 bytesRemaining = maxSize;
+    qint64 offset = 0;
+
+    while (bytesRemaining > 0) {
+        int bytesToCopy = qMin(bytesRemaining, static_cast<qint64>(m_blockSize - m_buffer.size()));
+
+        m_buffer.append(data + offset, bytesToCopy);
+
+        offset += bytesToCopy;
+        bytesRemaining -= bytesToCopy;
+
+        if (m_buffer.size() == m_blockSize) {
+            if (!writeHashedBlock()) {
+                if (m_error) {
+                    return -1;
+                }
+                else {
+                    return maxSize - bytesRemaining;
+                }
+            }
+        }
+    }
+
+    return maxSize;
+}
+
+bool HmacBlockStream::writeHashedBlock()
+{
+    QByteArray sizeBytes = Endian::int32ToBytes(m_buffer.size(), ByteOrder);
+
+    QByteArray hmac = blockHmac(sizeBytes);
+    if (m_baseDevice->write(hmac) != hmac.size()) {
+        m_error = true;
+        setErrorString(m_baseDevice->errorString());
+        return false;
+    }
+
+    if (m_baseDevice->write(sizeBytes) != sizeBytes.size()) {
+        m_error = true;
+        setErrorString(m_baseDevice->errorString());
+        return false;
+    }
+
+    if (!m_buffer.isEmpty()) {
+        if (m_baseDevice->write(m_buffer) != m_buffer.size()) {
+            m_error = true;
+            setErrorString(m_baseDevice->errorString());
+            return false;
+        }
+
+        m_buffer.clear();
+    }
+
+    m_blockIndex++;
+
+    return true;
+}
@@ -0,0 +1,318 @@
+/*
+ *  Copyright (C) 2017 KeePassXC Team <team@keepassxc.org>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 or (at your option)
+ *  version 3 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "PipelineStream.h"
+
+#include <QThread>
+
+#include <cstring>
+
+class PipelineStreamThread : public QThread
+{
+public:
+    explicit PipelineStreamThread(PipelineStream* stream)
+        : m_stream(stream)
+    {
+    }
+
+protected:
+    void run() override
+    {
+        m_stream->runWorker();
+    }
+
+private:
+    PipelineStream* const m_stream;
+};
+
+PipelineStream::PipelineStream(QIODevice* baseDevice, int chunkSize, int maxChunks)
+    : LayeredStream(baseDevice)
+    , m_chunkSize(chunkSize)
+    , m_maxChunks(maxChunks)
+    , m_chunkPos(0)
+    , m_writeMode(false)
+    , m_workerBusy(false)
+    , m_workerFinished(false)
+    , m_abort(false)
+{
+    Q_ASSERT(chunkSize > 0);
+    Q_ASSERT(maxChunks > 0);
+}
+
+PipelineStream::~PipelineStream()
+{
+    close();
+}
+
+bool PipelineStream::open(QIODevice::OpenMode mode)
+{
+    if (!LayeredStream::open(mode)) {
+        return false;
+    }
+
+    m_chunks.clear();
+    m_chunkPos = 0;
+    m_writeChunk.clear();
+    m_writeMode = isWritable();
+    m_workerBusy = false;
+    m_workerFinished = false;
+    m_abort = false;
+    m_workerError.clear();
+
+    m_thread.reset(new PipelineStreamThread(this));
+    m_thread->start();
+
+    return true;
+}
+
+bool PipelineStream::reset()
+{
+    if (!m_writeMode) {
+        return false;
+    }
+
+    return flush();
+}
+
+void PipelineStream::close()
+{
+    if (m_writeMode && m_thread) {
+        flush();
+    }
+
+    stopWorker();
+
+    LayeredStream::close();
+}
+
+/**
+ * In read mode this waits until the worker has either queued more data
+ * or reached the end of the base device.
+ */
+bool PipelineStream::atEnd() const
+{
+    if (!isReadable() || !m_thread) {
+        return LayeredStream::atEnd();
+    }
+
+    QMutexLocker locker(&m_mutex);
+
+    while (m_chunks.isEmpty() && !m_workerFinished) {
+        m_chunkQueued.wait(&m_mutex);
+    }
+
+    return m_chunks.isEmpty();
+}
+
+void PipelineStream::stopWorker()
+{
+    if (!m_thread) {
+        return;
+    }
+
+    m_mutex.lock();
+    m_abort = true;
+    m_chunkQueued.wakeAll();
+    m_chunkDequeued.wakeAll();
+    m_mutex.unlock();
+
+    m_thread->wait();
+    m_thread.reset();
+}
+
+void PipelineStream::runWorker()
+{
+    if (m_writeMode) {
+        writeChunks();
+    }
+    else {
+        readChunks();
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_workerFinished = true;
+    m_chunkQueued.wakeAll();
+    m_chunkDequeued.wakeAll();
+}
+
+void PipelineStream::readChunks()
+{
+    while (true) {
+        QByteArray chunk(m_chunkSize, Qt::Uninitialized);
+        qint64 bytesRead = m_baseDevice->read(chunk.data(), m_chunkSize);
+
+        QMutexLocker locker(&m_mutex);
+
+        if (bytesRead < 0) {
+            m_workerError = m_baseDevice->errorString();
+            return;
+        }
+        else if (bytesRead == 0) {
+            return;
+        }
+
+        chunk.resize(static_cast<int>(bytesRead));
+
+        while (m_chunks.size() >= m_maxChunks && !m_abort) {
+            m_chunkDequeued.wait(&m_mutex);
+        }
+
+        if (m_abort) {
+            return;
+        }
+
+        m_chunks.enqueue(chunk);
+        m_chunkQueued.wakeOne();
+    }
+}
+
+void PipelineStream::writeChunks()
+{
+    QMutexLocker locker(&m_mutex);
+
+    while (true) {
+        while (m_chunks.isEmpty() && !m_abort) {
+            m_chunkQueued.wait(&m_mutex);
+        }
+
+        if (m_chunks.isEmpty()) {
+            return;
+        }
+
+        QByteArray chunk = m_chunks.dequeue();
+        m_workerBusy = true;
+        m_chunkDequeued.wakeAll();
+        locker.unlock();
+
+        bool ok = (m_baseDevice->write(chunk) == chunk.size());
+
+        locker.relock();
+        m_workerBusy = false;
+        if (!ok) {
+            // drop the remaining data, the stream is unusable from here on
+            m_workerError = m_baseDevice->errorString();
+            m_chunks.clear();
+        }
+        m_chunkDequeued.wakeAll();
+    }
+}
+
+qint64 PipelineStream::readData(char* data, qint64 maxSize)
+{
+    QMutexLocker locker(&m_mutex);
+
+    qint64 bytesRead = 0;
+
+    while (bytesRead < maxSize) {
+        while (m_chunks.isEmpty() && !m_workerFinished) {
+            m_chunkQueued.wait(&m_mutex);
+        }
+
+        if (m_chunks.isEmpty()) {
+            break;
+        }
+
+        const QByteArray& chunk = m_chunks.head();
+        int bytesToCopy = static_cast<int>(qMin(maxSize - bytesRead,
+                                                static_cast<qint64>(chunk.size() - m_chunkPos)));
+        memcpy(data + bytesRead, chunk.constData() + m_chunkPos, bytesToCopy);
+
+        bytesRead += bytesToCopy;
+        m_chunkPos += bytesToCopy;
+
+        if (m_chunkPos == chunk.size()) {
+            m_chunks.dequeue();
+            m_chunkPos = 0;
+            m_chunkDequeued.wakeOne();
+        }
+    }
+
+    if (bytesRead == 0 && !m_workerError.isEmpty()) {
+        setErrorString(m_workerError);
+        return -1;
+    }
+
+    return bytesRead;
+}
+
+qint64 PipelineStream::writeData(const char* data, qint64 maxSize)
+{
+    qint64 bytesRemaining = maxSize;
+    qint64 offset = 0;
+
+    while (bytesRemaining > 0) {
+        if (m_writeChunk.isEmpty()) {
+            m_writeChunk.reserve(m_chunkSize);
+        }
+
+        int bytesToCopy = static_cast<int>(qMin(bytesRemaining,
+                                                static_cast<qint64>(m_chunkSize - m_writeChunk.size())));
+        m_writeChunk.append(data + offset, bytesToCopy);
+
+        offset += bytesToCopy;
+        bytesRemaining -= bytesToCopy;
+
+        if (m_writeChunk.size() == m_chunkSize) {
+            if (!queueWriteChunk()) {
+                return -1;
+            }
+        }
+    }
+
+    return maxSize;
+}
+
+bool PipelineStream::queueWriteChunk()
+{
+    QMutexLocker locker(&m_mutex);
+
+    while (m_chunks.size() >= m_maxChunks && m_workerError.isEmpty()) {
+        m_chunkDequeued.wait(&m_mutex);
+    }
+
+    if (!m_workerError.isEmpty()) {
+        setErrorString(m_workerError);
+        return false;
+    }
+
+    m_chunks.enqueue(m_writeChunk);
+    m_writeChunk.clear();
+    m_chunkQueued.wakeOne();
+
+    return true;
+}
+
+bool PipelineStream::flush()
+{
+    if (!m_writeChunk.isEmpty() && !queueWriteChunk()) {
+        return false;
+    }
+
+    QMutexLocker locker(&m_mutex);
+
+    while ((!m_chunks.isEmpty() || m_workerBusy) && m_workerError.isEmpty()) {
+        m_chunkDequeued.wait(&m_mutex);
+    }
+
+    if (!m_workerError.isEmpty()) {
+        setErrorString(m_workerError);
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,90 @@
+/*
+ *  Copyright (C) 2017 KeePassXC Team <team@keepassxc.org>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 or (at your option)
+ *  version 3 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef KEEPASSX_PIPELINESTREAM_H
+#define KEEPASSX_PIPELINESTREAM_H
+
+#include <QByteArray>
+#include <QMutex>
+#include <QQueue>
+#include <QScopedPointer>
+#include <QWaitCondition>
+
+#include "streams/LayeredStream.h"
+
+class QThread;
+
+/**
+ * Runs the base device on a worker thread of its own. Data is handed
+ * between the threads in large chunks through a bounded queue, so a
+ * stack of streams where every layer is wrapped in a PipelineStream
+ * processes the layers concurrently.
+ *
+ * The base device must not be used by any other thread while the
+ * stream is open. In write mode reset() waits until all data has been
+ * written to the base device, after which the base device may be used
+ * again until the next write.
+ */
+class PipelineStream : public LayeredStream
+{
+    Q_OBJECT
+
+public:
+    explicit PipelineStream(QIODevice* baseDevice, int chunkSize = DefaultChunkSize,
+                            int maxChunks = DefaultMaxChunks);
+    ~PipelineStream();
+
+    bool open(QIODevice::OpenMode mode) override;
+    bool reset() override;
+    void close() override;
+    bool atEnd() const override;
+
+    static const int DefaultChunkSize = 1024 * 1024;
+    static const int DefaultMaxChunks = 4;
+
+protected:
+    qint64 readData(char* data, qint64 maxSize) override;
+    qint64 writeData(const char* data, qint64 maxSize) override;
+
+private:
+    friend class PipelineStreamThread;
+
+    void runWorker();
+    void readChunks();
+    void writeChunks();
+    bool queueWriteChunk();
+    bool flush();
+    void stopWorker();
+
+    const int m_chunkSize;
+    const int m_maxChunks;
+    QScopedPointer<QThread> m_thread;
+    mutable QMutex m_mutex;
+    mutable QWaitCondition m_chunkQueued;
+    QWaitCondition m_chunkDequeued;
+    QQueue<QByteArray> m_chunks;
+    int m_chunkPos;
+    QByteArray m_writeChunk;
+    bool m_writeMode;
+    bool m_workerBusy;
+    bool m_workerFinished;
+    bool m_abort;
+    QString m_workerError;
+};
+
+#endif // KEEPASSX_PIPELINESTREAM_H
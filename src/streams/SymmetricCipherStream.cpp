@@ -17,12 +17,31 @@
 
 #include "SymmetricCipherStream.h"
 
+#include <cstring>
+
+namespace {
+    // Round the chunk size down to a multiple of the cipher block size.
+    // At least two blocks are needed so the final (padded) block can be
+    // held back while reading.
+    int alignedChunkSize(int chunkSize, int blockSize)
+    {
+        if (blockSize <= 0) {
+            return chunkSize;
+        }
+
+        chunkSize = qMax(chunkSize, 2 * blockSize);
+        return chunkSize - (chunkSize % blockSize);
+    }
+}
+
 SymmetricCipherStream::SymmetricCipherStream(QIODevice* baseDevice, SymmetricCipher::Algorithm algo,
-                                             SymmetricCipher::Mode mode, SymmetricCipher::Direction direction)
+                                             SymmetricCipher::Mode mode, SymmetricCipher::Direction direction,
+                                             int chunkSize)
     : LayeredStream(baseDevice)
     , m_cipher(new SymmetricCipher(algo, mode, direction))
+    , m_streamCipher(mode == SymmetricCipher::Stream)
+    , m_chunkSize(alignedChunkSize(chunkSize, m_cipher->blockSize()))
     , m_bufferPos(0)
-    , m_bufferFilling(false)
     , m_error(false)
     , m_isInitalized(false)
     , m_dataWritten(false)
@@ -44,11 +63,16 @@ bool SymmetricCipherStream::init(const QByteArray& key, const QByteArray& iv)
     return m_isInitalized;
 }
 
+int SymmetricCipherStream::chunkSize() const
+{
+    return m_chunkSize;
+}
+
 void SymmetricCipherStream::resetInternalState()
 {
     m_buffer.clear();
+    m_readBuffer.clear();
     m_bufferPos = 0;
-    m_bufferFilling = false;
     m_error = false;
     m_dataWritten = false;
     m_cipher->reset();
@@ -66,7 +90,7 @@ bool SymmetricCipherStream::open(QIODevice::OpenMode mode)
 bool SymmetricCipherStream::reset()
 {
     if (isWritable() && m_dataWritten) {
-        if (!writeBlock(true)) {
+        if (!writeChunk(true)) {
             return false;
         }
     }
@@ -79,7 +103,7 @@ bool SymmetricCipherStream::reset()
 void SymmetricCipherStream::close()
 {
     if (isWritable() && m_dataWritten) {
-        writeBlock(true);
+        writeChunk(true);
     }
 
     resetInternalState();
@@ -99,8 +123,8 @@ qint64 SymmetricCipherStream::readData(char* data, qint64 maxSize)
     qint64 offset = 0;
 
     while (bytesRemaining > 0) {
-        if ((m_bufferPos == m_buffer.size()) || m_bufferFilling) {
-            if (!readBlock()) {
+        if (m_bufferPos == m_buffer.size()) {
+            if (!readChunk()) {
                 if (m_error) {
                     return -1;
                 }
@@ -122,69 +146,79 @@ qint64 SymmetricCipherStream::readData(char* data, qint64 maxSize)
     return maxSize;
 }
 
-bool SymmetricCipherStream::readBlock()
+bool SymmetricCipherStream::readChunk()
 {
-    QByteArray newData;
+    const int blockSize = m_cipher->blockSize();
 
-    if (m_bufferFilling) {
-        newData.resize(m_cipher->blockSize() - m_buffer.size());
-    }
-    else {
-        m_buffer.clear();
-        newData.resize(m_cipher->blockSize());
-    }
+    // m_readBuffer may still hold ciphertext left over from the previous chunk:
+    // an incomplete block or the held back last block
+    bool atEnd = false;
+    int processSize = 0;
 
-    int readResult = m_baseDevice->read(newData.data(), newData.size());
+    while (processSize <= 0) {
+        int carry = m_readBuffer.size();
+        m_readBuffer.resize(m_chunkSize + blockSize);
 
-    if (readResult == -1) {
-        m_error = true;
-        setErrorString(m_baseDevice->errorString());
-        return false;
+        qint64 readResult = m_baseDevice->read(m_readBuffer.data() + carry, m_readBuffer.size() - carry);
+
+        if (readResult == -1) {
+            m_readBuffer.resize(carry);
+            m_error = true;
+            setErrorString(m_baseDevice->errorString());
+            return false;
+        }
+
+        m_readBuffer.resize(carry + static_cast<int>(readResult));
+
+        // Only a read that returns nothing marks the end of the stream. Layered
+        // base devices are sequential, so atEnd() can't be trusted for all of them.
+        atEnd = (readResult == 0);
+        processSize = m_readBuffer.size() - (m_readBuffer.size() % blockSize);
+        if (!atEnd && !m_streamCipher) {
+            // The last complete block could be the padded final block of the
+            // stream, so keep it back until we know more data follows.
+            processSize -= blockSize;
+        }
+
+        if (processSize <= 0 && atEnd) {
+            return false;
+        }
+    }
+
+    if (processSize == m_readBuffer.size()) {
+        m_buffer.swap(m_readBuffer);
+        m_readBuffer.clear();
     }
     else {
-        m_buffer.append(newData.left(readResult));
+        m_buffer = m_readBuffer.left(processSize);
+        m_readBuffer.remove(0, processSize);
     }
+    m_bufferPos = 0;
 
-    if (m_buffer.size() != m_cipher->blockSize()) {
-        m_bufferFilling = true;
+    if (!m_cipher->processInPlace(m_buffer)) {
+        m_error = true;
+        setErrorString(m_cipher->errorString());
         return false;
     }
-    else {
-        if (!m_cipher->processInPlace(m_buffer)) {
+
+    if (atEnd && m_readBuffer.isEmpty() && !m_streamCipher) {
+        // PKCS7 padding
+        quint8 padLength = m_buffer.at(m_buffer.size() - 1);
+
+        if (padLength == 0 || padLength > blockSize
+                || m_buffer.right(padLength) != QByteArray(padLength, static_cast<char>(padLength))) {
+            // invalid padding
+            m_buffer.clear();
             m_error = true;
-            setErrorString(m_cipher->errorString());
+            setErrorString("Invalid padding.");
             return false;
         }
-        m_bufferPos = 0;
-        m_bufferFilling = false;
-
-        if (m_baseDevice->atEnd()) {
-            // PKCS7 padding
-            quint8 padLength = m_buffer.at(m_buffer.size() - 1);
-
-            if (padLength == m_cipher->blockSize()) {
-                Q_ASSERT(m_buffer == QByteArray(m_cipher->blockSize(), m_cipher->blockSize()));
-                // full block with just padding: discard
-                m_buffer.clear();
-                return false;
-            }
-            else if (padLength > m_cipher->blockSize()) {
-                // invalid padding
-                m_error = true;
-                setErrorString("Invalid padding.");
-                return false;
-            }
-            else {
-                Q_ASSERT(m_buffer.right(padLength) == QByteArray(padLength, padLength));
-                // resize buffer to strip padding
-                m_buffer.resize(m_cipher->blockSize() - padLength);
-                return true;
-            }
-        }
-        else {
-            return true;
-        }
+
+        // resize buffer to strip padding, a block with just padding is discarded
+        m_buffer.resize(m_buffer.size() - padLength);
     }
+
+    return !m_buffer.isEmpty();
 }
 
 qint64 SymmetricCipherStream::writeData(const char* data, qint64 maxSize)
@@ -200,15 +234,16 @@ qint64 SymmetricCipherStream::writeData(const char* data, qint64 maxSize)
     qint64 offset = 0;
 
     while (bytesRemaining > 0) {
-        int bytesToCopy = qMin(bytesRemaining, static_cast<qint64>(m_cipher->blockSize() - m_buffer.size()));
+        int bytesToCopy = qMin(bytesRemaining, static_cast<qint64>(m_chunkSize - m_buffer.size()));
 
         m_buffer.append(data + offset, bytesToCopy);
 
         offset += bytesToCopy;
         bytesRemaining -= bytesToCopy;
 
-        if (m_buffer.size() == m_cipher->blockSize()) {
-            if (!writeBlock(false)) {
+        // encrypt all complete blocks once the chunk is full or the input is consumed
+        if (m_buffer.size() == m_chunkSize || bytesRemaining == 0) {
+            if (!writeChunk(false)) {
                 if (m_error) {
                     return -1;
                 }
@@ -222,16 +257,30 @@ qint64 SymmetricCipherStream::writeData(const char* data, qint64 maxSize)
     return maxSize;
 }
 
-bool SymmetricCipherStream::writeBlock(bool lastBlock)
+bool SymmetricCipherStream::writeChunk(bool lastBlock)
 {
-    Q_ASSERT(lastBlock || (m_buffer.size() == m_cipher->blockSize()));
+    const int blockSize = m_cipher->blockSize();
+    QByteArray remainder;
 
-    if (lastBlock) {
+    if (lastBlock && m_streamCipher) {
+        // stream ciphers aren't padded
+        if (m_buffer.isEmpty()) {
+            return true;
+        }
+    }
+    else if (lastBlock) {
         // PKCS7 padding
-        int padLen = m_cipher->blockSize() - m_buffer.size();
-        for (int i = 0; i < padLen; i++) {
-            m_buffer.append(static_cast<char>(padLen));
+        int padLen = blockSize - (m_buffer.size() % blockSize);
+        m_buffer.append(QByteArray(padLen, static_cast<char>(padLen)));
+    }
+    else {
+        int processSize = m_buffer.size() - (m_buffer.size() % blockSize);
+        if (processSize == 0) {
+            return true;
         }
+        // an incomplete block stays buffered until more data arrives
+        remainder = m_buffer.mid(processSize);
+        m_buffer.resize(processSize);
     }
 
     if (!m_cipher->processInPlace(m_buffer)) {
@@ -246,7 +295,7 @@ bool SymmetricCipherStream::writeBlock(bool lastBlock)
         return false;
     }
     else {
-        m_buffer.clear();
+        m_buffer = remainder;
         return true;
     }
 }
@@ -29,10 +29,14 @@ class SymmetricCipherStream : public LayeredStream
     Q_OBJECT
 
 public:
+    static const int DefaultChunkSize = 64 * 1024;
+
     SymmetricCipherStream(QIODevice* baseDevice, SymmetricCipher::Algorithm algo,
-                          SymmetricCipher::Mode mode, SymmetricCipher::Direction direction);
+                          SymmetricCipher::Mode mode, SymmetricCipher::Direction direction,
+                          int chunkSize = DefaultChunkSize);
     ~SymmetricCipherStream();
     bool init(const QByteArray& key, const QByteArray& iv);
+    int chunkSize() const;
     bool open(QIODevice::OpenMode mode) override;
     bool reset() override;
     void close() override;
@@ -43,13 +47,15 @@ protected:
 
 private:
     void resetInternalState();
-    bool readBlock();
-    bool writeBlock(bool lastBlock);
+    bool readChunk();
+    bool writeChunk(bool lastBlock);
 
     const QScopedPointer<SymmetricCipher> m_cipher;
+    const bool m_streamCipher;
+    const int m_chunkSize;
     QByteArray m_buffer;
+    QByteArray m_readBuffer;
     int m_bufferPos;
-    bool m_bufferFilling;
     bool m_error;
     bool m_isInitalized;
     bool m_dataWritten;
@@ -160,6 +160,35 @@ void TestAutoType::testAutoTypeWithSequence()
              .arg(m_entry1->password()));
 }
 
+void TestAutoType::testAutoTypeSequenceChanges()
+{
+    m_autoType->performAutoType(m_entry1, nullptr);
+    QCOMPARE(m_test->actionChars(),
+             QString("myuser%1mypass%2")
+             .arg(m_test->keyToString(Qt::Key_Tab))
+             .arg(m_test->keyToString(Qt::Key_Enter)));
+    m_test->clearActions();
+
+    // placeholders are resolved every time the sequence is typed
+    m_entry1->setUsername("otheruser");
+    m_autoType->performAutoType(m_entry1, nullptr);
+    QCOMPARE(m_test->actionChars(),
+             QString("otheruser%1mypass%2")
+             .arg(m_test->keyToString(Qt::Key_Tab))
+             .arg(m_test->keyToString(Qt::Key_Enter)));
+    m_test->clearActions();
+
+    // the effective sequence follows changes of the groups
+    m_group->setDefaultAutoTypeSequence("{PASSWORD}{ENTER}");
+    m_autoType->performAutoType(m_entry1, nullptr);
+    QCOMPARE(m_test->actionChars(), QString("mypass%1").arg(m_test->keyToString(Qt::Key_Enter)));
+    m_test->clearActions();
+
+    m_entry1->setDefaultAutoTypeSequence("{USERNAME}");
+    m_autoType->performAutoType(m_entry1, nullptr);
+    QCOMPARE(m_test->actionChars(), QString("otheruser"));
+}
+
 void TestAutoType::testGlobalAutoTypeWithNoMatch()
 {
     m_test->setActiveWindowTitle("nomatch");
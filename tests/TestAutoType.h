@@ -40,6 +40,7 @@ private slots:
     void testInternal();
     void testAutoTypeWithoutSequence();
     void testAutoTypeWithSequence();
+    void testAutoTypeSequenceChanges();
     void testGlobalAutoTypeWithNoMatch();
     void testGlobalAutoTypeWithOneMatch();
     void testGlobalAutoTypeTitleMatch();
@@ -0,0 +1,159 @@
+/*
+ *  Copyright (C) 2017 KeePassXC Team <team@keepassxc.org>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 or (at your option)
+ *  version 3 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TestAutoTypeXCB.h"
+
+#include <QGuiApplication>
+#include <QLineEdit>
+#include <QPluginLoader>
+#include <QTest>
+
+#include "autotype/AutoTypeAction.h"
+#include "autotype/AutoTypePlatformPlugin.h"
+#include "core/FilePath.h"
+
+QTEST_MAIN(TestAutoTypeXCB)
+
+namespace {
+    bool benchmarkEnabled()
+    {
+        QByteArray env = qgetenv("BENCHMARK");
+        return !(env.isEmpty() || env == "0" || env == "no");
+    }
+
+    const QString BenchmarkText = QString("The quick brown fox jumps over the lazy dog 0123456789 !\"#$%&'()*+,-./").repeated(4);
+}
+
+/**
+ * Types into a real window, so this needs an X server. Run it headless with
+ * xvfb-run, e.g. "BENCHMARK=1 xvfb-run -a ./testautotypexcb".
+ */
+void TestAutoTypeXCB::initTestCase()
+{
+    m_platform = nullptr;
+    m_executor = nullptr;
+
+    if (QGuiApplication::platformName() != "xcb") {
+        QSKIP("Auto-Type tests need an X server.");
+    }
+
+    QPluginLoader loader(filePath()->pluginPath("keepassx-autotype-xcb"));
+    loader.setLoadHints(QLibrary::ResolveAllSymbolsHint);
+    m_platform = qobject_cast<AutoTypePlatformInterface*>(loader.instance());
+    if (!m_platform || !m_platform->isAvailable()) {
+        QSKIP("The XCB Auto-Type plugin isn't available.");
+    }
+
+    m_executor = m_platform->createExecutor();
+
+    m_lineEdit = new QLineEdit();
+    m_lineEdit->show();
+    m_lineEdit->activateWindow();
+    QVERIFY(QTest::qWaitForWindowActive(m_lineEdit));
+}
+
+void TestAutoTypeXCB::init()
+{
+    m_lineEdit->clear();
+    m_lineEdit->setFocus();
+}
+
+void TestAutoTypeXCB::cleanupTestCase()
+{
+    delete m_lineEdit;
+    delete m_executor;
+    if (m_platform) {
+        m_platform->unload();
+    }
+}
+
+void TestAutoTypeXCB::testTypeText()
+{
+    const QString text = QString::fromUtf8("Hello, World! \xc3\xa4\xc3\xb6\xc3\xbc \xe2\x82\xac \xce\xb1\xce\xb2\xce\xb3");
+
+    typeText(text, true);
+    QTRY_COMPARE(m_lineEdit->text(), text);
+
+    /* the keycodes mapped for the previous batch are reused */
+    const QString other = QString::fromUtf8("\xc5\x82\xc4\x99 ok");
+    m_lineEdit->clear();
+    typeText(other, true);
+    QTRY_COMPARE(m_lineEdit->text(), other);
+}
+
+void TestAutoTypeXCB::testTypeMixedCase()
+{
+    /* Shift is pressed for the upper case keys only and must not stick */
+    const QString text("aBcDeFgHiJ aB1!2@");
+
+    typeText(text, true);
+    QTRY_COMPARE(m_lineEdit->text(), text);
+}
+
+void TestAutoTypeXCB::testTypeTextUnbatched()
+{
+    const QString text = QString::fromUtf8("Hello, World! \xc3\xa4\xc3\xb6\xc3\xbc");
+
+    typeText(text, false);
+    QTRY_COMPARE(m_lineEdit->text(), text);
+}
+
+void TestAutoTypeXCB::benchmarkTypeText()
+{
+    if (!benchmarkEnabled()) {
+        QSKIP("Benchmark skipped. Set env variable BENCHMARK=1 to enable.");
+    }
+
+    QBENCHMARK {
+        m_lineEdit->clear();
+        typeText(BenchmarkText, true);
+        QTRY_COMPARE(m_lineEdit->text(), BenchmarkText);
+    }
+}
+
+void TestAutoTypeXCB::benchmarkTypeTextUnbatched()
+{
+    if (!benchmarkEnabled()) {
+        QSKIP("Benchmark skipped. Set env variable BENCHMARK=1 to enable.");
+    }
+
+    QBENCHMARK {
+        m_lineEdit->clear();
+        typeText(BenchmarkText, false);
+        QTRY_COMPARE(m_lineEdit->text(), BenchmarkText);
+    }
+}
+
+void TestAutoTypeXCB::typeText(const QString& text, bool batched)
+{
+    QList<AutoTypeAction*> actions;
+    for (const QChar& ch : text) {
+        actions.append(new AutoTypeChar(ch));
+    }
+
+    if (batched) {
+        m_executor->prepare(actions);
+    }
+    for (AutoTypeAction* action : asConst(actions)) {
+        action->accept(m_executor);
+    }
+    if (batched) {
+        m_executor->finish();
+    }
+
+    qDeleteAll(actions);
+}
@@ -45,3 +45,29 @@ void TestCryptoHash::test()
     QCOMPARE(cryptoHash3.result(),
              QByteArray::fromHex("0b56e5f65263e747af4a833bd7dd7ad26a64d7a4de7c68e52364893dca0766b4"));
 }
+
+void TestCryptoHash::testSha512()
+{
+    CryptoHash cryptoHash1(CryptoHash::Sha512);
+    QCOMPARE(cryptoHash1.result(),
+             QByteArray::fromHex("cf83e1357eefb8bdf1542850d66d8007d620e4050b5715dc83f4a921d36ce9ce"
+                                 "47d0d13c5d85f2b0ff8318d2877eec2f63b931bd47417a81a538327af927da3e"));
+}
+
+void TestCryptoHash::testHmac()
+{
+    // RFC 4231 test case 2
+    QByteArray key("Jefe");
+    QByteArray data("what do ya want for nothing?");
+
+    QCOMPARE(CryptoHash::hmac(data, key, CryptoHash::Sha256),
+             QByteArray::fromHex("5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843"));
+
+    CryptoHash cryptoHash(CryptoHash::Sha512, true);
+    cryptoHash.setKey(key);
+    cryptoHash.addData(data.left(10));
+    cryptoHash.addData(data.mid(10));
+    QCOMPARE(cryptoHash.result(),
+             QByteArray::fromHex("164b7a7bfcf819e2e395fbe73b56e0a387bd64222e831fd610270cd7ea250554"
+                                 "9758bf75c05a994a6d034f65f8f0e6fdcaeab1a34d4a6b4b636e070a38bce737"));
+}
@@ -27,6 +27,8 @@ class TestCryptoHash : public QObject
 private slots:
     void initTestCase();
     void test();
+    void testSha512();
+    void testHmac();
 };
 
 #endif // KEEPASSX_TESTCRYPTOHASH_H
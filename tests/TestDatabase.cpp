@@ -18,16 +18,24 @@
 
 #include "TestDatabase.h"
 
+#include <QBuffer>
 #include <QTest>
 #include <QSignalSpy>
 #include <QTemporaryFile>
 
 #include "config-keepassx-tests.h"
 #include "core/Database.h"
+#include "core/AttachmentIndex.h"
+#include "core/AutoTypeIndex.h"
+#include "core/Entry.h"
+#include "core/EntryAttachments.h"
+#include "core/HostIndex.h"
 #include "crypto/Crypto.h"
 #include "keys/PasswordKey.h"
 #include "core/Metadata.h"
 #include "core/Group.h"
+#include "core/Uuid.h"
+#include "format/KeePass2Reader.h"
 #include "format/KeePass2Writer.h"
 
 QTEST_GUILESS_MAIN(TestDatabase)
@@ -111,3 +119,219 @@ void TestDatabase::testEmptyRecycleBinWithHierarchicalData()
 
     delete db;
 }
+
+void TestDatabase::testPrecomputedKey()
+{
+    CompositeKey key;
+    key.addKey(PasswordKey("test"));
+
+    Database db;
+    QVERIFY(db.setTransformRounds(1000));
+    QVERIFY(db.setKey(key));
+
+    db.precomputeNextKey();
+    QByteArray oldSeed = db.transformSeed();
+    QVERIFY(db.transformKeyWithNewSeed());
+    QVERIFY(db.transformSeed() != oldSeed);
+
+    QByteArray expectedKey;
+    QVERIFY(key.transform(*db.kdf(), expectedKey, nullptr));
+    QCOMPARE(db.transformedMasterKey(), expectedKey);
+
+    // a key change discards the precomputed key
+    CompositeKey newKey;
+    newKey.addKey(PasswordKey("new"));
+    db.precomputeNextKey();
+    QVERIFY(db.setKey(newKey));
+    QVERIFY(db.transformKeyWithNewSeed());
+    QVERIFY(newKey.transform(*db.kdf(), expectedKey, nullptr));
+    QCOMPARE(db.transformedMasterKey(), expectedKey);
+
+    // the database has to open with the key the writer got from the precomputation
+    db.precomputeNextKey();
+    QBuffer buffer;
+    QVERIFY(buffer.open(QBuffer::ReadWrite));
+    KeePass2Writer writer;
+    writer.writeDatabase(&buffer, &db);
+    QVERIFY(!writer.hasError());
+
+    buffer.seek(0);
+    KeePass2Reader reader;
+    QScopedPointer<Database> dbRead(reader.readDatabase(&buffer, newKey));
+    QVERIFY(dbRead);
+    QVERIFY(!reader.hasError());
+}
+
+void TestDatabase::testHostIndex()
+{
+    Database db;
+    HostIndex* index = db.hostIndex();
+
+    Entry* exact = new Entry();
+    exact->setUuid(Uuid::random());
+    exact->setUrl("https://login.example.com/signin");
+    exact->setGroup(db.rootGroup());
+
+    Entry* parent = new Entry();
+    parent->setUuid(Uuid::random());
+    parent->setTitle("example.com");
+    parent->setGroup(db.rootGroup());
+
+    Entry* other = new Entry();
+    other->setUuid(Uuid::random());
+    other->setTitle("Bad example");
+    other->setUrl("https://badexample.com");
+    other->setGroup(db.rootGroup());
+
+    QVector<QList<Entry*>> result = index->findEntries("login.example.com");
+    QCOMPARE(result.size(), 3);
+    QCOMPARE(result[0], QList<Entry*>() << exact);
+    QCOMPARE(result[1], QList<Entry*>() << parent);
+    QVERIFY(result[2].isEmpty());
+
+    QVERIFY(index->findEntries("example.org")[0].isEmpty());
+    QVERIFY(index->findEntries(QString()).isEmpty());
+
+    // changed and removed entries are reindexed
+    parent->setTitle("Example site");
+    parent->setUrl("https://www.example.com");
+    result = index->findEntries("www.example.com");
+    QCOMPARE(result[0], QList<Entry*>() << parent);
+    QVERIFY(result[1].isEmpty());
+
+    delete exact;
+    QVERIFY(index->findEntries("login.example.com")[0].isEmpty());
+
+    // urls with placeholders are resolved on every lookup
+    Entry* reference = new Entry();
+    reference->setUuid(Uuid::random());
+    reference->setUrl(QString("{REF:A@I:%1}").arg(other->uuid().toHex()));
+    reference->setGroup(db.rootGroup());
+    QCOMPARE(index->findEntries("badexample.com")[0], QList<Entry*>() << other << reference);
+
+    other->setUrl("https://example.net");
+    QCOMPARE(index->findEntries("example.net")[0], QList<Entry*>() << other << reference);
+    QVERIFY(index->findEntries("badexample.com")[0].isEmpty());
+
+    // single label titles don't match, they would be offered to any host
+    // containing that label
+    Entry* label = new Entry();
+    label->setUuid(Uuid::random());
+    label->setTitle("Google");
+    label->setGroup(db.rootGroup());
+    for (const QString& host : {"google.attacker.com", "login.google.phish.net", "google.com"}) {
+        result = index->findEntries(host);
+        for (const QList<Entry*>& entries : result) {
+            QVERIFY(!entries.contains(label));
+        }
+    }
+}
+
+void TestDatabase::testAttachmentIndex()
+{
+    Database db;
+    AttachmentIndex* index = db.attachmentIndex();
+
+    Entry* first = new Entry();
+    first->setUuid(Uuid::random());
+    first->attachments()->set("KeeAgent.settings", QByteArray("settings"));
+    first->setGroup(db.rootGroup());
+
+    Entry* plain = new Entry();
+    plain->setUuid(Uuid::random());
+    plain->setGroup(db.rootGroup());
+
+    Entry* second = new Entry();
+    second->setUuid(Uuid::random());
+    second->attachments()->set("KeeAgent.settings", QByteArray("settings"));
+    second->attachments()->set("id_rsa", QByteArray("key"));
+    second->setGroup(db.rootGroup());
+
+    QCOMPARE(index->findEntries("KeeAgent.settings"), QList<Entry*>() << first << second);
+    QCOMPARE(index->findEntries("id_rsa"), QList<Entry*>() << second);
+    QVERIFY(index->findEntries("missing").isEmpty());
+
+    // changed and removed entries are reindexed
+    plain->attachments()->set("KeeAgent.settings", QByteArray("settings"));
+    first->attachments()->remove("KeeAgent.settings");
+    QCOMPARE(index->findEntries("KeeAgent.settings"), QList<Entry*>() << plain << second);
+
+    delete second;
+    QCOMPARE(index->findEntries("KeeAgent.settings"), QList<Entry*>() << plain);
+    QVERIFY(index->findEntries("id_rsa").isEmpty());
+}
+
+void TestDatabase::testAutoTypeIndex()
+{
+    Database db;
+    AutoTypeIndex* index = db.autoTypeIndex();
+
+    auto findEntries = [index](const QString& windowTitle, bool matchTitle) {
+        QList<Entry*> entries;
+        const QList<AutoTypeIndex::Match> matches = index->findEntries(windowTitle, matchTitle, false);
+        for (const AutoTypeIndex::Match& match : matches) {
+            entries.append(match.entry);
+        }
+        return entries;
+    };
+
+    AutoTypeAssociations::Association association;
+
+    Entry* wildcard = new Entry();
+    wildcard->setUuid(Uuid::random());
+    wildcard->setTitle("Mail");
+    association.window = "*Mozilla Firefox";
+    association.sequence = "firefox";
+    wildcard->autoTypeAssociations()->add(association);
+    association.window = "Inbox*Mail*";
+    association.sequence = "inbox";
+    wildcard->autoTypeAssociations()->add(association);
+    wildcard->setGroup(db.rootGroup());
+
+    Entry* exact = new Entry();
+    exact->setUuid(Uuid::random());
+    association.window = "inbox - mail";
+    association.sequence = QString();
+    exact->autoTypeAssociations()->add(association);
+    exact->setGroup(db.rootGroup());
+
+    Entry* regExp = new Entry();
+    regExp->setUuid(Uuid::random());
+    association.window = "//^(Inbox|Outbox)//";
+    association.sequence = "regexp";
+    regExp->autoTypeAssociations()->add(association);
+    regExp->setGroup(db.rootGroup());
+
+    QList<AutoTypeIndex::Match> matches = index->findEntries("Inbox - Mail", false, false);
+    QCOMPARE(matches.size(), 3);
+    QCOMPARE(matches[0].entry, wildcard);
+    QCOMPARE(matches[0].sequence, QString("inbox"));
+    QCOMPARE(matches[1].entry, exact);
+    QVERIFY(matches[1].sequence.isEmpty());
+    QCOMPARE(matches[2].entry, regExp);
+    QCOMPARE(matches[2].sequence, QString("regexp"));
+
+    // the first matching association wins
+    matches = index->findEntries("Inbox Mail - Mozilla Firefox", false, false);
+    QCOMPARE(matches.size(), 2);
+    QCOMPARE(matches[0].sequence, QString("firefox"));
+
+    QCOMPARE(findEntries("Outbox", false), QList<Entry*>() << regExp);
+    QVERIFY(findEntries("Mozilla Firefox - Mail", false).isEmpty());
+    QCOMPARE(findEntries("Mozilla Firefox - Mail", true), QList<Entry*>() << wildcard);
+    QVERIFY(findEntries(QString(), false).isEmpty());
+
+    // changed and removed entries are recompiled
+    exact->autoTypeAssociations()->remove(0);
+    delete regExp;
+    QCOMPARE(findEntries("Inbox - Mail", false), QList<Entry*>() << wildcard);
+
+    // window patterns with placeholders are resolved on every lookup
+    Entry* placeholder = new Entry();
+    placeholder->setUuid(Uuid::random());
+    placeholder->setTitle("Bank");
+    association.window = "{TITLE} - *";
+    placeholder->autoTypeAssociations()->add(association);
+    placeholder->setGroup(db.rootGroup());
+    QCOMPARE(findEntries("Bank - Login", false), QList<Entry*>() << placeholder);
+}
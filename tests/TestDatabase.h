@@ -31,6 +31,10 @@ private slots:
     void testEmptyRecycleBinOnNotCreated();
     void testEmptyRecycleBinOnEmpty();
     void testEmptyRecycleBinWithHierarchicalData();
+    void testPrecomputedKey();
+    void testHostIndex();
+    void testAttachmentIndex();
+    void testAutoTypeIndex();
 };
 
 #endif // KEEPASSX_TESTDATABASE_H
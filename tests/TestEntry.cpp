@@ -24,6 +24,7 @@
 #include "core/Entry.h"
 #include "core/Group.h"
 #include "crypto/Crypto.h"
+#include "format/KeePass2RandomStream.h"
 
 QTEST_GUILESS_MAIN(TestEntry)
 
@@ -356,6 +357,135 @@ void TestEntry::testResolveReferencePlaceholders()
     QCOMPARE(tstEntry->resolveMultiplePlaceholders(QString("{REF:n@i:%1}").arg(entry3->uuid().toHex().toLower())), entry3->attributes()->value("AttributeNotes"));
 }
 
+void TestEntry::testResolveReferenceIndex()
+{
+    Database db;
+    Group* root = db.rootGroup();
+
+    Group* group = new Group();
+    group->setUuid(Uuid::random());
+    group->setParent(root);
+
+    Entry* entry1 = new Entry();
+    entry1->setUuid(Uuid::random());
+    entry1->setGroup(group);
+    entry1->setTitle("Entry1");
+    entry1->setUsername("shared");
+
+    Entry* entry2 = new Entry();
+    entry2->setUuid(Uuid::random());
+    entry2->setGroup(root);
+    entry2->setTitle("Entry2");
+    entry2->setUsername("shared");
+
+    Entry* tstEntry = new Entry();
+    tstEntry->setUuid(Uuid::random());
+    tstEntry->setGroup(root);
+
+    // entries of a group come before the entries of its children
+    QCOMPARE(tstEntry->resolveMultiplePlaceholders("{REF:T@U:shared}"), QString("Entry2"));
+    QCOMPARE(tstEntry->resolveMultiplePlaceholders("{REF:T@U:other}"), QString());
+
+    // the lookup tables follow changes of the entries
+    entry2->setUsername("other");
+    QCOMPARE(tstEntry->resolveMultiplePlaceholders("{REF:T@U:shared}"), QString("Entry1"));
+    QCOMPARE(tstEntry->resolveMultiplePlaceholders("{REF:T@U:other}"), QString("Entry2"));
+
+    entry1->attributes()->set("Custom", "custom value");
+    QCOMPARE(tstEntry->resolveMultiplePlaceholders("{REF:T@O:custom value}"), QString("Entry1"));
+    entry1->attributes()->rename("Custom", "Renamed");
+    QCOMPARE(tstEntry->resolveMultiplePlaceholders("{REF:T@O:custom value}"), QString("Entry1"));
+    entry1->attributes()->remove("Renamed");
+    QCOMPARE(tstEntry->resolveMultiplePlaceholders("{REF:T@O:custom value}"), QString());
+
+    Entry* entry3 = new Entry();
+    entry3->setUuid(Uuid::random());
+    entry3->setGroup(root);
+    entry3->setTitle("Entry3");
+    entry3->setUsername("shared");
+    QCOMPARE(tstEntry->resolveMultiplePlaceholders("{REF:T@U:shared}"), QString("Entry3"));
+
+    delete entry3;
+    QCOMPARE(tstEntry->resolveMultiplePlaceholders("{REF:T@U:shared}"), QString("Entry1"));
+
+    delete group;
+    QCOMPARE(tstEntry->resolveMultiplePlaceholders("{REF:T@U:shared}"), QString());
+}
+
+void TestEntry::testResolveCachedPlaceholders()
+{
+    Database db;
+    Group* root = db.rootGroup();
+
+    Entry* entry1 = new Entry();
+    entry1->setGroup(root);
+    entry1->setUuid(Uuid::random());
+    entry1->setTitle("Entry1Title");
+    entry1->setPassword("{S:Secret}");
+    entry1->attributes()->set("Secret", "SecretValue", true);
+
+    Entry* entry2 = new Entry();
+    entry2->setGroup(root);
+    entry2->setUuid(Uuid::random());
+    entry2->setTitle("Entry2Title");
+    entry2->setPassword(QString("{REF:P@I:%1}").arg(entry1->uuid().toHex()));
+
+    Entry* entry3 = new Entry();
+    entry3->setGroup(root);
+    entry3->setUuid(Uuid::random());
+    entry3->setTitle("{REF:T@U:shared}");
+    entry3->setPassword(QString("{REF:P@I:%1}").arg(entry2->uuid().toHex()));
+    entry3->setNotes("{}{a{TITLE} {S:Plain}{ {UNKNOWN}}");
+    entry3->attributes()->set("Plain", "plain");
+
+    QCOMPARE(entry3->resolveMultiplePlaceholders(entry3->password()), QString("SecretValue"));
+    QCOMPARE(entry3->resolveMultiplePlaceholders(entry3->title()), QString());
+    QCOMPARE(entry3->resolvePlaceholder(entry3->password()), QString("SecretValue"));
+    QCOMPARE(entry3->resolveMultiplePlaceholders(entry3->notes()),
+             QString("{}{a{TITLE} plain{ {UNKNOWN}}"));
+
+    // resolving again gives the same results
+    QCOMPARE(entry3->resolveMultiplePlaceholders(entry3->password()), QString("SecretValue"));
+    QCOMPARE(entry3->resolveMultiplePlaceholders(entry3->title()), QString());
+    QCOMPARE(entry3->resolvePlaceholder(entry3->password()), QString("SecretValue"));
+
+    // changes of indirectly referenced entries are picked up
+    entry1->attributes()->set("Secret", "OtherValue", true);
+    QCOMPARE(entry3->resolveMultiplePlaceholders(entry3->password()), QString("OtherValue"));
+    QCOMPARE(entry3->resolvePlaceholder(entry3->password()), QString("OtherValue"));
+
+    entry2->setUuid(Uuid::random());
+    QCOMPARE(entry3->resolveMultiplePlaceholders(entry3->password()), QString());
+
+    entry3->setPassword(QString("{REF:P@I:%1}").arg(entry2->uuid().toHex()));
+    QCOMPARE(entry3->resolveMultiplePlaceholders(entry3->password()), QString("OtherValue"));
+
+    // so are entries which start to match a reference
+    entry1->setUsername("shared");
+    QCOMPARE(entry3->resolveMultiplePlaceholders(entry3->title()), QString("Entry1Title"));
+
+    entry2->setUsername("shared");
+    Group* group = new Group();
+    group->setParent(root, 0);
+    entry2->setGroup(group);
+    QCOMPARE(entry3->resolveMultiplePlaceholders(entry3->title()), QString("Entry1Title"));
+
+    // root entries come before the entries of subgroups
+    entry1->setGroup(group);
+    QCOMPARE(entry3->resolveMultiplePlaceholders(entry3->title()), QString("Entry2Title"));
+
+    delete entry2;
+    QCOMPARE(entry3->resolveMultiplePlaceholders(entry3->title()), QString("Entry1Title"));
+    QCOMPARE(entry3->resolveMultiplePlaceholders(entry3->password()), QString());
+
+    // the cache is bounded, values resolve the same once it has been dropped
+    for (int i = 0; i < 2 * Entry::MaxResolvedValues; i++) {
+        QCOMPARE(entry3->resolveMultiplePlaceholders(QString("%1 {S:Plain}").arg(i)), QString("%1 plain").arg(i));
+    }
+    QCOMPARE(entry3->resolveMultiplePlaceholders("0 {S:Plain}"), QString("0 plain"));
+    QCOMPARE(entry3->resolveMultiplePlaceholders(entry3->title()), QString("Entry1Title"));
+}
+
 void TestEntry::testResolveNonIdPlaceholdersToUuid()
 {
     Database db;
@@ -503,3 +633,45 @@ void TestEntry::testResolveClonedEntry()
     QCOMPARE(cclone4->resolveMultiplePlaceholders(cclone4->username()), original->username());
     QCOMPARE(cclone4->resolveMultiplePlaceholders(cclone4->password()), original->password());
 }
+
+void TestEntry::testEncryptedAttributes()
+{
+    const QByteArray streamKey(32, '\x42');
+    QSharedPointer<KeePass2RandomStream> randomStream(new KeePass2RandomStream());
+    QVERIFY(randomStream->init(streamKey));
+
+    KeePass2RandomStream encryptStream;
+    QVERIFY(encryptStream.init(streamKey));
+    encryptStream.seek(100);
+    QCOMPARE(encryptStream.position(), qint64(100));
+    QByteArray ciphertext = QString::fromUtf8("secr\xc3\xa9t").toUtf8();
+    QVERIFY(encryptStream.processInPlace(ciphertext));
+
+    Entry* entry = new Entry();
+    entry->attributes()->setEncrypted(EntryAttributes::PasswordKey, ciphertext, randomStream, 100);
+    entry->attributes()->setEncrypted("custom", ciphertext, randomStream, 100);
+
+    QCOMPARE(entry->password(), QString::fromUtf8("secr\xc3\xa9t"));
+    QCOMPARE(entry->attributes()->value("custom"), QString::fromUtf8("secr\xc3\xa9t"));
+    QVERIFY(entry->attributes()->isProtected("custom"));
+    QVERIFY(entry->attributes()->containsValue(QString::fromUtf8("secr\xc3\xa9t")));
+
+    // decrypted values are cached, so the stream isn't needed anymore
+    QVERIFY(randomStream->init(QByteArray(32, '\x43')));
+    QCOMPARE(entry->password(), QString::fromUtf8("secr\xc3\xa9t"));
+    QCOMPARE(entry->attributes()->value("custom"), QString::fromUtf8("secr\xc3\xa9t"));
+
+    // clones share the encrypted value
+    QScopedPointer<Entry> clone(entry->clone(Entry::CloneNoFlags));
+    QVERIFY(*clone->attributes() == *entry->attributes());
+    QCOMPARE(clone->attributes()->value("custom"), entry->attributes()->value("custom"));
+
+    entry->attributes()->rename("custom", "renamed");
+    QCOMPARE(entry->attributes()->value("renamed"), QString::fromUtf8("secr\xc3\xa9t"));
+
+    entry->setPassword("plain");
+    QCOMPARE(entry->password(), QString("plain"));
+    QVERIFY(*clone->attributes() != *entry->attributes());
+
+    delete entry;
+}
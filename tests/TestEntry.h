@@ -35,8 +35,11 @@ private slots:
     void testResolveUrlPlaceholders();
     void testResolveRecursivePlaceholders();
     void testResolveReferencePlaceholders();
+    void testResolveReferenceIndex();
+    void testResolveCachedPlaceholders();
     void testResolveNonIdPlaceholdersToUuid();
     void testResolveClonedEntry();
+    void testEncryptedAttributes();
 };
 
 #endif // KEEPASSX_TESTENTRY_H
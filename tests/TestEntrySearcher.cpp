@@ -17,12 +17,19 @@
 
 #include "TestEntrySearcher.h"
 
+#include <QSignalSpy>
 #include <QTest>
 
+#include "core/AsyncEntrySearcher.h"
+#include "core/Database.h"
+#include "crypto/Crypto.h"
+
 QTEST_GUILESS_MAIN(TestEntrySearcher)
 
 void TestEntrySearcher::initTestCase()
 {
+    QVERIFY(Crypto::init());
+
     m_groupRoot = new Group();
 }
 
@@ -140,3 +147,149 @@ void TestEntrySearcher::testAllAttributesAreSearched()
     m_searchResult = m_entrySearcher.search("testTitle testUsername testUrl testNote", m_groupRoot, Qt::CaseInsensitive);
     QCOMPARE(m_searchResult.count(), 1);
 }
+
+void TestEntrySearcher::testIndexedSearch()
+{
+    Database db;
+    Group* root = db.rootGroup();
+
+    Group* group1 = new Group();
+    group1->setParent(root);
+    group1->setSearchingEnabled(Group::Disable);
+    Group* group11 = new Group();
+    group11->setParent(group1);
+    group11->setSearchingEnabled(Group::Enable);
+    Group* group2 = new Group();
+    group2->setParent(root);
+    Group* group21 = new Group();
+    group21->setParent(group2);
+    group21->setSearchingEnabled(Group::Disable);
+    Group* group3 = new Group();
+    group3->setParent(root);
+
+    // enough other entries that results are sorted instead of walking the tree
+    for (int i = 0; i < 500; ++i) {
+        Entry* entry = new Entry();
+        entry->setTitle(QString("Entry %1").arg(i));
+        entry->setGroup(group3);
+    }
+
+    Entry* eRoot = new Entry();
+    eRoot->setUuid(Uuid::random());
+    eRoot->setTitle("Search Term");
+    eRoot->setGroup(root);
+
+    Entry* e1 = new Entry();
+    e1->setNotes("search term");
+    e1->setGroup(group1);
+
+    Entry* e11 = new Entry();
+    e11->setUrl("https://search.example.com/TERM");
+    e11->setGroup(group11);
+
+    Entry* e2 = new Entry();
+    e2->setUsername("term");
+    e2->setGroup(group2);
+
+    Entry* e21 = new Entry();
+    e21->setTitle("other");
+    e21->setGroup(group21);
+
+    Entry* eRef = new Entry();
+    eRef->setUuid(Uuid::random());
+    eRef->setGroup(root);
+    eRef->setTitle(QString("{REF:T@I:%1}").arg(eRoot->uuid().toHex()));
+
+    m_searchResult = m_entrySearcher.search("search term", root, Qt::CaseInsensitive);
+    QCOMPARE(m_searchResult, QList<Entry*>() << eRoot << eRef);
+
+    m_searchResult = m_entrySearcher.search("search term", root, Qt::CaseSensitive);
+    QCOMPARE(m_searchResult, QList<Entry*>());
+
+    m_searchResult = m_entrySearcher.search("search term", group11, Qt::CaseInsensitive);
+    QCOMPARE(m_searchResult, QList<Entry*>() << e11);
+
+    m_searchResult = m_entrySearcher.search("te", root, Qt::CaseInsensitive);
+    QCOMPARE(m_searchResult, QList<Entry*>() << eRoot << eRef << e2);
+
+    // the index follows changes of entries and groups
+    group2->setName("Term Group");
+    m_searchResult = m_entrySearcher.search("term", root, Qt::CaseInsensitive);
+    QCOMPARE(m_searchResult, QList<Entry*>() << eRoot << eRef << e2 << e21);
+
+    group2->setName("Group");
+    e2->setUsername("user");
+    eRoot->setTitle("Other Title");
+    m_searchResult = m_entrySearcher.search("term", root, Qt::CaseInsensitive);
+    QCOMPARE(m_searchResult, QList<Entry*>());
+    m_searchResult = m_entrySearcher.search("other", root, Qt::CaseInsensitive);
+    QCOMPARE(m_searchResult, QList<Entry*>() << eRoot << eRef);
+
+    e21->setGroup(group2);
+    m_searchResult = m_entrySearcher.search("other", root, Qt::CaseInsensitive);
+    QCOMPARE(m_searchResult, QList<Entry*>() << eRoot << eRef << e21);
+
+    delete eRoot;
+    m_searchResult = m_entrySearcher.search("other", root, Qt::CaseInsensitive);
+    QCOMPARE(m_searchResult, QList<Entry*>() << e21);
+}
+
+void TestEntrySearcher::testAsyncSearch()
+{
+    Database db;
+    Group* root = db.rootGroup();
+
+    Group* disabledGroup = new Group();
+    disabledGroup->setParent(root);
+    disabledGroup->setSearchingEnabled(Group::Disable);
+    Group* matchingGroup = new Group();
+    matchingGroup->setName("Entry Group");
+    matchingGroup->setParent(root);
+
+    // enough entries to be split into several partitions
+    for (int i = 0; i < 3000; ++i) {
+        Entry* entry = new Entry();
+        entry->setTitle(QString("Entry %1").arg(i));
+        entry->setUsername(QString("user%1").arg(i % 7));
+        entry->setGroup(i % 3 == 0 ? root : (i % 3 == 1 ? disabledGroup : matchingGroup));
+    }
+
+    AsyncEntrySearcher searcher;
+    QList<Entry*> results;
+    connect(&searcher, &AsyncEntrySearcher::entriesFound, [&results](const QList<Entry*>& entries) {
+        results.append(entries);
+    });
+    QSignalSpy finishedSpy(&searcher, SIGNAL(finished()));
+
+    const QStringList searchTerms = QStringList() << "entry" << "entry 1" << "entry 12 user3" << "user" << "12"
+                                                  << "ENTRY 2" << "group" << "nothing";
+    for (const QString& searchTerm : searchTerms) {
+        results.clear();
+        finishedSpy.clear();
+        searcher.search(searchTerm, root, Qt::CaseInsensitive);
+        QVERIFY(searcher.isSearching());
+        QVERIFY(finishedSpy.wait());
+        QVERIFY(!searcher.isSearching());
+        QCOMPARE(results, m_entrySearcher.search(searchTerm, root, Qt::CaseInsensitive));
+    }
+
+    // a new search replaces the running one
+    results.clear();
+    finishedSpy.clear();
+    searcher.search("entry", root, Qt::CaseSensitive);
+    searcher.search("Entry 3", root, Qt::CaseSensitive);
+    QVERIFY(finishedSpy.wait());
+    QCOMPARE(results, m_entrySearcher.search("Entry 3", root, Qt::CaseSensitive));
+    QTest::qWait(50);
+    QCOMPARE(finishedSpy.count(), 1);
+
+    // changes of the database are picked up when narrowing down the results
+    results.clear();
+    finishedSpy.clear();
+    Entry* entry = new Entry();
+    entry->setTitle("Entry 3 added");
+    entry->setGroup(root);
+    searcher.search("Entry 3 add", root, Qt::CaseSensitive);
+    QVERIFY(finishedSpy.wait());
+    QCOMPARE(results, QList<Entry*>() << entry);
+}
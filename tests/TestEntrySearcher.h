@@ -35,6 +35,8 @@ private slots:
     void testAndConcatenationInSearch();
     void testSearch();
     void testAllAttributesAreSearched();
+    void testIndexedSearch();
+    void testAsyncSearch();
 
 private:
     Group* m_groupRoot;
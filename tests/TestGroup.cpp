@@ -531,6 +531,114 @@ void TestGroup::testFindEntry()
     QVERIFY(entry == nullptr);
 }
 
+void TestGroup::testUuidIndex()
+{
+    QScopedPointer<Database> db(new Database());
+    QScopedPointer<Database> db2(new Database());
+
+    Group* group1 = new Group();
+    group1->setUuid(Uuid::random());
+    Group* group2 = new Group();
+    group2->setUuid(Uuid::random());
+    group2->setParent(group1);
+
+    Entry* entry1 = new Entry();
+    entry1->setUuid(Uuid::random());
+    entry1->setGroup(group2);
+
+    // not part of a database yet
+    QVERIFY(!db->resolveGroup(group1->uuid()));
+    QVERIFY(!db->resolveEntry(entry1->uuid()));
+    QCOMPARE(group1->findEntryByUuid(entry1->uuid()), entry1);
+
+    group1->setParent(db->rootGroup());
+    QCOMPARE(db->resolveGroup(db->rootGroup()->uuid()), db->rootGroup());
+    QCOMPARE(db->resolveGroup(group1->uuid()), group1);
+    QCOMPARE(db->resolveGroup(group2->uuid()), group2);
+    QCOMPARE(db->resolveEntry(entry1->uuid()), entry1);
+    QCOMPARE(db->rootGroup()->findChildByUuid(group2->uuid()), group2);
+    QCOMPARE(group1->findEntryByUuid(entry1->uuid()), entry1);
+    QCOMPARE(group2->findChildByUuid(group2->uuid()), group2);
+    QVERIFY(!group2->findChildByUuid(group1->uuid()));
+
+    // changing the uuid updates the index
+    Uuid oldUuid = entry1->uuid();
+    entry1->setUuid(Uuid::random());
+    QVERIFY(!db->resolveEntry(oldUuid));
+    QCOMPARE(db->resolveEntry(entry1->uuid()), entry1);
+
+    oldUuid = group2->uuid();
+    group2->setUuid(Uuid::random());
+    QVERIFY(!db->resolveGroup(oldUuid));
+    QCOMPARE(db->resolveGroup(group2->uuid()), group2);
+
+    // moving within the database keeps the index, but restricts subtree searches
+    entry1->setGroup(db->rootGroup());
+    QCOMPARE(db->resolveEntry(entry1->uuid()), entry1);
+    QVERIFY(!group1->findEntryByUuid(entry1->uuid()));
+    QCOMPARE(db->rootGroup()->findEntryByUuid(entry1->uuid()), entry1);
+
+    // duplicate uuids in the same database resolve to the first one in tree order,
+    // regardless of the order they were added in
+    Entry* entry2 = entry1->clone(Entry::CloneNoFlags);
+    entry2->setGroup(group2);
+    QCOMPARE(group1->findEntryByUuid(entry1->uuid()), entry2);
+    QCOMPARE(db->resolveEntry(entry1->uuid()), entry1);
+    QCOMPARE(db->rootGroup()->findEntryByUuid(entry1->uuid()), entry1);
+    Entry* entry4 = entry1->clone(Entry::CloneNoFlags);
+    entry4->setGroup(db->rootGroup());
+    QCOMPARE(db->resolveEntry(entry1->uuid()), entry1);
+    entry1->setGroup(group2);
+    QCOMPARE(db->resolveEntry(entry1->uuid()), entry4);
+    QCOMPARE(group1->findEntryByUuid(entry1->uuid()), entry2);
+    entry1->setGroup(db->rootGroup());
+    delete entry4;
+    delete entry2;
+    QCOMPARE(db->resolveEntry(entry1->uuid()), entry1);
+
+    Group* group3 = new Group();
+    group3->setUuid(group2->uuid());
+    group3->setParent(db->rootGroup());
+    QCOMPARE(db->resolveGroup(group2->uuid()), group2);
+    QCOMPARE(db->rootGroup()->findChildByUuid(group2->uuid()), group2);
+    Group* group4 = new Group();
+    group4->setUuid(group2->uuid());
+    group4->setParent(group1, 0);
+    QCOMPARE(db->resolveGroup(group2->uuid()), group4);
+    QCOMPARE(group1->findChildByUuid(group2->uuid()), group4);
+    delete group4;
+    delete group3;
+    QCOMPARE(db->resolveGroup(group2->uuid()), group2);
+
+    // moving to another database
+    group1->setParent(db2->rootGroup());
+    QVERIFY(!db->resolveGroup(group1->uuid()));
+    QVERIFY(!db->resolveGroup(group2->uuid()));
+    QCOMPARE(db2->resolveGroup(group2->uuid()), group2);
+
+    Uuid entryUuid = entry1->uuid();
+    delete entry1;
+    QVERIFY(!db->resolveEntry(entryUuid));
+
+    Uuid groupUuid = group2->uuid();
+    delete group1;
+    QVERIFY(!db2->resolveGroup(groupUuid));
+
+    // replacing the root group detaches the old tree from the database
+    Group* oldRoot = db2->rootGroup();
+    Entry* entry3 = new Entry();
+    entry3->setUuid(Uuid::random());
+    entry3->setGroup(oldRoot);
+    Group* newRoot = new Group();
+    newRoot->setUuid(Uuid::random());
+    db2->setRootGroup(newRoot);
+    QVERIFY(!oldRoot->database());
+    QVERIFY(!db2->resolveGroup(oldRoot->uuid()));
+    QVERIFY(!db2->resolveEntry(entry3->uuid()));
+    QCOMPARE(db2->resolveGroup(newRoot->uuid()), newRoot);
+    delete oldRoot;
+}
+
 void TestGroup::testFindGroupByPath()
 {
     QScopedPointer<Database> db(new Database());
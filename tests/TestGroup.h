@@ -36,6 +36,7 @@ private slots:
     void testClone();
     void testCopyCustomIcons();
     void testFindEntry();
+    void testUuidIndex();
     void testFindGroupByPath();
     void testPrint();
     void testLocate();
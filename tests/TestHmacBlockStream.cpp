@@ -0,0 +1,147 @@
+/*
+ *  Copyright (C) 2017 KeePassXC Team <team@keepassxc.org>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 or (at your option)
+ *  version 3 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "TestHmacBlockStream.h"
+
+#include <QBuffer>
+#include <QTest>
+
+#include "crypto/Crypto.h"
+#include "streams/HmacBlockStream.h"
+
+QTEST_GUILESS_MAIN(TestHmacBlockStream)
+
+namespace {
+    const QByteArray Key(64, '\x2A');
+}
+
+void TestHmacBlockStream::initTestCase()
+{
+    QVERIFY(Crypto::init());
+}
+
+void TestHmacBlockStream::testWriteRead()
+{
+    QByteArray data = QByteArray::fromHex("603deb1015ca71be2b73aef0857d77811f352c073b6108d72d9810a30914dff4");
+
+    QBuffer buffer;
+    QVERIFY(buffer.open(QIODevice::ReadWrite));
+
+    HmacBlockStream writer(&buffer, Key, 16);
+    QVERIFY(writer.open(QIODevice::WriteOnly));
+
+    HmacBlockStream reader(&buffer, Key);
+    QVERIFY(reader.open(QIODevice::ReadOnly));
+
+    QCOMPARE(writer.write(data.left(16)), qint64(16));
+    QVERIFY(writer.reset());
+    buffer.reset();
+    QCOMPARE(reader.read(17), data.left(16));
+    QVERIFY(reader.reset());
+    buffer.reset();
+    buffer.buffer().clear();
+
+    QCOMPARE(writer.write(data.left(10)), qint64(10));
+    QVERIFY(writer.reset());
+    buffer.reset();
+    QCOMPARE(reader.read(5), data.left(5));
+    QVERIFY(!reader.atEnd());
+    QCOMPARE(reader.read(5), data.mid(5, 5));
+    QCOMPARE(reader.read(1).size(), 0);
+    QVERIFY(reader.atEnd());
+    QVERIFY(reader.reset());
+    buffer.reset();
+    buffer.buffer().clear();
+
+    QCOMPARE(writer.write(data), qint64(32));
+    QVERIFY(writer.reset());
+    buffer.reset();
+    QCOMPARE(reader.read(40), data);
+    QCOMPARE(reader.read(1).size(), 0);
+}
+
+void TestHmacBlockStream::testReset()
+{
+    QBuffer buffer;
+    QVERIFY(buffer.open(QIODevice::WriteOnly));
+
+    HmacBlockStream writer(&buffer, Key, 16);
+    QVERIFY(writer.open(QIODevice::WriteOnly));
+    QCOMPARE(writer.write(QByteArray(8, 'Z')), qint64(8));
+    // test if reset() and close() write only one final block
+    QVERIFY(writer.reset());
+    QVERIFY(writer.reset());
+    writer.close();
+    QCOMPARE(buffer.buffer().size(), 8 + (32 + 4) * 2);
+}
+
+void TestHmacBlockStream::testWrongKey()
+{
+    QBuffer buffer;
+    QVERIFY(buffer.open(QIODevice::ReadWrite));
+
+    HmacBlockStream writer(&buffer, Key);
+    QVERIFY(writer.open(QIODevice::WriteOnly));
+    QCOMPARE(writer.write(QByteArray(100, 'Z')), qint64(100));
+    QVERIFY(writer.reset());
+    buffer.reset();
+
+    HmacBlockStream reader(&buffer, QByteArray(64, '\x2B'));
+    QVERIFY(reader.open(QIODevice::ReadOnly));
+    QCOMPARE(reader.read(100).size(), 0);
+    QCOMPARE(reader.errorString(), QString("Mismatch between HMAC and data."));
+}
+
+void TestHmacBlockStream::testTamperedBlock()
+{
+    QBuffer buffer;
+    QVERIFY(buffer.open(QIODevice::ReadWrite));
+
+    HmacBlockStream writer(&buffer, Key, 16);
+    QVERIFY(writer.open(QIODevice::WriteOnly));
+    QCOMPARE(writer.write(QByteArray(32, 'Z')), qint64(32));
+    QVERIFY(writer.reset());
+
+    // swapping two blocks of the same size must be detected
+    QByteArray data = buffer.buffer();
+    const int blockLength = 32 + 4 + 16;
+    QByteArray swapped = data.mid(blockLength, blockLength) + data.left(blockLength)
+            + data.mid(2 * blockLength);
+
+    QBuffer tamperedBuffer(&swapped);
+    QVERIFY(tamperedBuffer.open(QIODevice::ReadOnly));
+    HmacBlockStream reader(&tamperedBuffer, Key);
+    QVERIFY(reader.open(QIODevice::ReadOnly));
+    QCOMPARE(reader.read(32).size(), 0);
+    QVERIFY(!reader.errorString().isEmpty());
+}
+
+void TestHmacBlockStream::testOversizedBlock()
+{
+    // a block size far beyond the data must fail before allocating the block
+    QByteArray data(32, '\0');
+    data.append(QByteArray::fromHex("ffffff7f"));
+    data.append(QByteArray(64, 'Z'));
+
+    QBuffer buffer(&data);
+    QVERIFY(buffer.open(QIODevice::ReadOnly));
+    HmacBlockStream reader(&buffer, Key);
+    QVERIFY(reader.open(QIODevice::ReadOnly));
+    QCOMPARE(reader.read(64).size(), 0);
+    QCOMPARE(reader.errorString(), QString("Invalid block size."));
+}
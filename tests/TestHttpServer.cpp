@@ -0,0 +1,877 @@
+/*
+ *  Copyright (C) 2017 KeePassXC Team <team@keepassxc.org>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 or (at your option)
+ *  version 3 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TestHttpServer.h"
+
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QInputDialog>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QListWidget>
+#include <QLocalSocket>
+#include <QRegularExpression>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTemporaryFile>
+#include <QTest>
+#include <QTimer>
+#include <QtConcurrent>
+#include <QtEndian>
+#include <algorithm>
+
+#include "core/Config.h"
+#include "core/Database.h"
+#include "core/Entry.h"
+#include "core/Group.h"
+#include "core/HostIndex.h"
+#include "core/Uuid.h"
+#include "crypto/Crypto.h"
+#include "crypto/Random.h"
+#include "crypto/SymmetricCipher.h"
+#include "format/KeePass2Writer.h"
+#include "gui/DatabaseTabWidget.h"
+#include "gui/DatabaseWidget.h"
+#include "http/AccessControlDialog.h"
+#include "http/EntryConfig.h"
+#include "http/HttpSettings.h"
+#include "http/Protocol.h"
+#include "http/Server.h"
+#include "http/Service.h"
+#include "http/qhttp/qhttpclient.hpp"
+#include "http/qhttp/qhttpclientrequest.hpp"
+#include "http/qhttp/qhttpclientresponse.hpp"
+#include "keys/CompositeKey.h"
+#include "keys/PasswordKey.h"
+
+QTEST_MAIN(TestHttpServer)
+
+namespace {
+    /**
+     * Server that answers from a plain database, without the GUI of Service.
+     */
+    class TestServer : public KeepassHttpProtocol::Server
+    {
+    public:
+        explicit TestServer(Database* db)
+            : m_db(db)
+        {
+        }
+
+        bool isDatabaseOpened() const override
+        {
+            return true;
+        }
+
+        bool openDatabase() override
+        {
+            return true;
+        }
+
+        QString getDatabaseRootUuid() override
+        {
+            return m_db->rootGroup()->uuid().toHex();
+        }
+
+        QString getDatabaseRecycleBinUuid() override
+        {
+            return QString();
+        }
+
+        QString getKey(const QString& id) override
+        {
+            return m_keys.value(id);
+        }
+
+        QString storeKey(const QString& key) override
+        {
+            const QString id = QString("client%1").arg(m_keys.size());
+            m_keys.insert(id, key);
+            return id;
+        }
+
+        QList<KeepassHttpProtocol::Entry> findMatchingEntries(const QString&, const QString& url,
+                                                              const QString&, const QString&) override
+        {
+            ++m_lookups;
+            QList<KeepassHttpProtocol::Entry> result;
+            const QVector<QList<Entry*>> matches = m_db->hostIndex()->findEntries(QUrl(url).host());
+            for (const QList<Entry*>& entries : matches) {
+                for (const Entry* entry : entries) {
+                    result << KeepassHttpProtocol::Entry(entry->title(), entry->username(),
+                                                         entry->password(), entry->uuid().toHex());
+                }
+                if (!result.isEmpty()) {
+                    break;
+                }
+            }
+            return result;
+        }
+
+        int countMatchingEntries(const QString& id, const QString& url,
+                                 const QString& submitUrl, const QString& realm) override
+        {
+            return findMatchingEntries(id, url, submitUrl, realm).size();
+        }
+
+        QList<KeepassHttpProtocol::Entry> searchAllEntries(const QString&) override
+        {
+            return QList<KeepassHttpProtocol::Entry>();
+        }
+
+        void addEntry(const QString&, const QString&, const QString&, const QString&,
+                      const QString&, const QString&) override
+        {
+        }
+
+        void updateEntry(const QString&, const QString&, const QString&, const QString&,
+                         const QString&) override
+        {
+        }
+
+        QString generatePassword() override
+        {
+            return QString();
+        }
+
+        int lookups() const
+        {
+            return m_lookups;
+        }
+
+    private:
+        Database* const m_db;
+        QHash<QString, QString> m_keys;
+        int m_lookups = 0;
+    };
+
+    /**
+     * Answers the dialogs Service opens while it exists: association requests
+     * get a fixed name, access requests are allowed or denied.
+     */
+    class DialogAnswerer
+    {
+    public:
+        explicit DialogAnswerer(bool allow = true, bool remember = false)
+            : m_allow(allow)
+            , m_remember(remember)
+        {
+            m_timer.setInterval(10);
+            QObject::connect(&m_timer, &QTimer::timeout, [this]() { answer(); });
+            m_timer.start();
+        }
+
+        /**
+         * The number of entries listed by each access control dialog.
+         */
+        QList<int> accessRequests() const
+        {
+            return m_accessRequests;
+        }
+
+    private:
+        void answer()
+        {
+            QWidget* widget = QApplication::activeModalWidget();
+            if (QInputDialog* input = qobject_cast<QInputDialog*>(widget)) {
+                input->setTextValue("test");
+                input->accept();
+            }
+            else if (AccessControlDialog* dialog = qobject_cast<AccessControlDialog*>(widget)) {
+                m_accessRequests << dialog->findChild<QListWidget*>("itemsList")->count();
+                dialog->setRemember(m_remember);
+                if (m_allow) {
+                    dialog->accept();
+                }
+                else {
+                    dialog->reject();
+                }
+            }
+        }
+
+        const bool m_allow;
+        const bool m_remember;
+        QList<int> m_accessRequests;
+        QTimer m_timer;
+    };
+
+    /**
+     * Saves the database to the file and opens it in the tab widget, the way
+     * Service expects to find it.
+     */
+    bool openDatabase(DatabaseTabWidget* tabWidget, Database* db, QTemporaryFile* file)
+    {
+        CompositeKey key;
+        key.addKey(PasswordKey("a"));
+        db->setKey(key);
+
+        if (!file->open()) {
+            return false;
+        }
+        KeePass2Writer writer;
+        writer.writeDatabase(file, db);
+        file->close();
+        if (writer.hasError()) {
+            return false;
+        }
+
+        tabWidget->openDatabase(file->fileName(), "a");
+        return tabWidget->currentDatabaseWidget() != nullptr;
+    }
+
+    QByteArray processCipher(SymmetricCipher::Direction direction, const QByteArray& data,
+                             const QByteArray& key, const QByteArray& iv)
+    {
+        SymmetricCipher cipher(SymmetricCipher::Aes256, SymmetricCipher::Cbc, direction);
+        if (!cipher.init(key, iv)) {
+            return QByteArray();
+        }
+        bool ok;
+        return cipher.process(data, &ok);
+    }
+
+    QString encrypt(const QString& text, const QByteArray& key, const QByteArray& iv)
+    {
+        QByteArray data = text.toUtf8();
+        const int padding = 16 - data.size() % 16;
+        data.append(QByteArray(padding, static_cast<char>(padding)));
+        return QString::fromLatin1(processCipher(SymmetricCipher::Encrypt, data, key, iv).toBase64());
+    }
+
+    QByteArray frame(const QByteArray& data)
+    {
+        QByteArray header(4, '\0');
+        qToBigEndian<quint32>(static_cast<quint32>(data.size()), reinterpret_cast<uchar*>(header.data()));
+        return header + data;
+    }
+
+    bool waitForBytes(QLocalSocket& socket, qint64 count)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        while (socket.bytesAvailable() < count) {
+            if (timer.hasExpired(10000) || socket.state() != QLocalSocket::ConnectedState) {
+                return false;
+            }
+            QTest::qWait(10);
+        }
+        return true;
+    }
+
+    /**
+     * Reads one response frame, returns false if none arrives.
+     */
+    bool readFrame(QLocalSocket& socket, QByteArray& data)
+    {
+        if (!waitForBytes(socket, 4)) {
+            return false;
+        }
+        uchar header[4];
+        socket.read(reinterpret_cast<char*>(header), 4);
+        const quint32 size = qFromBigEndian<quint32>(header);
+        if (!waitForBytes(socket, size)) {
+            return false;
+        }
+        data = socket.read(size);
+        return true;
+    }
+
+    qint64 percentile(const QVector<qint64>& sorted, int percent)
+    {
+        if (sorted.isEmpty()) {
+            return 0;
+        }
+        const int index = qMin(sorted.size() - 1, (sorted.size() * percent + 99) / 100 - 1);
+        return sorted.at(qMax(0, index));
+    }
+}
+
+void TestHttpServer::initTestCase()
+{
+    QVERIFY(Crypto::init());
+    Config::createTempFileInstance();
+
+    QTcpServer probe;
+    QVERIFY(probe.listen(QHostAddress::LocalHost));
+    const quint16 port = probe.serverPort();
+    probe.close();
+    config()->set("Http/Port", port);
+
+    m_url = QUrl(QString("http://127.0.0.1:%1/").arg(port));
+    m_key = randomGen()->randomArray(32);
+
+    // keep the local socket of the tests apart from the one of a running instance
+    QVERIFY(m_runtimeDir.isValid());
+    qputenv("XDG_RUNTIME_DIR", m_runtimeDir.path().toLocal8Bit());
+}
+
+void TestHttpServer::cleanup()
+{
+    HttpSettings::setAlwaysAllowAccess(false);
+    HttpSettings::setListenOnHttpPort(true);
+    HttpSettings::setLocalSocketEnabled(false);
+}
+
+Database* TestHttpServer::createDatabase(int entryCount)
+{
+    Database* db = new Database();
+    for (int i = 0; i < entryCount; ++i) {
+        Entry* entry = new Entry();
+        entry->setUuid(Uuid::random());
+        entry->setTitle(QString("Site %1").arg(i));
+        entry->setUrl(QString("https://site%1.example.com/login").arg(i));
+        entry->setUsername(QString("user%1").arg(i));
+        entry->setPassword(QString("pass%1").arg(i));
+        entry->setGroup(db->rootGroup());
+    }
+    return db;
+}
+
+QJsonObject TestHttpServer::createRequest(const QString& requestType, const QString& url,
+                                          const QStringList& batchUrls) const
+{
+    const QByteArray iv = randomGen()->randomArray(16);
+    const QString nonce = QString::fromLatin1(iv.toBase64());
+
+    QJsonObject request;
+    request.insert("RequestType", requestType);
+    request.insert("Nonce", nonce);
+    request.insert("Verifier", encrypt(nonce, m_key, iv));
+    if (requestType == "associate") {
+        request.insert("Key", QString::fromLatin1(m_key.toBase64()));
+    }
+    else {
+        request.insert("Id", m_id);
+    }
+    if (!url.isEmpty()) {
+        request.insert("Url", encrypt(url, m_key, iv));
+    }
+    if (!batchUrls.isEmpty()) {
+        QJsonArray urls;
+        for (const QString& batchUrl : batchUrls) {
+            QJsonObject item;
+            item.insert("Url", encrypt(batchUrl, m_key, iv));
+            item.insert("SubmitUrl", encrypt(batchUrl, m_key, iv));
+            urls.append(item);
+        }
+        request.insert("Urls", urls);
+    }
+    return request;
+}
+
+void TestHttpServer::sendRequest(const QJsonObject& request, std::function<void(const QJsonObject&)> handler)
+{
+    const QByteArray body = QJsonDocument(request).toJson(QJsonDocument::Compact);
+    qhttp::client::QHttpClient* client = new qhttp::client::QHttpClient(this);
+    client->request(qhttp::EHTTP_POST, m_url,
+        [body](qhttp::client::QHttpRequest* req) {
+            req->addHeader("content-type", "application/json");
+            req->addHeader("content-length", QByteArray::number(body.size()));
+            req->end(body);
+        },
+        [client, handler](qhttp::client::QHttpResponse* res) {
+            res->collectData();
+            res->onEnd([client, handler, res]() {
+                handler(QJsonDocument::fromJson(res->collectedData()).object());
+                client->deleteLater();
+            });
+        });
+}
+
+QJsonObject TestHttpServer::sendRequest(const QJsonObject& request)
+{
+    QEventLoop loop;
+    QJsonObject response;
+    sendRequest(request, [&loop, &response](const QJsonObject& result) {
+        response = result;
+        loop.quit();
+    });
+    QTimer::singleShot(10000, &loop, SLOT(quit()));
+    loop.exec();
+    return response;
+}
+
+QString TestHttpServer::decrypt(const QString& text, const QString& nonce) const
+{
+    QByteArray data = processCipher(SymmetricCipher::Decrypt, QByteArray::fromBase64(text.toLatin1()),
+                                    m_key, QByteArray::fromBase64(nonce.toLatin1()));
+    if (data.isEmpty()) {
+        return QString();
+    }
+    data.chop(data.at(data.size() - 1));
+    return QString::fromUtf8(data);
+}
+
+void TestHttpServer::testRequests()
+{
+    QScopedPointer<Database> db(createDatabase(50));
+    TestServer server(db.data());
+    server.start();
+
+    QJsonObject response = sendRequest(createRequest("associate"));
+    QVERIFY(response.value("Success").toBool());
+    m_id = response.value("Id").toString();
+    QVERIFY(!m_id.isEmpty());
+
+    response = sendRequest(createRequest("test-associate"));
+    QVERIFY(response.value("Success").toBool());
+    QCOMPARE(response.value("Id").toString(), m_id);
+
+    response = sendRequest(createRequest("get-logins", "https://site7.example.com/account"));
+    QVERIFY(response.value("Success").toBool());
+    const QJsonArray entries = response.value("Entries").toArray();
+    QCOMPARE(entries.size(), 1);
+    const QString nonce = response.value("Nonce").toString();
+    QCOMPARE(decrypt(entries.at(0).toObject().value("Login").toString(), nonce), QString("user7"));
+    QCOMPARE(decrypt(entries.at(0).toObject().value("Password").toString(), nonce), QString("pass7"));
+    QVERIFY(!response.contains("Results"));
+
+    response = sendRequest(createRequest("get-logins-count", "https://site8.example.com"));
+    QVERIFY(response.value("Success").toBool());
+    QCOMPARE(response.value("Count").toInt(), 1);
+
+    // a wrong key is rejected
+    const QByteArray key = m_key;
+    m_key = randomGen()->randomArray(32);
+    response = sendRequest(createRequest("get-logins", "https://site7.example.com"));
+    QVERIFY(!response.value("Success").toBool());
+    m_key = key;
+
+    const QString report = server.latencyReport();
+    QVERIFY(report.contains("associate: 1 requests"));
+    QVERIFY(report.contains("test-associate: 1 requests"));
+    QVERIFY(report.contains("get-logins: 2 requests"));
+    QVERIFY(report.contains("get-logins-count: 1 requests"));
+
+    server.resetLatencies();
+    QVERIFY(server.latencyReport().isEmpty());
+    server.stop();
+}
+
+void TestHttpServer::testBatchRequest()
+{
+    QScopedPointer<Database> db(createDatabase(50));
+    TestServer server(db.data());
+    server.start();
+
+    QJsonObject response = sendRequest(createRequest("associate"));
+    QVERIFY(response.value("Success").toBool());
+    m_id = response.value("Id").toString();
+
+    const QStringList urls = QStringList() << "https://site3.example.com/" << "https://unknown.example.org"
+                                           << "https://site4.example.com/login";
+    response = sendRequest(createRequest("get-logins-batch", QString(), urls));
+    QVERIFY(response.value("Success").toBool());
+    QCOMPARE(response.value("Count").toInt(), 2);
+
+    const QString nonce = response.value("Nonce").toString();
+    const QJsonArray results = response.value("Results").toArray();
+    QCOMPARE(results.size(), 3);
+    for (int i = 0; i < results.size(); ++i) {
+        QCOMPARE(decrypt(results.at(i).toObject().value("Url").toString(), nonce), urls.at(i));
+    }
+    QCOMPARE(results.at(1).toObject().value("Count").toInt(), 0);
+    QCOMPARE(results.at(1).toObject().value("Entries").toArray().size(), 0);
+
+    const QJsonArray first = results.at(0).toObject().value("Entries").toArray();
+    QCOMPARE(first.size(), 1);
+    QCOMPARE(decrypt(first.at(0).toObject().value("Login").toString(), nonce), QString("user3"));
+    const QJsonArray last = results.at(2).toObject().value("Entries").toArray();
+    QCOMPARE(last.size(), 1);
+    QCOMPARE(decrypt(last.at(0).toObject().value("Login").toString(), nonce), QString("user4"));
+
+    server.stop();
+}
+
+void TestHttpServer::testServiceBatch()
+{
+    QScopedPointer<Database> db(createDatabase(10));
+    DatabaseTabWidget tabWidget;
+    QTemporaryFile dbFile;
+    QVERIFY(openDatabase(&tabWidget, db.data(), &dbFile));
+    Service service(&tabWidget);
+    QTRY_VERIFY(service.isDatabaseOpened());
+
+    const QList<QPair<QString, QString>> urls = QList<QPair<QString, QString>>()
+        << qMakePair(QString("https://site1.example.com/"), QString("https://site1.example.com/login"))
+        << qMakePair(QString("https://unknown.example.org/"), QString())
+        << qMakePair(QString("https://site2.example.com/"), QString());
+
+    // a single dialog asks for the entries of all urls
+    QList<QList<KeepassHttpProtocol::Entry>> results;
+    {
+        DialogAnswerer answerer(true, true);
+        results = service.findMatchingEntriesBatch("test", urls, QString());
+        QCOMPARE(answerer.accessRequests(), QList<int>() << 2);
+    }
+    QCOMPARE(results.size(), 3);
+    QCOMPARE(results.at(0).size(), 1);
+    QCOMPARE(results.at(0).at(0).login(), QString("user1"));
+    QCOMPARE(results.at(1).size(), 0);
+    QCOMPARE(results.at(2).size(), 1);
+    QCOMPARE(results.at(2).at(0).login(), QString("user2"));
+
+    // the remembered decision covers every url of the batch
+    {
+        DialogAnswerer answerer(false, false);
+        results = service.findMatchingEntriesBatch("test", urls, QString());
+        QVERIFY(answerer.accessRequests().isEmpty());
+    }
+    QCOMPARE(results.at(0).size(), 1);
+    QCOMPARE(results.at(2).size(), 1);
+    QCOMPARE(service.findMatchingEntries("test", urls.at(0).first, urls.at(0).second, QString()).size(), 1);
+
+    // a denied batch returns no entries and, if not remembered, asks again
+    const QList<QPair<QString, QString>> otherUrls = QList<QPair<QString, QString>>()
+        << qMakePair(QString("https://site3.example.com/"), QString())
+        << qMakePair(QString("https://site4.example.com/"), QString());
+    for (int i = 0; i < 2; ++i) {
+        DialogAnswerer answerer(false, false);
+        results = service.findMatchingEntriesBatch("test", otherUrls, QString());
+        QCOMPARE(answerer.accessRequests(), QList<int>() << 2);
+        QCOMPARE(results.size(), 2);
+        QVERIFY(results.at(0).isEmpty());
+        QVERIFY(results.at(1).isEmpty());
+    }
+}
+
+void TestHttpServer::testRequestVerification()
+{
+    const QString key = QString::fromLatin1(m_key.toBase64());
+    const QStringList urls = QStringList() << "https://site1.example.com" << "https://site2.example.com";
+    const QByteArray json = QJsonDocument(createRequest("get-logins-batch", "https://site0.example.com", urls))
+                                .toJson(QJsonDocument::Compact);
+
+    KeepassHttpProtocol::Request request;
+    QVERIFY(request.fromJson(json));
+    QCOMPARE(request.requestType(), KeepassHttpProtocol::GET_LOGINS_BATCH);
+    QVERIFY(!request.isVerified());
+    QVERIFY(!request.verify(QString()));
+    QVERIFY(!request.verify(QString::fromLatin1(randomGen()->randomArray(32).toBase64())));
+    QVERIFY(!request.isVerified());
+
+    // the request is verified and decrypted on a worker thread, and read afterwards
+    QVERIFY(QtConcurrent::run([&request, key]() { return request.verify(key); }).result());
+    QVERIFY(request.isVerified());
+    QCOMPARE(request.verifiedKey(), key);
+    QCOMPARE(request.url(), QString("https://site0.example.com"));
+    QCOMPARE(request.urls().size(), 2);
+    QCOMPARE(request.urls().at(1).first, urls.at(1));
+    QCOMPARE(request.urls().at(1).second, urls.at(1));
+
+    // verifying again doesn't decrypt the fields twice
+    QVERIFY(request.verify(key));
+    QCOMPARE(request.url(), QString("https://site0.example.com"));
+
+    // a request with a wrong key never reaches the database lookups
+    QScopedPointer<Database> db(createDatabase(10));
+    TestServer server(db.data());
+    server.start();
+
+    QJsonObject response = sendRequest(createRequest("associate"));
+    QVERIFY(response.value("Success").toBool());
+    m_id = response.value("Id").toString();
+
+    response = sendRequest(createRequest("get-logins", "https://site1.example.com"));
+    QVERIFY(response.value("Success").toBool());
+    QCOMPARE(server.lookups(), 1);
+    const QString nonce = response.value("Nonce").toString();
+    QCOMPARE(decrypt(response.value("Verifier").toString(), nonce), nonce);
+
+    const QByteArray oldKey = m_key;
+    m_key = randomGen()->randomArray(32);
+    response = sendRequest(createRequest("get-logins", "https://site1.example.com"));
+    m_key = oldKey;
+    QVERIFY(!response.value("Success").toBool());
+    QVERIFY(response.value("Verifier").toString().isEmpty());
+    QCOMPARE(server.lookups(), 1);
+
+    server.stop();
+}
+
+void TestHttpServer::testEntryConfigCache()
+{
+    QScopedPointer<Entry> entry(new Entry());
+    entry->setUuid(Uuid::random());
+    QVERIFY(!EntryConfig::cached(entry.data()));
+
+    EntryConfig config;
+    config.allow("allowed.example.com");
+    config.save(entry.data());
+
+    // unchanged settings are only parsed once
+    QSharedPointer<const EntryConfig> cached = EntryConfig::cached(entry.data());
+    QVERIFY(cached);
+    QVERIFY(cached->isAllowed("allowed.example.com"));
+    QCOMPARE(EntryConfig::cached(entry.data()), cached);
+
+    // changed settings are parsed again
+    config.deny("denied.example.com");
+    config.save(entry.data());
+    QSharedPointer<const EntryConfig> changed = EntryConfig::cached(entry.data());
+    QVERIFY(changed != cached);
+    QVERIFY(changed->isAllowed("allowed.example.com"));
+    QVERIFY(changed->isDenied("denied.example.com"));
+
+    // a clone shares the uuid but has its own settings
+    QScopedPointer<Entry> clone(entry->clone(Entry::CloneNoFlags));
+    EntryConfig cloneConfig;
+    cloneConfig.allow("clone.example.com");
+    cloneConfig.save(clone.data());
+    QVERIFY(EntryConfig::cached(clone.data())->isAllowed("clone.example.com"));
+    QVERIFY(!EntryConfig::cached(clone.data())->isAllowed("allowed.example.com"));
+    QVERIFY(EntryConfig::cached(entry.data())->isAllowed("allowed.example.com"));
+
+    // a new entry, possibly at the address of the deleted one, doesn't get its settings
+    entry.reset();
+    clone.reset();
+    for (int i = 0; i < 10; ++i) {
+        QScopedPointer<Entry> other(new Entry());
+        other->setUuid(Uuid::random());
+        QVERIFY(!EntryConfig::cached(other.data()));
+        EntryConfig otherConfig;
+        otherConfig.allow(QString("other%1.example.com").arg(i));
+        otherConfig.save(other.data());
+        QSharedPointer<const EntryConfig> otherCached = EntryConfig::cached(other.data());
+        QVERIFY(otherCached->isAllowed(QString("other%1.example.com").arg(i)));
+        QVERIFY(!otherCached->isAllowed("allowed.example.com"));
+    }
+}
+
+void TestHttpServer::testLocalSocket()
+{
+    HttpSettings::setListenOnHttpPort(false);
+    HttpSettings::setLocalSocketEnabled(true);
+
+    QScopedPointer<Database> db(createDatabase(10));
+    TestServer server(db.data());
+    server.start();
+
+    // only the local socket is listening
+    QTcpSocket tcpSocket;
+    tcpSocket.connectToHost(m_url.host(), static_cast<quint16>(m_url.port()));
+    QVERIFY(!tcpSocket.waitForConnected(1000));
+
+    QLocalSocket socket;
+    socket.connectToServer(HttpSettings::localSocketName());
+    QVERIFY(socket.waitForConnected(1000));
+
+    QByteArray data;
+    socket.write(frame(QJsonDocument(createRequest("associate")).toJson(QJsonDocument::Compact)));
+    QVERIFY(readFrame(socket, data));
+    QJsonObject response = QJsonDocument::fromJson(data).object();
+    QVERIFY(response.value("Success").toBool());
+    m_id = response.value("Id").toString();
+
+    // pipelined requests are answered in order on the same connection
+    socket.write(frame(QJsonDocument(createRequest("get-logins", "https://site1.example.com")).toJson())
+                 + frame(QJsonDocument(createRequest("get-logins-count", "https://site2.example.com")).toJson()));
+    QVERIFY(readFrame(socket, data));
+    response = QJsonDocument::fromJson(data).object();
+    QCOMPARE(response.value("RequestType").toString(), QString("get-logins"));
+    QCOMPARE(response.value("Entries").toArray().size(), 1);
+    QCOMPARE(decrypt(response.value("Entries").toArray().at(0).toObject().value("Login").toString(),
+                     response.value("Nonce").toString()),
+             QString("user1"));
+    QVERIFY(readFrame(socket, data));
+    response = QJsonDocument::fromJson(data).object();
+    QCOMPARE(response.value("RequestType").toString(), QString("get-logins-count"));
+    QCOMPARE(response.value("Count").toInt(), 1);
+
+    // invalid requests get an empty message
+    socket.write(frame("{\"RequestType\": \"unknown\"}"));
+    QVERIFY(readFrame(socket, data));
+    QVERIFY(data.isEmpty());
+
+    server.stop();
+}
+
+void TestHttpServer::testLocalSocketFraming()
+{
+    HttpSettings::setLocalSocketEnabled(true);
+
+    QScopedPointer<Database> db(createDatabase(10));
+    TestServer server(db.data());
+    server.start();
+
+    QLocalSocket socket;
+    socket.connectToServer(HttpSettings::localSocketName());
+    QVERIFY(socket.waitForConnected(1000));
+
+    // a frame that arrives in pieces is only handled once it's complete
+    const QByteArray request = frame(QJsonDocument(createRequest("associate")).toJson(QJsonDocument::Compact));
+    const int pieces[] = {2, 4, request.size() / 2, request.size()};
+    int written = 0;
+    for (int end : pieces) {
+        socket.write(request.mid(written, end - written));
+        socket.flush();
+        written = end;
+        if (written < request.size()) {
+            QTest::qWait(50);
+            QCOMPARE(socket.bytesAvailable(), Q_INT64_C(0));
+        }
+    }
+    QByteArray data;
+    QVERIFY(readFrame(socket, data));
+    QVERIFY(QJsonDocument::fromJson(data).object().value("Success").toBool());
+
+    // frames larger than 1 MiB close the connection without an answer
+    QByteArray header(4, '\0');
+    qToBigEndian<quint32>(1024 * 1024 + 1, reinterpret_cast<uchar*>(header.data()));
+    socket.write(header + QByteArray(1024, ' '));
+    socket.flush();
+    QTRY_COMPARE_WITH_TIMEOUT(socket.state(), QLocalSocket::UnconnectedState, 10000);
+    QCOMPARE(socket.bytesAvailable(), Q_INT64_C(0));
+
+    // a frame of exactly 1 MiB is still accepted
+    QLocalSocket other;
+    other.connectToServer(HttpSettings::localSocketName());
+    QVERIFY(other.waitForConnected(1000));
+    other.write(frame(QByteArray(1024 * 1024, ' ')));
+    QVERIFY(readFrame(other, data));
+    QVERIFY(data.isEmpty());
+
+    server.stop();
+}
+
+void TestHttpServer::testLocalSocketInstances()
+{
+    HttpSettings::setListenOnHttpPort(false);
+    HttpSettings::setLocalSocketEnabled(true);
+    const QString name = HttpSettings::localSocketName();
+
+    QScopedPointer<Database> db(createDatabase(10));
+
+    // the socket left behind by a crashed instance is replaced
+    QFile stale(name);
+    QVERIFY(stale.open(QIODevice::WriteOnly));
+    stale.close();
+
+    TestServer server(db.data());
+    server.start();
+    QLocalSocket socket;
+    socket.connectToServer(name);
+    QVERIFY(socket.waitForConnected(1000));
+
+    // the socket of a running instance is left alone
+    QTest::ignoreMessage(QtWarningMsg, QRegularExpression("^Cannot listen on local socket"));
+    TestServer second(db.data());
+    second.start();
+    second.stop();
+
+    QLocalSocket other;
+    other.connectToServer(name);
+    QVERIFY(other.waitForConnected(1000));
+    other.write(frame(QJsonDocument(createRequest("associate")).toJson(QJsonDocument::Compact)));
+    QByteArray data;
+    QVERIFY(readFrame(other, data));
+    QVERIFY(QJsonDocument::fromJson(data).object().value("Success").toBool());
+
+    server.stop();
+    QVERIFY(!QFile::exists(name));
+}
+
+void TestHttpServer::benchmarkRequests()
+{
+    QByteArray env = qgetenv("BENCHMARK");
+
+    if (env.isEmpty() || env == "0" || env == "no") {
+        QSKIP("Benchmark skipped. Set env variable BENCHMARK=1 to enable.");
+    }
+
+    const int entryCount = 5000;
+    const int clientCount = 16;
+    const int requestsPerClient = 200;
+
+    // the requests go through Service, so the entries are looked up the same way as in the application
+    HttpSettings::setAlwaysAllowAccess(true);
+    QScopedPointer<Database> db(createDatabase(entryCount));
+    DatabaseTabWidget tabWidget;
+    QTemporaryFile dbFile;
+    QVERIFY(openDatabase(&tabWidget, db.data(), &dbFile));
+    Service service(&tabWidget);
+    QTRY_VERIFY(service.isDatabaseOpened());
+    service.start();
+
+    QJsonObject response;
+    {
+        DialogAnswerer answerer;
+        response = sendRequest(createRequest("associate"));
+    }
+    QVERIFY(response.value("Success").toBool());
+    m_id = response.value("Id").toString();
+    service.resetLatencies();
+
+    const QStringList requestTypes = QStringList() << "test-associate" << "get-logins"
+                                                   << "get-logins-count" << "get-logins-batch";
+    QVector<qint64> latencies;
+    latencies.reserve(clientCount * requestsPerClient);
+    int failures = 0;
+    int running = clientCount;
+    QEventLoop loop;
+    QElapsedTimer total;
+    total.start();
+
+    // every client sends its next request as soon as it got the previous response
+    std::function<void(int, int)> next = [&](int client, int sent) {
+        if (sent == requestsPerClient) {
+            if (--running == 0) {
+                loop.quit();
+            }
+            return;
+        }
+        const QString requestType = requestTypes.at((client + sent) % requestTypes.size());
+        const int site = (client * requestsPerClient + sent) % entryCount;
+        const QString url = QString("https://site%1.example.com/").arg(site);
+        QStringList batchUrls;
+        if (requestType == "get-logins-batch") {
+            for (int i = 0; i < 8; ++i) {
+                batchUrls << QString("https://site%1.example.com/").arg((site + i * 97) % entryCount);
+            }
+        }
+        const qint64 started = total.nsecsElapsed();
+        sendRequest(createRequest(requestType, url, batchUrls), [&, client, sent, started](const QJsonObject& result) {
+            latencies.append(total.nsecsElapsed() - started);
+            if (!result.value("Success").toBool()) {
+                failures++;
+            }
+            next(client, sent + 1);
+        });
+    };
+    for (int i = 0; i < clientCount; ++i) {
+        next(i, 0);
+    }
+    QTimer::singleShot(600000, &loop, SLOT(quit()));
+    loop.exec();
+
+    const qint64 elapsed = total.nsecsElapsed();
+    const QString report = service.latencyReport();
+    service.stop();
+
+    QCOMPARE(latencies.size(), clientCount * requestsPerClient);
+    QCOMPARE(failures, 0);
+
+    std::sort(latencies.begin(), latencies.end());
+    qDebug("%d requests from %d clients in %lld ms: %.1f requests/s",
+           latencies.size(), clientCount, elapsed / 1000000,
+           latencies.size() * 1e9 / static_cast<double>(elapsed));
+    qDebug("latency p50 %lld us, p95 %lld us, p99 %lld us",
+           percentile(latencies, 50) / 1000, percentile(latencies, 95) / 1000, percentile(latencies, 99) / 1000);
+    qDebug("%s", qPrintable(report));
+}
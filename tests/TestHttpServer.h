@@ -0,0 +1,61 @@
+/*
+ *  Copyright (C) 2017 KeePassXC Team <team@keepassxc.org>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 or (at your option)
+ *  version 3 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef KEEPASSX_TESTHTTPSERVER_H
+#define KEEPASSX_TESTHTTPSERVER_H
+
+#include <QJsonObject>
+#include <QObject>
+#include <QStringList>
+#include <QTemporaryDir>
+#include <QUrl>
+#include <functional>
+
+class Database;
+
+class TestHttpServer : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanup();
+    void testRequests();
+    void testBatchRequest();
+    void testServiceBatch();
+    void testRequestVerification();
+    void testEntryConfigCache();
+    void testLocalSocket();
+    void testLocalSocketFraming();
+    void testLocalSocketInstances();
+    void benchmarkRequests();
+
+private:
+    Database* createDatabase(int entryCount);
+    QJsonObject createRequest(const QString& requestType, const QString& url = QString(),
+                              const QStringList& batchUrls = QStringList()) const;
+    void sendRequest(const QJsonObject& request, std::function<void(const QJsonObject&)> handler);
+    QJsonObject sendRequest(const QJsonObject& request);
+    QString decrypt(const QString& text, const QString& nonce) const;
+
+    QTemporaryDir m_runtimeDir;
+    QUrl m_url;
+    QByteArray m_key;
+    QString m_id;
+};
+
+#endif // KEEPASSX_TESTHTTPSERVER_H
@@ -85,3 +85,80 @@ void TestKeePass2RandomStream::test()
     QCOMPARE(cipherData, cipherDataEncrypt);
     QCOMPARE(randomStreamData, cipherData);
 }
+
+void TestKeePass2RandomStream::testChaCha20()
+{
+    const QByteArray key("\x11\x22\x33\x44\x55\x66\x77\x88");
+    const QByteArray data(100, '\x5A');
+    bool ok;
+
+    QByteArray keyIv = CryptoHash::hash(key, CryptoHash::Sha512);
+    SymmetricCipher cipher(SymmetricCipher::ChaCha20, SymmetricCipher::Stream, SymmetricCipher::Encrypt);
+    QVERIFY(cipher.init(keyIv.left(32), keyIv.mid(32, 12)));
+    QByteArray cipherData = cipher.process(data, &ok);
+    QVERIFY(ok);
+
+    KeePass2RandomStream randomStream(KeePass2::ChaCha20);
+    QVERIFY(randomStream.init(key));
+    QByteArray randomStreamData;
+    randomStreamData.append(randomStream.process(data.mid(0, 33), &ok));
+    QVERIFY(ok);
+    randomStreamData.append(randomStream.process(data.mid(33), &ok));
+    QVERIFY(ok);
+
+    QCOMPARE(randomStreamData, cipherData);
+}
+
+void TestKeePass2RandomStream::testSeek_data()
+{
+    QTest::addColumn<int>("algo");
+
+    QTest::newRow("Salsa20") << static_cast<int>(KeePass2::Salsa20);
+    QTest::newRow("ChaCha20") << static_cast<int>(KeePass2::ChaCha20);
+}
+
+void TestKeePass2RandomStream::testSeek()
+{
+    QFETCH(int, algo);
+
+    const QByteArray key("\x11\x22\x33\x44\x55\x66\x77\x88");
+    bool ok;
+
+    KeePass2RandomStream sequentialStream(static_cast<KeePass2::ProtectedStreamAlgo>(algo));
+    QVERIFY(sequentialStream.init(key));
+    QByteArray keyStream = sequentialStream.randomBytes(10000, &ok);
+    QVERIFY(ok);
+    QCOMPARE(sequentialStream.position(), qint64(10000));
+
+    KeePass2RandomStream randomStream(static_cast<KeePass2::ProtectedStreamAlgo>(algo));
+    QVERIFY(randomStream.init(key));
+
+    // far ahead and back again
+    randomStream.seek(9000);
+    QCOMPARE(randomStream.randomBytes(1000, &ok), keyStream.mid(9000, 1000));
+    QCOMPARE(randomStream.processAt(6000, QByteArray(16, '\0'), &ok), keyStream.mid(6000, 16));
+    QVERIFY(ok);
+
+    // out of order, within a block and across block boundaries
+    randomStream.seek(700);
+    QCOMPARE(randomStream.randomBytes(100, &ok), keyStream.mid(700, 100));
+    QCOMPARE(randomStream.position(), qint64(800));
+    randomStream.seek(3);
+    QCOMPARE(randomStream.randomBytes(5, &ok), keyStream.mid(3, 5));
+    randomStream.seek(60);
+    QCOMPARE(randomStream.randomBytes(10, &ok), keyStream.mid(60, 10));
+    QCOMPARE(randomStream.randomBytes(930, &ok), keyStream.mid(70, 930));
+
+    // backwards through the whole key stream, like lazily decrypted values
+    // that are used in reverse file order
+    for (int pos = 10000 - 37; pos >= 0; pos -= 37) {
+        QCOMPARE(randomStream.processAt(pos, QByteArray(37, '\0'), &ok), keyStream.mid(pos, 37));
+        QVERIFY(ok);
+    }
+
+    QSharedPointer<KeePass2RandomStream> clonedStream = randomStream.clone();
+    QVERIFY(clonedStream);
+    QCOMPARE(clonedStream->position(), qint64(0));
+    clonedStream->seek(500);
+    QCOMPARE(clonedStream->randomBytes(20, &ok), keyStream.mid(500, 20));
+}
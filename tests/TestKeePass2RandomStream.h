@@ -27,6 +27,9 @@ class TestKeePass2RandomStream : public QObject
 private slots:
     void initTestCase();
     void test();
+    void testChaCha20();
+    void testSeek();
+    void testSeek_data();
 };
 
 #endif // KEEPASSX_TESTKEEPASS2RANDOMSTREAM_H
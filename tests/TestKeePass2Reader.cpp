@@ -24,6 +24,7 @@
 #include "core/Group.h"
 #include "core/Metadata.h"
 #include "crypto/Crypto.h"
+#include "crypto/kdf/Kdf.h"
 #include "format/KeePass2Reader.h"
 #include "keys/PasswordKey.h"
 
@@ -155,3 +156,58 @@ void TestKeePass2Reader::testFormat300()
 
     delete db;
 }
+
+void TestKeePass2Reader::testFormat400()
+{
+    // ChaCha20 encrypted KDBX 4 file with the defaults of KeePass 2.36
+    QString filename = QString(KEEPASSX_TEST_DATA_DIR).append("/Format400.kdbx");
+    CompositeKey key;
+    key.addKey(PasswordKey("a"));
+    KeePass2Reader reader;
+    QScopedPointer<Database> db(reader.readDatabase(filename, key));
+    QVERIFY(db);
+    QVERIFY(!reader.hasError());
+    QCOMPARE(reader.version(), KeePass2::FILE_VERSION_4);
+    QCOMPARE(db->cipher(), KeePass2::CIPHER_CHACHA20);
+    QCOMPARE(db->kdf()->uuid(), KeePass2::KDF_ARGON2D);
+
+    QCOMPARE(db->rootGroup()->name(), QString("Format400"));
+    QCOMPARE(db->metadata()->name(), QString("Format400"));
+    QCOMPARE(db->rootGroup()->entries().size(), 1);
+    Entry* entry = db->rootGroup()->entries().at(0);
+
+    QCOMPARE(entry->title(), QString("Sample Entry"));
+    QCOMPARE(entry->username(), QString("User Name"));
+    QCOMPARE(entry->password(), QString("Password"));
+    QCOMPARE(entry->attributes()->value("Secret"), QString("secret value"));
+    QVERIFY(entry->attributes()->isProtected("Secret"));
+    QCOMPARE(entry->timeInfo().creationTime(), QDateTime(QDate(2017, 7, 16), QTime(12, 30), Qt::UTC));
+
+    QCOMPARE(entry->attachments()->keys().size(), 2);
+    QCOMPARE(entry->attachments()->value("test.txt"), QByteArray("this is a test"));
+    QVERIFY(!entry->attachments()->isProtected("test.txt"));
+    QCOMPARE(entry->attachments()->value("protected.txt"), QByteArray("this attachment is protected"));
+    QVERIFY(entry->attachments()->isProtected("protected.txt"));
+}
+
+void TestKeePass2Reader::testNotPipelined()
+{
+    QString filename = QString(KEEPASSX_TEST_DATA_DIR).append("/Compressed.kdbx");
+    CompositeKey key;
+    key.addKey(PasswordKey(""));
+
+    KeePass2Reader pipelinedReader;
+    pipelinedReader.setSaveXml(true);
+    QScopedPointer<Database> pipelinedDb(pipelinedReader.readDatabase(filename, key));
+    QVERIFY(pipelinedDb);
+    QVERIFY(!pipelinedReader.hasError());
+
+    KeePass2Reader reader;
+    reader.setPipelined(false);
+    reader.setSaveXml(true);
+    QScopedPointer<Database> db(reader.readDatabase(filename, key));
+    QVERIFY(db);
+    QVERIFY(!reader.hasError());
+    QCOMPARE(db->metadata()->name(), QString("Compressed"));
+    QCOMPARE(reader.xmlData(), pipelinedReader.xmlData());
+}
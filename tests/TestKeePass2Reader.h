@@ -32,6 +32,8 @@ private slots:
     void testBrokenHeaderHash();
     void testFormat200();
     void testFormat300();
+    void testFormat400();
+    void testNotPipelined();
 };
 
 #endif // KEEPASSX_TESTKEEPASS2READER_H
@@ -26,7 +26,11 @@
 #include "core/Database.h"
 #include "core/Group.h"
 #include "core/Metadata.h"
+#include "core/Endian.h"
 #include "crypto/Crypto.h"
+#include "crypto/Random.h"
+#include "crypto/kdf/Argon2Kdf.h"
+#include "format/KeePass2.h"
 #include "format/KeePass2Reader.h"
 #include "format/KeePass2Repair.h"
 #include "format/KeePass2Writer.h"
@@ -159,6 +163,242 @@ void TestKeePass2Writer::testRepair()
     delete dbRepaired;
 }
 
+void TestKeePass2Writer::testKdbx4()
+{
+    CompositeKey key;
+    key.addKey(PasswordKey("test"));
+
+    QScopedPointer<Database> db(new Database());
+    QSharedPointer<Argon2Kdf> kdf(new Argon2Kdf());
+    QVERIFY(kdf->setRounds(2));
+    QVERIFY(kdf->setParallelism(2));
+    QVERIFY(kdf->setMemory(1024));
+    QVERIFY(db->setKdf(kdf));
+    QVERIFY(db->setKey(key));
+    db->metadata()->setName("TESTDB4");
+
+    Entry* entry = new Entry();
+    entry->setUuid(Uuid::random());
+    entry->setPassword("password");
+    entry->attributes()->set("test", "protectedTest", true);
+    QByteArray binary(100000, '\0');
+    for (int i = 0; i < binary.size(); i++) {
+        binary[i] = static_cast<char>(i % 251);
+    }
+    entry->attachments()->set("binary.dat", binary);
+    entry->attachments()->set("copy.dat", binary);
+    entry->attachments()->set("text.txt", QByteArray("this is an attachment"));
+    entry->attachments()->set("secret.txt", QByteArray("this is a protected attachment"));
+    entry->attachments()->setProtected("secret.txt", true);
+    TimeInfo timeInfo = entry->timeInfo();
+    timeInfo.setCreationTime(QDateTime(QDate(2010, 5, 17), QTime(12, 34, 56), Qt::UTC));
+    entry->setTimeInfo(timeInfo);
+    entry->setGroup(db->rootGroup());
+
+    QBuffer buffer;
+    buffer.open(QBuffer::ReadWrite);
+    KeePass2Writer writer;
+    writer.writeDatabase(&buffer, db.data());
+    QVERIFY(!writer.hasError());
+    QCOMPARE(Endian::bytesToUInt32(buffer.data().mid(8, 4), KeePass2::BYTEORDER), KeePass2::FILE_VERSION_4);
+
+    buffer.seek(0);
+    KeePass2Reader reader;
+    QScopedPointer<Database> dbRead(reader.readDatabase(&buffer, key));
+    QVERIFY(!reader.hasError());
+    QVERIFY(dbRead);
+    QCOMPARE(reader.version(), KeePass2::FILE_VERSION_4);
+
+    QCOMPARE(dbRead->kdf()->uuid(), KeePass2::KDF_ARGON2D);
+    const Argon2Kdf* kdfRead = static_cast<const Argon2Kdf*>(dbRead->kdf().data());
+    QCOMPARE(kdfRead->rounds(), static_cast<quint64>(2));
+    QCOMPARE(kdfRead->parallelism(), static_cast<quint32>(2));
+    QCOMPARE(kdfRead->memory(), static_cast<quint64>(1024));
+
+    QCOMPARE(dbRead->metadata()->name(), QString("TESTDB4"));
+    QCOMPARE(dbRead->rootGroup()->entries().size(), 1);
+    Entry* entryRead = dbRead->rootGroup()->entries().at(0);
+    QCOMPARE(entryRead->password(), QString("password"));
+    QCOMPARE(entryRead->attributes()->value("test"), QString("protectedTest"));
+    QVERIFY(entryRead->attributes()->isProtected("test"));
+    QCOMPARE(entryRead->attachments()->keys().size(), 4);
+    QCOMPARE(entryRead->attachments()->value("binary.dat"), binary);
+    QCOMPARE(entryRead->attachments()->value("copy.dat"), binary);
+    QCOMPARE(entryRead->attachments()->value("text.txt"), QByteArray("this is an attachment"));
+    QVERIFY(!entryRead->attachments()->isProtected("text.txt"));
+    QCOMPARE(entryRead->attachments()->value("secret.txt"), QByteArray("this is a protected attachment"));
+    QVERIFY(entryRead->attachments()->isProtected("secret.txt"));
+    QCOMPARE(entryRead->timeInfo().creationTime(), timeInfo.creationTime());
+
+    // the header HMAC detects a wrong key
+    CompositeKey wrongKey;
+    wrongKey.addKey(PasswordKey("wrong"));
+    buffer.seek(0);
+    KeePass2Reader wrongKeyReader;
+    QScopedPointer<Database> dbWrongKey(wrongKeyReader.readDatabase(&buffer, wrongKey));
+    QVERIFY(!dbWrongKey);
+    QVERIFY(wrongKeyReader.hasError());
+
+    // so does modifying the header
+    QByteArray data = buffer.data();
+    data[20] = static_cast<char>(data[20] ^ 0x01);
+    QBuffer modifiedBuffer(&data);
+    modifiedBuffer.open(QBuffer::ReadOnly);
+    KeePass2Reader modifiedReader;
+    QScopedPointer<Database> dbModified(modifiedReader.readDatabase(&modifiedBuffer, key));
+    QVERIFY(!dbModified);
+    QVERIFY(modifiedReader.hasError());
+}
+
+void TestKeePass2Writer::testChaCha20()
+{
+    CompositeKey key;
+    key.addKey(PasswordKey("test"));
+
+    QScopedPointer<Database> db(new Database());
+    db->setCipher(KeePass2::CIPHER_CHACHA20);
+    QVERIFY(db->setKey(key));
+    Entry* entry = new Entry();
+    entry->setUuid(Uuid::random());
+    entry->setTitle("chacha");
+    entry->setGroup(db->rootGroup());
+
+    QBuffer buffer;
+    buffer.open(QBuffer::ReadWrite);
+    KeePass2Writer writer;
+    writer.writeDatabase(&buffer, db.data());
+    QVERIFY(!writer.hasError());
+    // KeePass only reads ChaCha20 from KDBX 4, even with AES-KDF
+    QCOMPARE(Endian::bytesToUInt32(buffer.data().mid(8, 4), KeePass2::BYTEORDER), KeePass2::FILE_VERSION_4);
+
+    buffer.seek(0);
+    KeePass2Reader reader;
+    QScopedPointer<Database> dbRead(reader.readDatabase(&buffer, key));
+    QVERIFY(dbRead);
+    QVERIFY(!reader.hasError());
+    QCOMPARE(dbRead->cipher(), KeePass2::CIPHER_CHACHA20);
+    QCOMPARE(dbRead->kdf()->uuid(), KeePass2::KDF_AES);
+    QCOMPARE(dbRead->rootGroup()->entries().size(), 1);
+    QCOMPARE(dbRead->rootGroup()->entries().at(0)->title(), QString("chacha"));
+}
+
+void TestKeePass2Writer::testKdbx4BlockCiphers()
+{
+    CompositeKey key;
+    key.addKey(PasswordKey("test"));
+
+    // incompressible, so the payload spans several cipher chunks
+    QByteArray attachment = randomGen()->randomArray(600 * 1024 + 5);
+
+    for (const Uuid& cipher : {KeePass2::CIPHER_AES, KeePass2::CIPHER_TWOFISH}) {
+        QSharedPointer<Argon2Kdf> kdf(new Argon2Kdf());
+        QVERIFY(kdf->setRounds(1));
+        QVERIFY(kdf->setMemory(1024));
+
+        QScopedPointer<Database> db(new Database());
+        db->setCipher(cipher);
+        QVERIFY(db->setKdf(kdf));
+        QVERIFY(db->setKey(key));
+        Entry* entry = new Entry();
+        entry->setUuid(Uuid::random());
+        entry->setGroup(db->rootGroup());
+        entry->attachments()->set("random.bin", attachment);
+
+        QBuffer buffer;
+        buffer.open(QBuffer::ReadWrite);
+        KeePass2Writer writer;
+        writer.writeDatabase(&buffer, db.data());
+        QVERIFY(!writer.hasError());
+        QCOMPARE(Endian::bytesToUInt32(buffer.data().mid(8, 4), KeePass2::BYTEORDER), KeePass2::FILE_VERSION_4);
+
+        for (bool pipelined : {true, false}) {
+            buffer.seek(0);
+            KeePass2Reader reader;
+            reader.setPipelined(pipelined);
+            QScopedPointer<Database> dbRead(reader.readDatabase(&buffer, key));
+            QVERIFY(dbRead);
+            QVERIFY(!reader.hasError());
+            QCOMPARE(dbRead->cipher(), cipher);
+            QCOMPARE(dbRead->rootGroup()->entries().size(), 1);
+            QCOMPARE(dbRead->rootGroup()->entries().at(0)->attachments()->value("random.bin"), attachment);
+        }
+    }
+}
+
+void TestKeePass2Writer::testProtectedValuesReverseOrder()
+{
+    CompositeKey key;
+    key.addKey(PasswordKey("test"));
+
+    QScopedPointer<Database> db(new Database());
+    QVERIFY(db->setKey(key));
+    for (int i = 0; i < 200; i++) {
+        Entry* entry = new Entry();
+        entry->setUuid(Uuid::random());
+        entry->setPassword(QString("password %1").arg(i).repeated(i % 7 + 1));
+        entry->attributes()->set("secret", QString("secret %1").arg(i), true);
+        entry->setGroup(db->rootGroup());
+    }
+
+    QBuffer buffer;
+    buffer.open(QBuffer::ReadWrite);
+    KeePass2Writer writer;
+    writer.writeDatabase(&buffer, db.data());
+    QVERIFY(!writer.hasError());
+    // KDBX 3.1 uses the Salsa20 inner stream
+    QCOMPARE(Endian::bytesToUInt32(buffer.data().mid(8, 4), KeePass2::BYTEORDER), KeePass2::FILE_VERSION_3);
+
+    buffer.seek(0);
+    KeePass2Reader reader;
+    QScopedPointer<Database> dbRead(reader.readDatabase(&buffer, key));
+    QVERIFY(dbRead);
+    QVERIFY(!reader.hasError());
+
+    // the protected values are decrypted when they are used, last one first
+    const QList<Entry*> entries = dbRead->rootGroup()->entries();
+    QCOMPARE(entries.size(), 200);
+    for (int i = entries.size() - 1; i >= 0; i--) {
+        QCOMPARE(entries.at(i)->attributes()->value("secret"), QString("secret %1").arg(i));
+        QCOMPARE(entries.at(i)->password(), QString("password %1").arg(i).repeated(i % 7 + 1));
+    }
+}
+
+void TestKeePass2Writer::testPipelined()
+{
+    CompositeKey key;
+    key.addKey(PasswordKey("test"));
+
+    // large enough to pass several chunks through every stage
+    QByteArray attachment = randomGen()->randomArray(3 * 1024 * 1024 + 17);
+
+    QScopedPointer<Database> db(new Database());
+    db->setKey(key);
+    Entry* entry = new Entry();
+    entry->setGroup(db->rootGroup());
+    entry->attachments()->set("large.bin", attachment);
+
+    for (bool pipelinedWriter : {true, false}) {
+        QBuffer buffer;
+        buffer.open(QBuffer::ReadWrite);
+
+        KeePass2Writer writer;
+        writer.setPipelined(pipelinedWriter);
+        writer.writeDatabase(&buffer, db.data());
+        QVERIFY(!writer.hasError());
+
+        for (bool pipelinedReader : {true, false}) {
+            buffer.seek(0);
+            KeePass2Reader reader;
+            reader.setPipelined(pipelinedReader);
+            QScopedPointer<Database> dbRead(reader.readDatabase(&buffer, key));
+            QVERIFY(dbRead);
+            QVERIFY(!reader.hasError());
+            QCOMPARE(dbRead->rootGroup()->entries().size(), 1);
+            QCOMPARE(dbRead->rootGroup()->entries().at(0)->attachments()->value("large.bin"), attachment);
+        }
+    }
+}
+
 void TestKeePass2Writer::cleanupTestCase()
 {
     delete m_dbOrg;
@@ -34,6 +34,11 @@ private slots:
     void testNonAsciiPasswords();
     void testDeviceFailure();
     void testRepair();
+    void testKdbx4();
+    void testChaCha20();
+    void testKdbx4BlockCiphers();
+    void testProtectedValuesReverseOrder();
+    void testPipelined();
     void cleanupTestCase();
 
 private:
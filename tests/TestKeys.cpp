@@ -25,6 +25,9 @@
 #include "core/Database.h"
 #include "core/Metadata.h"
 #include "crypto/Crypto.h"
+#include "crypto/kdf/AesKdf.h"
+#include "crypto/kdf/Argon2Kdf.h"
+#include "format/KeePass2.h"
 #include "format/KeePass2Reader.h"
 #include "format/KeePass2Writer.h"
 #include "keys/CompositeKey.h"
@@ -172,6 +175,112 @@ void TestKeys::testFileKeyError()
     errorMsg = "";
 }
 
+void TestKeys::testAesKdf()
+{
+    CompositeKey compositeKey;
+    compositeKey.addKey(PasswordKey("test"));
+    QByteArray seed(32, '\x4B');
+    bool ok;
+    QString errorString;
+
+    QByteArray legacy = compositeKey.transform(seed, 1000, &ok, &errorString);
+    QVERIFY(ok);
+
+    AesKdf kdf;
+    QCOMPARE(kdf.uuid(), KeePass2::KDF_AES);
+    QCOMPARE(kdf.rounds(), static_cast<quint64>(AesKdf::DefaultRounds));
+    QVERIFY(kdf.setRounds(1000));
+    kdf.setSeed(seed);
+
+    QByteArray result;
+    QVERIFY(compositeKey.transform(kdf, result, &errorString));
+    QCOMPARE(result, legacy);
+
+    kdf.setSeed(QByteArray(16, '\x4B'));
+    QVERIFY(!compositeKey.transform(kdf, result, &errorString));
+    QVERIFY(!errorString.isEmpty());
+}
+
+void TestKeys::testArgon2Kdf()
+{
+    CompositeKey compositeKey;
+    compositeKey.addKey(PasswordKey("test"));
+    QString errorString;
+
+    Argon2Kdf kdf;
+    QCOMPARE(kdf.uuid(), KeePass2::KDF_ARGON2D);
+    QVERIFY(kdf.setRounds(2));
+    QVERIFY(kdf.setParallelism(2));
+    QVERIFY(kdf.setMemory(1024));
+    kdf.setSeed(QByteArray(32, '\x4B'));
+
+    QByteArray result1;
+    QVERIFY(compositeKey.transform(kdf, result1, &errorString));
+    QCOMPARE(result1.size(), 32);
+
+    QSharedPointer<Kdf> copy = kdf.clone();
+    QByteArray result2;
+    QVERIFY(compositeKey.transform(*copy, result2, &errorString));
+    QCOMPARE(result2, result1);
+
+    // every parameter contributes to the derived key
+    QVERIFY(kdf.setParallelism(4));
+    QVERIFY(compositeKey.transform(kdf, result2, &errorString));
+    QVERIFY(result2 != result1);
+    QVERIFY(kdf.setParallelism(2));
+
+    QVERIFY(kdf.setMemory(2048));
+    QVERIFY(compositeKey.transform(kdf, result2, &errorString));
+    QVERIFY(result2 != result1);
+    QVERIFY(kdf.setMemory(1024));
+
+    kdf.setSeed(QByteArray(32, '\x4C'));
+    QVERIFY(compositeKey.transform(kdf, result2, &errorString));
+    QVERIFY(result2 != result1);
+    kdf.setSeed(QByteArray(32, '\x4B'));
+
+    Argon2Kdf kdfId(Argon2Kdf::Type::Argon2id);
+    QCOMPARE(kdfId.uuid(), KeePass2::KDF_ARGON2ID);
+    QVERIFY(kdfId.setRounds(2));
+    QVERIFY(kdfId.setParallelism(2));
+    QVERIFY(kdfId.setMemory(1024));
+    kdfId.setSeed(QByteArray(32, '\x4B'));
+    QVERIFY(compositeKey.transform(kdfId, result2, &errorString));
+    QVERIFY(result2 != result1);
+
+    QVERIFY(kdf.benchmark(100) >= 1);
+}
+
+void TestKeys::testKdfParameters()
+{
+    Argon2Kdf kdf;
+    QVERIFY(!kdf.setRounds(0));
+    QVERIFY(!kdf.setParallelism(0));
+    QVERIFY(!kdf.setParallelism(Argon2Kdf::MaxParallelism + 1));
+    QVERIFY(kdf.setParallelism(4));
+    QVERIFY(!kdf.setMemory(8));
+    QCOMPARE(kdf.parallelism(), static_cast<quint32>(4));
+
+    QVERIFY(Kdf::create(KeePass2::KDF_AES));
+    QVERIFY(Kdf::create(KeePass2::KDF_ARGON2D));
+    QVERIFY(Kdf::create(KeePass2::KDF_ARGON2ID));
+    QVERIFY(!Kdf::create(Uuid::random()));
+
+    Database db;
+    QCOMPARE(db.kdf()->uuid(), KeePass2::KDF_AES);
+
+    CompositeKey compositeKey;
+    compositeKey.addKey(PasswordKey("test"));
+    QVERIFY(db.setKey(compositeKey));
+    QByteArray aesKey = db.transformedMasterKey();
+
+    QSharedPointer<Kdf> argon2 = Kdf::create(KeePass2::KDF_ARGON2D);
+    QVERIFY(argon2->setRounds(1));
+    QVERIFY(db.setKdf(argon2));
+    QCOMPARE(db.kdf()->uuid(), KeePass2::KDF_ARGON2D);
+    QVERIFY(db.transformedMasterKey() != aesKey);
+}
+
 void TestKeys::benchmarkTransformKey()
 {
     QByteArray env = qgetenv("BENCHMARK");
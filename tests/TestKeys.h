@@ -32,6 +32,9 @@ private slots:
     void testFileKey_data();
     void testCreateFileKey();
     void testFileKeyError();
+    void testAesKdf();
+    void testArgon2Kdf();
+    void testKdfParameters();
     void benchmarkTransformKey();
 };
 
@@ -20,6 +20,10 @@
 #include "sshagent/OpenSSHKey.h"
 #include <QTest>
 
+// bcrypt_pbkdf.cpp
+int bcrypt_pbkdf(const QByteArray& pass, const QByteArray& salt, QByteArray& key, quint32 rounds);
+int bcrypt_pbkdf_parallel(const QByteArray& pass, const QByteArray& salt, QByteArray& key, quint32 rounds);
+
 QTEST_GUILESS_MAIN(TestOpenSSHKey)
 
 void TestOpenSSHKey::initTestCase()
@@ -128,3 +132,58 @@ void TestOpenSSHKey::testDecryptAES256CTR()
     QVERIFY(publicKey.length() == 51);
     QVERIFY(privateKey.length() == 158);
 }
+
+void TestOpenSSHKey::testBcryptPbkdfParallel()
+{
+    const QByteArray pass("correct horse battery staple");
+    const QByteArray salt = QByteArray::fromHex("8b3b5a9c1e2f4d6a7c8e9f0a1b2c3d4e");
+
+    // the key lengths of the supported ciphers and the limits of the output mixing
+    const QList<int> keyLengths = QList<int>() << 1 << 32 << 33 << 48 << 64 << 100 << 1024;
+    for (int keyLength : keyLengths) {
+        QByteArray key(keyLength, '\0');
+        QCOMPARE(bcrypt_pbkdf(pass, salt, key, 4), 0);
+
+        QByteArray parallelKey(keyLength, '\0');
+        QCOMPARE(bcrypt_pbkdf_parallel(pass, salt, parallelKey, 4), 0);
+
+        QCOMPARE(parallelKey, key);
+    }
+
+    QByteArray key(1025, '\0');
+    QCOMPARE(bcrypt_pbkdf_parallel(pass, salt, key, 4), -1);
+    key.resize(48);
+    QCOMPARE(bcrypt_pbkdf_parallel(pass, salt, key, 0), -1);
+    QCOMPARE(bcrypt_pbkdf_parallel(QByteArray(), salt, key, 4), -1);
+}
+
+void TestOpenSSHKey::benchmarkBcryptPbkdf()
+{
+    QByteArray env = qgetenv("BENCHMARK");
+
+    if (env.isEmpty() || env == "0" || env == "no") {
+        QSKIP("Benchmark skipped. Set env variable BENCHMARK=1 to enable.");
+    }
+
+    // aes256-ctr key and iv with the round count of ssh-keygen -a 100
+    QByteArray key(48, '\0');
+
+    QBENCHMARK {
+        bcrypt_pbkdf("password", "saltsaltsaltsalt", key, 100);
+    }
+}
+
+void TestOpenSSHKey::benchmarkBcryptPbkdfParallel()
+{
+    QByteArray env = qgetenv("BENCHMARK");
+
+    if (env.isEmpty() || env == "0" || env == "no") {
+        QSKIP("Benchmark skipped. Set env variable BENCHMARK=1 to enable.");
+    }
+
+    QByteArray key(48, '\0');
+
+    QBENCHMARK {
+        bcrypt_pbkdf_parallel("password", "saltsaltsaltsalt", key, 100);
+    }
+}
@@ -31,6 +31,9 @@ private slots:
     void testParse();
     void testDecryptAES256CBC();
     void testDecryptAES256CTR();
+    void testBcryptPbkdfParallel();
+    void benchmarkBcryptPbkdf();
+    void benchmarkBcryptPbkdfParallel();
 };
 
 #endif // TESTOPENSSHKEY_H
@@ -0,0 +1,212 @@
+/*
+ *  Copyright (C) 2017 KeePassXC Team <team@keepassxc.org>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 or (at your option)
+ *  version 3 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TestPasswordHealth.h"
+
+#include <QTest>
+
+#include "core/Database.h"
+#include "core/Entry.h"
+#include "core/Group.h"
+#include "core/PasswordHealth.h"
+#include "crypto/Crypto.h"
+
+QTEST_GUILESS_MAIN(TestPasswordHealth)
+
+namespace {
+    Entry* createEntry(Group* group, const QString& title, const QString& password)
+    {
+        Entry* entry = new Entry();
+        entry->setUuid(Uuid::random());
+        entry->setGroup(group);
+        entry->setTitle(title);
+        entry->setPassword(password);
+        return entry;
+    }
+
+    PasswordHealth::Report findReport(const QList<PasswordHealth::Report>& reports, const Entry* entry)
+    {
+        for (const PasswordHealth::Report& report : reports) {
+            if (report.entry == entry) {
+                return report;
+            }
+        }
+
+        PasswordHealth::Report report;
+        report.entry = nullptr;
+        report.problems = PasswordHealth::NoProblem;
+        report.entropy = -1;
+        report.reuseCount = 0;
+        return report;
+    }
+}
+
+void TestPasswordHealth::initTestCase()
+{
+    QVERIFY(Crypto::init());
+}
+
+void TestPasswordHealth::testProblems()
+{
+    Database db;
+    Group* root = db.rootGroup();
+
+    Entry* strong = createEntry(root, "strong", "vU4#pQz9!rT2wLx7&mKd");
+    Entry* weak = createEntry(root, "weak", "password");
+    Entry* reused1 = createEntry(root, "reused1", "Plinth-Gravel-Oboe-Fjord-9137");
+    Group* group = new Group();
+    group->setParent(root);
+    Entry* reused2 = createEntry(group, "reused2", "Plinth-Gravel-Oboe-Fjord-9137");
+    Entry* reference = createEntry(root, "reference",
+                                   QString("{REF:P@I:%1}").arg(reused1->uuid().toHex()));
+    Entry* empty = createEntry(root, "empty", "");
+    Entry* expired = createEntry(root, "expired", "aX9$kL2@vB7#nM4!");
+    expired->setExpires(true);
+    expired->setExpiryTime(QDateTime::currentDateTimeUtc().addDays(-1));
+    Entry* recycled = createEntry(root, "recycled", "Plinth-Gravel-Oboe-Fjord-9137");
+    db.recycleEntry(recycled);
+
+    PasswordHealth health;
+    const QList<PasswordHealth::Report> reports = health.analyze(root);
+    QCOMPARE(reports.size(), 7);
+    QVERIFY(!findReport(reports, recycled).entry);
+
+    PasswordHealth::Report report = findReport(reports, strong);
+    QCOMPARE(report.problems, PasswordHealth::Problems(PasswordHealth::NoProblem));
+    QVERIFY(report.entropy >= health.weakEntropy());
+    QCOMPARE(report.reuseCount, 1);
+
+    report = findReport(reports, weak);
+    QCOMPARE(report.problems, PasswordHealth::Problems(PasswordHealth::WeakPassword));
+    QVERIFY(report.entropy < health.weakEntropy());
+
+    report = findReport(reports, reused1);
+    QCOMPARE(report.problems, PasswordHealth::Problems(PasswordHealth::ReusedPassword));
+    QCOMPARE(report.reuseCount, 2);
+    report = findReport(reports, reused2);
+    QCOMPARE(report.problems, PasswordHealth::Problems(PasswordHealth::ReusedPassword));
+    QCOMPARE(report.reuseCount, 2);
+
+    report = findReport(reports, reference);
+    QCOMPARE(report.problems, PasswordHealth::Problems(PasswordHealth::NoProblem));
+    QCOMPARE(report.entropy, -1.0);
+
+    report = findReport(reports, empty);
+    QCOMPARE(report.problems, PasswordHealth::Problems(PasswordHealth::NoProblem));
+    QCOMPARE(report.entropy, -1.0);
+
+    report = findReport(reports, expired);
+    QCOMPARE(report.problems, PasswordHealth::Problems(PasswordHealth::Expired));
+
+    health.setWeakEntropy(1000);
+    report = findReport(health.analyze(root), strong);
+    QCOMPARE(report.problems, PasswordHealth::Problems(PasswordHealth::WeakPassword));
+
+    QCOMPARE(PasswordHealth::problemsToString(PasswordHealth::WeakPassword | PasswordHealth::Expired),
+             QString("Weak password, Expired"));
+}
+
+void TestPasswordHealth::testStalePassword()
+{
+    Database db;
+    Entry* entry = createEntry(db.rootGroup(), "entry", "aX9$kL2@vB7#nM4!");
+    const QDateTime now = QDateTime::currentDateTimeUtc();
+
+    TimeInfo timeInfo = entry->timeInfo();
+    timeInfo.setLastModificationTime(now.addDays(-400));
+    entry->setTimeInfo(timeInfo);
+
+    PasswordHealth health;
+    PasswordHealth::Report report = findReport(health.analyze(db.rootGroup()), entry);
+    QCOMPARE(report.problems, PasswordHealth::Problems(PasswordHealth::StalePassword));
+    QCOMPARE(report.passwordChanged, now.addDays(-400));
+
+    health.setStaleDays(500);
+    report = findReport(health.analyze(db.rootGroup()), entry);
+    QCOMPARE(report.problems, PasswordHealth::Problems(PasswordHealth::NoProblem));
+    health.setStaleDays(365);
+
+    /* editing other fields doesn't change the age of the password */
+    Entry* historyItem = entry->clone(Entry::CloneNoFlags);
+    entry->addHistoryItem(historyItem);
+    entry->setUpdateTimeinfo(false);
+    entry->setTitle("renamed");
+    timeInfo.setLastModificationTime(now.addDays(-10));
+    entry->setTimeInfo(timeInfo);
+
+    report = findReport(health.analyze(db.rootGroup()), entry);
+    QCOMPARE(report.problems, PasswordHealth::Problems(PasswordHealth::StalePassword));
+    QCOMPARE(report.passwordChanged, now.addDays(-400));
+
+    /* a new password is fresh */
+    historyItem = entry->clone(Entry::CloneNoFlags);
+    entry->addHistoryItem(historyItem);
+    entry->setPassword("vU4#pQz9!rT2wLx7&mKd");
+    timeInfo.setLastModificationTime(now.addDays(-5));
+    entry->setTimeInfo(timeInfo);
+
+    report = findReport(health.analyze(db.rootGroup()), entry);
+    QCOMPARE(report.problems, PasswordHealth::Problems(PasswordHealth::NoProblem));
+    QCOMPARE(report.passwordChanged, now.addDays(-5));
+}
+
+void TestPasswordHealth::testIncremental()
+{
+    Database db;
+    Group* root = db.rootGroup();
+    createEntry(root, "entry1", "password1");
+    createEntry(root, "entry2", "password2");
+    Entry* entry3 = createEntry(root, "entry3", "password1");
+
+    PasswordHealth* health = db.passwordHealth();
+    QCOMPARE(health, db.passwordHealth());
+
+    health->analyze(root);
+    QCOMPARE(health->estimatedCount(), 2);
+
+    health->analyze(root);
+    QCOMPARE(health->estimatedCount(), 0);
+
+    entry3->setPassword("password3");
+    const QList<PasswordHealth::Report> reports = health->analyze(root);
+    QCOMPARE(health->estimatedCount(), 1);
+    QCOMPARE(findReport(reports, entry3).reuseCount, 1);
+
+    health->clearCache();
+    health->analyze(root);
+    QCOMPARE(health->estimatedCount(), 3);
+}
+
+void TestPasswordHealth::benchmarkAnalyze()
+{
+    QByteArray env = qgetenv("BENCHMARK");
+
+    if (env.isEmpty() || env == "0" || env == "no") {
+        QSKIP("Benchmark skipped. Set env variable BENCHMARK=1 to enable.");
+    }
+
+    Database db;
+    for (int i = 0; i < 2000; i++) {
+        createEntry(db.rootGroup(), QString("entry%1").arg(i),
+                    QString("%1-Tr0ub4dor&3-%2").arg(i * 7919).arg(i));
+    }
+
+    QBENCHMARK {
+        PasswordHealth health;
+        health.analyze(db.rootGroup());
+    }
+}
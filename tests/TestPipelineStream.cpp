@@ -0,0 +1,134 @@
+/*
+ *  Copyright (C) 2017 KeePassXC Team <team@keepassxc.org>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 or (at your option)
+ *  version 3 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "TestPipelineStream.h"
+
+#include <QBuffer>
+#include <QTest>
+
+#include "FailDevice.h"
+#include "crypto/Crypto.h"
+#include "crypto/Random.h"
+#include "streams/PipelineStream.h"
+
+QTEST_GUILESS_MAIN(TestPipelineStream)
+
+void TestPipelineStream::initTestCase()
+{
+    QVERIFY(Crypto::init());
+}
+
+void TestPipelineStream::testRead()
+{
+    QByteArray data = randomGen()->randomArray(100000);
+
+    QBuffer buffer(&data);
+    QVERIFY(buffer.open(QIODevice::ReadOnly));
+
+    PipelineStream stream(&buffer, 1000, 3);
+    QVERIFY(stream.open(QIODevice::ReadOnly));
+    QVERIFY(!stream.atEnd());
+
+    // reads have to be filled across chunk boundaries
+    QCOMPARE(stream.read(10), data.left(10));
+    QCOMPARE(stream.read(2500), data.mid(10, 2500));
+    QVERIFY(!stream.atEnd());
+    QCOMPARE(stream.read(1), data.mid(2510, 1));
+    QCOMPARE(stream.read(data.size() - 2512), data.mid(2511, data.size() - 2512));
+    QVERIFY(!stream.atEnd());
+    QCOMPARE(stream.readAll(), data.right(1));
+    QCOMPARE(stream.read(1).size(), 0);
+    QVERIFY(stream.atEnd());
+
+    stream.close();
+    QVERIFY(!stream.isOpen());
+}
+
+void TestPipelineStream::testReadError()
+{
+    QByteArray data = randomGen()->randomArray(5000);
+
+    FailDevice failDevice(2048);
+    failDevice.setData(data);
+    QVERIFY(failDevice.open(QIODevice::ReadOnly));
+
+    PipelineStream stream(&failDevice, 1024, 4);
+    QVERIFY(stream.open(QIODevice::ReadOnly));
+
+    // the data read before the error is delivered first
+    QCOMPARE(stream.read(4096), data.left(2048));
+    QCOMPARE(stream.read(1024).size(), 0);
+    QCOMPARE(stream.errorString(), QString("FAILDEVICE"));
+}
+
+void TestPipelineStream::testEarlyClose()
+{
+    QByteArray data = randomGen()->randomArray(100000);
+
+    QBuffer buffer(&data);
+    QVERIFY(buffer.open(QIODevice::ReadOnly));
+
+    // the worker thread is blocked on the full queue and has to be stopped
+    PipelineStream stream(&buffer, 100, 2);
+    QVERIFY(stream.open(QIODevice::ReadOnly));
+    QCOMPARE(stream.read(50), data.left(50));
+    stream.close();
+    QVERIFY(!stream.isOpen());
+
+    buffer.reset();
+    QVERIFY(stream.open(QIODevice::ReadOnly));
+    QCOMPARE(stream.read(150), data.left(150));
+}
+
+void TestPipelineStream::testWrite()
+{
+    QByteArray data = randomGen()->randomArray(100000);
+
+    QBuffer buffer;
+    QVERIFY(buffer.open(QIODevice::WriteOnly));
+
+    PipelineStream stream(&buffer, 1000, 3);
+    QVERIFY(stream.open(QIODevice::WriteOnly));
+
+    QCOMPARE(stream.write(data.left(10)), qint64(10));
+    QCOMPARE(stream.write(data.mid(10, 2500)), qint64(2500));
+    QCOMPARE(stream.write(data.mid(2510, 1)), qint64(1));
+
+    // reset() waits until everything has reached the base device
+    QVERIFY(stream.reset());
+    QCOMPARE(buffer.data(), data.left(2511));
+
+    QCOMPARE(stream.write(data.mid(2511)), qint64(data.size() - 2511));
+    stream.close();
+    QCOMPARE(buffer.data(), data);
+}
+
+void TestPipelineStream::testWriteError()
+{
+    FailDevice failDevice(1500);
+    QVERIFY(failDevice.open(QIODevice::WriteOnly));
+
+    PipelineStream stream(&failDevice, 1000, 2);
+    QVERIFY(stream.open(QIODevice::WriteOnly));
+
+    QByteArray data(5000, 'Z');
+    stream.write(data);
+    QVERIFY(!stream.reset());
+    QCOMPARE(stream.errorString(), QString("FAILDEVICE"));
+    QCOMPARE(stream.write(data), qint64(-1));
+}
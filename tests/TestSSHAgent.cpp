@@ -0,0 +1,222 @@
+/*
+ *  Copyright (C) 2017 KeePassXC Team <team@keepassxc.org>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 or (at your option)
+ *  version 3 of the License.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TestSSHAgent.h"
+
+#include <QAtomicInt>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QSemaphore>
+#include <QTest>
+#include <QThread>
+#include <QtEndian>
+
+#include "sshagent/BinaryStream.h"
+#include "sshagent/SSHAgent.h"
+
+QTEST_GUILESS_MAIN(TestSSHAgent)
+
+/**
+ * An SSH agent on its own thread, since the client blocks while it waits for
+ * the responses. It answers every message with SSH_AGENT_SUCCESS, but only
+ * once it received a whole batch, so a client that waits for each response
+ * before sending the next message leaves the batch incomplete.
+ */
+class FakeAgent : public QThread
+{
+public:
+    explicit FakeAgent(const QString& path)
+        : m_path(path)
+        , m_listening(false)
+    {
+    }
+
+    ~FakeAgent()
+    {
+        m_stop.store(1);
+        wait();
+    }
+
+    bool startListening()
+    {
+        start();
+        m_ready.acquire();
+        return m_listening;
+    }
+
+    QAtomicInt batchSize;
+    QAtomicInt closeAfterBatch;
+    QAtomicInt connections;
+    QAtomicInt messages;
+    QAtomicInt incompleteBatches;
+
+protected:
+    void run() override
+    {
+        QLocalServer server;
+        m_listening = server.listen(m_path);
+        m_ready.release();
+        if (!m_listening) {
+            return;
+        }
+
+        while (!m_stop.load()) {
+            if (!server.waitForNewConnection(100)) {
+                continue;
+            }
+            QScopedPointer<QLocalSocket> socket(server.nextPendingConnection());
+            connections.ref();
+            serve(socket.data());
+        }
+    }
+
+private:
+    static bool readMessage(QLocalSocket* socket, QByteArray& message, int timeout)
+    {
+        while (socket->bytesAvailable() < 4) {
+            if (!socket->waitForReadyRead(timeout)) {
+                return false;
+            }
+        }
+        uchar header[4];
+        socket->read(reinterpret_cast<char*>(header), 4);
+        const qint64 size = qFromBigEndian<quint32>(header);
+        while (socket->bytesAvailable() < size) {
+            if (!socket->waitForReadyRead(1000)) {
+                return false;
+            }
+        }
+        message = socket->read(size);
+        return true;
+    }
+
+    void serve(QLocalSocket* socket)
+    {
+        while (!m_stop.load()) {
+            QByteArray message;
+            if (!readMessage(socket, message, 100)) {
+                if (socket->state() != QLocalSocket::ConnectedState) {
+                    return;
+                }
+                continue;
+            }
+
+            int count = 1;
+            while (count < batchSize.load()) {
+                if (!readMessage(socket, message, 1000)) {
+                    incompleteBatches.ref();
+                    break;
+                }
+                count++;
+            }
+            messages.fetchAndAddRelaxed(count);
+
+            BinaryStream stream(socket);
+            for (int i = 0; i < count; ++i) {
+                stream.writeString(QByteArray(1, static_cast<char>(6)));
+            }
+            stream.flush();
+
+            if (closeAfterBatch.load()) {
+                socket->disconnectFromServer();
+                return;
+            }
+        }
+    }
+
+    const QString m_path;
+    bool m_listening;
+    QAtomicInt m_stop;
+    QSemaphore m_ready;
+};
+
+namespace {
+    QList<QByteArray> createRequests(int count)
+    {
+        QList<QByteArray> requests;
+        for (int i = 0; i < count; ++i) {
+            // SSH_AGENTC_REQUEST_IDENTITIES, the agent doesn't look at the content
+            requests << QByteArray(1, static_cast<char>(11)) + QByteArray::number(i);
+        }
+        return requests;
+    }
+}
+
+void TestSSHAgent::initTestCase()
+{
+    QVERIFY(m_dir.isValid());
+    const QString path = m_dir.path() + "/agent.socket";
+    m_agent.reset(new FakeAgent(path));
+    QVERIFY(m_agent->startListening());
+
+    qputenv("SSH_AUTH_SOCK", path.toLocal8Bit());
+    SSHAgent::init(this);
+    QVERIFY(SSHAgent::instance()->isAgentRunning());
+}
+
+void TestSSHAgent::cleanupTestCase()
+{
+    m_agent.reset();
+}
+
+void TestSSHAgent::testPipelining()
+{
+    m_agent->batchSize.store(5);
+    m_agent->closeAfterBatch.store(0);
+    const int connections = m_agent->connections.load();
+    const int messages = m_agent->messages.load();
+
+    QList<QByteArray> responses;
+    QVERIFY(SSHAgent::instance()->sendMessages(createRequests(5), responses));
+    QCOMPARE(responses.size(), 5);
+    for (const QByteArray& response : responses) {
+        QCOMPARE(response, QByteArray(1, static_cast<char>(6)));
+    }
+    QCOMPARE(m_agent->incompleteBatches.load(), 0);
+
+    // the next batch goes over the same connection
+    QVERIFY(SSHAgent::instance()->sendMessages(createRequests(5), responses));
+    QCOMPARE(responses.size(), 5);
+    QCOMPARE(m_agent->incompleteBatches.load(), 0);
+    QCOMPARE(m_agent->connections.load(), connections + 1);
+    QCOMPARE(m_agent->messages.load(), messages + 10);
+
+    // so do single messages
+    QVERIFY(SSHAgent::instance()->sendMessages(createRequests(1), responses));
+    QCOMPARE(m_agent->connections.load(), connections + 1);
+}
+
+void TestSSHAgent::testReconnect()
+{
+    m_agent->batchSize.store(2);
+    m_agent->closeAfterBatch.store(1);
+
+    // the agent closes the connection after answering
+    QList<QByteArray> responses;
+    QVERIFY(SSHAgent::instance()->sendMessages(createRequests(2), responses));
+    QCOMPARE(responses.size(), 2);
+    const int connections = m_agent->connections.load();
+
+    // the stale connection fails and the batch is sent again on a new one
+    QVERIFY(SSHAgent::instance()->sendMessages(createRequests(2), responses));
+    QCOMPARE(responses.size(), 2);
+    for (const QByteArray& response : responses) {
+        QCOMPARE(response, QByteArray(1, static_cast<char>(6)));
+    }
+    QCOMPARE(m_agent->connections.load(), connections + 1);
+    QCOMPARE(m_agent->incompleteBatches.load(), 0);
+}
@@ -22,6 +22,7 @@
 #include <QTest>
 
 #include "crypto/Crypto.h"
+#include "crypto/Random.h"
 #include "crypto/SymmetricCipher.h"
 #include "streams/SymmetricCipherStream.h"
 
@@ -342,6 +343,72 @@ void TestSymmetricCipher::testSalsa20()
     QCOMPARE(cipherTextB.mid(448, 64), expectedCipherText4);
 }
 
+void TestSymmetricCipher::testChaCha20()
+{
+    // https://tools.ietf.org/html/rfc7539#appendix-A.1
+
+    QByteArray key(32, '\0');
+    QByteArray iv(12, '\0');
+    bool ok;
+
+    SymmetricCipher cipher(SymmetricCipher::ChaCha20, SymmetricCipher::Stream, SymmetricCipher::Encrypt);
+    QVERIFY(cipher.init(key, iv));
+
+    QByteArray cipherText = cipher.process(QByteArray(128, '\0'), &ok);
+    QVERIFY(ok);
+
+    QByteArray expectedCipherText;
+    expectedCipherText.append(QByteArray::fromHex("76B8E0ADA0F13D90405D6AE55386BD28"));
+    expectedCipherText.append(QByteArray::fromHex("BDD219B8A08DED1AA836EFCC8B770DC7"));
+    expectedCipherText.append(QByteArray::fromHex("DA41597C5157488D7724E03FB8D84A37"));
+    expectedCipherText.append(QByteArray::fromHex("6A43B8F41518A11CC387B669B2EE6586"));
+    expectedCipherText.append(QByteArray::fromHex("9F07E7BE5551387A98BA977C732D080D"));
+    expectedCipherText.append(QByteArray::fromHex("CB0F29A048E3656912C6533E32EE7AED"));
+    expectedCipherText.append(QByteArray::fromHex("29B721769CE64E43D57133B074D839D5"));
+    expectedCipherText.append(QByteArray::fromHex("31ED1F28510AFB45ACE10A1F4B794D6F"));
+
+    QCOMPARE(cipherText, expectedCipherText);
+}
+
+void TestSymmetricCipher::testChaCha20Stream()
+{
+    QByteArray key(32, '\0');
+    QByteArray iv(12, '\0');
+    QByteArray plainText(131, '\0');
+
+    QBuffer buffer;
+    QVERIFY(buffer.open(QIODevice::ReadWrite));
+
+    // odd write sizes must not disturb the keystream
+    SymmetricCipherStream streamEnc(&buffer, SymmetricCipher::ChaCha20, SymmetricCipher::Stream,
+                                    SymmetricCipher::Encrypt, 48);
+    QVERIFY(streamEnc.init(key, iv));
+    QVERIFY(streamEnc.open(QIODevice::WriteOnly));
+    for (int pos = 0; pos < plainText.size(); pos += 7) {
+        QByteArray part = plainText.mid(pos, 7);
+        QCOMPARE(streamEnc.write(part), static_cast<qint64>(part.size()));
+    }
+    streamEnc.close();
+
+    // stream ciphers aren't padded
+    QCOMPARE(buffer.buffer().size(), plainText.size());
+    QCOMPARE(buffer.buffer().left(32),
+             QByteArray::fromHex("76B8E0ADA0F13D90405D6AE55386BD28BDD219B8A08DED1AA836EFCC8B770DC7"));
+
+    buffer.reset();
+    SymmetricCipherStream streamDec(&buffer, SymmetricCipher::ChaCha20, SymmetricCipher::Stream,
+                                    SymmetricCipher::Decrypt, 48);
+    QVERIFY(streamDec.init(key, iv));
+    QVERIFY(streamDec.open(QIODevice::ReadOnly));
+    QByteArray decrypted;
+    QByteArray part;
+    do {
+        part = streamDec.read(5);
+        decrypted.append(part);
+    } while (!part.isEmpty());
+    QCOMPARE(decrypted, plainText);
+}
+
 void TestSymmetricCipher::testPadding()
 {
     QByteArray key = QByteArray::fromHex("603deb1015ca71be2b73aef0857d77811f352c073b6108d72d9810a30914dff4");
@@ -387,3 +454,69 @@ void TestSymmetricCipher::testStreamReset()
     writer.close();
     QCOMPARE(buffer.buffer().size(), 16);
 }
+
+void TestSymmetricCipher::testStreamChunks_data()
+{
+    QTest::addColumn<int>("chunkSize");
+    QTest::addColumn<int>("dataSize");
+    QTest::addColumn<int>("ioSize");
+
+    QTest::newRow("tiny chunk, unaligned data") << 1 << 1000 << 7;
+    QTest::newRow("small chunk, aligned data") << 64 << 1024 << 100;
+    QTest::newRow("small chunk, data fills chunk") << 64 << 64 << 64;
+    QTest::newRow("small chunk, unaligned chunk") << 70 << 333 << 1;
+    QTest::newRow("default chunk, large data")
+        << static_cast<int>(SymmetricCipherStream::DefaultChunkSize) << 200000 << 4096;
+    QTest::newRow("default chunk, multiple of chunk")
+        << static_cast<int>(SymmetricCipherStream::DefaultChunkSize) << 2 * 65536 << 65536;
+}
+
+void TestSymmetricCipher::testStreamChunks()
+{
+    QFETCH(int, chunkSize);
+    QFETCH(int, dataSize);
+    QFETCH(int, ioSize);
+
+    QByteArray key = QByteArray::fromHex("603deb1015ca71be2b73aef0857d77811f352c073b6108d72d9810a30914dff4");
+    QByteArray iv = QByteArray::fromHex("000102030405060708090a0b0c0d0e0f");
+    QByteArray plainText = randomGen()->randomArray(dataSize);
+    bool ok;
+
+    QBuffer buffer;
+    QVERIFY(buffer.open(QIODevice::ReadWrite));
+
+    SymmetricCipherStream streamEnc(&buffer, SymmetricCipher::Aes256, SymmetricCipher::Cbc,
+                                    SymmetricCipher::Encrypt, chunkSize);
+    QCOMPARE(streamEnc.chunkSize() % 16, 0);
+    QVERIFY(streamEnc.chunkSize() >= 32);
+    QVERIFY(streamEnc.init(key, iv));
+    QVERIFY(streamEnc.open(QIODevice::WriteOnly));
+    for (int pos = 0; pos < plainText.size(); pos += ioSize) {
+        QByteArray part = plainText.mid(pos, ioSize);
+        QCOMPARE(streamEnc.write(part), static_cast<qint64>(part.size()));
+    }
+    QVERIFY(streamEnc.reset());
+    streamEnc.close();
+
+    // the stream must produce the same output as a single call to the cipher
+    QByteArray padded = plainText;
+    int padLen = 16 - (plainText.size() % 16);
+    padded.append(QByteArray(padLen, static_cast<char>(padLen)));
+    SymmetricCipher cipher(SymmetricCipher::Aes256, SymmetricCipher::Cbc, SymmetricCipher::Encrypt);
+    QVERIFY(cipher.init(key, iv));
+    QCOMPARE(buffer.buffer(), cipher.process(padded, &ok));
+    QVERIFY(ok);
+
+    buffer.reset();
+    SymmetricCipherStream streamDec(&buffer, SymmetricCipher::Aes256, SymmetricCipher::Cbc,
+                                    SymmetricCipher::Decrypt, chunkSize);
+    QVERIFY(streamDec.init(key, iv));
+    QVERIFY(streamDec.open(QIODevice::ReadOnly));
+    QByteArray decrypted;
+    QByteArray part;
+    do {
+        part = streamDec.read(ioSize);
+        decrypted.append(part);
+    } while (!part.isEmpty());
+    QCOMPARE(decrypted, plainText);
+}
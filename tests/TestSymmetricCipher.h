@@ -34,8 +34,12 @@ private slots:
     void testTwofish256CbcEncryption();
     void testTwofish256CbcDecryption();
     void testSalsa20();
+    void testChaCha20();
+    void testChaCha20Stream();
     void testPadding();
     void testStreamReset();
+    void testStreamChunks_data();
+    void testStreamChunks();
 };
 
 #endif // KEEPASSX_TESTSYMMETRICCIPHER_H